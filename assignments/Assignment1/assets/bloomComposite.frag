@@ -0,0 +1,12 @@
+#version 450
+out vec4 FragColor;
+in vec2 UV;
+uniform sampler2D _ColorBuffer;
+uniform sampler2D _BloomBuffer;
+
+uniform float _Intensity = 1.0;
+
+void main(){
+	vec3 color = texture(_ColorBuffer,UV).rgb + texture(_BloomBuffer,UV).rgb * _Intensity;
+	FragColor = vec4(color, 1.0);
+}
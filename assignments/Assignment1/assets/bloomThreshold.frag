@@ -0,0 +1,16 @@
+#version 450
+out vec4 FragColor;
+in vec2 UV;
+uniform sampler2D _ColorBuffer;
+
+uniform float _Threshold = 0.8;
+uniform float _Knee = 0.2; //Soft transition width around the threshold
+
+void main(){
+	vec3 color = texture(_ColorBuffer,UV).rgb;
+	float brightness = max(color.r, max(color.g, color.b));
+	float soft = clamp(brightness - _Threshold + _Knee, 0.0, 2.0 * _Knee);
+	soft = soft * soft / (4.0 * _Knee + 0.00001);
+	float contribution = max(soft, brightness - _Threshold) / max(brightness, 0.00001);
+	FragColor = vec4(color * contribution, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 450
+out vec4 FragColor;
+in vec2 UV;
+uniform sampler2D _ColorBuffer;
+
+//One direction of a separable gaussian. Neighbouring kernel taps are merged into a single
+//bilinear fetch placed between them, so a radius R kernel needs 1 + R/2 fetches per side.
+#define MAX_TAPS 16
+uniform vec2 _Direction; //Texel step along the blur axis, in UV units
+uniform int _NumTaps;
+uniform float _Offsets[MAX_TAPS];
+uniform float _Weights[MAX_TAPS];
+
+void main(){
+	vec3 color = texture(_ColorBuffer,UV).rgb * _Weights[0];
+	for(int i = 1; i < _NumTaps; i++){
+		vec2 offset = _Direction * _Offsets[i];
+		color += (texture(_ColorBuffer,UV + offset).rgb + texture(_ColorBuffer,UV - offset).rgb) * _Weights[i];
+	}
+	FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 450
+out vec4 FragColor;
+in vec2 UV;
+uniform sampler2D _ColorBuffer;
+
+//Dual Kawase downsample: center + 4 diagonal bilinear taps, written at half the source size
+uniform float _Offset = 1.0;
+
+void main(){
+	vec2 halfTexel = 0.5 / vec2(textureSize(_ColorBuffer,0)) * _Offset;
+	vec3 sum = texture(_ColorBuffer,UV).rgb * 4.0;
+	sum += texture(_ColorBuffer,UV - halfTexel).rgb;
+	sum += texture(_ColorBuffer,UV + halfTexel).rgb;
+	sum += texture(_ColorBuffer,UV + vec2(halfTexel.x,-halfTexel.y)).rgb;
+	sum += texture(_ColorBuffer,UV - vec2(halfTexel.x,-halfTexel.y)).rgb;
+	FragColor = vec4(sum / 8.0, 1.0);
+}
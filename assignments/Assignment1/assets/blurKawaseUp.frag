@@ -0,0 +1,20 @@
+#version 450
+out vec4 FragColor;
+in vec2 UV;
+uniform sampler2D _ColorBuffer;
+
+//Dual Kawase upsample: 8 bilinear taps in a ring around the pixel, written at twice the source size
+uniform float _Offset = 1.0;
+
+void main(){
+	vec2 halfTexel = 0.5 / vec2(textureSize(_ColorBuffer,0)) * _Offset;
+	vec3 sum = texture(_ColorBuffer,UV + vec2(-halfTexel.x * 2.0, 0.0)).rgb;
+	sum += texture(_ColorBuffer,UV + vec2(-halfTexel.x, halfTexel.y)).rgb * 2.0;
+	sum += texture(_ColorBuffer,UV + vec2(0.0, halfTexel.y * 2.0)).rgb;
+	sum += texture(_ColorBuffer,UV + vec2(halfTexel.x, halfTexel.y)).rgb * 2.0;
+	sum += texture(_ColorBuffer,UV + vec2(halfTexel.x * 2.0, 0.0)).rgb;
+	sum += texture(_ColorBuffer,UV + vec2(halfTexel.x, -halfTexel.y)).rgb * 2.0;
+	sum += texture(_ColorBuffer,UV + vec2(0.0, -halfTexel.y * 2.0)).rgb;
+	sum += texture(_ColorBuffer,UV + vec2(-halfTexel.x, -halfTexel.y)).rgb * 2.0;
+	FragColor = vec4(sum / 12.0, 1.0);
+}
@@ -11,16 +11,6 @@ void main(){
 //https://www.youtube.com/watch?v=3CsNRBme6nU
 vec3 color = texture(_ColorBuffer,UV).rgb;
 
-//vec2 texelSize = 1.0 / textureSize(_ColorBuffer,0).xy;
-//vec3 totalColor = vec3(0);
-//for(int y = -2; y <= 2; y++){
-//   for(int x = -2; x <= 2; x++){
-//      vec2 offset = vec2(x,y) * texelSize;
-//      totalColor += texture(_ColorBuffer,UV + offset).rgb;
-//   }
-//}
-//totalColor/=(5 * 5);
-//FragColor = vec4(totalColor,1.0);
 	float red = texture(_ColorBuffer,UV - _Red).g;
 	float blue = texture(_ColorBuffer,UV - _Blue).b;
 
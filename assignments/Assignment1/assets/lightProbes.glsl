@@ -0,0 +1,60 @@
+//Irradiance probes from ew::LightProbeGrid. Coefficients are L2 spherical harmonics already convolved with
+//the cosine lobe, divided by pi and scaled by the basis constants, so only the basis polynomials are evaluated
+
+//Matches the uniform layout in lightProbes.cpp
+const int MAX_LIGHT_PROBES = 96;
+const int MAX_PROBE_OBJECTS = 8;
+layout(std140, binding = 0) uniform LightProbes{
+	vec4 _ProbeGridMin; //World position of the first probe
+	vec4 _ProbeGridInvSpacing; //0 along axes with a single probe
+	ivec4 _ProbeGridCount; //w = total probes
+	vec4 _ObjectProbes[MAX_PROBE_OBJECTS * 9]; //Grid interpolated at each object's position on the CPU
+	vec4 _Probes[MAX_LIGHT_PROBES * 9]; //x fastest, then y, then z
+};
+
+void shBasis(vec3 n, out float b[9]){
+	b[0] = 1.0;
+	b[1] = n.y;
+	b[2] = n.z;
+	b[3] = n.x;
+	b[4] = n.x * n.y;
+	b[5] = n.y * n.z;
+	b[6] = 3.0 * n.z * n.z - 1.0;
+	b[7] = n.x * n.z;
+	b[8] = n.x * n.x - n.y * n.y;
+}
+
+//Diffuse ambient light for normal n, from an object's slot
+vec3 objectIrradiance(int object, vec3 n){
+	float b[9];
+	shBasis(n, b);
+	vec3 result = vec3(0.0);
+	for(int i = 0; i < 9; i++){
+		result += _ObjectProbes[object * 9 + i].rgb * b[i];
+	}
+	return result;
+}
+
+//Diffuse ambient light for normal n, interpolated between the 8 probes around worldPos
+vec3 gridIrradiance(vec3 worldPos, vec3 n){
+	ivec3 maxIndex = _ProbeGridCount.xyz - 1;
+	vec3 grid = clamp((worldPos - _ProbeGridMin.xyz) * _ProbeGridInvSpacing.xyz, vec3(0.0), vec3(maxIndex));
+	ivec3 i0 = ivec3(grid);
+	ivec3 i1 = min(i0 + 1, maxIndex);
+	vec3 f = grid - vec3(i0);
+	float b[9];
+	shBasis(n, b);
+	vec3 result = vec3(0.0);
+	for(int corner = 0; corner < 8; corner++){
+		bvec3 upper = bvec3((corner & 1) != 0, (corner & 2) != 0, (corner & 4) != 0);
+		ivec3 i = mix(i0, i1, upper);
+		vec3 w = mix(1.0 - f, f, upper);
+		int first = (i.x + (i.y + i.z * _ProbeGridCount.y) * _ProbeGridCount.x) * 9;
+		vec3 irradiance = vec3(0.0);
+		for(int k = 0; k < 9; k++){
+			irradiance += _Probes[first + k].rgb * b[k];
+		}
+		result += irradiance * (w.x * w.y * w.z);
+	}
+	return result;
+}
@@ -11,6 +11,18 @@ uniform vec3 _EyePos;
 uniform vec3 _LightDirection = vec3(0.0,-1.0,0.0);
 uniform vec3 _LightColor = vec3(1.0);
 uniform vec3 _AmbientColor = vec3(0.3,0.4,0.46);
+#ifdef LIGHT_PROBES_OBJECT
+//Ambient light from the probe grid, sampled at the object's position
+#include "lightProbes.glsl"
+uniform int _ProbeObject; //Object's slot in _ObjectProbes
+#endif
+#ifdef LIGHT_PROBES_VERTEX
+in vec3 ProbeAmbient;
+#endif
+#ifdef AMBIENT_OCCLUSION
+//Full resolution visibility from ew::AmbientOcclusion, same size and viewport as the scene target
+uniform sampler2D _AmbientOcclusion;
+#endif
 
 struct Material{
 	float Ka; //Ambient coefficient (0-1)
@@ -20,20 +32,83 @@ struct Material{
 };
 uniform Material _Material;
 
+//Clustered point and spot lights (see ew::ClusteredLighting)
+struct Light{
+	vec4 positionRadius; //World space
+	vec4 color; //rgb = color * intensity, a = cos of inner spot angle
+	vec4 directionCosOuter; //w = cos of outer spot angle, below -1 for point lights
+};
+layout(std430, binding = 0) readonly buffer LightBuffer{
+	Light _Lights[];
+};
+layout(std430, binding = 1) readonly buffer ClusterBuffer{
+	uvec2 _Clusters[]; //Offset into _LightIndices, light count
+};
+layout(std430, binding = 2) readonly buffer LightIndexBuffer{
+	uint _LightIndices[];
+};
+uniform mat4 _View;
+uniform vec3 _ClusterDims;
+uniform vec2 _ClusterDepthParams; //Depth slice = log(view depth) * x + y
+uniform vec2 _ViewportSize;
+
+uint clusterIndex(vec3 worldPos){
+	float depth = -(_View * vec4(worldPos,1.0)).z;
+	uvec3 dims = uvec3(_ClusterDims);
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / _ViewportSize * _ClusterDims.xy), dims.xy - 1u);
+	uint slice = uint(clamp(log(depth) * _ClusterDepthParams.x + _ClusterDepthParams.y, 0.0, _ClusterDims.z - 1.0));
+	return tile.x + tile.y * dims.x + slice * dims.x * dims.y;
+}
+
+//Blinn-phong diffuse + specular from one light direction
+float blinnPhong(vec3 normal, vec3 toLight, vec3 toEye){
+	float diffuseFactor = max(dot(normal,toLight),0.0);
+	vec3 h = normalize(toLight + toEye);
+	float specularFactor = pow(max(dot(normal,h),0.0),_Material.Shininess);
+	return _Material.Kd * diffuseFactor + _Material.Ks * specularFactor;
+}
+
+vec3 clusteredLights(vec3 worldPos, vec3 normal, vec3 toEye){
+	vec3 result = vec3(0.0);
+	uvec2 cluster = _Clusters[clusterIndex(worldPos)];
+	for(uint i = 0u; i < cluster.y; i++){
+		Light light = _Lights[_LightIndices[cluster.x + i]];
+		vec3 toLight = light.positionRadius.xyz - worldPos;
+		float dist = length(toLight);
+		toLight /= max(dist, 1e-4);
+		//Inverse square, windowed to reach 0 at the light's radius
+		float window = clamp(1.0 - pow(dist / light.positionRadius.w, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (dist * dist + 1.0);
+		float cosOuter = light.directionCosOuter.w;
+		if(cosOuter >= -1.0){
+			float cosAngle = dot(-toLight, light.directionCosOuter.xyz);
+			attenuation *= smoothstep(cosOuter, light.color.a, cosAngle);
+		}
+		result += blinnPhong(normal, toLight, toEye) * light.color.rgb * attenuation;
+	}
+	return result;
+}
+
 void main(){
 	//Make sure fragment normal is still length 1 after interpolation.
 	vec3 normal = normalize(fs_in.WorldNormal);
 	//Light pointing straight down
 	vec3 toLight = -_LightDirection;
-	float diffuseFactor = max(dot(normal,toLight),0.0);
-	//Calculate specularly reflected light
 	vec3 toEye = normalize(_EyePos - fs_in.WorldPos);
-	//Blinn-phong uses half angle
-	vec3 h = normalize(toLight + toEye);
-	float specularFactor = pow(max(dot(normal,h),0.0),_Material.Shininess);
 	//Combination of specular and diffuse reflection
-	vec3 lightColor = (_Material.Kd * diffuseFactor + _Material.Ks * specularFactor) * _LightColor;
-	lightColor+=_AmbientColor * _Material.Ka;
+	vec3 lightColor = blinnPhong(normal, toLight, toEye) * _LightColor;
+	lightColor += clusteredLights(fs_in.WorldPos, normal, toEye);
+	float ambientVisibility = 1.0;
+#ifdef AMBIENT_OCCLUSION
+	ambientVisibility = texelFetch(_AmbientOcclusion, ivec2(gl_FragCoord.xy), 0).r;
+#endif
+	vec3 ambientColor = _AmbientColor;
+#if defined(LIGHT_PROBES_OBJECT)
+	ambientColor = objectIrradiance(_ProbeObject, normal);
+#elif defined(LIGHT_PROBES_VERTEX)
+	ambientColor = ProbeAmbient;
+#endif
+	lightColor+=ambientColor * _Material.Ka * ambientVisibility;
 	vec3 objectColor = texture(_MainTex,fs_in.TexCoord).rgb;
 	FragColor = vec4(objectColor * lightColor,1.0);
 }
@@ -13,6 +13,16 @@ out Surface{
 	vec2 TexCoord;
 }vs_out;
 
+#ifdef LIGHT_PROBES_VERTEX
+//Ambient light from the probe grid, interpolated per vertex to keep the fragment shader as cheap as the constant
+#include "lightProbes.glsl"
+out vec3 ProbeAmbient;
+#endif
+
+//The ambient occlusion pre-pass draws with this shader too. The scene pass tests against its depth,
+//so both programs must compute positions bit for bit the same
+invariant gl_Position;
+
 void main(){
 	//Transform vertex position to World Space.
 vs_out.WorldPos = vec3(_Model * vec4(vPos,1.0));
@@ -20,5 +30,8 @@ vs_out.WorldPos = vec3(_Model * vec4(vPos,1.0));
 	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * vNormal;
 
 vs_out.TexCoord = vTexCoord;
+#ifdef LIGHT_PROBES_VERTEX
+	ProbeAmbient = gridIrradiance(vs_out.WorldPos, normalize(vs_out.WorldNormal));
+#endif
 gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
 }
@@ -0,0 +1,9 @@
+#version 450
+out vec4 FragColor;
+in vec2 UV;
+uniform sampler2D _ColorBuffer;
+
+//Final copy of the post process chain into the backbuffer
+void main(){
+	FragColor = vec4(texture(_ColorBuffer,UV).rgb, 1.0);
+}
@@ -0,0 +1,52 @@
+#version 450
+//Alchemy ambient obscurance (McGuire et al. 2011) on the downsampled depth and normals, see ew::AmbientOcclusion
+layout(location = 0) out vec2 Occlusion; //x = visibility (1 = unoccluded), y = view depth for the blur
+
+uniform sampler2D _Depth; //Positive view depth
+uniform sampler2D _Normals;
+uniform vec2 _ViewportSize;
+uniform vec2 _ProjectionScale; //tan(fov / 2) * aspect, tan(fov / 2)
+uniform float _PixelsPerUnit; //At a view depth of 1
+uniform int _NumSamples;
+uniform float _Radius;
+uniform float _Intensity;
+uniform float _Bias;
+
+const float SPIRAL_TURNS = 7.0;
+//Rotation order of the 4x4 interleaved pattern. Neighbouring pixels get very different rotations,
+//so the blur averages every rotation within a few texels
+const int PATTERN[16] = int[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+
+vec3 viewPosition(ivec2 pixel, float depth){
+	vec2 ndc = (vec2(pixel) + 0.5) / _ViewportSize * 2.0 - 1.0;
+	return vec3(ndc * _ProjectionScale * depth, -depth);
+}
+
+void main(){
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 viewportMax = ivec2(_ViewportSize) - 1;
+	float depth = texelFetch(_Depth, pixel, 0).r;
+	vec3 position = viewPosition(pixel, depth);
+	vec3 normal = normalize(texelFetch(_Normals, pixel, 0).xyz * 2.0 - 1.0);
+
+	float rotation = float(PATTERN[(pixel.x & 3) + (pixel.y & 3) * 4]) * (6.28318530718 / 16.0);
+	float screenRadius = _Radius * _PixelsPerUnit / depth;
+	float radius2 = _Radius * _Radius;
+	float sum = 0.0;
+	//Samples closer than a pixel all land on the center
+	if(screenRadius >= 1.0){
+		for(int i = 0; i < _NumSamples; i++){
+			float alpha = (float(i) + 0.5) / float(_NumSamples);
+			float angle = alpha * SPIRAL_TURNS * 6.28318530718 + rotation;
+			ivec2 samplePixel = clamp(pixel + ivec2(vec2(cos(angle), sin(angle)) * alpha * screenRadius), ivec2(0), viewportMax);
+			vec3 v = viewPosition(samplePixel, texelFetch(_Depth, samplePixel, 0).r) - position;
+			float vv = dot(v, v);
+			float vn = dot(v, normal);
+			//Falls off smoothly to 0 at the radius
+			float f = max(radius2 - vv, 0.0);
+			sum += f * f * f * max((vn - _Bias) / (vv + 0.01), 0.0);
+		}
+	}
+	float visibility = max(0.0, 1.0 - sum * _Intensity * 5.0 / (radius2 * radius2 * radius2 * float(_NumSamples)));
+	Occlusion = vec2(visibility, depth);
+}
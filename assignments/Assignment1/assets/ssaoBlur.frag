@@ -0,0 +1,31 @@
+#version 450
+//One direction of a separable, depth aware gaussian over occlusion, see ew::AmbientOcclusion
+layout(location = 0) out vec2 Occlusion; //x = visibility, y = view depth, passed through
+
+uniform sampler2D _Source; //x = visibility, y = view depth
+uniform vec2 _Direction;
+uniform int _Radius;
+uniform vec2 _ViewportMax; //Last pixel of the viewport
+uniform float _Sharpness;
+
+void main(){
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 direction = ivec2(_Direction);
+	ivec2 viewportMax = ivec2(_ViewportMax);
+	vec2 center = texelFetch(_Source, pixel, 0).xy;
+	float sigma = float(_Radius) * 0.5 + 0.5;
+	float total = center.x;
+	float totalWeight = 1.0;
+	for(int i = -_Radius; i <= _Radius; i++){
+		if(i == 0){
+			continue;
+		}
+		vec2 tap = texelFetch(_Source, clamp(pixel + direction * i, ivec2(0), viewportMax), 0).xy;
+		//Taps across a depth edge get no weight, so occlusion doesn't bleed onto the other surface
+		float depthWeight = exp(-abs(tap.y - center.y) / center.y * _Sharpness);
+		float weight = exp(-float(i * i) / (2.0 * sigma * sigma)) * depthWeight;
+		total += tap.x * weight;
+		totalWeight += weight;
+	}
+	Occlusion = vec2(total / totalWeight, center.y);
+}
@@ -0,0 +1,37 @@
+#version 450
+//Linearizes depth and keeps one full resolution texel per low resolution pixel, see ew::AmbientOcclusion
+layout(location = 0) out float Depth; //Positive view depth
+layout(location = 1) out vec4 Normal; //View space normal * 0.5 + 0.5, of the texel depth was taken from
+
+uniform sampler2D _Depth;
+uniform sampler2D _Normals;
+uniform int _Factor; //Full resolution pixels per low resolution pixel, along each axis
+uniform vec2 _SourceMax; //Last pixel of the full resolution viewport
+uniform vec2 _NearFar;
+
+float linearDepth(float depth){
+	float ndc = depth * 2.0 - 1.0;
+	return 2.0 * _NearFar.x * _NearFar.y / (_NearFar.y + _NearFar.x - ndc * (_NearFar.y - _NearFar.x));
+}
+
+void main(){
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 sourceMax = ivec2(_SourceMax);
+	ivec2 base = pixel * _Factor;
+	//Nearest and farthest alternate in a checkerboard, so thin surfaces in front of and behind others both survive
+	bool nearest = ((pixel.x + pixel.y) & 1) == 0;
+	ivec2 best = min(base, sourceMax);
+	float bestDepth = linearDepth(texelFetch(_Depth, best, 0).r);
+	for(int y = 0; y < _Factor; y++){
+		for(int x = 0; x < _Factor; x++){
+			ivec2 source = min(base + ivec2(x, y), sourceMax);
+			float depth = linearDepth(texelFetch(_Depth, source, 0).r);
+			if(nearest ? depth < bestDepth : depth > bestDepth){
+				best = source;
+				bestDepth = depth;
+			}
+		}
+	}
+	Depth = bestDepth;
+	Normal = texelFetch(_Normals, best, 0);
+}
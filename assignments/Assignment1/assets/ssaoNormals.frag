@@ -0,0 +1,15 @@
+#version 450
+//Depth/normal pre-pass for ambient occlusion. Writes view space normals
+out vec4 FragColor;
+in Surface{
+	vec3 WorldPos;
+	vec3 WorldNormal;
+	vec2 TexCoord;
+}fs_in;
+
+uniform mat4 _View;
+
+void main(){
+	vec3 normal = normalize(mat3(_View) * normalize(fs_in.WorldNormal));
+	FragColor = vec4(normal * 0.5 + 0.5, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 450
+//Joint bilateral upsample of blurred occlusion to full resolution, see ew::AmbientOcclusion
+layout(location = 0) out float Occlusion;
+
+uniform sampler2D _Depth; //Full resolution depth buffer
+uniform sampler2D _Source; //x = visibility, y = view depth, at low resolution
+uniform int _Factor; //Full resolution pixels per low resolution pixel, along each axis
+uniform vec2 _SourceMax; //Last pixel of the low resolution viewport
+uniform vec2 _NearFar;
+uniform float _Sharpness;
+
+float linearDepth(float depth){
+	float ndc = depth * 2.0 - 1.0;
+	return 2.0 * _NearFar.x * _NearFar.y / (_NearFar.y + _NearFar.x - ndc * (_NearFar.y - _NearFar.x));
+}
+
+void main(){
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 sourceMax = ivec2(_SourceMax);
+	float depth = linearDepth(texelFetch(_Depth, pixel, 0).r);
+	vec2 sourcePos = (vec2(pixel) + 0.5) / float(_Factor) - 0.5;
+	ivec2 base = ivec2(floor(sourcePos));
+	vec2 f = sourcePos - vec2(base);
+	float total = 0.0;
+	float totalWeight = 0.0;
+	for(int i = 0; i < 4; i++){
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec2 tap = texelFetch(_Source, clamp(base + offset, ivec2(0), sourceMax), 0).xy;
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		//Small floor so a pixel whose depth matches no tap still gets the bilinear result
+		float weight = bilinear.x * bilinear.y * (exp(-abs(tap.y - depth) / depth * _Sharpness) + 1e-4);
+		total += tap.x * weight;
+		totalWeight += weight;
+	}
+	Occlusion = total / max(totalWeight, 1e-6);
+}
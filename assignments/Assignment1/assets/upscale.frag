@@ -0,0 +1,30 @@
+#version 450
+out vec4 FragColor;
+in vec2 UV;
+uniform sampler2D _ColorBuffer;
+
+//Scene was rendered into the bottom-left _ViewportScale portion of _ColorBuffer.
+//Upscale bilinearly, optionally sharpening with a clamped 5-tap unsharp mask.
+uniform vec2 _ViewportScale = vec2(1.0);
+uniform float _Sharpness = 0.0;
+
+void main(){
+	vec2 texelSize = 1.0 / vec2(textureSize(_ColorBuffer,0));
+	//Keep bilinear taps inside the rendered region so unrendered texels never bleed in
+	vec2 maxUV = _ViewportScale - texelSize * 0.5;
+	vec2 uv = min(UV * _ViewportScale, maxUV);
+	vec3 center = texture(_ColorBuffer,uv).rgb;
+	if(_Sharpness <= 0.0){
+		FragColor = vec4(center, 1.0);
+		return;
+	}
+	vec3 left = texture(_ColorBuffer,clamp(uv - vec2(texelSize.x,0.0), vec2(0.0), maxUV)).rgb;
+	vec3 right = texture(_ColorBuffer,clamp(uv + vec2(texelSize.x,0.0), vec2(0.0), maxUV)).rgb;
+	vec3 down = texture(_ColorBuffer,clamp(uv - vec2(0.0,texelSize.y), vec2(0.0), maxUV)).rgb;
+	vec3 up = texture(_ColorBuffer,clamp(uv + vec2(0.0,texelSize.y), vec2(0.0), maxUV)).rgb;
+	vec3 sharpened = center + (center * 4.0 - left - right - down - up) * _Sharpness;
+	//Clamp to the neighbourhood to avoid halos
+	vec3 minColor = min(center, min(min(left, right), min(down, up)));
+	vec3 maxColor = max(center, max(max(left, right), max(down, up)));
+	FragColor = vec4(clamp(sharpened, minColor, maxColor), 1.0);
+}
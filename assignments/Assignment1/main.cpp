@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
 #include <ew/external/glad.h>
 #include <ew/shader.h>
@@ -7,20 +8,189 @@
 #include <GLFW/glfw3.h>
 #include <ew/camera.h>
 #include <ew/texture.h>
+#include <ew/gpuResources.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <ew/transform.h>
 #include <ew/cameraController.h>
+#include <ew/renderGraph.h>
+#include <ew/postProcess.h>
+#include <ew/dynamicResolution.h>
+#include <ew/gpuTimer.h>
+#include <ew/procGen.h>
+#include <ew/clusteredLighting.h>
+#include <ew/softwareRenderer.h>
+#include <ew/framePipeline.h>
+#include <ew/dynamicMesh.h>
+#include <ew/ambientOcclusion.h>
+#include <ew/lightProbes.h>
+#include <ew/jobSystem.h>
+#include <ew/assetArchive.h>
+#include <ew/objLoader.h>
+#include <random>
+#include <atomic>
+#include <algorithm>
+//Declared before every global that owns GL objects, so it reports after they have released theirs.
+//Anything it lists was never released
+ew::GpuLeakReport gpuLeakReport;
 ew::CameraController cameraController;
+ew::RenderGraph renderGraph;
+bool renderGraphDirty = true; //Rebuild graph before next frame
+
+//Scene renders into a scaled viewport of the full size target, then gets upscaled
+ew::DynamicResolution dynamicResolution;
+ew::GpuTimer frameTimer;
+
+//Post processing
+ew::PostProcessChain* postProcessChain;
+ew::UpscaleEffect* upscale;
+ew::GaussianBlurEffect* gaussianBlur;
+ew::DualKawaseBlurEffect* kawaseBlur;
+ew::ComputeBlurEffect* computeBlur;
+ew::BloomEffect* bloom;
+ew::ChromaticAberrationEffect* aberration;
+const char* blurModeNames[] = { "None", "Separable Gaussian", "Dual Kawase", "Compute (shared memory)" };
+int blurMode = 0;
+
+//Ambient occlusion from a depth/normal pre-pass, darkening the ambient term of the scene pass
+ew::AmbientOcclusion* ambientOcclusion;
+bool ambientOcclusionEnabled = true;
+int ambientOcclusionPreset = 1;
+
+//Ambient term of the scene pass: a constant color, or irradiance probes baked from an environment map
+const int NUM_AMBIENT_MODES = 3;
+const int AMBIENT_CONSTANT = 0;
+const int AMBIENT_PROBES_OBJECT = 1; //Grid sampled at each object's position on the CPU, evaluated per pixel
+const int AMBIENT_PROBES_VERTEX = 2; //Grid interpolated and evaluated per vertex
+const char* ambientModeNames[NUM_AMBIENT_MODES] = { "Constant", "Probes per object", "Probes per vertex" };
+const char* ambientModeDefines[NUM_AMBIENT_MODES] = { nullptr, "LIGHT_PROBES_OBJECT", "LIGHT_PROBES_VERTEX" };
+int ambientMode = AMBIENT_PROBES_OBJECT;
+const int PROBE_OBJECT_MONKEY = 0; //Slots in the probe grid's per-object SH
+const int PROBE_OBJECT_PLANE = 1;
+ew::LightProbeGrid lightProbes;
+ew::EnvironmentMap environmentMap;
+ew::JobSystem* jobSystem;
+const int NUM_PROBE_MAP_WIDTHS = 4;
+const int probeMapWidths[NUM_PROBE_MAP_WIDTHS] = { 256, 512, 1024, 2048 };
+const char* probeMapWidthNames[NUM_PROBE_MAP_WIDTHS] = { "256x128", "512x256", "1024x512", "2048x1024" };
+int probeMapWidthIndex = 2;
+
+//Renders each ambient mode for a fixed number of frames and prints average scene pass GPU time.
+//Dynamic resolution is paused
+struct AmbientBenchmark {
+	bool running = false;
+	int mode = 0;
+	int frame = 0;
+	int prevMode = 0;
+	bool prevDynamicResolution = false;
+	float gpuMs[NUM_AMBIENT_MODES] = {};
+	int numFrames[NUM_AMBIENT_MODES] = {};
+}ambientBenchmark;
 
 ew::Transform monkeyTransform;
+ew::Transform planeTransform;
 ew::Camera camera;
 
+//Camera and monkey are simulated at a fixed rate, on a worker thread when pipelined.
+//The render loop only reads interpolated snapshots
+ew::FramePipeline framePipeline;
+const float SIMULATION_TIMESTEP = 1.0f / 60.0f;
+const int SNAPSHOT_MONKEY = 0; //Index into FrameSnapshot::transforms
+std::atomic<float> extraStepMilliseconds(0.0f); //Busy work per step, standing in for heavier game logic
+
+//Renders a fixed number of frames in each pipeline mode and prints frame time and input latency
+const char* pipelineModeNames[2] = { "Serial", "Pipelined" };
+struct PipelineBenchmark {
+	bool running = false;
+	int mode = 0;
+	int frame = 0;
+	bool prevThreaded = false;
+	double frameMs[2] = {};
+	double latencyMs[2] = {};
+	int numFrames[2] = {};
+}pipelineBenchmark;
+
+//Point and spot lights, shaded with clustered forward lighting
+ew::ClusteredLighting clusteredLighting;
+std::vector<ew::Light> lights;
+std::vector<glm::vec3> lightOrbitCenters; //Lights circle around these
+const int NUM_LIGHT_COUNTS = 4;
+const int lightCounts[NUM_LIGHT_COUNTS] = { 0, 16, 256, 1024 };
+const char* lightCountNames[NUM_LIGHT_COUNTS] = { "0", "16", "256", "1024" };
+int lightCountIndex = 2;
+
+//Renders each light count for a fixed number of frames and prints average scene pass GPU time
+//and CPU light assignment time. Dynamic resolution is paused so every count renders at full size
+struct LightBenchmark {
+	bool running = false;
+	int step = 1; //Index into lightCounts, skipping 0
+	int frame = 0;
+	int prevCountIndex = 0;
+	bool prevDynamicResolution = false;
+	float gpuMs[NUM_LIGHT_COUNTS] = {};
+	float cpuMs[NUM_LIGHT_COUNTS] = {};
+	int numFrames[NUM_LIGHT_COUNTS] = {};
+}lightBenchmark;
+const int BENCHMARK_WARMUP_FRAMES = 10;
+const int BENCHMARK_FRAMES = 240;
+
+//Water surface animated on the CPU every frame, replacing the floor when enabled.
+//Each mode streams the same vertices to the GPU a different way
+const int WATER_SUBDIVISIONS = 999; //1000x1000 vertices
+const int NUM_WATER_MODES = 4;
+const int WATER_OFF = 0;
+const int WATER_RELOAD = 1; //Mesh::load, reallocating both buffers every frame
+const int WATER_ORPHAN = 2; //DynamicMesh orphaning its buffer every frame
+const int WATER_PERSISTENT = 3; //DynamicMesh writing to a persistently mapped triple buffer
+const char* waterModeNames[NUM_WATER_MODES] = { "Off", "Mesh::load re-upload", "Orphaning", "Persistent triple buffer" };
+int waterMode = WATER_OFF;
+ew::MeshData waterMeshData; //Animated in place in WATER_RELOAD mode
+ew::Mesh* waterMeshPtr;
+ew::DynamicMesh* waterDynamicMeshPtr;
+float waterAnimateMs = 0.0f;
+float waterUploadMs = 0.0f;
+
+//Renders each water mode for a fixed number of frames and prints average upload, frame and GPU time
+struct WaterBenchmark {
+	bool running = false;
+	int mode = WATER_RELOAD;
+	int frame = 0;
+	int prevMode = WATER_OFF;
+	bool prevDynamicResolution = false;
+	std::chrono::steady_clock::time_point prevFrameTime;
+	float uploadMs[NUM_WATER_MODES] = {};
+	float waitMs[NUM_WATER_MODES] = {};
+	float frameMs[NUM_WATER_MODES] = {};
+	float gpuMs[NUM_WATER_MODES] = {};
+	int numFrames[NUM_WATER_MODES] = {};
+}waterBenchmark;
+
+//Renders without ambient occlusion, then with each preset, for a fixed number of frames and prints
+//average GPU time of the pre-pass, every AO stage and the scene pass. Dynamic resolution is paused
+const int NUM_AO_BENCHMARK_STEPS = ew::NUM_AMBIENT_OCCLUSION_PRESETS + 1; //Off, then each preset
+struct AmbientOcclusionBenchmark {
+	bool running = false;
+	int step = 0;
+	int frame = 0;
+	bool prevEnabled = false;
+	int prevPreset = 0;
+	bool prevDynamicResolution = false;
+	float prepassMs[NUM_AO_BENCHMARK_STEPS] = {};
+	float stageMs[NUM_AO_BENCHMARK_STEPS][ew::AmbientOcclusion::NUM_STAGES] = {};
+	float sceneMs[NUM_AO_BENCHMARK_STEPS] = {};
+	int numFrames[NUM_AO_BENCHMARK_STEPS] = {};
+}aoBenchmark;
+
+//Archive the build packs this assignment's assets into. Without it assets load from loose files
+const char* ASSET_ARCHIVE = "Assignment1.pak";
+float startupAssetMilliseconds = 0.0f; //Loading the textures, shaders and model needed for the first frame
+ew::AssetLoadBenchmarkResult assetBenchmark;
+
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
-float red, blue;
 void drawUI();
+ew::Model* monkeyModelPtr;
 
 struct Material {
 	float Ka = 1.0;
@@ -32,8 +202,6 @@ struct Material {
 //Global state
 int screenWidth = 1080;
 int screenHeight = 720;
-float prevFrameTime;
-float deltaTime;
 
 void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	camera->position = glm::vec3(0, 0, 5.0f);
@@ -41,89 +209,708 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	controller->yaw = controller->pitch = 0;
 }
 
-int main() {
+//One simulation step. Runs on the pipeline's thread when pipelined, so it must only touch the state it's given
+//and the camera controller
+void simulate(ew::FrameSnapshot& state, const ew::CameraInput& input, float timestep) {
+	cameraController.move(input, &state.camera, timestep);
+	ew::Transform& monkey = state.transforms[SNAPSHOT_MONKEY];
+	monkey.rotation = glm::rotate(monkey.rotation, timestep, glm::vec3(0.0, 1.0, 0.0));
+	//Spin rather than sleep so the cost is CPU time, like real work
+	auto startTime = std::chrono::steady_clock::now();
+	while (std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count() < extraStepMilliseconds) {}
+}
+
+void startPipelineBenchmark() {
+	pipelineBenchmark = PipelineBenchmark();
+	pipelineBenchmark.running = true;
+	pipelineBenchmark.prevThreaded = framePipeline.isThreaded();
+}
+
+//Called once per frame after endFrame()
+void updatePipelineBenchmark() {
+	if (!pipelineBenchmark.running) {
+		return;
+	}
+	PipelineBenchmark& b = pipelineBenchmark;
+	framePipeline.setThreaded(b.mode == 1);
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		b.frameMs[b.mode] += framePipeline.getFrameMilliseconds();
+		b.latencyMs[b.mode] += framePipeline.getLatencyMilliseconds();
+		b.numFrames[b.mode]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.mode < 2) {
+		return;
+	}
+	b.running = false;
+	framePipeline.setThreaded(b.prevThreaded);
+	printf("\nFrame pipeline (%.0f Hz simulation, %.2f ms extra per step, average of %d frames):\n", 1.0f / SIMULATION_TIMESTEP, extraStepMilliseconds.load(), BENCHMARK_FRAMES);
+	for (int i = 0; i < 2; i++)
+	{
+		int n = std::max(b.numFrames[i], 1);
+		double frameMs = b.frameMs[i] / n;
+		printf("  %-9s frame %.3f ms (%.1f fps), input latency %.3f ms\n", pipelineModeNames[i], frameMs, frameMs > 0.0 ? 1000.0 / frameMs : 0.0, b.latencyMs[i] / n);
+	}
+}
+
+//Scatters lights over the plane. Same seed every time so benchmarks are repeatable
+void createLights(int count) {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	lights.resize(count);
+	lightOrbitCenters.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		ew::Light& light = lights[i];
+		lightOrbitCenters[i] = glm::vec3(unit(random) * 20.0f - 10.0f, -1.0f + unit(random) * 1.5f, unit(random) * 20.0f - 10.0f);
+		light.color = glm::vec3(unit(random), unit(random), unit(random));
+		light.radius = 1.5f + unit(random) * 1.5f;
+		light.intensity = 2.0f;
+		//Every fourth light is a downward spot light
+		if (i % 4 == 3) {
+			light.spotAngle = 30.0f;
+			light.radius *= 1.5f;
+			light.intensity = 4.0f;
+		}
+	}
+}
+
+void updateLights(float time) {
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		float phase = i * 2.39996f;
+		lights[i].position = lightOrbitCenters[i] + glm::vec3(cosf(time + phase), 0.0f, sinf(time + phase)) * 0.75f;
+	}
+}
+
+float passMilliseconds(const char* name) {
+	for (int i = 0; i < renderGraph.getNumPasses(); i++)
+	{
+		if (renderGraph.getPassName(i) == name) {
+			return renderGraph.getPassGpuMilliseconds(i);
+		}
+	}
+	return 0.0f;
+}
+
+float scenePassMilliseconds() {
+	return passMilliseconds("Scene");
+}
+
+//Scene geometry the probes see, as world space boxes
+std::vector<ew::Bounds> getProbeOccluders() {
+	std::vector<ew::Bounds> occluders(2);
+	//Suzanne's bounds, widened to cover any rotation about Y
+	occluders[0].min = monkeyTransform.position + glm::vec3(-1.4f, -1.0f, -1.4f);
+	occluders[0].max = monkeyTransform.position + glm::vec3(1.4f, 1.0f, 1.4f);
+	occluders[1].min = planeTransform.position + glm::vec3(-10.0f, 0.0f, -10.0f);
+	occluders[1].max = planeTransform.position + glm::vec3(10.0f, 0.0f, 10.0f);
+	return occluders;
+}
+
+void bakeLightProbes() {
+	ew::EnvironmentMap map = environmentMap.width == probeMapWidths[probeMapWidthIndex] ? environmentMap : ew::resizeEnvironmentMap(environmentMap, probeMapWidths[probeMapWidthIndex]);
+	lightProbes.bake(map, ew::ProbeGridSettings(), getProbeOccluders(), jobSystem);
+}
+
+//Bakes every combination of map resolution and probe count, on one thread without and with SIMD and on
+//every thread with SIMD, and prints the bake times. Blocks until done
+void benchmarkLightProbeBake() {
+	const int NUM_GRIDS = 4;
+	const glm::ivec3 grids[NUM_GRIDS] = { glm::ivec3(1), glm::ivec3(2), glm::ivec3(3), glm::ivec3(5, 3, 5) };
+	std::vector<ew::Bounds> occluders = getProbeOccluders();
+	ew::LightProbeGrid grid;
+	printf("\nLight probe bake (L2 SH, %d occluders, ms CPU):\n", (int)occluders.size());
+	printf("  %-10s %7s %10s %10s %14s\n", "Map", "Probes", "Scalar", "SIMD", "SIMD threads");
+	for (int w = 0; w < NUM_PROBE_MAP_WIDTHS; w++)
+	{
+		ew::EnvironmentMap map = ew::resizeEnvironmentMap(environmentMap, probeMapWidths[w]);
+		for (int g = 0; g < NUM_GRIDS; g++)
+		{
+			ew::ProbeGridSettings settings;
+			settings.count = grids[g];
+			float ms[3];
+			for (int run = 0; run < 3; run++)
+			{
+				grid.bake(map, settings, occluders, run == 2 ? jobSystem : nullptr, run > 0);
+				ms[run] = grid.getStats().bakeMilliseconds;
+			}
+			printf("  %-10s %7d %10.2f %10.2f %9.2f (%2d)\n", probeMapWidthNames[w], grid.getNumProbes(), ms[0], ms[1], ms[2], jobSystem->getNumThreads());
+		}
+	}
+}
+
+//Loads every packed asset from loose files and from the archive, cold and warm, and prints the times. Blocks until done
+void benchmarkAssetArchive() {
+	assetBenchmark = ew::benchmarkAssetLoading(ASSET_ARCHIVE);
+	if (assetBenchmark.numAssets == 0) {
+		printf("\nNo asset archive to benchmark (%s)\n", ASSET_ARCHIVE);
+		return;
+	}
+	const ew::AssetLoadBenchmarkResult& r = assetBenchmark;
+	printf("\nAsset loading (%d assets, %s):\n", r.numAssets, r.coldCache ? "cold runs with the OS file cache dropped" : "OS file cache could not be dropped, cold runs may be warm");
+	printf("  %-12s %6s %9s %9s %9s\n", "Source", "Files", "MB read", "Cold ms", "Warm ms");
+	printf("  %-12s %6d %9.2f %9.2f %9.2f\n", "Loose files", r.looseFilesOpened, r.looseBytes / (1024.0f * 1024.0f), r.looseColdMilliseconds, r.looseWarmMilliseconds);
+	printf("  %-12s %6d %9.2f %9.2f %9.2f\n", "Archive", 1, r.archiveBytes / (1024.0f * 1024.0f), r.archiveColdMilliseconds, r.archiveWarmMilliseconds);
+}
+
+//Writes a generated 256 MB OBJ, loads it on one thread and on every thread, and prints parse and weld times
+//next to parsing the same text from memory. Blocks until done
+void benchmarkObjLoader() {
+	const size_t FILE_BYTES = 256 * 1024 * 1024;
+	const char* FILE_PATH = "objBenchmark.obj";
+	if (!ew::writeObjGrid(FILE_PATH, FILE_BYTES)) {
+		return;
+	}
+	int threadCounts[2] = { 1, (int)std::max(1u, std::thread::hardware_concurrency()) };
+	printf("\nOBJ loading (generated grid, memory mapped from %s):\n", FILE_PATH);
+	printf("  %-8s %8s %9s %11s %9s %11s %14s %9s\n", "Threads", "MB", "Parse ms", "Parse MB/s", "Weld ms", "Total MB/s", "Memory MB/s", "Tris");
+	for (int threads : threadCounts) {
+		ew::ObjLoadBenchmarkResult b = ew::benchmarkObjLoading(FILE_PATH, threads);
+		const ew::ObjLoadStats& r = b.file;
+		printf("  %-8d %8.1f %9.1f %11.1f %9.1f %11.1f %14.1f %9zu\n", r.numThreads, r.fileBytes / (1024.0f * 1024.0f), r.parseMilliseconds,
+			r.parseMegabytesPerSecond, r.weldMilliseconds, r.totalMegabytesPerSecond, b.memoryParseMegabytesPerSecond, r.numTriangles);
+	}
+	remove(FILE_PATH);
+}
+
+void startAmbientBenchmark() {
+	ambientBenchmark = AmbientBenchmark();
+	ambientBenchmark.running = true;
+	ambientBenchmark.prevMode = ambientMode;
+	ambientBenchmark.prevDynamicResolution = dynamicResolution.enabled;
+	dynamicResolution.enabled = false;
+}
+
+//Called once per frame after the graph has executed
+void updateAmbientBenchmark() {
+	if (!ambientBenchmark.running) {
+		return;
+	}
+	AmbientBenchmark& b = ambientBenchmark;
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		b.gpuMs[b.mode] += scenePassMilliseconds();
+		b.numFrames[b.mode]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.mode < NUM_AMBIENT_MODES) {
+		return;
+	}
+	b.running = false;
+	ambientMode = b.prevMode;
+	dynamicResolution.enabled = b.prevDynamicResolution;
+	printf("\nAmbient light (%dx%d, average of %d frames):\n", screenWidth, screenHeight, BENCHMARK_FRAMES);
+	float constantMs = b.numFrames[0] > 0 ? b.gpuMs[0] / b.numFrames[0] : 0.0f;
+	for (int i = 0; i < NUM_AMBIENT_MODES; i++)
+	{
+		float gpu = b.numFrames[i] > 0 ? b.gpuMs[i] / b.numFrames[i] : 0.0f;
+		printf("  %-18s scene pass %.3f ms GPU (%+.3f ms)\n", ambientModeNames[i], gpu, gpu - constantMs);
+	}
+}
+
+//Graph is rebuilt on change, since the preset may change AO resolution
+void setAmbientOcclusion(bool enabled, int preset) {
+	if (enabled != ambientOcclusionEnabled || preset != ambientOcclusionPreset) {
+		renderGraphDirty = true;
+	}
+	ambientOcclusionEnabled = enabled;
+	ambientOcclusionPreset = preset;
+	ambientOcclusion->applyPreset(preset);
+}
+
+void startAmbientOcclusionBenchmark() {
+	aoBenchmark = AmbientOcclusionBenchmark();
+	aoBenchmark.running = true;
+	aoBenchmark.prevEnabled = ambientOcclusionEnabled;
+	aoBenchmark.prevPreset = ambientOcclusionPreset;
+	aoBenchmark.prevDynamicResolution = dynamicResolution.enabled;
+	dynamicResolution.enabled = false;
+}
+
+//Called once per frame after the graph has executed
+void updateAmbientOcclusionBenchmark() {
+	if (!aoBenchmark.running) {
+		return;
+	}
+	AmbientOcclusionBenchmark& b = aoBenchmark;
+	//The graph is rebuilt between steps, so the warmup also lets the new passes' timers fill
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		b.prepassMs[b.step] += passMilliseconds("AO Prepass");
+		for (int stage = 0; stage < ew::AmbientOcclusion::NUM_STAGES && b.step > 0; stage++)
+		{
+			b.stageMs[b.step][stage] += ambientOcclusion->getStageGpuMilliseconds(renderGraph, stage);
+		}
+		b.sceneMs[b.step] += scenePassMilliseconds();
+		b.numFrames[b.step]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.step < NUM_AO_BENCHMARK_STEPS) {
+		return;
+	}
+	b.running = false;
+	dynamicResolution.enabled = b.prevDynamicResolution;
+	setAmbientOcclusion(b.prevEnabled, b.prevPreset);
+	printf("\nAmbient occlusion (%dx%d, average of %d frames, GPU ms):\n", screenWidth, screenHeight, BENCHMARK_FRAMES);
+	printf("  %-34s %8s", "Preset", "Prepass");
+	for (int stage = 0; stage < ew::AmbientOcclusion::NUM_STAGES; stage++)
+	{
+		printf(" %10s", ew::AmbientOcclusion::getStageName(stage));
+	}
+	printf(" %8s %8s\n", "AO total", "Scene");
+	for (int i = 0; i < NUM_AO_BENCHMARK_STEPS; i++)
+	{
+		float n = (float)std::max(b.numFrames[i], 1);
+		printf("  %-34s %8.3f", i == 0 ? "Off" : ew::AMBIENT_OCCLUSION_PRESETS[i - 1].name, b.prepassMs[i] / n);
+		float total = b.prepassMs[i];
+		for (int stage = 0; stage < ew::AmbientOcclusion::NUM_STAGES; stage++)
+		{
+			printf(" %10.3f", b.stageMs[i][stage] / n);
+			total += b.stageMs[i][stage];
+		}
+		printf(" %8.3f %8.3f\n", total / n, b.sceneMs[i] / n);
+	}
+}
+
+void startLightBenchmark() {
+	lightBenchmark = LightBenchmark();
+	lightBenchmark.running = true;
+	lightBenchmark.prevCountIndex = lightCountIndex;
+	lightBenchmark.prevDynamicResolution = dynamicResolution.enabled;
+	dynamicResolution.enabled = false;
+}
+
+//Called once per frame after the graph has executed
+void updateLightBenchmark() {
+	if (!lightBenchmark.running) {
+		return;
+	}
+	LightBenchmark& b = lightBenchmark;
+	//Pass timings lag a few frames behind, so the warmup also flushes results from the previous count
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		b.gpuMs[b.step] += scenePassMilliseconds();
+		b.cpuMs[b.step] += clusteredLighting.getAssignMilliseconds();
+		b.numFrames[b.step]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.step < NUM_LIGHT_COUNTS) {
+		return;
+	}
+	b.running = false;
+	lightCountIndex = b.prevCountIndex;
+	dynamicResolution.enabled = b.prevDynamicResolution;
+	createLights(lightCounts[lightCountIndex]);
+	printf("\nClustered lighting (%dx%d, %d threads, average of %d frames):\n", screenWidth, screenHeight, clusteredLighting.getNumThreadsUsed(), BENCHMARK_FRAMES);
+	for (int i = 1; i < NUM_LIGHT_COUNTS; i++)
+	{
+		float gpu = b.numFrames[i] > 0 ? b.gpuMs[i] / b.numFrames[i] : 0.0f;
+		float cpu = b.numFrames[i] > 0 ? b.cpuMs[i] / b.numFrames[i] : 0.0f;
+		printf("  %5d lights: scene pass %.3f ms GPU, assignment %.3f ms CPU\n", lightCounts[i], gpu, cpu);
+	}
+}
+
+//Only the active mode keeps GPU storage
+void setWaterMode(int mode) {
+	waterMode = mode;
+	*waterMeshPtr = ew::Mesh();
+	*waterDynamicMeshPtr = ew::DynamicMesh();
+	if (mode == WATER_OFF) {
+		return;
+	}
+	if (waterMeshData.vertices.empty()) {
+		waterMeshData = ew::createPlane(20, 20, WATER_SUBDIVISIONS);
+	}
+	if (mode == WATER_RELOAD) {
+		waterMeshPtr->load(waterMeshData);
+	}
+	else {
+		waterDynamicMeshPtr->load(waterMeshData, mode == WATER_ORPHAN ? ew::DynamicMeshMode::ORPHAN : ew::DynamicMeshMode::PERSISTENT);
+	}
+}
+
+//Two crossing sine waves. Only height and normal change, so xz doubles as the rest position
+void animateWater(ew::Vertex* vertices, int count, float time) {
+	for (int i = 0; i < count; i++)
+	{
+		ew::Vertex& v = vertices[i];
+		float a = v.pos.x * 0.8f + time * 1.5f;
+		float b = (v.pos.x * 0.6f + v.pos.z * 0.8f) * 1.7f + time * 2.3f;
+		v.pos.y = 0.15f * sinf(a) + 0.08f * sinf(b);
+		float dx = 0.15f * 0.8f * cosf(a) + 0.08f * 1.7f * 0.6f * cosf(b);
+		float dz = 0.08f * 1.7f * 0.8f * cosf(b);
+		v.normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+	}
+}
+
+//Animates and uploads the water. Called before the graph executes
+void updateWater(float time) {
+	if (waterMode == WATER_OFF) {
+		return;
+	}
+	auto startTime = std::chrono::high_resolution_clock::now();
+	int count = (int)waterMeshData.vertices.size();
+	ew::Vertex* vertices = waterMode == WATER_RELOAD ? waterMeshData.vertices.data() : waterDynamicMeshPtr->getVertices();
+	animateWater(vertices, count, time);
+	auto animateTime = std::chrono::high_resolution_clock::now();
+	if (waterMode == WATER_RELOAD) {
+		waterMeshPtr->load(waterMeshData);
+	}
+	else {
+		waterDynamicMeshPtr->markDirty(0, count);
+		waterDynamicMeshPtr->flush();
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	waterAnimateMs = std::chrono::duration<float, std::milli>(animateTime - startTime).count();
+	waterUploadMs = std::chrono::duration<float, std::milli>(endTime - animateTime).count();
+}
+
+void drawWater() {
+	if (waterMode == WATER_RELOAD) {
+		waterMeshPtr->draw();
+	}
+	else {
+		waterDynamicMeshPtr->draw();
+	}
+}
+
+void startWaterBenchmark() {
+	waterBenchmark = WaterBenchmark();
+	waterBenchmark.running = true;
+	waterBenchmark.prevMode = waterMode;
+	waterBenchmark.prevDynamicResolution = dynamicResolution.enabled;
+	waterBenchmark.prevFrameTime = std::chrono::steady_clock::now();
+	dynamicResolution.enabled = false;
+}
+
+//Called once per frame after the graph has executed
+void updateWaterBenchmark() {
+	if (!waterBenchmark.running) {
+		return;
+	}
+	WaterBenchmark& b = waterBenchmark;
+	auto frameTime = std::chrono::steady_clock::now();
+	//Frame time catches stalls the driver defers past the upload call, e.g. until swap
+	float frameMs = std::chrono::duration<float, std::milli>(frameTime - b.prevFrameTime).count();
+	b.prevFrameTime = frameTime;
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		b.uploadMs[b.mode] += waterUploadMs;
+		b.waitMs[b.mode] += waterMode == WATER_RELOAD ? 0.0f : waterDynamicMeshPtr->getWaitMilliseconds();
+		b.frameMs[b.mode] += frameMs;
+		b.gpuMs[b.mode] += frameTimer.getMilliseconds();
+		b.numFrames[b.mode]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.mode < NUM_WATER_MODES) {
+		return;
+	}
+	b.running = false;
+	setWaterMode(b.prevMode);
+	dynamicResolution.enabled = b.prevDynamicResolution;
+	int numVertices = (WATER_SUBDIVISIONS + 1) * (WATER_SUBDIVISIONS + 1);
+	printf("\nWater streaming (%d vertices, %.1f MB per frame, average of %d frames):\n", numVertices, numVertices * sizeof(ew::Vertex) / (1024.0f * 1024.0f), BENCHMARK_FRAMES);
+	printf("  %-26s %10s %10s %10s %10s\n", "Mode", "Upload ms", "Wait ms", "Frame ms", "GPU ms");
+	for (int i = WATER_RELOAD; i < NUM_WATER_MODES; i++)
+	{
+		float n = (float)std::max(b.numFrames[i], 1);
+		printf("  %-26s %10.3f %10.3f %10.3f %10.3f\n", waterModeNames[i], b.uploadMs[i] / n, b.waitMs[i] / n, b.frameMs[i] / n, b.gpuMs[i] / n);
+	}
+}
+
+//Renders the scene on the CPU without creating a window, for reference images on machines without a GPU.
+//Clustered lights are GPU only and left out
+int renderSoftware(const char* outputPath) {
+	ew::JobSystem jobs;
+	std::vector<ew::MeshData> monkeyMeshes;
+	if (!ew::loadModelMeshData("assets/suzanne.obj", &monkeyMeshes, ew::WeldSettings(), nullptr, &jobs)) {
+		return 1;
+	}
+	ew::MeshData planeMeshData = ew::createPlane(20, 20, 1);
+	ew::SoftwareTexture brickTexture = ew::loadSoftwareTexture("assets/brick_color.jpg");
+	planeTransform.position = glm::vec3(0.0f, -1.5f, 0.0f);
+	camera.aspectRatio = (float)screenWidth / screenHeight;
+
+	ew::SoftwareRenderer renderer(screenWidth, screenHeight);
+	ew::SoftwareMaterial softwareMaterial = { material.Ka, material.Kd, material.Ks, material.Shininess };
+	renderer.setCamera(camera);
+	//Same fixed time step for every run, so output images can be compared
+	const int NUM_FRAMES = 30;
+	double geometryMs = 0.0, rasterMs = 0.0;
+	for (int i = 0; i < NUM_FRAMES; i++)
+	{
+		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, 1.0f / 60.0f, glm::vec3(0.0, 1.0, 0.0));
+		renderer.clear(glm::vec3(0.6f, 0.8f, 0.92f));
+		for (const ew::MeshData& meshData : monkeyMeshes) {
+			renderer.draw(&meshData, monkeyTransform.modelMatrix(), softwareMaterial, &brickTexture);
+		}
+		renderer.draw(&planeMeshData, planeTransform.modelMatrix(), softwareMaterial, &brickTexture);
+		renderer.flush(&jobs);
+		geometryMs += renderer.getStats().geometryMilliseconds;
+		rasterMs += renderer.getStats().rasterMilliseconds;
+	}
+	const ew::SoftwareRenderStats& stats = renderer.getStats();
+	geometryMs /= NUM_FRAMES;
+	rasterMs /= NUM_FRAMES;
+	printf("Software renderer (%dx%d, %d threads, average of %d frames):\n", screenWidth, screenHeight, stats.numThreadsUsed, NUM_FRAMES);
+	printf("  %d triangles (%d rasterized), %lld pixels shaded\n", stats.numTrianglesSubmitted, stats.numTrianglesRasterized, (long long)stats.numPixelsShaded);
+	printf("  Geometry %.3f ms, raster %.3f ms\n", geometryMs, rasterMs);
+	printf("  %.2f Mtris/s, %.2f Mpixels/s\n", stats.numTrianglesSubmitted / (geometryMs + rasterMs) / 1000.0, stats.numPixelsShaded / rasterMs / 1000.0);
+	return renderer.writePPM(outputPath) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	//--benchmark-assets compares cold loading from loose files and from the archive, without opening a window
+	if (argc > 1 && strcmp(argv[1], "--benchmark-assets") == 0) {
+		benchmarkAssetArchive();
+		return 0;
+	}
+	bool packedAssets = ew::mountAssetArchive(ASSET_ARCHIVE);
+	//--software [output.ppm] renders a reference image on the CPU and exits
+	if (argc > 1 && strcmp(argv[1], "--software") == 0) {
+		return renderSoftware(argc > 2 ? argv[2] : "software.ppm");
+	}
 	GLFWwindow* window = initWindow("Assignment 0", screenWidth, screenHeight);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK); //Back face culling
 	glEnable(GL_DEPTH_TEST); //Depth testing
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
+	jobSystem = new ew::JobSystem();
+	auto assetLoadStart = std::chrono::high_resolution_clock::now();
+	ew::Texture brickTexture = ew::Texture("assets/brick_color.jpg");
 	//Shader
-	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
+	//Scene shader variants, indexed by ambient mode * 2 + ambient occlusion
+	std::vector<ew::Shader> sceneShaders;
+	for (int mode = 0; mode < NUM_AMBIENT_MODES; mode++)
+	{
+		for (int occlusion = 0; occlusion < 2; occlusion++)
+		{
+			std::vector<std::string> defines;
+			if (ambientModeDefines[mode] != nullptr) {
+				defines.push_back(ambientModeDefines[mode]);
+			}
+			if (occlusion) {
+				defines.push_back("AMBIENT_OCCLUSION");
+			}
+			sceneShaders.push_back(ew::Shader("assets/lit.vert", "assets/lit.frag", defines));
+		}
+	}
+	ew::Shader normalsShader = ew::Shader("assets/lit.vert", "assets/ssaoNormals.frag");
+	ambientOcclusion = new ew::AmbientOcclusion();
+	ambientOcclusion->applyPreset(ambientOcclusionPreset);
 
-	ew::Shader postProccess = ew::Shader("assets/postprocess.vert", "assets/postprocess.frag");
+	postProcessChain = new ew::PostProcessChain();
+	upscale = new ew::UpscaleEffect();
+	gaussianBlur = new ew::GaussianBlurEffect();
+	kawaseBlur = new ew::DualKawaseBlurEffect();
+	computeBlur = new ew::ComputeBlurEffect();
+	bloom = new ew::BloomEffect();
+	aberration = new ew::ChromaticAberrationEffect();
+	gaussianBlur->enabled = kawaseBlur->enabled = computeBlur->enabled = false;
+	bloom->enabled = false;
+	postProcessChain->addEffect(upscale);
+	postProcessChain->addEffect(gaussianBlur);
+	postProcessChain->addEffect(kawaseBlur);
+	postProcessChain->addEffect(computeBlur);
+	postProcessChain->addEffect(bloom);
+	postProcessChain->addEffect(aberration);
 	//Model
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
+	ew::Model monkeyModel = ew::Model("assets/suzanne.obj", ew::WeldSettings(), jobSystem);
+	monkeyModelPtr = &monkeyModel;
+	startupAssetMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - assetLoadStart).count();
+	printf("Loaded startup assets from %s in %.1f ms\n", packedAssets ? ASSET_ARCHIVE : "loose files", startupAssetMilliseconds);
 	//camera
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
 	camera.target = glm::vec3(0.0f, 0.0f, 0.0f); //Look at the center of the scene
 	camera.aspectRatio = (float)screenWidth / screenHeight;
 	camera.fov = 60.0f; //Vertical field of view, in degrees
-	shader.use();
 
-	unsigned int fbo, rbo, depth;
+	//Floor for the lights to fall on. Subdivided so per vertex probe lighting can vary across it
+	ew::Mesh planeMesh = ew::Mesh(ew::createPlane(20, 20, 20));
+	planeTransform.position = glm::vec3(0.0f, -1.5f, 0.0f);
+	ew::Mesh waterMesh;
+	ew::DynamicMesh waterDynamicMesh;
+	waterMeshPtr = &waterMesh;
+	waterDynamicMeshPtr = &waterDynamicMesh;
+	createLights(lightCounts[lightCountIndex]);
+
+	if (!ew::loadEnvironmentMap("assets/environment.hdr", &environmentMap)) {
+		printf("Using an analytic sky for the light probes\n");
+		environmentMap = ew::createSkyEnvironmentMap(probeMapWidths[NUM_PROBE_MAP_WIDTHS - 1]);
+	}
+	bakeLightProbes();
+
+	//The pre-pass and scene pass must draw exactly the same geometry
+	auto drawGeometry = [&](const ew::Shader& geometryShader) {
+		geometryShader.setMat4("_Model", monkeyTransform.modelMatrix());
+		geometryShader.setInt("_ProbeObject", PROBE_OBJECT_MONKEY);
+		monkeyModel.draw();
+		geometryShader.setMat4("_Model", planeTransform.modelMatrix());
+		geometryShader.setInt("_ProbeObject", PROBE_OBJECT_PLANE);
+		if (waterMode == WATER_OFF) {
+			planeMesh.draw();
+		}
+		else {
+			drawWater();
+		}
+	};
+
+	//Offscreen targets are transient render graph textures, reallocated when the window resizes.
+	//Graph is rebuilt whenever the set of enabled effects changes
+	auto buildRenderGraph = [&]() {
+		renderGraph.reset();
+		int sceneColor = renderGraph.createTexture("SceneColor", { GL_RGBA8 });
+		//Float depth, since ambient occlusion reconstructs positions from it
+		int sceneDepth = renderGraph.createTexture("SceneDepth", { GL_DEPTH_COMPONENT32F });
+		int backbuffer = renderGraph.importBackbuffer();
 
-	glCreateFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		//Fills scene depth and view space normals, then ambient occlusion is computed from them
+		int occlusion = -1;
+		if (ambientOcclusionEnabled) {
+			int viewNormals = renderGraph.createTexture("ViewNormals", { GL_RGB10_A2 });
+			renderGraph.addPass("AO Prepass", [&, sceneColor](const ew::RenderGraph& graph) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glm::ivec2 viewport = dynamicResolution.getViewportSize(graph.getWidth(sceneColor), graph.getHeight(sceneColor));
+				glViewport(0, 0, viewport.x, viewport.y);
+				normalsShader.use();
+				normalsShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+				normalsShader.setMat4("_View", camera.viewMatrix());
+				drawGeometry(normalsShader);
+			}).writeColor(viewNormals).writeDepth(sceneDepth);
+			occlusion = ambientOcclusion->addPasses(renderGraph, sceneDepth, viewNormals);
+		}
 
-	glGenTextures(1, &rbo);
-	glBindTexture(GL_TEXTURE_2D, rbo);
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, screenWidth, screenHeight);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, rbo, 0);
+		ew::RenderGraph::PassBuilder scenePass = renderGraph.addPass("Scene", [&, sceneColor, occlusion](const ew::RenderGraph& graph) {
+			glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
+			//Depth is already filled by the pre-pass when ambient occlusion is on
+			glClear(occlusion >= 0 ? GL_COLOR_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glDepthFunc(occlusion >= 0 ? GL_LEQUAL : GL_LESS);
+			//Targets stay full size; only the viewport shrinks, so scale changes never reallocate
+			glm::ivec2 viewport = dynamicResolution.getViewportSize(graph.getWidth(sceneColor), graph.getHeight(sceneColor));
+			glViewport(0, 0, viewport.x, viewport.y);
+			const ew::Shader& sceneShader = sceneShaders[ambientMode * 2 + (occlusion >= 0 ? 1 : 0)];
+			sceneShader.use();
+			if (ambientMode != AMBIENT_CONSTANT) {
+				lightProbes.setObject(PROBE_OBJECT_MONKEY, monkeyTransform.position);
+				lightProbes.setObject(PROBE_OBJECT_PLANE, planeTransform.position);
+				lightProbes.bind();
+			}
+			glBindTextureUnit(0, brickTexture.getHandle());
+			sceneShader.setInt("_MainTex", 0);
+			if (occlusion >= 0) {
+				glBindTextureUnit(1, graph.getTexture(occlusion));
+				sceneShader.setInt("_AmbientOcclusion", 1);
+			}
+			clusteredLighting.bind(sceneShader, glm::vec2(viewport));
+			sceneShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			sceneShader.setVec3("_EyePos", camera.position);
+			sceneShader.setFloat("_Material.Ka", material.Ka);
+			sceneShader.setFloat("_Material.Kd", material.Kd);
+			sceneShader.setFloat("_Material.Ks", material.Ks);
+			sceneShader.setFloat("_Material.Shininess", material.Shininess);
+			drawGeometry(sceneShader);
+			glDepthFunc(GL_LESS);
+		}).writeColor(sceneColor).writeDepth(sceneDepth);
+		if (occlusion >= 0) {
+			scenePass.read(occlusion);
+		}
 
-	glGenTextures(1, &depth);
-	glBindTexture(GL_TEXTURE_2D, depth);
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT16, screenWidth, screenHeight);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+		postProcessChain->addPasses(renderGraph, sceneColor, backbuffer);
+	};
 
-	unsigned int dummyVAO;
-	glCreateVertexArrays(1, &dummyVAO);
+	renderGraph.resize(screenWidth, screenHeight);
 
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
+	ew::FrameSnapshot initialState;
+	initialState.camera = camera;
+	initialState.transforms = { monkeyTransform };
+	framePipeline.start(initialState, simulate, SIMULATION_TIMESTEP, true);
+
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
-
-		float time = (float)glfwGetTime();
-		deltaTime = time - prevFrameTime;
-		prevFrameTime = time;
+		//Input is polled on the main thread and consumed by the next simulation step
+		framePipeline.setInput(ew::CameraController::sampleInput(window));
+		const ew::FrameSnapshot& frame = framePipeline.beginFrame();
+		float time = (float)frame.time;
+		camera = frame.camera;
+		if (screenHeight > 0) {
+			camera.aspectRatio = (float)screenWidth / screenHeight;
+		}
+		monkeyTransform = frame.transforms[SNAPSHOT_MONKEY];
 		//RENDER
-		cameraController.move(window, &camera, deltaTime);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-		glViewport(0, 0, screenWidth, screenHeight);
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		shader.use();
-		glBindTextureUnit(0, brickTexture);
-		shader.setInt("_MainTex", 0);
-		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
-		shader.setMat4("_Model", monkeyTransform.modelMatrix());
-		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		shader.setVec3("_EyePos", camera.position);
-		shader.setFloat("_Material.Ka", material.Ka);
-		shader.setFloat("_Material.Kd", material.Kd);
-		shader.setFloat("_Material.Ks", material.Ks);
-		shader.setFloat("_Material.Shininess", material.Shininess);
 
-		monkeyModel.draw();
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (lightBenchmark.running && (int)lights.size() != lightCounts[lightBenchmark.step]) {
+			lightCountIndex = lightBenchmark.step;
+			createLights(lightCounts[lightCountIndex]);
+		}
+		updateLights(time);
+		clusteredLighting.update(camera, lights, jobSystem);
+		if (waterBenchmark.running && waterMode != waterBenchmark.mode) {
+			setWaterMode(waterBenchmark.mode);
+		}
+		updateWater(time);
 
-		postProccess.use();
-		postProccess.setFloat("_Red", red);
-		postProccess.setFloat("_Blue", blue);
-		glBindTextureUnit(0, rbo);
-		glBindVertexArray(dummyVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		if (ambientBenchmark.running) {
+			ambientMode = ambientBenchmark.mode;
+		}
+		if (aoBenchmark.running) {
+			setAmbientOcclusion(aoBenchmark.step > 0, std::max(aoBenchmark.step - 1, 0));
+		}
+		if (renderGraphDirty) {
+			buildRenderGraph();
+			renderGraphDirty = false;
+		}
+		//A minimized window has no size, so keep last frame's scale
+		if (screenWidth > 0 && screenHeight > 0) {
+			glm::ivec2 sceneViewport = dynamicResolution.getViewportSize(screenWidth, screenHeight);
+			upscale->viewportScale = glm::vec2((float)sceneViewport.x / screenWidth, (float)sceneViewport.y / screenHeight);
+		}
+		ambientOcclusion->viewportScale = upscale->viewportScale;
+		ambientOcclusion->camera = camera;
 
+		frameTimer.begin();
+		renderGraph.execute();
+		frameTimer.end();
+		//Only feed the controller newly resolved results
+		static unsigned int prevFrameSamples = 0;
+		if (frameTimer.getNumSamples() != prevFrameSamples) {
+			prevFrameSamples = frameTimer.getNumSamples();
+			dynamicResolution.update(frameTimer.getMilliseconds());
+		}
+		updateLightBenchmark();
+		updateWaterBenchmark();
+		updateAmbientOcclusionBenchmark();
+		updateAmbientBenchmark();
 
 		drawUI();
 
 		glfwSwapBuffers(window);
+		framePipeline.endFrame();
+		updatePipelineBenchmark();
 	}
+	framePipeline.stop();
+	delete postProcessChain;
+	delete upscale;
+	delete gaussianBlur;
+	delete kawaseBlur;
+	delete computeBlur;
+	delete bloom;
+	delete aberration;
+	delete ambientOcclusion;
+	delete jobSystem;
 	printf("Shutting down...");
 }
 
@@ -134,7 +921,10 @@ void drawUI() {
 
 	ImGui::Begin("Settings");
 	if (ImGui::Button("Reset Camera")) {
-		resetCamera(&camera, &cameraController);
+		//Camera state belongs to the simulation
+		framePipeline.queueEdit([](ew::FrameSnapshot& state) {
+			resetCamera(&state.camera, &cameraController);
+		});
 	}
 
 	if (ImGui::CollapsingHeader("Material")) {
@@ -144,14 +934,219 @@ void drawUI() {
 		ImGui::SliderFloat("Shininess", &material.Shininess, 2.0f, 1024.0f);
 	}
 
-	if (ImGui::CollapsingHeader("Aberration")) {
-		ImGui::SliderFloat("Red", &red, -.01f, .01f);
-		ImGui::SliderFloat("Blue", &blue , -.01f, .01f);
+	if (ImGui::CollapsingHeader("Model")) {
+		const ew::ModelImportStats& stats = monkeyModelPtr->getImportStats();
+		ImGui::Text("Vertices: %zu imported, %zu after welding", stats.verticesBefore, stats.verticesAfter);
+		ImGui::Text("Import: %.2f ms (weld %.2f ms)", stats.importMilliseconds, stats.weldMilliseconds);
+		if (stats.nativeObj) {
+			ImGui::Text("Native OBJ loader: %.1f MB/s parsing", stats.parseMegabytesPerSecond);
+		}
+		if (ImGui::Button("Benchmark OBJ Loader")) {
+			benchmarkObjLoader();
+		}
+		//The old meshes are freed as they're replaced, so GPU memory stays flat across reloads
+		if (ImGui::Button("Reload Model")) {
+			*monkeyModelPtr = ew::Model("assets/suzanne.obj", ew::WeldSettings(), jobSystem);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Assets")) {
+		ImGui::Text("Source: %s", ew::getMountedAssetArchive().isOpen() ? ASSET_ARCHIVE : "loose files");
+		ImGui::Text("Startup assets: %.1f ms", startupAssetMilliseconds);
+		if (ImGui::Button("Benchmark Asset Loading")) {
+			benchmarkAssetArchive();
+		}
+		if (assetBenchmark.numAssets > 0) {
+			ImGui::Text("Cold: %.2f ms loose, %.2f ms archive%s", assetBenchmark.looseColdMilliseconds, assetBenchmark.archiveColdMilliseconds, assetBenchmark.coldCache ? "" : " (cache not dropped)");
+			ImGui::Text("Warm: %.2f ms loose, %.2f ms archive", assetBenchmark.looseWarmMilliseconds, assetBenchmark.archiveWarmMilliseconds);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Lights")) {
+		if (ImGui::Combo("Count", &lightCountIndex, lightCountNames, NUM_LIGHT_COUNTS)) {
+			createLights(lightCounts[lightCountIndex]);
+		}
+		ImGui::Text("Assignment: %.3f ms CPU (%d threads), upload %.3f ms", clusteredLighting.getAssignMilliseconds(), clusteredLighting.getNumThreadsUsed(), clusteredLighting.getUploadMilliseconds());
+		ImGui::Text("Light indices: %d, max per cluster: %d", clusteredLighting.getNumLightIndices(), clusteredLighting.getMaxLightsPerCluster());
+		ImGui::Text("Scene pass: %.3f ms GPU", scenePassMilliseconds());
+		if (lightBenchmark.running) {
+			ImGui::Text("Benchmarking %d lights...", lightCounts[lightBenchmark.step]);
+		}
+		else if (ImGui::Button("Benchmark Light Counts")) {
+			startLightBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Ambient Occlusion")) {
+		bool enabled = ambientOcclusionEnabled;
+		int preset = ambientOcclusionPreset;
+		const char* presetNames[ew::NUM_AMBIENT_OCCLUSION_PRESETS];
+		for (int i = 0; i < ew::NUM_AMBIENT_OCCLUSION_PRESETS; i++)
+		{
+			presetNames[i] = ew::AMBIENT_OCCLUSION_PRESETS[i].name;
+		}
+		bool changed = ImGui::Checkbox("Enabled##AO", &enabled);
+		changed |= ImGui::Combo("Preset", &preset, presetNames, ew::NUM_AMBIENT_OCCLUSION_PRESETS);
+		if (changed && !aoBenchmark.running) {
+			setAmbientOcclusion(enabled, preset);
+		}
+		ImGui::SliderInt("Samples", &ambientOcclusion->numSamples, 1, ew::AmbientOcclusion::MAX_SAMPLES);
+		ImGui::SliderInt("Blur Radius", &ambientOcclusion->blurRadius, 0, ew::AmbientOcclusion::MAX_BLUR_RADIUS);
+		ImGui::SliderFloat("Radius##AO", &ambientOcclusion->radius, 0.05f, 2.0f);
+		ImGui::SliderFloat("Intensity##AO", &ambientOcclusion->intensity, 0.0f, 4.0f);
+		ImGui::SliderFloat("Bias##AO", &ambientOcclusion->bias, 0.0f, 0.1f);
+		ImGui::SliderFloat("Edge Sharpness", &ambientOcclusion->blurSharpness, 1.0f, 64.0f);
+		if (ambientOcclusionEnabled) {
+			ImGui::Text("Prepass: %.3f ms", passMilliseconds("AO Prepass"));
+			for (int stage = 0; stage < ew::AmbientOcclusion::NUM_STAGES; stage++)
+			{
+				ImGui::Text("%s: %.3f ms", ew::AmbientOcclusion::getStageName(stage), ambientOcclusion->getStageGpuMilliseconds(renderGraph, stage));
+			}
+		}
+		if (aoBenchmark.running) {
+			ImGui::Text("Benchmarking %s...", aoBenchmark.step == 0 ? "Off" : ew::AMBIENT_OCCLUSION_PRESETS[aoBenchmark.step - 1].name);
+		}
+		else if (ImGui::Button("Benchmark Presets")) {
+			startAmbientOcclusionBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Ambient Light")) {
+		if (ImGui::Combo("Ambient", &ambientMode, ambientModeNames, NUM_AMBIENT_MODES) && ambientBenchmark.running) {
+			ambientMode = ambientBenchmark.mode;
+		}
+		ImGui::Combo("Bake Map", &probeMapWidthIndex, probeMapWidthNames, NUM_PROBE_MAP_WIDTHS);
+		if (ImGui::Button("Bake Probes")) {
+			bakeLightProbes();
+		}
+		const ew::ProbeBakeStats& stats = lightProbes.getStats();
+		ImGui::Text("%d probes from %dx%d: %.2f ms CPU (%d threads%s)", stats.numProbes, stats.mapWidth, stats.mapHeight,
+			stats.bakeMilliseconds, stats.numThreads, stats.simd ? ", SIMD" : "");
+		ImGui::Text("Scene pass: %.3f ms", scenePassMilliseconds());
+		if (ImGui::Button("Benchmark Bake")) {
+			benchmarkLightProbeBake();
+		}
+		if (ambientBenchmark.running) {
+			ImGui::Text("Benchmarking %s...", ambientModeNames[ambientBenchmark.mode]);
+		}
+		else if (ImGui::Button("Benchmark Shading")) {
+			startAmbientBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Water")) {
+		int mode = waterMode;
+		if (ImGui::Combo("Upload", &mode, waterModeNames, NUM_WATER_MODES) && !waterBenchmark.running) {
+			setWaterMode(mode);
+		}
+		if (waterMode != WATER_OFF) {
+			ImGui::Text("Vertices: %d", (int)waterMeshData.vertices.size());
+			ImGui::Text("Animate: %.3f ms CPU, upload %.3f ms CPU", waterAnimateMs, waterUploadMs);
+			if (waterMode != WATER_RELOAD) {
+				ImGui::Text("Fence wait: %.3f ms, %.1f MB written", waterDynamicMeshPtr->getWaitMilliseconds(), waterDynamicMeshPtr->getUploadBytes() / (1024.0f * 1024.0f));
+			}
+		}
+		if (waterBenchmark.running) {
+			ImGui::Text("Benchmarking %s...", waterModeNames[waterBenchmark.mode]);
+		}
+		else if (ImGui::Button("Benchmark Water Uploads")) {
+			startWaterBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Frame Pipeline")) {
+		bool threaded = framePipeline.isThreaded();
+		if (ImGui::Checkbox("Simulation thread", &threaded)) {
+			framePipeline.setThreaded(threaded);
+		}
+		float extraMs = extraStepMilliseconds;
+		if (ImGui::SliderFloat("Extra step cost (ms)", &extraMs, 0.0f, 10.0f)) {
+			extraStepMilliseconds = extraMs;
+		}
+		float frameMs = framePipeline.getAverageFrameMilliseconds();
+		ImGui::Text("Frame: %.3f ms (%.1f fps)", frameMs, frameMs > 0.0f ? 1000.0f / frameMs : 0.0f);
+		ImGui::Text("Input latency: %.3f ms", framePipeline.getAverageLatencyMilliseconds());
+		ImGui::Text("Step: %.3f ms, on render thread %.3f ms/frame", framePipeline.getStepMilliseconds(), framePipeline.getRenderThreadUpdateMilliseconds());
+		ImGui::Text("Interpolation: %.2f", framePipeline.getInterpolation());
+		if (pipelineBenchmark.running) {
+			ImGui::Text("Benchmarking %s...", pipelineModeNames[pipelineBenchmark.mode]);
+		}
+		else if (ImGui::Button("Benchmark Pipeline")) {
+			startPipelineBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Dynamic Resolution")) {
+		ImGui::Checkbox("Enabled", &dynamicResolution.enabled);
+		ImGui::SliderFloat("GPU Budget (ms)", &dynamicResolution.targetMilliseconds, 1.0f, 33.0f);
+		ImGui::SliderFloat("Min Scale", &dynamicResolution.minScale, 0.25f, 1.0f);
+		ImGui::SliderFloat("Sharpness", &upscale->sharpness, 0.0f, 1.0f);
+		glm::ivec2 viewport = dynamicResolution.getViewportSize(screenWidth, screenHeight);
+		ImGui::Text("Scale: %.3f (%dx%d of %dx%d)", dynamicResolution.getScale(), viewport.x, viewport.y, screenWidth, screenHeight);
+		ImGui::Text("GPU frame: %.3f ms", frameTimer.getAverageMilliseconds());
+		ImGui::PlotLines("Scale", dynamicResolution.getScaleHistory(), ew::DynamicResolution::HISTORY_SIZE, dynamicResolution.getHistoryOffset(), NULL, 0.0f, 1.0f, ImVec2(0, 60));
+		ImGui::PlotLines("GPU ms", dynamicResolution.getTimeHistory(), ew::DynamicResolution::HISTORY_SIZE, dynamicResolution.getHistoryOffset(), NULL, 0.0f, dynamicResolution.targetMilliseconds * 2.0f, ImVec2(0, 60));
+	}
+
+	if (ImGui::CollapsingHeader("Post Processing")) {
+		if (ImGui::Combo("Blur", &blurMode, blurModeNames, 4)) {
+			gaussianBlur->enabled = blurMode == 1;
+			kawaseBlur->enabled = blurMode == 2;
+			computeBlur->enabled = blurMode == 3;
+			renderGraphDirty = true;
+		}
+		if (blurMode == 1) {
+			ImGui::SliderInt("Radius", &gaussianBlur->radius, 1, 2 * (ew::GaussianBlurEffect::MAX_TAPS - 1));
+			renderGraphDirty |= ImGui::SliderFloat("Resolution", &gaussianBlur->resolutionScale, 0.25f, 1.0f);
+		}
+		else if (blurMode == 2) {
+			renderGraphDirty |= ImGui::SliderInt("Iterations", &kawaseBlur->iterations, 1, 6);
+			ImGui::SliderFloat("Offset", &kawaseBlur->offset, 0.5f, 3.0f);
+		}
+		else if (blurMode == 3) {
+			ImGui::SliderInt("Radius", &computeBlur->radius, 1, ew::ComputeBlurEffect::MAX_RADIUS);
+			renderGraphDirty |= ImGui::SliderFloat("Resolution", &computeBlur->resolutionScale, 0.25f, 1.0f);
+		}
+		renderGraphDirty |= ImGui::Checkbox("Bloom", &bloom->enabled);
+		if (bloom->enabled) {
+			ImGui::SliderFloat("Threshold", &bloom->threshold, 0.0f, 1.0f);
+			ImGui::SliderFloat("Intensity", &bloom->intensity, 0.0f, 4.0f);
+			renderGraphDirty |= ImGui::SliderInt("Bloom Iterations", &bloom->blur.iterations, 1, 6);
+		}
+		renderGraphDirty |= ImGui::Checkbox("Chromatic Aberration", &aberration->enabled);
+		if (aberration->enabled) {
+			ImGui::SliderFloat("Red", &aberration->red, -.01f, .01f);
+			ImGui::SliderFloat("Blue", &aberration->blue, -.01f, .01f);
+		}
+		ImGui::Separator();
+		for (int i = 0; i < postProcessChain->getNumEffects(); i++)
+		{
+			ew::PostProcessEffect* effect = postProcessChain->getEffect(i);
+			if (effect->enabled) {
+				ImGui::Text("%s: %.3f ms", effect->getName(), postProcessChain->getEffectGpuMilliseconds(renderGraph, i));
+			}
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Render Graph")) {
+		for (int i = 0; i < renderGraph.getNumPasses(); i++)
+		{
+			if (renderGraph.isPassCulled(i)) {
+				ImGui::Text("%s: culled", renderGraph.getPassName(i).c_str());
+			}
+			else {
+				ImGui::Text("%s: GPU %.3f ms, CPU %.3f ms", renderGraph.getPassName(i).c_str(), renderGraph.getPassGpuMilliseconds(i), renderGraph.getPassCpuMilliseconds(i));
+			}
+		}
+		ImGui::Text("Transient textures: %d", renderGraph.getNumPhysicalTextures());
+		ImGui::Text("Peak transient memory: %.2f MB", renderGraph.getTransientBytes() / (1024.0f * 1024.0f));
+		ImGui::Text("Without aliasing: %.2f MB", renderGraph.getUnaliasedBytes() / (1024.0f * 1024.0f));
 	}
 
-	ImGui::Text("Add Controls Here!");
 	ImGui::End();
 
+	ew::drawGpuResourceWindow();
+
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -161,6 +1156,10 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 	glViewport(0, 0, width, height);
 	screenWidth = width;
 	screenHeight = height;
+	if (height > 0) {
+		camera.aspectRatio = (float)screenWidth / screenHeight;
+	}
+	renderGraph.resize(width, height);
 }
 
 /// <summary>
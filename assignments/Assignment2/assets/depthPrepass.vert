@@ -0,0 +1,13 @@
+#version 450
+//Position only pass that fills the depth buffer before lit shading.
+//gl_Position must be computed exactly like lit.vert for GL_EQUAL depth testing to pass
+layout(location = 0) in vec3 vPos;
+
+uniform mat4 _Model;
+uniform mat4 _ViewProjection;
+
+invariant gl_Position;
+
+void main(){
+	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
+}
@@ -22,33 +22,24 @@ struct Material{
 uniform Material _Material;
 
 uniform vec3 lightPos;
-uniform sampler2D shadowMap;
+//Depth comparison is done by the sampler (GL_TEXTURE_COMPARE_MODE) with hardware bilinear PCF
+uniform sampler2DShadow shadowMap;
 
+#include "shadowFilter.glsl"
+#ifdef POINT_SHADOWS
+#include "pointShadows.glsl"
+#endif
 
 float ShadowCalc(vec4 fragPosLightSpace)
 {
     vec3 projCoord = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoord = projCoord * 0.5 + 0.5;
-    float nearDepth = texture(shadowMap, projCoord.xy).r; 
-    float currentDepth = projCoord.z;
+    if(projCoord.z > 1.0)
+        return 0.0;
     vec3 normal = normalize(fs_in.WorldNormal);
     vec3 lightDir = normalize(lightPos - fs_in.WorldPos);
     float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    for(int x = -1; x <= 1; ++x)
-    {
-        for(int y = -1; y <= 1; ++y)
-        {
-            float pcfDepth = texture(shadowMap, projCoord.xy + vec2(x, y) * texelSize).r; 
-            shadow += currentDepth - bias > pcfDepth  ? 1.0 : 0.0;        
-        }    
-    }
-    shadow /= 9.0;
-    if(projCoord.z > 1.0)
-        shadow = 0.0;
-        
-    return shadow;
+    return 1.0 - SampleShadow(projCoord.xy, projCoord.z - bias);
 }
 
 void main(){
@@ -68,5 +59,8 @@ void main(){
 	vec3 objectColor = texture(_MainTex,fs_in.TexCoord).rgb;
 	float shadow = ShadowCalc(fs_in.fragLightSpace);  ;
 	FragColor = vec4(objectColor +(1.00-shadow) * lightColor,1.0);
+#ifdef POINT_SHADOWS
+	FragColor.rgb += objectColor * PointLighting(normal, toEye);
+#endif
 
 }
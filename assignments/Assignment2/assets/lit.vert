@@ -7,6 +7,10 @@ layout(location = 2) in vec2 vTexCoord;
 uniform mat4 _Model; 
 uniform mat4 _ViewProjection;
 uniform mat4 lightMat;
+#ifdef CPU_NORMAL_MATRIX
+//Inverse transpose of _Model's upper 3x3, computed once per draw on the CPU
+uniform mat3 _NormalMatrix;
+#endif
 
 out Surface{
 	vec3 WorldPos; //Vertex position in world space
@@ -15,11 +19,18 @@ out Surface{
 	vec4 fragLightSpace;
 }vs_out;
 
+//Matches depthPrepass.vert bit for bit, so the lit pass can test against pre-pass depth with GL_EQUAL
+invariant gl_Position;
+
 void main(){
 	//Transform vertex position to World Space.
 vs_out.WorldPos = vec3(_Model * vec4(vPos,1.0));
 	//Transform vertex normal to world space using Normal Matrix
+#ifdef CPU_NORMAL_MATRIX
+	vs_out.WorldNormal = _NormalMatrix * vNormal;
+#else
 	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * vNormal;
+#endif
 vs_out.TexCoord = vTexCoord;
 
 vs_out.fragLightSpace = lightMat * vec4(vs_out.WorldPos, 1.0);
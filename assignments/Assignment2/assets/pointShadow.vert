@@ -0,0 +1,25 @@
+#version 450
+//Renders a caster into every cube face it was culled into, one instance per face. See ew::PointShadows
+layout(location = 0) in vec3 vPos;
+
+//View projection per cube face of every layer, in tier order
+layout(std430, binding = 5) readonly buffer PointShadowFaces{
+	mat4 _FaceMatrices[];
+};
+//Layer * 6 + face of each instance
+layout(std430, binding = 6) readonly buffer PointShadowFaceIndices{
+	uint _FaceIndices[];
+};
+uniform mat4 _Model;
+uniform int _FirstMatrix; //This tier's first face in _FaceMatrices
+uniform int _FirstFace; //This draw's first instance in _FaceIndices
+
+out Face{
+	flat int Layer;
+}vs_out;
+
+void main(){
+	int face = int(_FaceIndices[_FirstFace + gl_InstanceID]);
+	vs_out.Layer = face;
+	gl_Position = _FaceMatrices[_FirstMatrix + face] * _Model * vec4(vPos,1.0);
+}
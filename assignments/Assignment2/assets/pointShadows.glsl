@@ -0,0 +1,60 @@
+//Shadowed point lights for lit.frag, from ew::PointShadows. Expects _Material to be declared by the including shader
+
+//Matches GpuPointLight in pointShadows.h
+struct PointLight{
+	vec4 positionRadius;
+	vec4 color; //rgb = color * intensity
+	vec4 shadow; //x = tier, -1 for unshadowed, y = cube map layer, z = near plane, w = normal offset per unit of distance
+};
+layout(std430, binding = 7) readonly buffer PointLights{
+	PointLight _PointLights[];
+};
+uniform int _NumPointLights;
+//One cube map array per resolution tier. Comparison is done by the texture (GL_TEXTURE_COMPARE_MODE)
+uniform samplerCubeArrayShadow _PointShadowMaps[4];
+
+//Fraction of the light reaching worldPos (1 = fully lit)
+float PointShadow(PointLight light, vec3 worldPos, vec3 normal){
+	int tier = int(light.shadow.x);
+	if(tier < 0){
+		return 1.0;
+	}
+	vec3 toFragment = worldPos - light.positionRadius.xyz;
+	//Distance along the face's axis is the view depth the face was rendered with
+	float axisDistance = max(abs(toFragment.x), max(abs(toFragment.y), abs(toFragment.z)));
+	//Texels get larger with distance, and so does the offset that keeps surfaces from shadowing themselves
+	toFragment += normal * light.shadow.w * axisDistance;
+	axisDistance = max(abs(toFragment.x), max(abs(toFragment.y), abs(toFragment.z)));
+	//Depth the face's perspective projection gives that distance, in the default depth convention
+	float n = light.shadow.z;
+	float f = light.positionRadius.w;
+	float ndc = (f + n) / (f - n) - 2.0 * f * n / ((f - n) * axisDistance);
+	float ref = ndc * 0.5 + 0.5;
+	//Lights are looped over in the same order by every fragment, so the index is dynamically uniform
+	return texture(_PointShadowMaps[tier], vec4(toFragment, light.shadow.y), ref);
+}
+
+vec3 PointLighting(vec3 normal, vec3 toEye){
+	vec3 total = vec3(0.0);
+	for(int i = 0; i < _NumPointLights; i++){
+		PointLight light = _PointLights[i];
+		vec3 toLight = light.positionRadius.xyz - fs_in.WorldPos;
+		float lightDistance = length(toLight);
+		if(lightDistance >= light.positionRadius.w){
+			continue;
+		}
+		toLight /= lightDistance;
+		//Smooth falloff that reaches 0 at the radius
+		float falloff = 1.0 - lightDistance / light.positionRadius.w;
+		falloff *= falloff;
+		float diffuseFactor = max(dot(normal, toLight), 0.0);
+		if(diffuseFactor <= 0.0){
+			continue;
+		}
+		vec3 h = normalize(toLight + toEye);
+		float specularFactor = pow(max(dot(normal, h), 0.0), _Material.Shininess);
+		float shadow = PointShadow(light, fs_in.WorldPos, normal);
+		total += (_Material.Kd * diffuseFactor + _Material.Ks * specularFactor) * light.color.rgb * falloff * shadow;
+	}
+	return total;
+}
@@ -0,0 +1,74 @@
+//Shadow map filtering for lit.frag. Quality is selected by shader variant:
+//neither define = single hardware PCF tap (2x2 bilinear)
+//SHADOW_GATHER = 4 textureGather taps weighted into a smooth 3x3 bilinear PCF kernel
+//SHADOW_POISSON = rotated Poisson disc of hardware PCF taps with early-out
+//SHADOW_POISSON wins when both are defined. Expects shadowMap to be declared by the including shader
+
+#if defined(SHADOW_POISSON)
+const int POISSON_SAMPLES = 16;
+const int POISSON_EARLY_SAMPLES = 4;
+const float POISSON_RADIUS = 2.5; //In texels
+//First 4 samples are spread over the disc so they are representative for the early-out test
+const vec2 poissonDisk[POISSON_SAMPLES] = vec2[](
+	vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725),
+	vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+	vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464),
+	vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+	vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420),
+	vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+	vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590),
+	vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+
+//Per-pixel rotation angle so banding turns into fine noise
+float interleavedGradientNoise(vec2 pixel){
+	return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+#endif
+
+#if defined(SHADOW_GATHER) && !defined(SHADOW_POISSON)
+//Weighs one textureGather footprint. Gather order is (0,1),(1,1),(1,0),(0,0)
+float gatherQuad(vec2 uv, float ref, vec2 wx, vec2 wy){
+	vec4 g = textureGather(shadowMap, uv, ref);
+	return g.w * wx.x * wy.x + g.z * wx.y * wy.x + g.x * wx.x * wy.y + g.y * wx.y * wy.y;
+}
+#endif
+
+//Returns fraction of light visible (1 = fully lit)
+float SampleShadow(vec2 uv, float ref){
+	vec2 shadowSize = vec2(textureSize(shadowMap, 0));
+	vec2 texelSize = 1.0 / shadowSize;
+#if defined(SHADOW_POISSON)
+	float angle = interleavedGradientNoise(gl_FragCoord.xy) * 6.28318530718;
+	float s = sin(angle);
+	float c = cos(angle);
+	mat2 rotation = mat2(c, s, -s, c);
+	vec2 radius = texelSize * POISSON_RADIUS;
+	float sum = 0.0;
+	for(int i = 0; i < POISSON_EARLY_SAMPLES; i++){
+		sum += texture(shadowMap, vec3(uv + rotation * poissonDisk[i] * radius, ref));
+	}
+	//Fully lit or fully shadowed across the disc - skip the remaining taps
+	if(sum <= 0.0 || sum >= float(POISSON_EARLY_SAMPLES)){
+		return sum / float(POISSON_EARLY_SAMPLES);
+	}
+	for(int i = POISSON_EARLY_SAMPLES; i < POISSON_SAMPLES; i++){
+		sum += texture(shadowMap, vec3(uv + rotation * poissonDisk[i] * radius, ref));
+	}
+	return sum / float(POISSON_SAMPLES);
+#elif defined(SHADOW_GATHER)
+	//3x3 bilinear PCF covers a 4x4 texel footprint. Column weights are (1-f, 1, 1, f)
+	vec2 st = uv * shadowSize - 0.5;
+	vec2 base = floor(st);
+	vec2 f = st - base;
+	vec2 lo = vec2(1.0) - f;
+	float sum = 0.0;
+	sum += gatherQuad((base + vec2(0.0, 0.0)) * texelSize, ref, vec2(lo.x, 1.0), vec2(lo.y, 1.0));
+	sum += gatherQuad((base + vec2(2.0, 0.0)) * texelSize, ref, vec2(1.0, f.x), vec2(lo.y, 1.0));
+	sum += gatherQuad((base + vec2(0.0, 2.0)) * texelSize, ref, vec2(lo.x, 1.0), vec2(1.0, f.y));
+	sum += gatherQuad((base + vec2(2.0, 2.0)) * texelSize, ref, vec2(1.0, f.x), vec2(1.0, f.y));
+	return sum / 9.0;
+#else
+	return texture(shadowMap, vec3(uv, ref));
+#endif
+}
@@ -1,28 +1,59 @@
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
+#include <algorithm>
 
 #include <ew/external/glad.h>
 #include <ew/shader.h>
+#include <ew/shaderVariants.h>
 #include <ew/model.h>
 #include <GLFW/glfw3.h>
 #include <ew/camera.h>
 #include <ew/texture.h>
+#include <ew/gpuResources.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/procGen.h>
+#include <ew/gpuTimer.h>
+#include <ew/renderGraph.h>
+#include <ew/sceneGraph.h>
+#include <ew/occlusionCulling.h>
+#include <ew/gpuSampleCounter.h>
+#include <ew/jobSystem.h>
+#include <ew/glCapture.h>
+#include <ew/pointShadows.h>
+#include <ew/assetArchive.h>
+#include <thread>
+//Declared before every global that owns GL objects, so it reports after they have released theirs.
+//Anything it lists was never released
+ew::GpuLeakReport gpuLeakReport;
 ew::CameraController cameraController;
+ew::RenderGraph renderGraph;
+ew::SceneGraph sceneGraph;
+ew::OcclusionCuller occlusionCuller;
+bool occlusionCulling = true;
+int numDrawnInstances = 0;
+
+//Depth pre-pass: a position only pass fills the depth buffer, then the lit pass shades with GL_EQUAL
+//so every pixel runs lit.frag (and its shadow filtering) once
+bool depthPrepass = false;
+bool frontToBack = true; //Sort scene graph draws nearest first
+ew::GpuSampleCounter shadedFragments; //Fragments passing the depth test in the lit pass
 
 ew::Transform monkeyTransform;
+ew::Transform planeTransform;
 ew::Camera camera;
 ew::Camera light;
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
+//--capture installs the GL capture layer. Without it glad's pointers are left alone and nothing is recorded
+bool glCaptureEnabled = false;
 
-void drawUI();
+void drawUI(unsigned int occlusionDepthTexture, const ew::ShaderCache& shaderCache);
 
 struct Material {
 	float Ka = 1.0;
@@ -31,6 +62,103 @@ struct Material {
 	float Shininess = 128;
 }material;
 
+//Shadow quality tiers. Each tier is its own lit shader variant (SHADOW_GATHER and SHADOW_POISSON features)
+const int NUM_SHADOW_TIERS = 3;
+const char* shadowTierNames[NUM_SHADOW_TIERS] = { "1-tap hardware PCF", "4-tap Gather PCF", "Rotated Poisson disc" };
+int shadowTier = 1;
+bool cpuNormalMatrix = true; //Lit variant with the normal matrix computed per draw instead of per vertex
+ew::GpuTimer litPassTimers[NUM_SHADOW_TIERS]; //Lit pass GPU time, per tier
+
+//Renders each tier for a fixed number of frames and prints average lit pass GPU time
+struct ShadowTierBenchmark {
+	bool running = false;
+	int tier = 0;
+	int frame = 0;
+	int prevTier = 0;
+	float totalMs[NUM_SHADOW_TIERS] = {};
+	int numFrames[NUM_SHADOW_TIERS] = {};
+}tierBenchmark;
+const int BENCHMARK_WARMUP_FRAMES = 10;
+const int BENCHMARK_FRAMES = 240;
+
+//Renders each depth mode for a fixed number of frames and prints GPU time and shaded fragments
+const int NUM_DEPTH_MODES = 3;
+const char* depthModeNames[NUM_DEPTH_MODES] = { "Submission order", "Front-to-back", "Pre-pass, front-to-back" };
+struct DepthBenchmark {
+	bool running = false;
+	int mode = 0;
+	int frame = 0;
+	bool prevPrepass = false;
+	bool prevFrontToBack = false;
+	float prepassMs[NUM_DEPTH_MODES] = {};
+	float litMs[NUM_DEPTH_MODES] = {};
+	double fragments[NUM_DEPTH_MODES] = {};
+	int numFrames[NUM_DEPTH_MODES] = {};
+}depthBenchmark;
+
+//Scene graph update cost with 1% of nodes moving, for hierarchies of different shapes
+const int NUM_SCENE_BENCHMARKS = 3;
+const char* sceneBenchmarkNames[NUM_SCENE_BENCHMARKS] = { "Deep (chain)", "Wide (one level)", "Balanced (4-ary)" };
+const int sceneBenchmarkBranching[NUM_SCENE_BENCHMARKS] = { 1, 100000, 4 };
+const int SCENE_BENCHMARK_NODES = 100000;
+ew::SceneGraphBenchmarkResult sceneBenchmarkResults[NUM_SCENE_BENCHMARKS];
+bool sceneBenchmarkDone = false;
+
+//Occlusion culling cost on an occluder heavy scene, at increasing thread counts
+const int NUM_OCCLUSION_BENCHMARKS = 4;
+const int occlusionBenchmarkThreads[NUM_OCCLUSION_BENCHMARKS] = { 1, 2, 4, 8 };
+ew::OcclusionBenchmarkResult occlusionBenchmarkResults[NUM_OCCLUSION_BENCHMARKS];
+bool occlusionBenchmarkDone = false;
+
+//Job system scaling from 1 thread up to every core, on sphere generation and Assimp mesh conversion.
+//Both meshes are about a million vertices, suzanne.obj has too few for the conversion to scale
+const int JOB_BENCHMARK_SUBDIVISIONS = 1024;
+std::vector<ew::JobBenchmarkResult> jobBenchmarkResults;
+
+//Point lights circling the scene, each with an omnidirectional shadow
+ew::PointShadows pointShadows;
+std::vector<ew::Light> pointLights;
+bool pointShadowsEnabled = true;
+int numPointLights = 8;
+const int MAX_POINT_LIGHTS = 32;
+
+//Renders the scene with each number of point lights for a fixed number of frames and prints draws and GPU time
+const int NUM_POINT_LIGHT_COUNTS = 3;
+const int pointLightCounts[NUM_POINT_LIGHT_COUNTS] = { 1, 8, 32 };
+struct PointShadowBenchmark {
+	bool running = false;
+	int step = 0;
+	int frame = 0;
+	int prevNumLights = 0;
+	bool prevEnabled = false;
+	double draws[NUM_POINT_LIGHT_COUNTS] = {};
+	double faceRenders[NUM_POINT_LIGHT_COUNTS] = {};
+	double unculledFaceRenders[NUM_POINT_LIGHT_COUNTS] = {};
+	float cullMs[NUM_POINT_LIGHT_COUNTS] = {};
+	float shadowMs[NUM_POINT_LIGHT_COUNTS] = {};
+	float litMs[NUM_POINT_LIGHT_COUNTS] = {};
+	ew::PointShadowStats lastStats[NUM_POINT_LIGHT_COUNTS];
+	int numFrames[NUM_POINT_LIGHT_COUNTS] = {};
+}pointShadowBenchmark;
+
+//Shadow pass cost of high-poly spheres with each vertex layout. They are drawn into the shadow map only,
+//beneath the floor so the image doesn't change
+const int NUM_STREAM_MODES = 3;
+const char* streamModeNames[NUM_STREAM_MODES] = { "Interleaved, all", "Interleaved, positions", "Split, positions" };
+const int NUM_STREAM_MESHES = 3;
+const int streamMeshSubdivisions[NUM_STREAM_MESHES] = { 64, 256, 512 };
+const int STREAM_BENCHMARK_INSTANCES = 16;
+std::vector<ew::Mesh> streamMeshes[2]; //Interleaved and split copies of each sphere, while benchmarking
+struct VertexStreamBenchmark {
+	bool running = false;
+	int step = -1; //-1 = baseline without the spheres, then sphere * NUM_STREAM_MODES + mode
+	int frame = 0;
+	float baselineMs = 0.0f;
+	int numBaselineFrames = 0;
+	float shadowMs[NUM_STREAM_MESHES][NUM_STREAM_MODES] = {};
+	int numFrames[NUM_STREAM_MESHES][NUM_STREAM_MODES] = {};
+}streamBenchmark;
+
 //Global state
 int screenWidth = 1080;
 int screenHeight = 720;
@@ -43,118 +171,612 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	controller->yaw = controller->pitch = 0;
 }
 
-int main() {
-	GLFWwindow* window = initWindow("Assignment 0", screenWidth, screenHeight);
+float passMilliseconds(const char* name) {
+	for (int i = 0; i < renderGraph.getNumPasses(); i++)
+	{
+		if (renderGraph.getPassName(i) == name) {
+			return renderGraph.getPassGpuMilliseconds(i);
+		}
+	}
+	return 0.0f;
+}
+
+//Depth convention for passes rendered from the camera.
+//Reversed-Z clears to 0, which is infinitely far away, and keeps greater depths
+void setCameraDepthState(bool reversedZ) {
+	glClipControl(GL_LOWER_LEFT, reversedZ ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+	glClearDepth(reversedZ ? 0.0 : 1.0);
+	glDepthFunc(reversedZ ? GL_GREATER : GL_LESS);
+}
+
+void setDepthMode(int mode) {
+	frontToBack = mode >= 1;
+	depthPrepass = mode == 2;
+}
+
+void startDepthBenchmark() {
+	depthBenchmark = DepthBenchmark();
+	depthBenchmark.running = true;
+	depthBenchmark.prevPrepass = depthPrepass;
+	depthBenchmark.prevFrontToBack = frontToBack;
+}
+
+//Called once per frame after the graph has executed
+void updateDepthBenchmark() {
+	if (!depthBenchmark.running) {
+		return;
+	}
+	DepthBenchmark& b = depthBenchmark;
+	//Timings and sample counts lag a few frames behind, so the warmup also flushes results from the previous mode
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		b.prepassMs[b.mode] += passMilliseconds("DepthPrepass");
+		b.litMs[b.mode] += passMilliseconds("Lit");
+		b.fragments[b.mode] += (double)shadedFragments.getSamples();
+		b.numFrames[b.mode]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.mode < NUM_DEPTH_MODES) {
+		return;
+	}
+	b.running = false;
+	depthPrepass = b.prevPrepass;
+	frontToBack = b.prevFrontToBack;
+	int numPixels = screenWidth * screenHeight;
+	printf("\nDepth modes (%dx%d, %s, average of %d frames):\n", screenWidth, screenHeight, camera.reversedZ ? "reversed-Z" : "standard Z", BENCHMARK_FRAMES);
+	double baseline = b.numFrames[0] > 0 ? b.fragments[0] / b.numFrames[0] : 0.0;
+	for (int i = 0; i < NUM_DEPTH_MODES; i++)
+	{
+		int n = std::max(b.numFrames[i], 1);
+		double fragments = b.fragments[i] / n;
+		double saved = baseline > 0.0 ? 100.0 * (1.0 - fragments / baseline) : 0.0;
+		printf("  %-24s pre-pass %.3f ms, lit %.3f ms GPU, %.0f fragments shaded (%.2f per pixel, %.1f%% saved)\n", depthModeNames[i],
+			b.prepassMs[i] / n, b.litMs[i] / n, fragments, fragments / numPixels, saved);
+	}
+}
+
+void startVertexStreamBenchmark() {
+	streamBenchmark = VertexStreamBenchmark();
+	streamBenchmark.running = true;
+	for (int i = 0; i < NUM_STREAM_MESHES; i++)
+	{
+		ew::MeshData sphere = ew::createSphere(0.8f, streamMeshSubdivisions[i]);
+		streamMeshes[0].push_back(ew::Mesh(sphere, ew::VertexLayout::INTERLEAVED));
+		streamMeshes[1].push_back(ew::Mesh(sphere, ew::VertexLayout::SPLIT));
+	}
+}
+
+//Called from the shadow pass
+void drawVertexStreamBenchmark(const ew::Shader& depthShader) {
+	if (!streamBenchmark.running || streamBenchmark.step < 0) {
+		return;
+	}
+	int sphere = streamBenchmark.step / NUM_STREAM_MODES;
+	int mode = streamBenchmark.step % NUM_STREAM_MODES;
+	const ew::Mesh& mesh = streamMeshes[mode == 2 ? 1 : 0][sphere];
+	for (int i = 0; i < STREAM_BENCHMARK_INSTANCES; i++)
+	{
+		ew::Transform transform;
+		transform.position = glm::vec3((i % 4 - 1.5f) * 2.0f, -3.5f, (i / 4 - 1.5f) * 2.0f);
+		depthShader.setMat4("model", transform.modelMatrix());
+		if (mode == 0) {
+			mesh.draw();
+		}
+		else {
+			mesh.drawPositions();
+		}
+	}
+}
+
+//Called once per frame after the graph has executed
+void updateVertexStreamBenchmark() {
+	if (!streamBenchmark.running) {
+		return;
+	}
+	VertexStreamBenchmark& b = streamBenchmark;
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		float ms = passMilliseconds("Shadow");
+		if (b.step < 0) {
+			b.baselineMs += ms;
+			b.numBaselineFrames++;
+		}
+		else {
+			b.shadowMs[b.step / NUM_STREAM_MODES][b.step % NUM_STREAM_MODES] += ms;
+			b.numFrames[b.step / NUM_STREAM_MODES][b.step % NUM_STREAM_MODES]++;
+		}
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.step < NUM_STREAM_MESHES * NUM_STREAM_MODES) {
+		return;
+	}
+	b.running = false;
+	float baseline = b.baselineMs / std::max(b.numBaselineFrames, 1);
+	printf("\nVertex streams in the shadow pass (%d spheres per draw set, average of %d frames, GPU ms above the %.3f ms scene):\n",
+		STREAM_BENCHMARK_INSTANCES, BENCHMARK_FRAMES, baseline);
+	printf("  %9s %10s", "Vertices", "Triangles");
+	for (int mode = 0; mode < NUM_STREAM_MODES; mode++)
+	{
+		printf(" %24s", streamModeNames[mode]);
+	}
+	printf("\n");
+	for (int i = 0; i < NUM_STREAM_MESHES; i++)
+	{
+		const ew::Mesh& mesh = streamMeshes[0][i];
+		printf("  %9d %10d", mesh.getNumVertices(), mesh.getNumIndices() / 3);
+		for (int mode = 0; mode < NUM_STREAM_MODES; mode++)
+		{
+			printf(" %24.3f", b.shadowMs[i][mode] / std::max(b.numFrames[i][mode], 1) - baseline);
+		}
+		printf("\n");
+	}
+	streamMeshes[0].clear();
+	streamMeshes[1].clear();
+}
+
+void runSceneGraphBenchmark() {
+	printf("\nScene graph update (%d nodes, 1%% moving):\n", SCENE_BENCHMARK_NODES);
+	for (int i = 0; i < NUM_SCENE_BENCHMARKS; i++)
+	{
+		ew::SceneGraphBenchmarkResult& r = sceneBenchmarkResults[i];
+		r = ew::benchmarkSceneGraphUpdate(SCENE_BENCHMARK_NODES, sceneBenchmarkBranching[i]);
+		printf("  %-18s depth %6d  full %.3f ms  incremental %.3f ms (%.0f nodes)\n", sceneBenchmarkNames[i], r.maxDepth, r.fullUpdateMilliseconds, r.incrementalUpdateMilliseconds, r.averageUpdatedNodes);
+	}
+	sceneBenchmarkDone = true;
+}
+
+void runOcclusionBenchmark() {
+	printf("\nOcclusion culling (%dx%d depth buffer):\n", occlusionCuller.getWidth(), occlusionCuller.getHeight());
+	for (int i = 0; i < NUM_OCCLUSION_BENCHMARKS; i++)
+	{
+		ew::OcclusionBenchmarkResult& r = occlusionBenchmarkResults[i];
+		r = ew::benchmarkOcclusionCulling(occlusionBenchmarkThreads[i], occlusionCuller.getWidth(), occlusionCuller.getHeight());
+		printf("  %d threads: %d occluder tris, bin %.3f ms, raster %.3f ms, pyramid %.3f ms, %d tests %.3f ms (%d culled)\n", occlusionBenchmarkThreads[i],
+			r.numOccluderTriangles, r.binMilliseconds, r.rasterMilliseconds, r.pyramidMilliseconds, r.numObjects, r.testMilliseconds, r.numCulled);
+	}
+	occlusionBenchmarkDone = true;
+}
+
+void runJobBenchmark() {
+	int maxThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+	printf("\nJob system (createSphere and processAiMesh, sphere of %d subdivisions):\n", JOB_BENCHMARK_SUBDIVISIONS);
+	jobBenchmarkResults.clear();
+	for (int threads = 1; threads <= maxThreads; threads++)
+	{
+		ew::JobBenchmarkResult r = ew::benchmarkJobSystem(threads, JOB_BENCHMARK_SUBDIVISIONS, JOB_BENCHMARK_SUBDIVISIONS);
+		//Speedup over the single threaded run
+		const ew::JobBenchmarkResult& base = jobBenchmarkResults.empty() ? r : jobBenchmarkResults[0];
+		float sphereSpeedup = r.sphereMilliseconds > 0.0f ? base.sphereMilliseconds / r.sphereMilliseconds : 0.0f;
+		float aiMeshSpeedup = r.aiMeshMilliseconds > 0.0f ? base.aiMeshMilliseconds / r.aiMeshMilliseconds : 0.0f;
+		printf("  %2d threads: createSphere %.3f ms (%.2fx)  processAiMesh %.3f ms (%.2fx)  %lld steals\n", r.numThreads,
+			r.sphereMilliseconds, sphereSpeedup, r.aiMeshMilliseconds, aiMeshSpeedup, r.numSteals);
+		jobBenchmarkResults.push_back(r);
+	}
+}
+
+//Spreads the lights over three rings at different heights, turning slowly
+void updatePointLights(int count, float time) {
+	pointLights.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		ew::Light& pointLight = pointLights[i];
+		int ring = i % 3;
+		float angle = glm::two_pi<float>() * i / count + time * (ring == 1 ? -0.3f : 0.3f);
+		float ringRadius = 1.8f + ring * 1.4f;
+		pointLight.position = glm::vec3(cosf(angle) * ringRadius, -0.6f + ring * 0.7f, sinf(angle) * ringRadius);
+		pointLight.radius = 4.0f;
+		//Evenly spaced hues
+		float hue = (float)i / count * 6.0f;
+		pointLight.color = glm::clamp(glm::vec3(fabsf(hue - 3.0f) - 1.0f, 2.0f - fabsf(hue - 2.0f), 2.0f - fabsf(hue - 4.0f)), 0.0f, 1.0f);
+		pointLight.intensity = 8.0f / sqrtf((float)count);
+	}
+}
+
+void startPointShadowBenchmark() {
+	pointShadowBenchmark = PointShadowBenchmark();
+	pointShadowBenchmark.running = true;
+	pointShadowBenchmark.prevNumLights = numPointLights;
+	pointShadowBenchmark.prevEnabled = pointShadowsEnabled;
+	pointShadowsEnabled = true;
+}
+
+//Called once per frame after the graph has executed
+void updatePointShadowBenchmark() {
+	if (!pointShadowBenchmark.running) {
+		return;
+	}
+	PointShadowBenchmark& b = pointShadowBenchmark;
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		const ew::PointShadowStats& stats = pointShadows.getStats();
+		b.draws[b.step] += stats.numDraws;
+		b.faceRenders[b.step] += stats.numFaceRenders;
+		b.unculledFaceRenders[b.step] += stats.numUnculledFaceRenders;
+		b.cullMs[b.step] += stats.cullMilliseconds;
+		b.shadowMs[b.step] += stats.gpuMilliseconds;
+		b.litMs[b.step] += passMilliseconds("Lit");
+		b.lastStats[b.step] = stats;
+		b.numFrames[b.step]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.step < NUM_POINT_LIGHT_COUNTS) {
+		return;
+	}
+	b.running = false;
+	numPointLights = b.prevNumLights;
+	pointShadowsEnabled = b.prevEnabled;
+	const ew::PointShadowSettings& settings = pointShadows.getSettings();
+	printf("\nPoint shadows (%dx%d, %d casters, tiers", screenWidth, screenHeight, sceneGraph.getNumInstances() + 1);
+	for (int tier = 0; tier < settings.numTiers; tier++)
+	{
+		printf(" %d x%d", pointShadows.getFaceResolution(tier), settings.tierCapacity[tier]);
+	}
+	printf(", average of %d frames):\n", BENCHMARK_FRAMES);
+	for (int i = 0; i < NUM_POINT_LIGHT_COUNTS; i++)
+	{
+		int n = std::max(b.numFrames[i], 1);
+		const ew::PointShadowStats& stats = b.lastStats[i];
+		printf("  %2d lights: %2d shadowed (%d/%d/%d per tier), %.1f draws, %.1f face renders of %.1f unculled, cull %.3f ms, shadow %.3f ms GPU, lit %.3f ms GPU\n",
+			pointLightCounts[i], stats.numShadowedLights, stats.numTierLights[0], stats.numTierLights[1], stats.numTierLights[2],
+			b.draws[i] / n, b.faceRenders[i] / n, b.unculledFaceRenders[i] / n, b.cullMs[i] / n, b.shadowMs[i] / n, b.litMs[i] / n);
+	}
+}
+
+void startTierBenchmark() {
+	tierBenchmark = ShadowTierBenchmark();
+	tierBenchmark.running = true;
+	tierBenchmark.prevTier = shadowTier;
+}
+
+//Called once per frame after the lit pass has been timed
+void updateTierBenchmark() {
+	if (!tierBenchmark.running) {
+		return;
+	}
+	ShadowTierBenchmark& b = tierBenchmark;
+	if (b.frame >= BENCHMARK_WARMUP_FRAMES) {
+		b.totalMs[b.tier] += litPassTimers[b.tier].getMilliseconds();
+		b.numFrames[b.tier]++;
+	}
+	if (++b.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.tier < NUM_SHADOW_TIERS) {
+		return;
+	}
+	b.running = false;
+	shadowTier = b.prevTier;
+	printf("\nShadow tier GPU time (lit pass, %dx%d, average of %d frames):\n", screenWidth, screenHeight, BENCHMARK_FRAMES);
+	for (int i = 0; i < NUM_SHADOW_TIERS; i++)
+	{
+		float avg = b.numFrames[i] > 0 ? b.totalMs[i] / b.numFrames[i] : 0.0f;
+		printf("  %-22s %.3f ms\n", shadowTierNames[i], avg);
+	}
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--capture") == 0) {
+			glCaptureEnabled = true;
+		}
+	}
+	//Assets come from the archive the build packs next to the executable, or loose files without one
+	ew::mountAssetArchive("Assignment2.pak");
+	GLFWwindow* window = initWindow("Assignment 2", screenWidth, screenHeight);
 	//Resizing WIndow
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK); //Back face culling
 	glEnable(GL_DEPTH_TEST); //Depth testing
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
-	//Shader
-	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
+	ew::Texture brickTexture = ew::Texture("assets/brick_color.jpg");
+	//Lit shader variants, by shadow tier and where the normal matrix is computed. The starting variant
+	//is compiled now, the others on a background context while the first frames render
+	ew::ShaderCache shaderCache;
+	shaderCache.startBackgroundCompiler(window);
+	ew::ShaderVariants litShaders(&shaderCache, "assets/lit.vert", "assets/lit.frag", { "SHADOW_GATHER", "SHADOW_POISSON", "CPU_NORMAL_MATRIX", "POINT_SHADOWS" });
+	const unsigned int shadowTierMasks[NUM_SHADOW_TIERS] = { 0, litShaders.getMask("SHADOW_GATHER"), litShaders.getMask("SHADOW_POISSON") };
+	const unsigned int normalMatrixMask = litShaders.getMask("CPU_NORMAL_MATRIX");
+	const unsigned int pointShadowMask = litShaders.getMask("POINT_SHADOWS");
+	auto litVariantMask = [&]() {
+		return shadowTierMasks[shadowTier] | (cpuNormalMatrix ? normalMatrixMask : 0) | (pointShadowsEnabled ? pointShadowMask : 0);
+	};
+	const unsigned int startingLitMask = litVariantMask();
+	const ew::Shader* startingLitShader = litShaders.get(startingLitMask);
+	for (int i = 0; i < NUM_SHADOW_TIERS; i++)
+	{
+		litShaders.precompile(shadowTierMasks[i]);
+		litShaders.precompile(shadowTierMasks[i] | normalMatrixMask);
+		litShaders.precompile(shadowTierMasks[i] | pointShadowMask);
+		litShaders.precompile(shadowTierMasks[i] | normalMatrixMask | pointShadowMask);
+	}
 	ew::Shader depthShader = ew::Shader("assets/depthShader.vert", "assets/depthShader.frag");
-	//Model
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
+	ew::Shader prepassShader = ew::Shader("assets/depthPrepass.vert", "assets/depthShader.frag");
+	ew::Shader pointShadowShader = ew::Shader("assets/pointShadow.vert", "assets/pointShadow.geom", "assets/depthShader.frag");
+	pointShadows.create(ew::PointShadowSettings());
+	//Scene: the imported monkey with a ring of smaller monkeys orbiting it. The moons are children of
+	//the monkey's root node and instance its meshes, so they follow its rotation
+	//Depth only passes fetch just the position stream
+	sceneGraph.setVertexLayout(ew::VertexLayout::SPLIT);
+	int sceneRoot = sceneGraph.addNode("Scene");
+	int monkeyNode = sceneGraph.import("assets/suzanne.obj", sceneRoot);
+	int orbitNode = sceneGraph.addNode("Orbit", monkeyNode);
+	const int NUM_MOONS = 4;
+	for (int i = 0; i < NUM_MOONS && monkeyNode >= 0; i++)
+	{
+		ew::Transform moonTransform;
+		float angle = glm::two_pi<float>() * i / NUM_MOONS;
+		moonTransform.position = glm::vec3(cosf(angle), 0.0f, sinf(angle)) * 2.5f;
+		moonTransform.scale = glm::vec3(0.3f);
+		int moon = sceneGraph.addNode("Moon" + std::to_string(i), orbitNode, moonTransform);
+		for (int mesh = 0; mesh < sceneGraph.getNumMeshes(); mesh++)
+		{
+			sceneGraph.addMeshInstance(moon, mesh);
+		}
+	}
+	//Simplified occluders: a sphere that fits inside the monkey's head, and the floor. They are binned and
+	//rasterized by jobs every frame
+	ew::JobSystem jobs;
+	ew::MeshData monkeyOccluder = ew::createSphere(0.6f, 8);
+	ew::MeshData planeOccluder = ew::createPlane(10, 10, 1);
+	unsigned int occlusionDepthTexture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &occlusionDepthTexture);
+	glTextureStorage2D(occlusionDepthTexture, 1, GL_R32F, occlusionCuller.getWidth(), occlusionCuller.getHeight());
+
 	//camera
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
 	camera.target = glm::vec3(0.0f, 0.0f, 0.0f); //Look at the center of the scene
 	camera.aspectRatio = (float)screenWidth / screenHeight;
 	camera.fov = 60.0f; //Vertical field of view, in degrees
 
-	light.position = glm::vec3(2.0f, 1.0f, 0.0f);
-	light.target = glm::vec3(0.0, 1.0, 0.0);
+	//Orthographic light covering the whole plane
+	light.position = glm::vec3(3.0f, 6.0f, 2.0f);
+	light.target = glm::vec3(0.0f, 0.0f, 0.0f);
 	light.aspectRatio = (float)1;
 	light.orthographic = true;
-	light.orthoHeight = 1.0f;
+	light.orthoHeight = 14.0f;
+	light.nearPlane = 0.1f;
+	light.farPlane = 20.0f;
 
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
 	//Plane
-	ew::Mesh planeMesh = ew::Mesh(ew::createPlane(10, 10, 1));
-	//Shadow Buffer
-	unsigned int depthMapFBO;
-	glGenFramebuffers(1, &depthMapFBO);
-	const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-
-	unsigned int depthMap;
-	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-		SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-	shader.use();
-	shader.setInt("diffuseTexture", 0);
-	shader.setInt("shadowMap", 1);
-
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
-
-		float time = (float)glfwGetTime();
-		deltaTime = time - prevFrameTime;
-		prevFrameTime = time;
-		shader.setVec3("_EyePos", camera.position);
-
-		//RENDER
-		cameraController.move(window, &camera, deltaTime);
-		glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBindTextureUnit(0, brickTexture);
-
-		//Depth Buffer Setting viewport
-		glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+	ew::Mesh planeMesh = ew::Mesh(ew::createPlane(10, 10, 1), ew::VertexLayout::SPLIT);
+	ew::Bounds planeBounds = ew::computeBounds(ew::createPlane(10, 10, 1));
+	planeTransform.position = glm::vec3(0.0f, -1.5f, 0.0f);
+	//Shadow map is a fixed size transient texture of the render graph
+	const int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
+	ew::RenderTextureDesc shadowDesc;
+	shadowDesc.format = GL_DEPTH_COMPONENT24;
+	shadowDesc.width = SHADOW_WIDTH;
+	shadowDesc.height = SHADOW_HEIGHT;
+	int shadowMap = renderGraph.createTexture("ShadowMap", shadowDesc);
+	int backbuffer = renderGraph.importBackbuffer();
+	//The scene renders offscreen so it can have a float depth buffer, which reversed-Z needs for its precision
+	int sceneColor = renderGraph.createTexture("SceneColor", { GL_RGBA8 });
+	int sceneDepth = renderGraph.createTexture("SceneDepth", { GL_DEPTH_COMPONENT32F });
+	unsigned int presentFramebuffer;
+	glCreateFramebuffers(1, &presentFramebuffer);
+
+	//Graph textures may be aliased, so comparison state lives in a sampler rather than the texture.
+	//Linear filtering + compare mode gives hardware 2x2 bilinear PCF per tap
+	unsigned int shadowSampler;
+	glCreateSamplers(1, &shadowSampler);
+	glSamplerParameteri(shadowSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(shadowSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(shadowSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(shadowSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	//Anything outside of the light's frustum is lit
+	glSamplerParameteri(shadowSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glSamplerParameteri(shadowSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	float borderColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glSamplerParameterfv(shadowSampler, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+	glm::mat4 lightSpaceMatrix;
+
+	//Draws the monkeys and the plane. The pre-pass and lit pass must draw exactly the same geometry,
+	//otherwise GL_EQUAL leaves holes or lets hidden surfaces through.
+	//normalMatrixUniform is set per draw when the shader variant reads it. Position only shaders (positionsOnly)
+	//get the same vertices from the position stream alone
+	auto drawScene = [&](const ew::Shader& shader, const std::string& normalMatrixUniform, bool positionsOnly) {
+		ew::SceneGraph::VisibilityTest isVisible = [](const ew::Bounds& bounds, const glm::mat4& worldMatrix) {
+			return occlusionCuller.isVisible(bounds, worldMatrix);
+		};
+		if (occlusionCulling) {
+			numDrawnInstances = positionsOnly ? sceneGraph.drawPositions(shader, isVisible) : sceneGraph.draw(shader, isVisible, "_Model", normalMatrixUniform);
+		}
+		else if (positionsOnly) {
+			sceneGraph.drawPositions(shader);
+			numDrawnInstances = sceneGraph.getNumInstances();
+		}
+		else {
+			sceneGraph.draw(shader, "_Model", normalMatrixUniform);
+			numDrawnInstances = sceneGraph.getNumInstances();
+		}
+		glm::mat4 planeModel = planeTransform.modelMatrix();
+		shader.setMat4("_Model", planeModel);
+		if (!normalMatrixUniform.empty()) {
+			shader.setMat3(normalMatrixUniform, glm::transpose(glm::inverse(glm::mat3(planeModel))));
+		}
+		if (positionsOnly) {
+			planeMesh.drawPositions();
+		}
+		else {
+			planeMesh.draw();
+		}
+	};
+
+	renderGraph.addPass("Shadow", [&](const ew::RenderGraph& graph) {
+		//The light uses the default depth convention
+		setCameraDepthState(false);
 		glClear(GL_DEPTH_BUFFER_BIT);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, brickTexture);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		monkeyModel.draw(); //Draws monkey model using current shader
-		planeMesh.draw();
-		// reset viewport
-		glViewport(0, 0, screenWidth, screenHeight);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
 		depthShader.use();
-
-
+		depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+		sceneGraph.drawPositions(depthShader, "model");
+		depthShader.setMat4("model", planeTransform.modelMatrix());
+		planeMesh.drawPositions();
+		drawVertexStreamBenchmark(depthShader);
+	}).writeDepth(shadowMap);
+
+	//Writes the point lights' own cube maps rather than graph textures, so it is kept explicitly
+	renderGraph.addPass("PointShadows", [&](const ew::RenderGraph& graph) {
+		setCameraDepthState(false);
+		pointShadows.render(pointShadowShader);
+	}).sideEffects();
+
+	//Clears the scene depth, then fills it when the pre-pass is enabled
+	renderGraph.addPass("DepthPrepass", [&](const ew::RenderGraph& graph) {
+		setCameraDepthState(camera.reversedZ);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		if (!depthPrepass) {
+			return;
+		}
+		prepassShader.use();
+		prepassShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+		drawScene(prepassShader, "", true);
+	}).writeDepth(sceneDepth);
+
+	renderGraph.addPass("Lit", [&](const ew::RenderGraph& graph) {
+		glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		setCameraDepthState(camera.reversedZ);
+		//Depth is final already. Only the nearest surface passes, and nothing needs writing
+		if (depthPrepass) {
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
+
+		litPassTimers[shadowTier].begin();
+		//Until the selected variant has compiled, the starting one stands in. Benchmarks wait for it
+		unsigned int mask = litVariantMask();
+		bool benchmarking = tierBenchmark.running || pointShadowBenchmark.running;
+		const ew::Shader* litShader = benchmarking ? litShaders.get(mask) : litShaders.tryGet(mask);
+		if (litShader == nullptr) {
+			//Uniforms below follow the features of the variant actually bound
+			litShader = startingLitShader;
+			mask = startingLitMask;
+		}
+		const ew::Shader& shader = *litShader;
 		shader.use();
 		shader.setInt("_MainTex", 0);
-		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
-		monkeyTransform.position = glm::vec3(10.0f, 0.0f, 0.0f);
+		shader.setInt("shadowMap", 1);
+		glBindTextureUnit(0, brickTexture.getHandle());
+		glBindTextureUnit(1, graph.getTexture(shadowMap));
+		glBindSampler(1, shadowSampler);
+		pointShadows.bind(shader, 2);
+		shader.setVec3("_EyePos", camera.position);
+		shader.setVec3("_LightDirection", glm::normalize(light.target - light.position));
+		shader.setVec3("lightPos", light.position);
+		shader.setMat4("lightMat", lightSpaceMatrix);
 		shader.setFloat("_Material.Ka", material.Ka);
 		shader.setFloat("_Material.Kd", material.Kd);
 		shader.setFloat("_Material.Ks", material.Ks);
 		shader.setFloat("_Material.Shininess", material.Shininess);
+		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
 
-		//transform.modelMatrix() combines translation, rotation, and scale into a 4x4 model matrix
-		shader.setMat4("_Model", monkeyTransform.modelMatrix());
+		shadedFragments.begin();
+		drawScene(shader, (mask & normalMatrixMask) ? "_NormalMatrix" : "", false);
+		shadedFragments.end();
+		glBindSampler(1, 0);
+		glDepthMask(GL_TRUE);
+		setCameraDepthState(false);
+		litPassTimers[shadowTier].end();
+	}).read(shadowMap).writeColor(sceneColor).writeDepth(sceneDepth);
+
+	renderGraph.addPass("Present", [&](const ew::RenderGraph& graph) {
+		//Scene color may be aliased to a different texture after a resize, so it's attached every frame
+		glNamedFramebufferTexture(presentFramebuffer, GL_COLOR_ATTACHMENT0, graph.getTexture(sceneColor), 0);
+		int width = graph.getWidth(sceneColor);
+		int height = graph.getHeight(sceneColor);
+		glBlitNamedFramebuffer(presentFramebuffer, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}).read(sceneColor).writeColor(backbuffer);
+
+	renderGraph.resize(screenWidth, screenHeight);
 
-		shader.use();
-		shader.setMat4("_Model", glm::mat4(1.0f));
-		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		monkeyModel.draw(); //Draws monkey model using current shader
-		planeMesh.draw();
+	while (!glfwWindowShouldClose(window)) {
+		glfwPollEvents();
 
-		drawUI();
+		float time = (float)glfwGetTime();
+		deltaTime = time - prevFrameTime;
+		prevFrameTime = time;
 
+		cameraController.move(window, &camera, deltaTime);
+		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
+		if (monkeyNode >= 0) {
+			//Keep the imported root's own transform, and spin it
+			ew::Transform transform = sceneGraph.getLocalTransform(monkeyNode);
+			transform.rotation = monkeyTransform.rotation;
+			sceneGraph.setLocalTransform(monkeyNode, transform);
+		}
+		sceneGraph.updateWorldMatrices();
+
+		if (depthBenchmark.running) {
+			setDepthMode(depthBenchmark.mode);
+		}
+		if (frontToBack) {
+			sceneGraph.sortFrontToBack(camera.position);
+		}
+		else {
+			sceneGraph.resetDrawOrder();
+		}
+
+		if (occlusionCulling) {
+			//The culler works in the default depth convention
+			ew::Camera cullCamera = camera;
+			cullCamera.reversedZ = false;
+			occlusionCuller.beginFrame(cullCamera.projectionMatrix() * cullCamera.viewMatrix());
+			for (int i = 0; i < sceneGraph.getNumInstances(); i++)
+			{
+				occlusionCuller.addOccluder(&monkeyOccluder, sceneGraph.getWorldMatrix(sceneGraph.getInstanceNode(i)));
+			}
+			occlusionCuller.addOccluder(&planeOccluder, planeTransform.modelMatrix());
+			occlusionCuller.rasterize(&jobs);
+			glTextureSubImage2D(occlusionDepthTexture, 0, 0, 0, occlusionCuller.getWidth(), occlusionCuller.getHeight(), GL_RED, GL_FLOAT, occlusionCuller.getDepth(0));
+		}
+		lightSpaceMatrix = light.projectionMatrix() * light.viewMatrix();
+
+		if (pointShadowBenchmark.running) {
+			numPointLights = pointLightCounts[pointShadowBenchmark.step];
+		}
+		updatePointLights(pointShadowsEnabled ? numPointLights : 0, time);
+		std::vector<ew::ShadowCaster> shadowCasters;
+		for (int i = 0; i < sceneGraph.getNumInstances(); i++)
+		{
+			int mesh = sceneGraph.getInstanceMesh(i);
+			shadowCasters.push_back({ &sceneGraph.getMesh(mesh), sceneGraph.getWorldMatrix(sceneGraph.getInstanceNode(i)), sceneGraph.getMeshBounds(mesh) });
+		}
+		shadowCasters.push_back({ &planeMesh, planeTransform.modelMatrix(), planeBounds });
+		pointShadows.update(camera, pointLights, shadowCasters);
+
+		if (tierBenchmark.running) {
+			shadowTier = tierBenchmark.tier;
+		}
+
+		//Picks up variants finished by the background compiler
+		shaderCache.update();
+		renderGraph.execute();
+
+		updateTierBenchmark();
+		updateDepthBenchmark();
+		updatePointShadowBenchmark();
+		updateVertexStreamBenchmark();
+
+		drawUI(occlusionDepthTexture, shaderCache);
+
+		ew::endGlCaptureFrame();
 		glfwSwapBuffers(window);
 	}
+	glDeleteFramebuffers(1, &presentFramebuffer);
 	printf("Shutting down...");
 }
 
-void drawUI() {
+void drawUI(unsigned int occlusionDepthTexture, const ew::ShaderCache& shaderCache) {
 	ImGui_ImplGlfw_NewFrame();
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui::NewFrame();
@@ -171,9 +793,130 @@ void drawUI() {
 		ImGui::SliderFloat("Shininess", &material.Shininess, 2.0f, 1024.0f);
 	}
 
-	ImGui::Text("Add Controls Here!");
+	if (ImGui::CollapsingHeader("Shadows")) {
+		ImGui::Combo("Quality", &shadowTier, shadowTierNames, NUM_SHADOW_TIERS);
+		ImGui::Checkbox("CPU Normal Matrix", &cpuNormalMatrix);
+		ImGui::Text("Shader programs: %d (%d compiling), %.1f ms compiling", shaderCache.getNumPrograms(), shaderCache.getNumPending(), shaderCache.getCompileMilliseconds());
+		ImGui::Text("Variant requests: %d, %d deduplicated", shaderCache.getNumRequests(), shaderCache.getNumDeduplicated());
+		for (int i = 0; i < renderGraph.getNumPasses(); i++)
+		{
+			ImGui::Text("%s pass: %.3f ms", renderGraph.getPassName(i).c_str(), renderGraph.getPassGpuMilliseconds(i));
+		}
+		for (int i = 0; i < NUM_SHADOW_TIERS; i++)
+		{
+			ImGui::Text("Lit pass (%s): %.3f ms", shadowTierNames[i], litPassTimers[i].getAverageMilliseconds());
+		}
+		if (tierBenchmark.running) {
+			ImGui::Text("Benchmarking %s...", shadowTierNames[tierBenchmark.tier]);
+		}
+		else if (ImGui::Button("Benchmark Tiers")) {
+			startTierBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Point Shadows")) {
+		ImGui::Checkbox("Enabled##PointShadows", &pointShadowsEnabled);
+		ImGui::SliderInt("Lights", &numPointLights, 1, MAX_POINT_LIGHTS);
+		ew::PointShadowSettings& settings = pointShadows.getSettings();
+		ImGui::SliderFloat("Tier 0 Coverage", &settings.tierCoverage, 0.05f, 2.0f);
+		ImGui::SliderFloat("Normal Offset", &settings.normalOffset, 0.0f, 4.0f);
+		const ew::PointShadowStats& stats = pointShadows.getStats();
+		ImGui::Text("Shadowed: %d of %d visible, %d lights", stats.numShadowedLights, stats.numVisibleLights, stats.numLights);
+		for (int tier = 0; tier < settings.numTiers; tier++)
+		{
+			ImGui::Text("Tier %d (%d): %d / %d", tier, pointShadows.getFaceResolution(tier), stats.numTierLights[tier], settings.tierCapacity[tier]);
+		}
+		ImGui::Text("Draws: %d, face renders: %d of %d", stats.numDraws, stats.numFaceRenders, stats.numUnculledFaceRenders);
+		ImGui::Text("Cull %.3f ms, render %.3f ms GPU", stats.cullMilliseconds, stats.gpuMilliseconds);
+		if (pointShadowBenchmark.running) {
+			ImGui::Text("Benchmarking %d lights...", pointLightCounts[pointShadowBenchmark.step]);
+		}
+		else if (ImGui::Button("Benchmark Point Shadows")) {
+			startPointShadowBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Depth")) {
+		ImGui::Checkbox("Depth Pre-pass", &depthPrepass);
+		ImGui::Checkbox("Front-to-back", &frontToBack);
+		ImGui::Checkbox("Reversed-Z", &camera.reversedZ);
+		float fragments = shadedFragments.getAverageSamples();
+		ImGui::Text("Shaded fragments: %.0f (%.2f per pixel)", fragments, fragments / std::max(screenWidth * screenHeight, 1));
+		ImGui::Text("Pre-pass %.3f ms, lit %.3f ms GPU", passMilliseconds("DepthPrepass"), passMilliseconds("Lit"));
+		if (depthBenchmark.running) {
+			ImGui::Text("Benchmarking %s...", depthModeNames[depthBenchmark.mode]);
+		}
+		else if (ImGui::Button("Benchmark Depth Modes")) {
+			startDepthBenchmark();
+		}
+		ImGui::Text("Shadow pass %.3f ms GPU", passMilliseconds("Shadow"));
+		if (streamBenchmark.running) {
+			ImGui::Text("Benchmarking %s...", streamBenchmark.step < 0 ? "baseline" : streamModeNames[streamBenchmark.step % NUM_STREAM_MODES]);
+		}
+		else if (ImGui::Button("Benchmark Vertex Streams")) {
+			startVertexStreamBenchmark();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Scene Graph")) {
+		ImGui::Text("Nodes: %d, meshes: %d, instances: %d", sceneGraph.getNumNodes(), sceneGraph.getNumMeshes(), sceneGraph.getNumInstances());
+		ImGui::Text("Updated this frame: %d", sceneGraph.getNumUpdatedNodes());
+		if (ImGui::Button("Benchmark Updates")) {
+			runSceneGraphBenchmark();
+		}
+		for (int i = 0; i < NUM_SCENE_BENCHMARKS && sceneBenchmarkDone; i++)
+		{
+			const ew::SceneGraphBenchmarkResult& r = sceneBenchmarkResults[i];
+			ImGui::Text("%s: full %.3f ms, 1%% moving %.3f ms", sceneBenchmarkNames[i], r.fullUpdateMilliseconds, r.incrementalUpdateMilliseconds);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Occlusion Culling")) {
+		ImGui::Checkbox("Enabled##Occlusion", &occlusionCulling);
+		ImGui::Text("Drawn instances: %d / %d", numDrawnInstances, sceneGraph.getNumInstances());
+		ImGui::Text("Occluder triangles: %d (%d threads)", occlusionCuller.getNumOccluderTriangles(), occlusionCuller.getNumThreadsUsed());
+		ImGui::Text("Bin %.3f ms, raster %.3f ms, pyramid %.3f ms", occlusionCuller.getBinMilliseconds(), occlusionCuller.getRasterMilliseconds(), occlusionCuller.getPyramidMilliseconds());
+		//Flipped, since the depth buffer's first row is the bottom of the screen
+		ImGui::Image((void*)(intptr_t)occlusionDepthTexture, ImVec2((float)occlusionCuller.getWidth(), (float)occlusionCuller.getHeight()), ImVec2(0, 1), ImVec2(1, 0));
+		if (ImGui::Button("Benchmark Occlusion")) {
+			runOcclusionBenchmark();
+		}
+		for (int i = 0; i < NUM_OCCLUSION_BENCHMARKS && occlusionBenchmarkDone; i++)
+		{
+			const ew::OcclusionBenchmarkResult& r = occlusionBenchmarkResults[i];
+			ImGui::Text("%d threads: raster %.3f ms, tests %.3f ms, %d/%d culled", occlusionBenchmarkThreads[i],
+				r.binMilliseconds + r.rasterMilliseconds + r.pyramidMilliseconds, r.testMilliseconds, r.numCulled, r.numObjects);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Job System")) {
+		if (ImGui::Button("Benchmark Scaling")) {
+			runJobBenchmark();
+		}
+		for (const ew::JobBenchmarkResult& r : jobBenchmarkResults) {
+			ImGui::Text("%d threads: sphere %.3f ms, processAiMesh %.3f ms", r.numThreads, r.sphereMilliseconds, r.aiMeshMilliseconds);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("GL Capture")) {
+		//Replay with tools/glReplay: GLReplay capture.ewcap [other.ewcap]
+		static int captureFrames = 3;
+		ImGui::SliderInt("Frames", &captureFrames, 1, 30);
+		if (!glCaptureEnabled) {
+			ImGui::Text("Run with --capture to record frames");
+		}
+		else if (ew::isGlCapturing()) {
+			ImGui::Text("Capturing...");
+		}
+		else if (ImGui::Button("Capture")) {
+			ew::startGlCapture("capture.ewcap", captureFrames, screenWidth, screenHeight);
+		}
+	}
+
 	ImGui::End();
 
+	ew::drawGpuResourceWindow();
+
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -183,6 +926,10 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 	glViewport(0, 0, width, height);
 	screenWidth = width;
 	screenHeight = height;
+	if (height > 0) {
+		camera.aspectRatio = (float)screenWidth / screenHeight;
+	}
+	renderGraph.resize(width, height);
 }
 
 /// <summary>
@@ -210,6 +957,10 @@ GLFWwindow* initWindow(const char* title, int width, int height) {
 		printf("GLAD Failed to load GL headers");
 		return nullptr;
 	}
+	//Records object setup from here on, so any frame can be captured later
+	if (glCaptureEnabled) {
+		ew::installGlCapture();
+	}
 
 	//Initialize ImGUI
 	IMGUI_CHECKVERSION();
@@ -0,0 +1,32 @@
+#version 450
+//Vertex attributes
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+
+//Per instance data, indexed by gl_InstanceID
+struct Instance{
+	mat4 model;
+	vec4 params; //x = layer in _MainTexArray
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer{
+	Instance _Instances[];
+};
+uniform int _FirstInstance; //Offset of this draw's instances in _Instances
+uniform mat4 _ViewProjection;
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec3 WorldNormal; //Vertex normal in world space
+	vec2 TexCoord;
+	flat float Layer;
+}vs_out;
+
+void main(){
+	Instance instance = _Instances[_FirstInstance + gl_InstanceID];
+	vs_out.WorldPos = vec3(instance.model * vec4(vPos,1.0));
+	vs_out.WorldNormal = transpose(inverse(mat3(instance.model))) * vNormal;
+	vs_out.TexCoord = vTexCoord;
+	vs_out.Layer = instance.params.x;
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos,1.0);
+}
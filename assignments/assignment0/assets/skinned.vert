@@ -0,0 +1,33 @@
+#version 450
+//Vertex attributes
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in uvec4 vJoints;
+layout(location = 4) in vec4 vWeights; //Sum to 1
+
+//Skinning matrices of every character, _NumJoints per instance, with the character's world matrix applied
+layout(std430, binding = 3) readonly buffer SkinningBuffer{
+	mat4 _SkinningMatrices[];
+};
+uniform int _NumJoints;
+uniform mat4 _ViewProjection;
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec3 WorldNormal; //Vertex normal in world space
+	vec2 TexCoord;
+}vs_out;
+
+void main(){
+	int first = gl_InstanceID * _NumJoints;
+	mat4 skin = _SkinningMatrices[first + int(vJoints.x)] * vWeights.x
+		+ _SkinningMatrices[first + int(vJoints.y)] * vWeights.y
+		+ _SkinningMatrices[first + int(vJoints.z)] * vWeights.z
+		+ _SkinningMatrices[first + int(vJoints.w)] * vWeights.w;
+	vs_out.WorldPos = vec3(skin * vec4(vPos,1.0));
+	//Blended joints may scale non-uniformly, so normals need the inverse transpose
+	vs_out.WorldNormal = transpose(inverse(mat3(skin))) * vNormal;
+	vs_out.TexCoord = vTexCoord;
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos,1.0);
+}
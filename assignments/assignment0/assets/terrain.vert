@@ -0,0 +1,59 @@
+#version 450
+//Patch from ew::createPlane(1, 1, gridSize), x and z in [-0.5, 0.5]
+layout(location = 0) in vec3 vPos;
+
+//Node selected by ew::Terrain, indexed by gl_InstanceID
+struct TerrainNode{
+	vec4 area; //xy = world xz of the min corner, z = world size, w = level
+	vec4 params; //x = layer in _HeightPages, y = distance morphing starts, z = 1 / morph distance
+};
+layout(std430, binding = 4) readonly buffer TerrainNodes{
+	TerrainNode _Nodes[];
+};
+uniform int _FirstInstance; //Offset of this draw's nodes in _Nodes
+uniform mat4 _ViewProjection;
+uniform sampler2DArray _HeightPages; //One page of heights per node, a texel per vertex plus a 1 texel border
+uniform float _GridSize; //Quads per patch side
+uniform float _PageSize; //Texels per page side
+uniform float _HeightScale;
+uniform float _BaseHeight;
+uniform vec3 _MorphEye; //Camera position nodes were selected from
+uniform float _TexCoordScale = 0.25; //Texture repeats per world unit
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec3 WorldNormal; //Vertex normal in world space
+	vec2 TexCoord;
+}vs_out;
+
+//gridPos is in patch quads, 0 to _GridSize
+float sampleHeight(vec2 gridPos, float layer){
+	vec2 uv = (gridPos + 1.5) / _PageSize;
+	return _BaseHeight + textureLod(_HeightPages, vec3(uv, layer), 0).r * _HeightScale;
+}
+
+void main(){
+	TerrainNode node = _Nodes[_FirstInstance + gl_InstanceID];
+	float layer = node.params.x;
+	float quadSize = node.area.z / _GridSize;
+	vec2 gridPos = round((vPos.xz + 0.5) * _GridSize);
+
+	//Odd vertices slide onto their even neighbours as the morph factor goes to 1, which turns the patch
+	//into the next coarser level's exactly where that level takes over
+	vec2 worldXZ = node.area.xy + gridPos * quadSize;
+	vec3 unmorphed = vec3(worldXZ.x, sampleHeight(gridPos, layer), worldXZ.y);
+	float morph = clamp((distance(_MorphEye, unmorphed) - node.params.y) * node.params.z, 0.0, 1.0);
+	gridPos -= mod(gridPos, 2.0) * morph;
+	worldXZ = node.area.xy + gridPos * quadSize;
+
+	float height = sampleHeight(gridPos, layer);
+	float left = sampleHeight(gridPos - vec2(1.0, 0.0), layer);
+	float right = sampleHeight(gridPos + vec2(1.0, 0.0), layer);
+	float back = sampleHeight(gridPos - vec2(0.0, 1.0), layer);
+	float front = sampleHeight(gridPos + vec2(0.0, 1.0), layer);
+
+	vs_out.WorldPos = vec3(worldXZ.x, height, worldXZ.y);
+	vs_out.WorldNormal = normalize(vec3(left - right, 2.0 * quadSize, back - front));
+	vs_out.TexCoord = worldXZ * _TexCoordScale;
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos, 1.0);
+}
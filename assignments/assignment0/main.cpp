@@ -7,11 +7,27 @@
 #include <GLFW/glfw3.h>
 #include <ew/camera.h>
 #include <ew/texture.h>
+#include <ew/gpuResources.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <ew/transform.h>
 #include <ew/cameraController.h>
+#include <ew/textureArray.h>
+#include <ew/procGen.h>
+#include <ew/gpuTimer.h>
+#include <ew/skinnedMesh.h>
+#include <ew/jobSystem.h>
+#include <ew/terrain.h>
+#include <ew/assetArchive.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <glm/gtc/constants.hpp>
+//Declared before every global that owns GL objects, so it reports after they have released theirs.
+//Anything it lists was never released
+ew::GpuLeakReport gpuLeakReport;
 ew::CameraController cameraController;
 
 ew::Transform monkeyTransform;
@@ -29,6 +45,71 @@ struct Material {
 	float Shininess = 128;
 }material;
 
+//Grid of spheres below the monkey, each with one of many albedo textures. Drawn either one sphere at a time
+//with a bind per texture, or as one instanced draw per texture array
+const int GRID_SIZE = 16;
+const int NUM_ALBEDO_TEXTURES = 64;
+const int ALBEDO_SIZE = 128;
+bool useTextureArrays = true;
+ew::GpuTimer gridTimer;
+float gridSubmitMilliseconds = 0.0f;
+unsigned int numTextureBinds = 0; //Last frame
+int numGridDrawCalls = 0;
+
+//Matches Instance in litArray.vert
+struct GridInstance {
+	glm::mat4 model;
+	glm::vec4 params; //x = texture array layer
+};
+//Consecutive instances sharing a texture array
+struct GridBatch {
+	int array;
+	int firstInstance;
+	int numInstances;
+};
+
+//Field of tentacles behind the grid, each blending two looping clips. Poses are evaluated on the CPU
+//across the job system and skinned on the GPU, all characters in one instanced draw
+const int NUM_CHARACTERS = 1000;
+const int CHARACTER_COLUMNS = 40;
+const int TENTACLE_JOINTS = 12;
+const float TENTACLE_LENGTH = 2.4f;
+ew::Skeleton tentacleSkeleton;
+std::vector<ew::AnimationClip> tentacleClips;
+bool drawCharacters = true;
+bool animationSimd = true;
+int animationThreads = 0;
+float animationMilliseconds = 0.0f; //Sampling, blending and skinning matrices
+float paletteUploadMilliseconds = 0.0f;
+ew::GpuTimer characterTimer;
+std::vector<ew::AnimationBenchmarkResult> animationBenchmarkResults;
+
+//CDLOD terrain far below the scene, over a procedural 16k x 16k heightmap
+const int TERRAIN_SIZE = 16384;
+ew::Terrain terrain;
+bool drawTerrain = true;
+ew::GpuTimer terrainTimer;
+
+//Flies the camera over the terrain at each LOD distance ratio and prints average triangles and times
+const int NUM_TERRAIN_LOD_RATIOS = 3;
+const float terrainLodRatios[NUM_TERRAIN_LOD_RATIOS] = { 1.0f, 2.0f, 4.0f };
+struct TerrainBenchmark {
+	bool running = false;
+	int ratio = 0;
+	int frame = 0;
+	float prevRatio = 0.0f;
+	ew::Camera prevCamera;
+	double triangles[NUM_TERRAIN_LOD_RATIOS] = {};
+	double nodes[NUM_TERRAIN_LOD_RATIOS] = {};
+	double selectMs[NUM_TERRAIN_LOD_RATIOS] = {};
+	double streamMs[NUM_TERRAIN_LOD_RATIOS] = {};
+	double gpuMs[NUM_TERRAIN_LOD_RATIOS] = {};
+	double frameMs[NUM_TERRAIN_LOD_RATIOS] = {};
+	int numFrames[NUM_TERRAIN_LOD_RATIOS] = {};
+}terrainBenchmark;
+const int TERRAIN_BENCHMARK_WARMUP_FRAMES = 30;
+const int TERRAIN_BENCHMARK_FRAMES = 300;
+
 //Global state
 int screenWidth = 1080;
 int screenHeight = 720;
@@ -41,22 +122,274 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	controller->yaw = controller->pitch = 0;
 }
 
+//Checkerboard in a different hue and check size per index, standing in for a library of material textures
+void createAlbedoPixels(int index, std::vector<unsigned char>* pixels) {
+	pixels->resize(ALBEDO_SIZE * ALBEDO_SIZE * 4);
+	float hue = (float)index / NUM_ALBEDO_TEXTURES;
+	glm::vec3 color;
+	color.x = 0.5f + 0.5f * cosf(glm::two_pi<float>() * hue);
+	color.y = 0.5f + 0.5f * cosf(glm::two_pi<float>() * (hue + 0.33f));
+	color.z = 0.5f + 0.5f * cosf(glm::two_pi<float>() * (hue + 0.67f));
+	int checkSize = 4 << (index % 4);
+	for (int y = 0; y < ALBEDO_SIZE; y++)
+	{
+		for (int x = 0; x < ALBEDO_SIZE; x++)
+		{
+			float shade = ((x / checkSize + y / checkSize) % 2) ? 1.0f : 0.35f;
+			unsigned char* p = &(*pixels)[(y * ALBEDO_SIZE + x) * 4];
+			p[0] = (unsigned char)(color.x * shade * 255.0f);
+			p[1] = (unsigned char)(color.y * shade * 255.0f);
+			p[2] = (unsigned char)(color.z * shade * 255.0f);
+			p[3] = 255;
+		}
+	}
+}
+
+//Standalone GL_TEXTURE_2D with mipmaps, the way every texture was stored before texture arrays
+ew::Texture createTexture2D(int width, int height, const unsigned char* rgba) {
+	int numLevels = 1;
+	while ((std::max(width, height) >> numLevels) > 0) {
+		numLevels++;
+	}
+	unsigned int texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, numLevels, GL_RGBA8, width, height);
+	glTextureSubImage2D(texture, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenerateTextureMipmap(texture);
+	ew::trackGpuResource(ew::GpuResourceType::TEXTURE, texture, (size_t)width * height * 4 * 4 / 3, "Albedo");
+	return ew::Texture(texture);
+}
+
+//Chain of joints straight up from the origin, TENTACLE_LENGTH long
+void createTentacleSkeleton(ew::Skeleton* skeleton) {
+	float segment = TENTACLE_LENGTH / (TENTACLE_JOINTS - 1);
+	for (int i = 0; i < TENTACLE_JOINTS; i++)
+	{
+		glm::vec3 position = glm::vec3(0.0f, i == 0 ? 0.0f : segment, 0.0f);
+		glm::mat4 inverseBind = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -segment * i, 0.0f));
+		skeleton->addJoint("Joint" + std::to_string(i), i - 1, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f), inverseBind);
+	}
+}
+
+//Every joint rotates about axis, with a phase offset that travels up the chain. Loops over duration
+ew::AnimationClip createTentacleClip(const char* name, const glm::vec3& axis, float degrees, float phasePerJoint, float duration) {
+	const int NUM_KEYS = 16;
+	std::vector<ew::JointTrack> tracks(TENTACLE_JOINTS);
+	for (int j = 1; j < TENTACLE_JOINTS; j++)
+	{
+		for (int k = 0; k <= NUM_KEYS; k++)
+		{
+			float t = duration * k / NUM_KEYS;
+			float angle = glm::radians(degrees) * sinf(glm::two_pi<float>() * k / NUM_KEYS - j * phasePerJoint);
+			tracks[j].rotationTimes.push_back(t);
+			tracks[j].rotations.push_back(glm::angleAxis(angle, axis));
+		}
+	}
+	return ew::AnimationClip(name, tentacleSkeleton, tracks, duration);
+}
+
+//Tapered tube along the joint chain. Each ring is weighted between the two joints it lies between
+ew::SkinnedMeshData createTentacleMesh() {
+	const int NUM_RINGS = (TENTACLE_JOINTS - 1) * 4 + 1;
+	const int NUM_SIDES = 12;
+	float segment = TENTACLE_LENGTH / (TENTACLE_JOINTS - 1);
+	ew::SkinnedMeshData mesh;
+	for (int ring = 0; ring < NUM_RINGS; ring++)
+	{
+		float v = (float)ring / (NUM_RINGS - 1);
+		float y = v * TENTACLE_LENGTH;
+		float radius = glm::mix(0.12f, 0.03f, v);
+		int joint = std::min((int)(y / segment), TENTACLE_JOINTS - 2);
+		int joints[2] = { joint, joint + 1 };
+		float weights[2] = { 1.0f - (y / segment - joint), y / segment - joint };
+		for (int side = 0; side <= NUM_SIDES; side++)
+		{
+			float theta = glm::two_pi<float>() * side / NUM_SIDES;
+			ew::SkinnedVertex vertex;
+			vertex.normal = glm::vec3(cosf(theta), 0.0f, sinf(theta));
+			vertex.pos = glm::vec3(vertex.normal.x * radius, y, vertex.normal.z * radius);
+			vertex.uv = glm::vec2((float)side / NUM_SIDES, v);
+			ew::setSkinWeights(&vertex, joints, weights, 2);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	int columns = NUM_SIDES + 1;
+	for (int ring = 0; ring < NUM_RINGS - 1; ring++)
+	{
+		for (int side = 0; side < NUM_SIDES; side++)
+		{
+			unsigned int a = ring * columns + side;
+			unsigned int b = a + 1;
+			unsigned int c = a + columns;
+			unsigned int d = c + 1;
+			mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+		}
+	}
+	return mesh;
+}
+
+void startTerrainBenchmark() {
+	terrainBenchmark = TerrainBenchmark();
+	terrainBenchmark.running = true;
+	terrainBenchmark.prevRatio = terrain.getSettings().lodDistanceRatio;
+	terrainBenchmark.prevCamera = camera;
+}
+
+//Places the camera along a fixed path across the terrain, low over the ground and looking ahead
+void moveTerrainBenchmarkCamera(int frame) {
+	float t = (float)frame / (TERRAIN_BENCHMARK_WARMUP_FRAMES + TERRAIN_BENCHMARK_FRAMES);
+	glm::vec2 size = terrain.getWorldSize();
+	glm::vec3 origin = terrain.getSettings().position;
+	glm::vec2 position = glm::vec2(origin.x + size.x * (0.2f + 0.6f * t), origin.z + size.y * (0.5f + 0.2f * sinf(t * glm::two_pi<float>())));
+	glm::vec2 ahead = position + glm::vec2(40.0f, 0.0f);
+	camera.position = glm::vec3(position.x, terrain.getHeight(position.x, position.y) + 10.0f, position.y);
+	camera.target = glm::vec3(ahead.x, terrain.getHeight(ahead.x, ahead.y), ahead.y);
+}
+
+//Called once per frame after the terrain has been drawn
+void updateTerrainBenchmark() {
+	if (!terrainBenchmark.running) {
+		return;
+	}
+	TerrainBenchmark& b = terrainBenchmark;
+	if (b.frame >= TERRAIN_BENCHMARK_WARMUP_FRAMES) {
+		const ew::TerrainStats& stats = terrain.getStats();
+		b.triangles[b.ratio] += stats.numTriangles;
+		b.nodes[b.ratio] += stats.numNodes;
+		b.selectMs[b.ratio] += stats.selectMilliseconds;
+		b.streamMs[b.ratio] += stats.streamMilliseconds;
+		b.gpuMs[b.ratio] += terrainTimer.getMilliseconds();
+		b.frameMs[b.ratio] += deltaTime * 1000.0f;
+		b.numFrames[b.ratio]++;
+	}
+	if (++b.frame < TERRAIN_BENCHMARK_WARMUP_FRAMES + TERRAIN_BENCHMARK_FRAMES) {
+		return;
+	}
+	b.frame = 0;
+	if (++b.ratio < NUM_TERRAIN_LOD_RATIOS) {
+		return;
+	}
+	b.running = false;
+	terrain.getSettings().lodDistanceRatio = b.prevRatio;
+	camera = b.prevCamera;
+	printf("\nTerrain (%dx%d heightmap, %d levels, %dx%d patches, %dx%d, average of %d frames):\n", TERRAIN_SIZE, TERRAIN_SIZE,
+		terrain.getNumLevels(), terrain.getSettings().gridSize, terrain.getSettings().gridSize, screenWidth, screenHeight, TERRAIN_BENCHMARK_FRAMES);
+	printf("  Full resolution grid: %.0f triangles\n", 2.0 * (TERRAIN_SIZE - 1) * (TERRAIN_SIZE - 1));
+	printf("  %-10s %12s %8s %10s %10s %10s %10s\n", "LOD ratio", "Triangles", "Nodes", "Select ms", "Stream ms", "GPU ms", "Frame ms");
+	for (int i = 0; i < NUM_TERRAIN_LOD_RATIOS; i++)
+	{
+		double n = std::max(b.numFrames[i], 1);
+		printf("  %-10.1f %12.0f %8.0f %10.3f %10.3f %10.3f %10.3f\n", terrainLodRatios[i], b.triangles[i] / n, b.nodes[i] / n,
+			b.selectMs[i] / n, b.streamMs[i] / n, b.gpuMs[i] / n, b.frameMs[i] / n);
+	}
+}
+
+void runAnimationBenchmark() {
+	int maxThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+	animationBenchmarkResults.clear();
+	for (int threads = 1; threads <= maxThreads; threads++)
+	{
+		animationBenchmarkResults.push_back(ew::benchmarkAnimation(tentacleSkeleton, tentacleClips, NUM_CHARACTERS, threads));
+	}
+	const ew::AnimationBenchmarkResult& base = animationBenchmarkResults[0];
+	printf("\nAnimation (%d characters, %d joints, 2 clips blended):\n", base.numCharacters, base.numJoints);
+	printf("  Sample + blend, 1 thread: scalar %.3f ms, SIMD %.3f ms (%.2fx)\n", base.scalarPoseMilliseconds, base.simdPoseMilliseconds,
+		base.simdPoseMilliseconds > 0.0f ? base.scalarPoseMilliseconds / base.simdPoseMilliseconds : 0.0f);
+	for (const ew::AnimationBenchmarkResult& r : animationBenchmarkResults) {
+		float speedup = r.evaluateMilliseconds > 0.0f ? base.evaluateMilliseconds / r.evaluateMilliseconds : 0.0f;
+		printf("  %2d threads: evaluate with skinning matrices %.3f ms (%.2fx)\n", r.numThreads, r.evaluateMilliseconds, speedup);
+	}
+}
+
 int main() {
+	//Assets come from the archive the build packs next to the executable, or loose files without one
+	ew::mountAssetArchive("assignment0.pak");
 	GLFWwindow* window = initWindow("Assignment 0", screenWidth, screenHeight);
 	//Resizing WIndow
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK); //Back face culling
 	glEnable(GL_DEPTH_TEST); //Depth testing
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
+	ew::Texture brickTexture = ew::Texture("assets/brick_color.jpg");
 	//Shader
 	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
 	//Model
 	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
+
+	//Every albedo texture, both as a standalone texture and as a layer of a texture array
+	ew::Shader arrayShader = ew::Shader("assets/litArray.vert", "assets/litArray.frag");
+	ew::TextureArrayManager textureArrays;
+	std::vector<ew::Texture> albedoTextures;
+	std::vector<ew::TextureLayer> albedoLayers;
+	std::vector<unsigned char> pixels;
+	for (int i = 0; i < NUM_ALBEDO_TEXTURES; i++)
+	{
+		createAlbedoPixels(i, &pixels);
+		albedoTextures.push_back(createTexture2D(ALBEDO_SIZE, ALBEDO_SIZE, pixels.data()));
+		albedoLayers.push_back(textureArrays.add(ALBEDO_SIZE, ALBEDO_SIZE, 4, pixels.data()));
+	}
+	textureArrays.upload();
+
+	ew::Mesh sphereMesh = ew::Mesh(ew::createSphere(0.35f, 16));
+	std::vector<int> gridTextures; //Albedo index per instance
+	std::vector<GridInstance> gridInstances;
+	std::vector<GridBatch> gridBatches;
+	//Instances are grouped by texture array, so each array is one draw
+	for (int array = 0; array < textureArrays.getNumArrays(); array++)
+	{
+		GridBatch batch = { array, (int)gridInstances.size(), 0 };
+		for (int i = 0; i < GRID_SIZE * GRID_SIZE; i++)
+		{
+			int texture = (i * 7) % NUM_ALBEDO_TEXTURES;
+			if (albedoLayers[texture].array != array) {
+				continue;
+			}
+			GridInstance instance;
+			instance.model = glm::translate(glm::mat4(1.0f), glm::vec3((i % GRID_SIZE) - GRID_SIZE * 0.5f, -2.0f, -(float)(i / GRID_SIZE)));
+			instance.params = glm::vec4((float)albedoLayers[texture].layer, 0.0f, 0.0f, 0.0f);
+			gridInstances.push_back(instance);
+			gridTextures.push_back(texture);
+			batch.numInstances++;
+		}
+		gridBatches.push_back(batch);
+	}
+	unsigned int gridInstanceBuffer;
+	glCreateBuffers(1, &gridInstanceBuffer);
+	glNamedBufferStorage(gridInstanceBuffer, sizeof(GridInstance) * gridInstances.size(), gridInstances.data(), 0);
+
+	ew::JobSystem jobs;
+	animationThreads = jobs.getNumThreads();
+	ew::Shader skinnedShader = ew::Shader("assets/skinned.vert", "assets/lit.frag");
+	createTentacleSkeleton(&tentacleSkeleton);
+	tentacleClips.push_back(createTentacleClip("Sway", glm::vec3(0.0f, 0.0f, 1.0f), 12.0f, 0.5f, 2.0f));
+	tentacleClips.push_back(createTentacleClip("Curl", glm::vec3(1.0f, 0.0f, 0.0f), 20.0f, 0.25f, 3.0f));
+	ew::SkinnedMesh tentacleMesh = ew::SkinnedMesh(createTentacleMesh());
+	std::vector<ew::AnimationState> characters(NUM_CHARACTERS);
+	for (int i = 0; i < NUM_CHARACTERS; i++)
+	{
+		glm::vec3 position = glm::vec3((i % CHARACTER_COLUMNS) - CHARACTER_COLUMNS * 0.5f, -2.5f, -17.0f - (float)(i / CHARACTER_COLUMNS));
+		characters[i].worldMatrix = glm::translate(glm::mat4(1.0f), position);
+		characters[i].clipA = 0;
+		characters[i].clipB = 1;
+	}
+	std::vector<glm::mat4> skinningMatrices((size_t)NUM_CHARACTERS * tentacleSkeleton.getNumJoints());
+	ew::SkinningPalette skinningPalette;
+
+	ew::Shader terrainShader = ew::Shader("assets/terrain.vert", "assets/lit.frag");
+	ew::TerrainSettings terrainSettings;
+	terrainSettings.texelSpacing = 0.1f;
+	terrainSettings.heightScale = 100.0f;
+	terrainSettings.position = glm::vec3(-TERRAIN_SIZE * 0.05f, -120.0f, -TERRAIN_SIZE * 0.05f);
+	terrain.load(ew::getProceduralHeight, TERRAIN_SIZE, TERRAIN_SIZE, terrainSettings);
+
 	//camera
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
 	camera.target = glm::vec3(0.0f, 0.0f, 0.0f); //Look at the center of the scene
 	camera.aspectRatio = (float)screenWidth / screenHeight;
 	camera.fov = 60.0f; //Vertical field of view, in degrees
+	camera.nearPlane = 0.05f;
+	camera.farPlane = 2000.0f; //Far enough for the terrain
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
 	while (!glfwWindowShouldClose(window)) {
@@ -65,13 +398,21 @@ int main() {
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
 		prevFrameTime = time;
+		numTextureBinds = ew::getTextureBindCount();
+		ew::resetTextureBindCount();
 		shader.setVec3("_EyePos", camera.position);
 		//RENDER
-		cameraController.move(window, &camera, deltaTime);
+		if (terrainBenchmark.running) {
+			terrain.getSettings().lodDistanceRatio = terrainLodRatios[terrainBenchmark.ratio];
+			moveTerrainBenchmarkCamera(terrainBenchmark.frame);
+		}
+		else {
+			cameraController.move(window, &camera, deltaTime);
+		}
 		glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBindTextureUnit(0, brickTexture);
+		ew::bindTextureUnit(0, brickTexture.getHandle());
 		shader.use();
 		shader.setInt("_MainTex", 0);
 		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
@@ -89,6 +430,92 @@ int main() {
 		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
 		monkeyModel.draw(); //Draws monkey model using current shader
 
+		//Sphere grid
+		gridTimer.begin();
+		auto submitStart = std::chrono::high_resolution_clock::now();
+		numGridDrawCalls = 0;
+		if (useTextureArrays) {
+			arrayShader.use();
+			arrayShader.setInt("_MainTexArray", 0);
+			arrayShader.setVec3("_EyePos", camera.position);
+			arrayShader.setFloat("_Material.Ka", material.Ka);
+			arrayShader.setFloat("_Material.Kd", material.Kd);
+			arrayShader.setFloat("_Material.Ks", material.Ks);
+			arrayShader.setFloat("_Material.Shininess", material.Shininess);
+			arrayShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gridInstanceBuffer);
+			for (const GridBatch& batch : gridBatches) {
+				textureArrays.bind(0, batch.array);
+				arrayShader.setInt("_FirstInstance", batch.firstInstance);
+				sphereMesh.drawInstanced(batch.numInstances);
+				numGridDrawCalls++;
+			}
+		}
+		else {
+			//Same instances and order, one bind and draw each
+			for (size_t i = 0; i < gridInstances.size(); i++)
+			{
+				ew::bindTextureUnit(0, albedoTextures[gridTextures[i]].getHandle());
+				shader.setMat4("_Model", gridInstances[i].model);
+				sphereMesh.draw();
+				numGridDrawCalls++;
+			}
+		}
+		auto submitEnd = std::chrono::high_resolution_clock::now();
+		gridSubmitMilliseconds = std::chrono::duration<float, std::milli>(submitEnd - submitStart).count();
+		gridTimer.end();
+
+		//Tentacles
+		if (drawCharacters) {
+			for (int i = 0; i < NUM_CHARACTERS; i++)
+			{
+				ew::AnimationState& character = characters[i];
+				character.timeA = time + i * 0.13f;
+				character.timeB = time * 1.3f + i * 0.07f;
+				character.weight = 0.5f + 0.5f * sinf(time * 0.7f + i * 0.3f);
+			}
+			auto animateStart = std::chrono::high_resolution_clock::now();
+			ew::evaluateAnimations(tentacleSkeleton, tentacleClips, characters.data(), NUM_CHARACTERS, skinningMatrices.data(), &jobs, animationSimd);
+			auto animateEnd = std::chrono::high_resolution_clock::now();
+			skinningPalette.upload(skinningMatrices.data(), (int)skinningMatrices.size());
+			auto uploadEnd = std::chrono::high_resolution_clock::now();
+			animationMilliseconds = std::chrono::duration<float, std::milli>(animateEnd - animateStart).count();
+			paletteUploadMilliseconds = std::chrono::duration<float, std::milli>(uploadEnd - animateEnd).count();
+
+			characterTimer.begin();
+			skinnedShader.use();
+			ew::bindTextureUnit(0, brickTexture.getHandle());
+			skinnedShader.setInt("_MainTex", 0);
+			skinnedShader.setInt("_NumJoints", tentacleSkeleton.getNumJoints());
+			skinnedShader.setVec3("_EyePos", camera.position);
+			skinnedShader.setFloat("_Material.Ka", material.Ka);
+			skinnedShader.setFloat("_Material.Kd", material.Kd);
+			skinnedShader.setFloat("_Material.Ks", material.Ks);
+			skinnedShader.setFloat("_Material.Shininess", material.Shininess);
+			skinnedShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			skinningPalette.bind();
+			tentacleMesh.drawInstanced(NUM_CHARACTERS);
+			characterTimer.end();
+		}
+
+		//Terrain
+		if (drawTerrain || terrainBenchmark.running) {
+			terrain.update(camera, &jobs);
+			terrainTimer.begin();
+			ew::bindTextureUnit(0, brickTexture.getHandle());
+			terrainShader.use();
+			terrainShader.setInt("_MainTex", 0);
+			terrainShader.setVec3("_EyePos", camera.position);
+			terrainShader.setFloat("_Material.Ka", material.Ka);
+			terrainShader.setFloat("_Material.Kd", material.Kd);
+			terrainShader.setFloat("_Material.Ks", material.Ks);
+			terrainShader.setFloat("_Material.Shininess", material.Shininess);
+			terrainShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			terrain.draw(terrainShader);
+			terrainTimer.end();
+			updateTerrainBenchmark();
+		}
+
 		drawUI();
 
 		glfwSwapBuffers(window);
@@ -113,9 +540,48 @@ void drawUI() {
 		ImGui::SliderFloat("Shininess", &material.Shininess, 2.0f, 1024.0f);
 	}
 
+	if (ImGui::CollapsingHeader("Texture Batching")) {
+		ImGui::Checkbox("Texture arrays", &useTextureArrays);
+		ImGui::Text("Texture binds: %u, grid draw calls: %d", numTextureBinds, numGridDrawCalls);
+		ImGui::Text("Grid CPU submit %.3f ms, GPU %.3f ms", gridSubmitMilliseconds, gridTimer.getAverageMilliseconds());
+		ImGui::Text("%d albedo textures, %d spheres", NUM_ALBEDO_TEXTURES, GRID_SIZE * GRID_SIZE);
+	}
+
+	if (ImGui::CollapsingHeader("Skinned Characters")) {
+		ImGui::Checkbox("Draw", &drawCharacters);
+		ImGui::Checkbox("SIMD pose evaluation", &animationSimd);
+		ImGui::Text("%d characters, %d joints, %d threads", NUM_CHARACTERS, tentacleSkeleton.getNumJoints(), animationThreads);
+		ImGui::Text("Evaluate %.3f ms CPU, palette upload %.3f ms", animationMilliseconds, paletteUploadMilliseconds);
+		ImGui::Text("Skinned draw %.3f ms GPU", characterTimer.getAverageMilliseconds());
+		if (ImGui::Button("Benchmark Animation")) {
+			runAnimationBenchmark();
+		}
+		for (const ew::AnimationBenchmarkResult& r : animationBenchmarkResults) {
+			ImGui::Text("%d threads: %.3f ms (pose scalar %.3f, SIMD %.3f)", r.numThreads, r.evaluateMilliseconds, r.scalarPoseMilliseconds, r.simdPoseMilliseconds);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Terrain")) {
+		const ew::TerrainStats& stats = terrain.getStats();
+		ImGui::Checkbox("Draw terrain", &drawTerrain);
+		ImGui::SliderFloat("LOD distance ratio", &terrain.getSettings().lodDistanceRatio, 1.0f, 8.0f);
+		ImGui::SliderFloat("Morph start", &terrain.getSettings().morphStartRatio, 0.0f, 0.95f);
+		ImGui::Text("%d levels, %d nodes, %d triangles", terrain.getNumLevels(), stats.numNodes, stats.numTriangles);
+		ImGui::Text("Pages: %d resident, %d loaded, %d waiting", stats.numResidentPages, stats.numPageLoads, stats.numPageRequests - stats.numPageLoads);
+		ImGui::Text("Select %.3f ms, stream %.3f ms, GPU %.3f ms", stats.selectMilliseconds, stats.streamMilliseconds, terrainTimer.getAverageMilliseconds());
+		if (terrainBenchmark.running) {
+			ImGui::Text("Benchmarking LOD ratio %.1f...", terrainLodRatios[terrainBenchmark.ratio]);
+		}
+		else if (ImGui::Button("Benchmark Terrain")) {
+			startTerrainBenchmark();
+		}
+	}
+
 	ImGui::Text("Add Controls Here!");
 	ImGui::End();
 
+	ew::drawGpuResourceWindow();
+
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
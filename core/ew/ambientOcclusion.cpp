@@ -0,0 +1,162 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "ambientOcclusion.h"
+#include "postProcess.h"
+#include "external/glad.h"
+#include <math.h>
+#include <algorithm>
+
+namespace ew {
+	const AmbientOcclusionPreset AMBIENT_OCCLUSION_PRESETS[NUM_AMBIENT_OCCLUSION_PRESETS] = {
+		{ "Low (half res, 6 samples)", 0.5f, 6, 2 },
+		{ "Medium (half res, 10 samples)", 0.5f, 10, 4 },
+		{ "High (half res, 16 samples)", 0.5f, 16, 4 },
+		{ "Reference (full res, 16 samples)", 1.0f, 16, 4 },
+	};
+
+	AmbientOcclusion::AmbientOcclusion(const std::string& assetDirectory)
+		:m_downsampleShader(assetDirectory + "postprocess.vert", assetDirectory + "ssaoDownsample.frag"),
+		m_occlusionShader(assetDirectory + "postprocess.vert", assetDirectory + "ssao.frag"),
+		m_blurShader(assetDirectory + "postprocess.vert", assetDirectory + "ssaoBlur.frag"),
+		m_upsampleShader(assetDirectory + "postprocess.vert", assetDirectory + "ssaoUpsample.frag")
+	{
+	}
+
+	void AmbientOcclusion::applyPreset(int preset)
+	{
+		const AmbientOcclusionPreset& p = AMBIENT_OCCLUSION_PRESETS[std::min(std::max(preset, 0), NUM_AMBIENT_OCCLUSION_PRESETS - 1)];
+		resolutionScale = p.resolutionScale;
+		numSamples = p.numSamples;
+		blurRadius = p.blurRadius;
+	}
+
+	const char* AmbientOcclusion::getStageName(int stage)
+	{
+		const char* names[NUM_STAGES] = { "Downsample", "Occlusion", "Blur", "Upsample" };
+		return stage >= 0 && stage < NUM_STAGES ? names[stage] : "";
+	}
+
+	//Full resolution pixels per low resolution pixel, along each axis
+	int AmbientOcclusion::getFactor() const
+	{
+		return resolutionScale < 0.75f ? 2 : 1;
+	}
+
+	/// <summary>
+	/// Part of a target the current frame renders to, matching the scene's scaled viewport
+	/// </summary>
+	static glm::ivec2 getViewport(const RenderGraph& graph, int resource, const glm::vec2& viewportScale) {
+		glm::vec2 size = glm::vec2(graph.getWidth(resource), graph.getHeight(resource)) * viewportScale;
+		return glm::max(glm::ivec2(size), glm::ivec2(1));
+	}
+
+	int AmbientOcclusion::addPasses(RenderGraph& graph, int depth, int normals)
+	{
+		int factor = getFactor();
+		RenderTextureDesc desc;
+		desc.scale = 1.0f / factor;
+		desc.format = GL_R32F;
+		int lowDepth = graph.createTexture("AODepth", desc);
+		desc.format = GL_RGB10_A2;
+		int lowNormals = graph.createTexture("AONormals", desc);
+		//Occlusion travels with its depth through the blur, so each blur tap is one fetch
+		desc.format = GL_RG16F;
+		int occlusion = graph.createTexture("AOOcclusion", desc);
+		int blurH = graph.createTexture("AOBlurH", desc);
+		int blurV = graph.createTexture("AOBlurV", desc);
+		desc.scale = 1.0f;
+		desc.format = GL_R8;
+		int result = graph.createTexture("AmbientOcclusion", desc);
+
+		m_firstPass[0] = graph.getNumPasses();
+		graph.addPass("AO Downsample", [=](const RenderGraph& g) {
+			glm::ivec2 viewport = getViewport(g, lowDepth, viewportScale);
+			glViewport(0, 0, viewport.x, viewport.y);
+			m_downsampleShader.use();
+			m_downsampleShader.setInt("_Depth", 0);
+			m_downsampleShader.setInt("_Normals", 1);
+			m_downsampleShader.setInt("_Factor", factor);
+			glm::ivec2 sourceMax = getViewport(g, depth, viewportScale) - 1;
+			m_downsampleShader.setVec2("_SourceMax", glm::vec2(sourceMax));
+			m_downsampleShader.setVec2("_NearFar", camera.nearPlane, camera.farPlane);
+			glBindTextureUnit(0, g.getTexture(depth));
+			glBindTextureUnit(1, g.getTexture(normals));
+			drawFullscreen();
+		}).read(depth).read(normals).writeColor(lowDepth).writeColor(lowNormals);
+
+		m_firstPass[1] = m_endPass[0] = graph.getNumPasses();
+		graph.addPass("AO Occlusion", [=](const RenderGraph& g) {
+			glm::ivec2 viewport = getViewport(g, occlusion, viewportScale);
+			glViewport(0, 0, viewport.x, viewport.y);
+			float tanHalfFov = tanf(glm::radians(camera.fov) * 0.5f);
+			int samples = std::min(std::max(numSamples, 1), MAX_SAMPLES);
+			m_occlusionShader.use();
+			m_occlusionShader.setInt("_Depth", 0);
+			m_occlusionShader.setInt("_Normals", 1);
+			m_occlusionShader.setVec2("_ViewportSize", glm::vec2(viewport));
+			m_occlusionShader.setVec2("_ProjectionScale", tanHalfFov * camera.aspectRatio, tanHalfFov);
+			//Pixels covered by one world unit at a view depth of 1
+			m_occlusionShader.setFloat("_PixelsPerUnit", viewport.y / (2.0f * tanHalfFov));
+			m_occlusionShader.setInt("_NumSamples", samples);
+			m_occlusionShader.setFloat("_Radius", radius);
+			m_occlusionShader.setFloat("_Intensity", intensity);
+			m_occlusionShader.setFloat("_Bias", bias);
+			glBindTextureUnit(0, g.getTexture(lowDepth));
+			glBindTextureUnit(1, g.getTexture(lowNormals));
+			drawFullscreen();
+		}).read(lowDepth).read(lowNormals).writeColor(occlusion);
+
+		m_firstPass[2] = m_endPass[1] = graph.getNumPasses();
+		auto blur = [=](const RenderGraph& g, int source, int dest, bool horizontal) {
+			glm::ivec2 viewport = getViewport(g, dest, viewportScale);
+			glViewport(0, 0, viewport.x, viewport.y);
+			m_blurShader.use();
+			m_blurShader.setInt("_Source", 0);
+			m_blurShader.setVec2("_Direction", horizontal ? 1.0f : 0.0f, horizontal ? 0.0f : 1.0f);
+			m_blurShader.setInt("_Radius", std::min(std::max(blurRadius, 0), MAX_BLUR_RADIUS));
+			m_blurShader.setVec2("_ViewportMax", glm::vec2(viewport - 1));
+			m_blurShader.setFloat("_Sharpness", blurSharpness);
+			glBindTextureUnit(0, g.getTexture(source));
+			drawFullscreen();
+		};
+		graph.addPass("AO Blur H", [=](const RenderGraph& g) {
+			blur(g, occlusion, blurH, true);
+		}).read(occlusion).writeColor(blurH);
+		graph.addPass("AO Blur V", [=](const RenderGraph& g) {
+			blur(g, blurH, blurV, false);
+		}).read(blurH).writeColor(blurV);
+
+		m_firstPass[3] = m_endPass[2] = graph.getNumPasses();
+		graph.addPass("AO Upsample", [=](const RenderGraph& g) {
+			glm::ivec2 viewport = getViewport(g, result, viewportScale);
+			glViewport(0, 0, viewport.x, viewport.y);
+			m_upsampleShader.use();
+			m_upsampleShader.setInt("_Depth", 0);
+			m_upsampleShader.setInt("_Source", 1);
+			m_upsampleShader.setInt("_Factor", factor);
+			m_upsampleShader.setVec2("_SourceMax", glm::vec2(getViewport(g, blurV, viewportScale) - 1));
+			m_upsampleShader.setVec2("_NearFar", camera.nearPlane, camera.farPlane);
+			m_upsampleShader.setFloat("_Sharpness", blurSharpness);
+			glBindTextureUnit(0, g.getTexture(depth));
+			glBindTextureUnit(1, g.getTexture(blurV));
+			drawFullscreen();
+		}).read(depth).read(blurV).writeColor(result);
+		m_endPass[3] = graph.getNumPasses();
+		return result;
+	}
+
+	float AmbientOcclusion::getStageGpuMilliseconds(const RenderGraph& graph, int stage) const
+	{
+		if (stage < 0 || stage >= NUM_STAGES || m_endPass[stage] > graph.getNumPasses()) {
+			return 0.0f;
+		}
+		float total = 0.0f;
+		for (int i = m_firstPass[stage]; i < m_endPass[stage]; i++)
+		{
+			total += graph.getPassGpuMilliseconds(i);
+		}
+		return total;
+	}
+}
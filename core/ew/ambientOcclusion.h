@@ -0,0 +1,63 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include "shader.h"
+#include "camera.h"
+#include "renderGraph.h"
+
+namespace ew {
+	struct AmbientOcclusionPreset {
+		const char* name;
+		float resolutionScale;
+		int numSamples;
+		int blurRadius;
+	};
+	const int NUM_AMBIENT_OCCLUSION_PRESETS = 4;
+	//Low to high quality, ending with a full resolution reference
+	extern const AmbientOcclusionPreset AMBIENT_OCCLUSION_PRESETS[NUM_AMBIENT_OCCLUSION_PRESETS];
+
+	//Screen space ambient obscurance computed at reduced resolution. Needs the scene's depth and view space
+	//normals before shading, e.g. from a depth/normal pre-pass, in the default depth convention.
+	//Downsample: depth is linearized and one texel of each block is kept, alternating nearest and farthest
+	//in a checkerboard so thin surfaces in front of and behind others both survive.
+	//Occlusion: Alchemy obscurance from a spiral of samples, rotated per pixel by a 4x4 interleaved pattern.
+	//Blur: separable and depth aware, wide enough to average the pattern away without bleeding across edges.
+	//Upsample: joint bilateral, weighting the 4 nearest low resolution texels by bilinear weight and depth similarity.
+	//Like the scene, every stage only covers viewportScale of its target
+	class AmbientOcclusion {
+	public:
+		static const int NUM_STAGES = 4;
+		static const int MAX_SAMPLES = 32;
+		static const int MAX_BLUR_RADIUS = 8;
+
+		AmbientOcclusion(const std::string& assetDirectory = "assets/");
+		//depth is the full resolution depth buffer, normals holds view space normals * 0.5 + 0.5.
+		//Returns a full resolution GL_R8 resource, 1 = unoccluded
+		int addPasses(RenderGraph& graph, int depth, int normals);
+		void applyPreset(int preset);
+		static const char* getStageName(int stage);
+		//Sum of the GPU time of the stage's passes
+		float getStageGpuMilliseconds(const RenderGraph& graph, int stage)const;
+
+		Camera camera; //Camera the depth and normals were rendered with. Set every frame
+		glm::vec2 viewportScale = glm::vec2(1.0f); //Fraction of each target that holds the image
+		float resolutionScale = 0.5f; //1 or 0.5. Takes effect when the passes are next added
+		int numSamples = 10;
+		float radius = 0.5f; //World units
+		float intensity = 1.0f;
+		float bias = 0.01f; //Keeps flat surfaces from occluding themselves, in world units
+		int blurRadius = 4; //Low resolution texels
+		float blurSharpness = 16.0f; //How quickly blur and upsample weights fall off with relative depth difference
+	private:
+		Shader m_downsampleShader;
+		Shader m_occlusionShader;
+		Shader m_blurShader;
+		Shader m_upsampleShader;
+		int m_firstPass[NUM_STAGES] = {};
+		int m_endPass[NUM_STAGES] = {};
+		int getFactor()const;
+	};
+}
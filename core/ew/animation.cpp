@@ -0,0 +1,427 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "animation.h"
+#include "jobSystem.h"
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define EW_ANIMATION_SSE
+#endif
+
+namespace ew {
+	int Skeleton::findJoint(const std::string& name) const
+	{
+		for (int i = 0; i < (int)jointNames.size(); i++)
+		{
+			if (jointNames[i] == name) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	int Skeleton::addJoint(const std::string& name, int parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& inverseBindMatrix)
+	{
+		jointNames.push_back(name);
+		parents.push_back(parent);
+		inverseBindMatrices.push_back(inverseBindMatrix);
+		restPositions.push_back(position);
+		restRotations.push_back(rotation);
+		restScales.push_back(scale);
+		return (int)parents.size() - 1;
+	}
+
+	Pose::Pose(int numJoints)
+	{
+		resize(numJoints);
+	}
+
+	void Pose::resize(int numJoints)
+	{
+		m_numJoints = numJoints;
+		m_stride = (numJoints + 3) & ~3;
+		m_data.assign((size_t)NUM_STREAMS * m_stride, 0.0f);
+		//Padding joints are identity too, so interpolating them never divides by zero
+		std::fill(getStream(RW), getStream(RW) + m_stride, 1.0f);
+		std::fill(getStream(SX), getStream(SX) + 3 * m_stride, 1.0f);
+	}
+
+	void Pose::setJoint(int joint, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		float values[NUM_STREAMS] = { position.x, position.y, position.z, rotation.x, rotation.y, rotation.z, rotation.w, scale.x, scale.y, scale.z };
+		for (int i = 0; i < NUM_STREAMS; i++)
+		{
+			getStream(i)[joint] = values[i];
+		}
+	}
+
+	glm::vec3 Pose::getPosition(int joint) const
+	{
+		return glm::vec3(getStream(TX)[joint], getStream(TY)[joint], getStream(TZ)[joint]);
+	}
+
+	glm::quat Pose::getRotation(int joint) const
+	{
+		return glm::quat(getStream(RW)[joint], getStream(RX)[joint], getStream(RY)[joint], getStream(RZ)[joint]);
+	}
+
+	glm::vec3 Pose::getScale(int joint) const
+	{
+		return glm::vec3(getStream(SX)[joint], getStream(SY)[joint], getStream(SZ)[joint]);
+	}
+
+	/// <summary>
+	/// Corrects t so that normalized lerp follows slerp's constant angular velocity, within about 0.1 degrees.
+	/// d is the absolute cosine of the angle between the quaternions.
+	/// Polynomial fit from Arseny Kapoulkine, "Approximating slerp"
+	/// </summary>
+	static inline float slerpCorrection(float t, float d) {
+		float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+		float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+		float k = a * (t - 0.5f) * (t - 0.5f) + b;
+		return t + t * (t - 0.5f) * (t - 1.0f) * k;
+	}
+
+	/// <summary>
+	/// Interpolates every stream of two Pose layouts with stride floats per stream. out may be a or b
+	/// </summary>
+	static void interpolatePoseScalar(const float* a, const float* b, float t, float* out, int stride) {
+		const int streams[6] = { Pose::TX, Pose::TY, Pose::TZ, Pose::SX, Pose::SY, Pose::SZ };
+		for (int s : streams) {
+			const float* sa = a + s * stride;
+			const float* sb = b + s * stride;
+			float* so = out + s * stride;
+			for (int j = 0; j < stride; j++)
+			{
+				so[j] = sa[j] + (sb[j] - sa[j]) * t;
+			}
+		}
+		for (int j = 0; j < stride; j++)
+		{
+			float ax = a[Pose::RX * stride + j], ay = a[Pose::RY * stride + j], az = a[Pose::RZ * stride + j], aw = a[Pose::RW * stride + j];
+			float bx = b[Pose::RX * stride + j], by = b[Pose::RY * stride + j], bz = b[Pose::RZ * stride + j], bw = b[Pose::RW * stride + j];
+			float d = ax * bx + ay * by + az * bz + aw * bw;
+			//Take the short way around
+			if (d < 0.0f) {
+				bx = -bx; by = -by; bz = -bz; bw = -bw;
+				d = -d;
+			}
+			float ot = slerpCorrection(t, d);
+			float x = ax + (bx - ax) * ot;
+			float y = ay + (by - ay) * ot;
+			float z = az + (bz - az) * ot;
+			float w = aw + (bw - aw) * ot;
+			float invLength = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+			out[Pose::RX * stride + j] = x * invLength;
+			out[Pose::RY * stride + j] = y * invLength;
+			out[Pose::RZ * stride + j] = z * invLength;
+			out[Pose::RW * stride + j] = w * invLength;
+		}
+	}
+
+#ifdef EW_ANIMATION_SSE
+	/// <summary>
+	/// Same as interpolatePoseScalar, 4 joints at a time
+	/// </summary>
+	static void interpolatePoseSse(const float* a, const float* b, float t, float* out, int stride) {
+		const __m128 vt = _mm_set1_ps(t);
+		const int streams[6] = { Pose::TX, Pose::TY, Pose::TZ, Pose::SX, Pose::SY, Pose::SZ };
+		for (int s : streams) {
+			const float* sa = a + s * stride;
+			const float* sb = b + s * stride;
+			float* so = out + s * stride;
+			for (int j = 0; j < stride; j += 4)
+			{
+				__m128 va = _mm_loadu_ps(sa + j);
+				__m128 vb = _mm_loadu_ps(sb + j);
+				_mm_storeu_ps(so + j, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+			}
+		}
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		//Parts of slerpCorrection that only depend on t
+		const __m128 tHalf = _mm_sub_ps(vt, half);
+		const __m128 tHalf2 = _mm_mul_ps(tHalf, tHalf);
+		const __m128 tCubic = _mm_mul_ps(_mm_mul_ps(vt, tHalf), _mm_sub_ps(vt, one));
+		for (int j = 0; j < stride; j += 4)
+		{
+			__m128 ax = _mm_loadu_ps(a + Pose::RX * stride + j);
+			__m128 ay = _mm_loadu_ps(a + Pose::RY * stride + j);
+			__m128 az = _mm_loadu_ps(a + Pose::RZ * stride + j);
+			__m128 aw = _mm_loadu_ps(a + Pose::RW * stride + j);
+			__m128 bx = _mm_loadu_ps(b + Pose::RX * stride + j);
+			__m128 by = _mm_loadu_ps(b + Pose::RY * stride + j);
+			__m128 bz = _mm_loadu_ps(b + Pose::RZ * stride + j);
+			__m128 bw = _mm_loadu_ps(b + Pose::RW * stride + j);
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+			//Take the short way around: flip b's sign where the dot product is negative
+			__m128 sign = _mm_and_ps(d, signBit);
+			bx = _mm_xor_ps(bx, sign);
+			by = _mm_xor_ps(by, sign);
+			bz = _mm_xor_ps(bz, sign);
+			bw = _mm_xor_ps(bw, sign);
+			d = _mm_andnot_ps(signBit, d);
+
+			__m128 ca = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+			__m128 cb = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+			__m128 k = _mm_add_ps(_mm_mul_ps(ca, tHalf2), cb);
+			__m128 ot = _mm_add_ps(vt, _mm_mul_ps(tCubic, k));
+
+			__m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), ot));
+			__m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), ot));
+			__m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), ot));
+			__m128 w = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), ot));
+			__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+			//Full precision. _mm_rsqrt_ps would let rotations drift from the scalar path
+			__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+			_mm_storeu_ps(out + Pose::RX * stride + j, _mm_mul_ps(x, invLength));
+			_mm_storeu_ps(out + Pose::RY * stride + j, _mm_mul_ps(y, invLength));
+			_mm_storeu_ps(out + Pose::RZ * stride + j, _mm_mul_ps(z, invLength));
+			_mm_storeu_ps(out + Pose::RW * stride + j, _mm_mul_ps(w, invLength));
+		}
+	}
+#endif
+
+	static void interpolatePose(const float* a, const float* b, float t, float* out, int stride, bool simd) {
+#ifdef EW_ANIMATION_SSE
+		if (simd) {
+			interpolatePoseSse(a, b, t, out, stride);
+			return;
+		}
+#endif
+		interpolatePoseScalar(a, b, t, out, stride);
+	}
+
+	/// <summary>
+	/// Index of the key at or before time, or -1 if time is before the first key
+	/// </summary>
+	static int findKey(const std::vector<float>& times, float time) {
+		return (int)(std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+	}
+
+	static glm::vec3 sampleTrack(const std::vector<float>& times, const std::vector<glm::vec3>& values, float time, const glm::vec3& rest) {
+		if (values.empty()) {
+			return rest;
+		}
+		int key = findKey(times, time);
+		if (key < 0) {
+			return values.front();
+		}
+		if (key >= (int)values.size() - 1) {
+			return values.back();
+		}
+		float span = times[key + 1] - times[key];
+		float t = span > 0.0f ? (time - times[key]) / span : 0.0f;
+		return glm::mix(values[key], values[key + 1], t);
+	}
+
+	static glm::quat sampleTrack(const std::vector<float>& times, const std::vector<glm::quat>& values, float time, const glm::quat& rest) {
+		if (values.empty()) {
+			return rest;
+		}
+		int key = findKey(times, time);
+		if (key < 0) {
+			return values.front();
+		}
+		if (key >= (int)values.size() - 1) {
+			return values.back();
+		}
+		float span = times[key + 1] - times[key];
+		float t = span > 0.0f ? (time - times[key]) / span : 0.0f;
+		return glm::slerp(values[key], values[key + 1], t);
+	}
+
+	AnimationClip::AnimationClip(const std::string& name, const Skeleton& skeleton, const std::vector<JointTrack>& tracks, float duration, float sampleRate)
+	{
+		m_name = name;
+		m_duration = std::max(duration, 0.0f);
+		m_numJoints = skeleton.getNumJoints();
+		m_stride = (m_numJoints + 3) & ~3;
+		//Frames span the clip exactly, so the rate is rounded up to fit a whole number of them
+		m_numFrames = std::max((int)ceilf(m_duration * std::max(sampleRate, 1.0f)) + 1, 2);
+		m_sampleRate = m_duration > 0.0f ? (m_numFrames - 1) / m_duration : 0.0f;
+		if ((int)tracks.size() != m_numJoints) {
+			printf("AnimationClip %s has %d tracks for %d joints\n", name.c_str(), (int)tracks.size(), m_numJoints);
+		}
+
+		Pose frame(m_numJoints);
+		size_t frameSize = (size_t)Pose::NUM_STREAMS * m_stride;
+		m_frames.resize(frameSize * m_numFrames);
+		for (int f = 0; f < m_numFrames; f++)
+		{
+			float time = m_duration * f / (m_numFrames - 1);
+			for (int j = 0; j < m_numJoints; j++)
+			{
+				glm::vec3 position = skeleton.restPositions[j];
+				glm::quat rotation = skeleton.restRotations[j];
+				glm::vec3 scale = skeleton.restScales[j];
+				if (j < (int)tracks.size()) {
+					const JointTrack& track = tracks[j];
+					position = sampleTrack(track.positionTimes, track.positions, time, position);
+					rotation = glm::normalize(sampleTrack(track.rotationTimes, track.rotations, time, rotation));
+					scale = sampleTrack(track.scaleTimes, track.scales, time, scale);
+				}
+				frame.setJoint(j, position, rotation, scale);
+			}
+			std::copy(frame.getData(), frame.getData() + frameSize, m_frames.data() + frameSize * f);
+		}
+	}
+
+	void AnimationClip::sample(float time, Pose* pose, bool loop, bool simd) const
+	{
+		if (pose->getNumJoints() != m_numJoints) {
+			pose->resize(m_numJoints);
+		}
+		if (m_numFrames < 2) {
+			return;
+		}
+		if (loop && m_duration > 0.0f) {
+			time = fmodf(time, m_duration);
+			if (time < 0.0f) {
+				time += m_duration;
+			}
+		}
+		float position = std::min(std::max(time, 0.0f), m_duration) * m_sampleRate;
+		int frame = std::min((int)position, m_numFrames - 2);
+		float t = position - frame;
+		size_t frameSize = (size_t)Pose::NUM_STREAMS * m_stride;
+		const float* a = m_frames.data() + frameSize * frame;
+		interpolatePose(a, a + frameSize, t, pose->getData(), m_stride, simd);
+	}
+
+	void blendPoses(const Pose& a, const Pose& b, float weight, Pose* out, bool simd)
+	{
+		if (a.getNumJoints() != b.getNumJoints()) {
+			printf("Can't blend poses with %d and %d joints\n", a.getNumJoints(), b.getNumJoints());
+			return;
+		}
+		if (out->getNumJoints() != a.getNumJoints()) {
+			out->resize(a.getNumJoints());
+		}
+		interpolatePose(a.getData(), b.getData(), weight, out->getData(), a.getStride(), simd);
+	}
+
+	void computeSkinningMatrices(const Skeleton& skeleton, const Pose& pose, const glm::mat4& worldMatrix, glm::mat4* skinningMatrices)
+	{
+		const float* tx = pose.getStream(Pose::TX);
+		const float* ty = pose.getStream(Pose::TY);
+		const float* tz = pose.getStream(Pose::TZ);
+		const float* rx = pose.getStream(Pose::RX);
+		const float* ry = pose.getStream(Pose::RY);
+		const float* rz = pose.getStream(Pose::RZ);
+		const float* rw = pose.getStream(Pose::RW);
+		const float* sx = pose.getStream(Pose::SX);
+		const float* sy = pose.getStream(Pose::SY);
+		const float* sz = pose.getStream(Pose::SZ);
+		int numJoints = std::min(skeleton.getNumJoints(), pose.getNumJoints());
+		//Model matrices first. Parents come first, so theirs are always ready
+		for (int j = 0; j < numJoints; j++)
+		{
+			glm::mat3 rotation = glm::mat3_cast(glm::quat(rw[j], rx[j], ry[j], rz[j]));
+			glm::mat4 local = glm::mat4(
+				glm::vec4(rotation[0] * sx[j], 0.0f),
+				glm::vec4(rotation[1] * sy[j], 0.0f),
+				glm::vec4(rotation[2] * sz[j], 0.0f),
+				glm::vec4(tx[j], ty[j], tz[j], 1.0f));
+			int parent = skeleton.parents[j];
+			skinningMatrices[j] = (parent >= 0 ? skinningMatrices[parent] : worldMatrix) * local;
+		}
+		for (int j = 0; j < numJoints; j++)
+		{
+			skinningMatrices[j] = skinningMatrices[j] * skeleton.inverseBindMatrices[j];
+		}
+	}
+
+	void evaluateAnimations(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, const AnimationState* states, int numCharacters,
+		glm::mat4* skinningMatrices, JobSystem* jobs, bool simd)
+	{
+		if (clips.empty()) {
+			return;
+		}
+		int numJoints = skeleton.getNumJoints();
+		int numClips = (int)clips.size();
+		//Characters are cheap and uniform, so small ranges still pay for the split
+		parallelFor(jobs, numCharacters, [&](size_t begin, size_t end) {
+			Pose a(numJoints);
+			Pose b(numJoints);
+			for (size_t i = begin; i < end; i++)
+			{
+				const AnimationState& state = states[i];
+				clips[std::min(std::max(state.clipA, 0), numClips - 1)].sample(state.timeA, &a, true, simd);
+				if (state.weight > 0.0f) {
+					clips[std::min(std::max(state.clipB, 0), numClips - 1)].sample(state.timeB, &b, true, simd);
+					blendPoses(a, b, state.weight, &a, simd);
+				}
+				computeSkinningMatrices(skeleton, a, state.worldMatrix, skinningMatrices + i * numJoints);
+			}
+		}, 16);
+	}
+
+	AnimationBenchmarkResult benchmarkAnimation(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, int numCharacters, int numThreads, int iterations)
+	{
+		iterations = std::max(iterations, 1);
+		AnimationBenchmarkResult result;
+		result.numCharacters = numCharacters;
+		result.numJoints = skeleton.getNumJoints();
+		if (clips.empty()) {
+			printf("Animation benchmark needs at least one clip\n");
+			return result;
+		}
+		int numClips = (int)clips.size();
+		std::vector<AnimationState> states(numCharacters);
+		for (int i = 0; i < numCharacters; i++)
+		{
+			states[i].clipA = i % numClips;
+			states[i].clipB = (i + 1) % numClips;
+			states[i].timeA = i * 0.037f;
+			states[i].timeB = i * 0.053f;
+			states[i].weight = (i % 10) / 9.0f;
+		}
+
+		//Poses only, on this thread
+		Pose a(result.numJoints);
+		Pose b(result.numJoints);
+		volatile float sink = 0.0f;
+		for (int simd = 0; simd < 2; simd++)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			for (int iteration = 0; iteration < iterations; iteration++)
+			{
+				for (const AnimationState& state : states) {
+					clips[state.clipA].sample(state.timeA + iteration * 0.016f, &a, true, simd != 0);
+					clips[state.clipB].sample(state.timeB + iteration * 0.016f, &b, true, simd != 0);
+					blendPoses(a, b, state.weight, &a, simd != 0);
+					sink = sink + a.getData()[0];
+				}
+			}
+			auto endTime = std::chrono::high_resolution_clock::now();
+			float ms = std::chrono::duration<float, std::milli>(endTime - startTime).count() / iterations;
+			(simd ? result.simdPoseMilliseconds : result.scalarPoseMilliseconds) = ms;
+		}
+
+		JobSystem jobs(numThreads);
+		result.numThreads = jobs.getNumThreads();
+		std::vector<glm::mat4> skinningMatrices((size_t)numCharacters * result.numJoints);
+		//Warm up so thread startup isn't timed
+		evaluateAnimations(skeleton, clips, states.data(), numCharacters, skinningMatrices.data(), &jobs);
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			for (AnimationState& state : states) {
+				state.timeA += 0.016f;
+				state.timeB += 0.016f;
+			}
+			evaluateAnimations(skeleton, clips, states.data(), numCharacters, skinningMatrices.data(), &jobs);
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		result.evaluateMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count() / iterations;
+		return result;
+	}
+}
@@ -0,0 +1,121 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <string>
+
+namespace ew {
+	class JobSystem;
+
+	//Joint hierarchy. Joints are ordered so parents always come before their children
+	struct Skeleton {
+		std::vector<std::string> jointNames;
+		std::vector<int> parents; //-1 for roots
+		std::vector<glm::mat4> inverseBindMatrices; //Mesh space to joint space in the bind pose. Identity for joints that only carry the hierarchy
+		//Local transform of each joint, used where a clip has no keys for it
+		std::vector<glm::vec3> restPositions;
+		std::vector<glm::quat> restRotations;
+		std::vector<glm::vec3> restScales;
+
+		inline int getNumJoints()const { return (int)parents.size(); }
+		//-1 if there is no joint with that name
+		int findJoint(const std::string& name)const;
+		//Appends a joint. parent must already be in the skeleton
+		int addJoint(const std::string& name, int parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& inverseBindMatrix);
+	};
+
+	//Local joint transforms in SoA layout: each component of every joint is its own stream, padded to a multiple
+	//of 4 joints, so poses are interpolated and blended 4 joints at a time and read front to back
+	class Pose {
+	public:
+		//Translation xyz, rotation xyzw, scale xyz
+		enum Stream { TX, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, NUM_STREAMS };
+
+		Pose() {};
+		Pose(int numJoints);
+		//Resets every joint to identity
+		void resize(int numJoints);
+		inline int getNumJoints()const { return m_numJoints; }
+		//Floats per stream, a multiple of 4
+		inline int getStride()const { return m_stride; }
+		inline float* getStream(int stream) { return m_data.data() + stream * m_stride; }
+		inline const float* getStream(int stream)const { return m_data.data() + stream * m_stride; }
+		inline float* getData() { return m_data.data(); }
+		inline const float* getData()const { return m_data.data(); }
+		void setJoint(int joint, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+		glm::vec3 getPosition(int joint)const;
+		glm::quat getRotation(int joint)const;
+		glm::vec3 getScale(int joint)const;
+	private:
+		int m_numJoints = 0;
+		int m_stride = 0;
+		std::vector<float> m_data;
+	};
+
+	//Keyframes of one joint, times in seconds. Empty channels keep the skeleton's rest transform
+	struct JointTrack {
+		std::vector<float> positionTimes;
+		std::vector<glm::vec3> positions;
+		std::vector<float> rotationTimes;
+		std::vector<glm::quat> rotations;
+		std::vector<float> scaleTimes;
+		std::vector<glm::vec3> scales;
+	};
+
+	//Animation resampled at a fixed rate into Pose sized frames, so sampling never searches for keys:
+	//it reads two consecutive frames and interpolates them
+	class AnimationClip {
+	public:
+		AnimationClip() {};
+		//One track per skeleton joint
+		AnimationClip(const std::string& name, const Skeleton& skeleton, const std::vector<JointTrack>& tracks, float duration, float sampleRate = 30.0f);
+		//Time wraps when looping, otherwise it is clamped to the clip
+		void sample(float time, Pose* pose, bool loop = true, bool simd = true)const;
+		inline const std::string& getName()const { return m_name; }
+		inline float getDuration()const { return m_duration; }
+		inline int getNumFrames()const { return m_numFrames; }
+		inline int getNumJoints()const { return m_numJoints; }
+	private:
+		std::string m_name;
+		float m_duration = 0.0f;
+		float m_sampleRate = 30.0f;
+		int m_numFrames = 0;
+		int m_numJoints = 0;
+		int m_stride = 0;
+		std::vector<float> m_frames; //Pose::NUM_STREAMS * m_stride floats per frame
+	};
+
+	//out = a blended toward b by weight, per joint. Rotations use an approximated slerp. out may be a or b
+	void blendPoses(const Pose& a, const Pose& b, float weight, Pose* out, bool simd = true);
+	//worldMatrix * joint model matrix * inverse bind matrix, for each joint
+	void computeSkinningMatrices(const Skeleton& skeleton, const Pose& pose, const glm::mat4& worldMatrix, glm::mat4* skinningMatrices);
+
+	//One animated character: two looping clips blended by weight
+	struct AnimationState {
+		int clipA = 0;
+		int clipB = 0;
+		float timeA = 0.0f;
+		float timeB = 0.0f;
+		float weight = 0.0f; //0 = clipA, 1 = clipB
+		glm::mat4 worldMatrix = glm::mat4(1.0f);
+	};
+	//Samples, blends and skins every character. Characters are evaluated in parallel when jobs is given.
+	//skinningMatrices holds getNumJoints() matrices per character, in character order
+	void evaluateAnimations(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, const AnimationState* states, int numCharacters,
+		glm::mat4* skinningMatrices, JobSystem* jobs = nullptr, bool simd = true);
+
+	struct AnimationBenchmarkResult {
+		int numCharacters = 0;
+		int numJoints = 0;
+		int numThreads = 0;
+		float scalarPoseMilliseconds = 0.0f; //Sampling and blending every character on one thread, without SIMD
+		float simdPoseMilliseconds = 0.0f; //Same, with SIMD
+		float evaluateMilliseconds = 0.0f; //evaluateAnimations() on numThreads threads, including skinning matrices
+	};
+	//Averages over iterations, with characters at different times and blend weights
+	AnimationBenchmarkResult benchmarkAnimation(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, int numCharacters, int numThreads, int iterations = 20);
+}
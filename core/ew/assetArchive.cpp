@@ -0,0 +1,530 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "assetArchive.h"
+#include "lz4.h"
+#include "external/stb_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+#include <algorithm>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ew {
+	static const char ARCHIVE_MAGIC[4] = { 'E', 'W', 'P', 'K' };
+	static const uint32_t ARCHIVE_VERSION = 1;
+
+	struct AssetArchiveHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t numEntries;
+		uint32_t numSlots; //Power of two, more than numEntries so every probe sequence reaches an empty slot
+		uint64_t entriesOffset;
+		uint64_t slotsOffset;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+		uint64_t fileSize; //Catches truncated archives
+	};
+	static_assert(sizeof(AssetArchiveHeader) == 56, "Archive header layout changed");
+	static_assert(sizeof(AssetArchiveEntry) == 56, "Archive entry layout changed");
+
+	static inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	std::string normalizeAssetPath(const std::string& path) {
+		std::vector<std::string> segments;
+		size_t start = 0;
+		while (start <= path.size()) {
+			size_t end = path.find_first_of("/\\", start);
+			if (end == std::string::npos) {
+				end = path.size();
+			}
+			std::string segment = path.substr(start, end - start);
+			if (segment == ".." && !segments.empty() && segments.back() != ".." && !segments.back().empty()) {
+				segments.pop_back();
+			}
+			else if (segment != "." && (!segment.empty() || segments.empty())) {
+				segments.push_back(segment);
+			}
+			start = end + 1;
+		}
+		std::string result;
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			result += (i > 0 ? "/" : "") + segments[i];
+		}
+		return result;
+	}
+
+	uint64_t hashAssetPath(const std::string& normalizedPath) {
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : normalizedPath) {
+			hash ^= (uint64_t)(unsigned char)tolower((unsigned char)c);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static bool equalsIgnoreCase(const char* a, const char* b, size_t length) {
+		for (size_t i = 0; i < length; i++)
+		{
+			if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Formats stb_image decodes from 8 bit. HDR stays encoded, since its loader wants floats
+	/// </summary>
+	static bool isImagePath(const std::string& path) {
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos) {
+			return false;
+		}
+		std::string extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+	}
+
+	static bool readWholeFile(const std::string& filePath, std::vector<char>* data) {
+		FILE* file = fopen(filePath.c_str(), "rb");
+		if (file == NULL) {
+			return false;
+		}
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		data->resize(size > 0 ? (size_t)size : 0);
+		bool ok = size >= 0 && fread(data->data(), 1, data->size(), file) == data->size();
+		fclose(file);
+		return ok;
+	}
+
+	bool AssetArchive::open(const std::string& filePath)
+	{
+		close();
+		if (!m_file.open(filePath)) {
+			return false;
+		}
+		const char* base = m_file.data();
+		uint64_t size = m_file.size();
+		const AssetArchiveHeader* header = (const AssetArchiveHeader*)base;
+		bool valid = size >= sizeof(AssetArchiveHeader) && memcmp(header->magic, ARCHIVE_MAGIC, 4) == 0 && header->version == ARCHIVE_VERSION;
+		valid = valid && header->fileSize == size && header->numSlots > header->numEntries && (header->numSlots & (header->numSlots - 1)) == 0;
+		valid = valid && header->entriesOffset % 8 == 0 && header->entriesOffset <= size && (size - header->entriesOffset) / sizeof(AssetArchiveEntry) >= header->numEntries;
+		valid = valid && header->slotsOffset % 4 == 0 && header->slotsOffset <= size && (size - header->slotsOffset) / sizeof(uint32_t) >= header->numSlots;
+		valid = valid && header->namesOffset <= size && header->namesSize <= size - header->namesOffset;
+		if (valid) {
+			m_entries = (const AssetArchiveEntry*)(base + header->entriesOffset);
+			m_slots = (const uint32_t*)(base + header->slotsOffset);
+			m_names = base + header->namesOffset;
+			for (uint32_t i = 0; i < header->numEntries && valid; i++)
+			{
+				const AssetArchiveEntry& e = m_entries[i];
+				valid = e.offset <= size && e.storedSize <= size - e.offset && (uint64_t)e.nameOffset + e.nameLength <= header->namesSize;
+				//An LZ4 block expands at most about 255 times, which bounds what a corrupt size can make read allocate
+				valid = valid && ((e.flags & COMPRESSED) != 0 ? e.size <= e.storedSize * 255 + 16 : e.storedSize == e.size);
+				valid = valid && ((e.flags & TEXTURE) == 0 || (e.numComponents >= 1 && e.numComponents <= 4 && (uint64_t)e.width * e.height * e.numComponents == e.size));
+			}
+			//find() stops at the first empty slot, so a table without one would make it probe forever
+			uint32_t numEmptySlots = 0;
+			for (uint32_t i = 0; i < header->numSlots && valid; i++)
+			{
+				valid = m_slots[i] <= header->numEntries;
+				numEmptySlots += m_slots[i] == 0 ? 1 : 0;
+			}
+			valid = valid && numEmptySlots > 0;
+		}
+		if (!valid) {
+			printf("Invalid asset archive %s\n", filePath.c_str());
+			close();
+			return false;
+		}
+		m_numEntries = header->numEntries;
+		m_slotMask = header->numSlots - 1;
+		m_filePath = filePath;
+		return true;
+	}
+
+	void AssetArchive::close()
+	{
+		m_file.close();
+		m_filePath.clear();
+		m_entries = nullptr;
+		m_slots = nullptr;
+		m_names = nullptr;
+		m_numEntries = 0;
+		m_slotMask = 0;
+	}
+
+	int AssetArchive::find(const std::string& path) const
+	{
+		if (!isOpen()) {
+			return -1;
+		}
+		std::string name = normalizeAssetPath(path);
+		uint64_t hash = hashAssetPath(name);
+		//Linear probing. open() checked that an empty slot exists, so one always ends the search
+		for (uint32_t slot = (uint32_t)hash & m_slotMask;; slot = (slot + 1) & m_slotMask) {
+			uint32_t index = m_slots[slot];
+			if (index == 0) {
+				return -1;
+			}
+			const AssetArchiveEntry& e = m_entries[index - 1];
+			if (e.hash == hash && e.nameLength == name.size() && equalsIgnoreCase(m_names + e.nameOffset, name.data(), name.size())) {
+				return (int)index - 1;
+			}
+		}
+	}
+
+	bool AssetArchive::read(int entry, AssetData* out) const
+	{
+		if (entry < 0 || entry >= (int)m_numEntries) {
+			return false;
+		}
+		const AssetArchiveEntry& e = m_entries[entry];
+		const char* stored = m_file.data() + e.offset;
+		out->entry = &e;
+		if ((e.flags & COMPRESSED) == 0) {
+			std::vector<char>().swap(out->storage);
+			out->data = stored;
+			out->size = (size_t)e.size;
+			return true;
+		}
+		out->storage.resize((size_t)e.size);
+		if (!lz4Decompress(stored, (size_t)e.storedSize, out->storage.data(), out->storage.size())) {
+			printf("Failed to decompress %s from %s\n", getName(entry).c_str(), m_filePath.c_str());
+			out->data = nullptr;
+			out->size = 0;
+			return false;
+		}
+		out->data = out->storage.data();
+		out->size = out->storage.size();
+		return true;
+	}
+
+	static AssetArchive s_mountedArchive;
+
+	bool mountAssetArchive(const std::string& filePath) {
+		s_mountedArchive.close();
+		//Running without an archive is normal, so only a broken one is reported
+		FILE* file = fopen(filePath.c_str(), "rb");
+		if (file == NULL) {
+			return false;
+		}
+		fclose(file);
+		return s_mountedArchive.open(filePath);
+	}
+
+	void unmountAssetArchive() {
+		s_mountedArchive.close();
+	}
+
+	const AssetArchive& getMountedAssetArchive() {
+		return s_mountedArchive;
+	}
+
+	bool readMountedAsset(const std::string& path, AssetData* out) {
+		return s_mountedArchive.read(s_mountedArchive.find(path), out);
+	}
+
+	AssetImage::~AssetImage()
+	{
+		if (m_decoded != nullptr) {
+			stbi_image_free(m_decoded);
+		}
+	}
+
+	bool AssetImage::load(const char* filePath)
+	{
+		if (m_decoded != nullptr) {
+			stbi_image_free(m_decoded);
+		}
+		m_decoded = nullptr;
+		m_pixels = nullptr;
+		m_width = m_height = m_numComponents = 0;
+		stbi_set_flip_vertically_on_load(true);
+		if (readMountedAsset(filePath, &m_asset)) {
+			const AssetArchiveEntry& e = *m_asset.entry;
+			if (e.flags & AssetArchive::TEXTURE) {
+				m_pixels = (const unsigned char*)m_asset.data;
+				m_width = (int)e.width;
+				m_height = (int)e.height;
+				m_numComponents = (int)e.numComponents;
+				return true;
+			}
+			m_decoded = stbi_load_from_memory((const stbi_uc*)m_asset.data, (int)m_asset.size, &m_width, &m_height, &m_numComponents, 0);
+			m_asset = AssetData();
+		}
+		else {
+			m_decoded = stbi_load(filePath, &m_width, &m_height, &m_numComponents, 0);
+		}
+		m_pixels = m_decoded;
+		return m_decoded != nullptr;
+	}
+
+	bool writeAssetArchive(const std::string& filePath, const std::vector<AssetPackInput>& inputs, const AssetPackSettings& settings, AssetPackStats* stats)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		AssetPackStats packStats;
+		uint32_t numEntries = (uint32_t)inputs.size();
+		std::vector<AssetArchiveEntry> entries(numEntries);
+		std::vector<std::vector<char>> payloads(numEntries);
+		std::string names;
+		for (uint32_t i = 0; i < numEntries; i++)
+		{
+			std::vector<char> data;
+			if (!readWholeFile(inputs[i].filePath, &data)) {
+				printf("Failed to read %s\n", inputs[i].filePath.c_str());
+				return false;
+			}
+			packStats.inputBytes += data.size();
+			AssetArchiveEntry& e = entries[i];
+			memset(&e, 0, sizeof(e));
+			std::string name = normalizeAssetPath(inputs[i].name);
+			e.hash = hashAssetPath(name);
+			e.nameOffset = (uint32_t)names.size();
+			e.nameLength = (uint32_t)name.size();
+			names += name;
+
+			if (settings.decodeImages && isImagePath(name)) {
+				//Same orientation texture loaders ask stb_image for
+				stbi_set_flip_vertically_on_load(true);
+				int width, height, numComponents;
+				unsigned char* pixels = stbi_load_from_memory((const stbi_uc*)data.data(), (int)data.size(), &width, &height, &numComponents, 0);
+				if (pixels != NULL) {
+					data.assign((const char*)pixels, (const char*)pixels + (size_t)width * height * numComponents);
+					stbi_image_free(pixels);
+					e.flags |= AssetArchive::TEXTURE;
+					e.width = (uint32_t)width;
+					e.height = (uint32_t)height;
+					e.numComponents = (uint32_t)numComponents;
+					packStats.numTextures++;
+				}
+				else {
+					printf("Failed to decode %s, storing it encoded\n", inputs[i].filePath.c_str());
+				}
+			}
+			e.size = data.size();
+			if (settings.compress && !data.empty()) {
+				std::vector<char> compressed(lz4CompressBound(data.size()));
+				size_t compressedSize = lz4Compress(data.data(), data.size(), compressed.data(), compressed.size());
+				if (compressedSize > 0 && compressedSize <= data.size() * (1.0f - settings.minSavings)) {
+					compressed.resize(compressedSize);
+					data.swap(compressed);
+					e.flags |= AssetArchive::COMPRESSED;
+					packStats.numCompressed++;
+				}
+			}
+			e.storedSize = data.size();
+			payloads[i].swap(data);
+		}
+
+		AssetArchiveHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, ARCHIVE_MAGIC, 4);
+		header.version = ARCHIVE_VERSION;
+		header.numEntries = numEntries;
+		header.numSlots = 2;
+		while (header.numSlots < numEntries * 2) {
+			header.numSlots *= 2;
+		}
+		header.entriesOffset = alignUp(sizeof(AssetArchiveHeader), 8);
+		header.slotsOffset = header.entriesOffset + (uint64_t)numEntries * sizeof(AssetArchiveEntry);
+		header.namesOffset = header.slotsOffset + (uint64_t)header.numSlots * sizeof(uint32_t);
+		header.namesSize = names.size();
+		uint64_t offset = alignUp(header.namesOffset + header.namesSize, AssetArchive::ALIGNMENT);
+		for (uint32_t i = 0; i < numEntries; i++)
+		{
+			entries[i].offset = offset;
+			offset = alignUp(offset + entries[i].storedSize, AssetArchive::ALIGNMENT);
+		}
+		header.fileSize = offset;
+
+		std::vector<uint32_t> slots(header.numSlots, 0);
+		uint32_t slotMask = header.numSlots - 1;
+		for (uint32_t i = 0; i < numEntries; i++)
+		{
+			const AssetArchiveEntry& e = entries[i];
+			uint32_t slot = (uint32_t)e.hash & slotMask;
+			for (; slots[slot] != 0; slot = (slot + 1) & slotMask) {
+				const AssetArchiveEntry& other = entries[slots[slot] - 1];
+				if (other.hash == e.hash && other.nameLength == e.nameLength && equalsIgnoreCase(&names[other.nameOffset], &names[e.nameOffset], e.nameLength)) {
+					printf("Asset %s was added twice\n", inputs[i].name.c_str());
+					return false;
+				}
+			}
+			slots[slot] = i + 1;
+		}
+
+		FILE* file = fopen(filePath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to open %s for writing\n", filePath.c_str());
+			return false;
+		}
+		static const char padding[AssetArchive::ALIGNMENT] = {};
+		uint64_t written = 0;
+		auto write = [&](const void* data, uint64_t size) {
+			if (size > 0 && fwrite(data, 1, (size_t)size, file) != size) {
+				return false;
+			}
+			written += size;
+			return true;
+		};
+		auto padTo = [&](uint64_t position) {
+			return write(padding, position - written);
+		};
+		bool ok = write(&header, sizeof(header)) && padTo(header.entriesOffset);
+		ok = ok && write(entries.data(), (uint64_t)numEntries * sizeof(AssetArchiveEntry));
+		ok = ok && write(slots.data(), (uint64_t)slots.size() * sizeof(uint32_t));
+		ok = ok && write(names.data(), names.size());
+		for (uint32_t i = 0; i < numEntries && ok; i++)
+		{
+			ok = padTo(entries[i].offset) && write(payloads[i].data(), payloads[i].size());
+		}
+		ok = ok && padTo(header.fileSize);
+		ok = fclose(file) == 0 && ok;
+		if (!ok) {
+			printf("Failed to write %s\n", filePath.c_str());
+			return false;
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		packStats.numEntries = (int)numEntries;
+		packStats.archiveBytes = (size_t)header.fileSize;
+		packStats.milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		if (stats != nullptr) {
+			*stats = packStats;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Asks the OS to drop a file's cached pages, so the next read comes from storage.
+	/// Only possible on Linux, and pages that are still mapped somewhere stay
+	/// </summary>
+	static bool evictFileCache(const std::string& filePath) {
+#if defined(__linux__)
+		int fd = ::open(filePath.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		::close(fd);
+		return evicted;
+#else
+		(void)filePath;
+		return false;
+#endif
+	}
+
+	//Keeps page touching loops from being optimized away
+	static volatile unsigned int s_touchSink = 0;
+
+	AssetLoadBenchmarkResult benchmarkAssetLoading(const std::string& archivePath, int warmIterations)
+	{
+		AssetLoadBenchmarkResult result;
+		std::string mountedPath = s_mountedArchive.getFilePath();
+		s_mountedArchive.close();
+
+		std::vector<std::string> names;
+		{
+			AssetArchive archive;
+			if (archive.open(archivePath)) {
+				for (int i = 0; i < archive.getNumEntries(); i++)
+				{
+					names.push_back(archive.getName(i));
+				}
+				result.archiveBytes = archive.getFileSize();
+			}
+		}
+		result.numAssets = (int)names.size();
+		stbi_set_flip_vertically_on_load(true);
+
+		auto evictAll = [&]() {
+			bool evicted = evictFileCache(archivePath);
+			for (const std::string& name : names) {
+				evicted = evictFileCache(name) && evicted;
+			}
+			return evicted;
+		};
+		auto decodeImage = [](const char* data, size_t size) {
+			int width, height, numComponents;
+			unsigned char* pixels = stbi_load_from_memory((const stbi_uc*)data, (int)size, &width, &height, &numComponents, 0);
+			if (pixels != NULL) {
+				stbi_image_free(pixels);
+			}
+		};
+		auto loadLoose = [&]() {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			result.looseFilesOpened = 0;
+			result.looseBytes = 0;
+			std::vector<char> data;
+			for (const std::string& name : names) {
+				if (!readWholeFile(name, &data)) {
+					continue;
+				}
+				result.looseFilesOpened++;
+				result.looseBytes += data.size();
+				if (isImagePath(name)) {
+					decodeImage(data.data(), data.size());
+				}
+			}
+			auto endTime = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		};
+		auto loadArchive = [&]() {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			AssetArchive archive;
+			if (archive.open(archivePath)) {
+				AssetData asset;
+				for (int i = 0; i < archive.getNumEntries(); i++)
+				{
+					if (!archive.read(i, &asset)) {
+						continue;
+					}
+					if ((asset.entry->flags & AssetArchive::TEXTURE) == 0 && isImagePath(names[i])) {
+						decodeImage(asset.data, asset.size);
+					}
+					else if (asset.storage.empty()) {
+						//Zero-copy data hasn't been read yet. Fault in every page, as uploading it would
+						unsigned int sum = 0;
+						for (size_t b = 0; b < asset.size; b += 4096)
+						{
+							sum += (unsigned char)asset.data[b];
+						}
+						s_touchSink += sum;
+					}
+				}
+			}
+			auto endTime = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		};
+
+		if (result.numAssets > 0) {
+			result.coldCache = evictAll();
+			result.looseColdMilliseconds = loadLoose();
+			result.coldCache = evictAll() && result.coldCache;
+			result.archiveColdMilliseconds = loadArchive();
+			int iterations = std::max(warmIterations, 1);
+			for (int i = 0; i < iterations; i++)
+			{
+				result.looseWarmMilliseconds += loadLoose() / iterations;
+				result.archiveWarmMilliseconds += loadArchive() / iterations;
+			}
+		}
+
+		if (!mountedPath.empty()) {
+			mountAssetArchive(mountedPath);
+		}
+		return result;
+	}
+}
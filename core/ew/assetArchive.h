@@ -0,0 +1,150 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "mappedFile.h"
+
+namespace ew {
+	//Table of contents entry, as stored in the archive
+	struct AssetArchiveEntry {
+		uint64_t hash; //hashAssetPath of the name
+		uint64_t offset; //From the start of the archive, a multiple of AssetArchive::ALIGNMENT
+		uint64_t storedSize; //Bytes in the archive
+		uint64_t size; //Bytes once decompressed
+		uint32_t nameOffset; //Into the name block. Names aren't null terminated
+		uint32_t nameLength;
+		uint32_t flags; //AssetArchive::COMPRESSED, AssetArchive::TEXTURE
+		uint32_t width; //Textures only
+		uint32_t height;
+		uint32_t numComponents;
+	};
+
+	//Paths name the same asset regardless of slash direction, "." and "dir/.." segments, or case (assets are
+	//referred to as "suzanne.obj" but shipped as "Suzanne.obj", which only works on case-insensitive file systems)
+	std::string normalizeAssetPath(const std::string& path);
+	//64 bit FNV-1a of the lowercased normalized path
+	uint64_t hashAssetPath(const std::string& normalizedPath);
+
+	//One asset read from an archive. Uncompressed entries are zero-copy: data points into the archive's mapping
+	//and is valid while the archive stays open. Compressed entries are decompressed into storage
+	struct AssetData {
+		const char* data = nullptr;
+		size_t size = 0;
+		const AssetArchiveEntry* entry = nullptr;
+		std::vector<char> storage;
+	};
+
+	//Read-only, memory mapped pack of assets produced by writeAssetArchive (or the AssetPack tool).
+	//Layout: header, entry table, open addressing hash table of entry indices, names, then each asset's data
+	//starting on an ALIGNMENT boundary, so anything handed to the GPU straight from the mapping is suitably aligned.
+	//Entries may be LZ4 compressed. 8 bit images may be stored decoded (TEXTURE), bottom row first, ready to upload.
+	//Lookups and reads don't modify the archive, so any number of threads may use it while it is open.
+	//Integers are stored little endian, like every platform this builds for
+	class AssetArchive {
+	public:
+		static const uint32_t ALIGNMENT = 256;
+		static const uint32_t COMPRESSED = 1;
+		static const uint32_t TEXTURE = 2;
+
+		AssetArchive() {};
+		AssetArchive(const AssetArchive&) = delete;
+		AssetArchive& operator=(const AssetArchive&) = delete;
+		bool open(const std::string& filePath);
+		void close();
+		inline bool isOpen()const { return m_file.isOpen(); }
+		inline const std::string& getFilePath()const { return m_filePath; }
+		//Index of the entry for path, or -1
+		int find(const std::string& path)const;
+		bool read(int entry, AssetData* out)const;
+		inline int getNumEntries()const { return (int)m_numEntries; }
+		inline const AssetArchiveEntry& getEntry(int i)const { return m_entries[i]; }
+		inline std::string getName(int i)const { return std::string(m_names + m_entries[i].nameOffset, m_entries[i].nameLength); }
+		inline size_t getFileSize()const { return m_file.size(); }
+	private:
+		MappedFile m_file;
+		std::string m_filePath;
+		const AssetArchiveEntry* m_entries = nullptr;
+		const uint32_t* m_slots = nullptr; //Entry index + 1, 0 = empty
+		const char* m_names = nullptr;
+		uint32_t m_numEntries = 0;
+		uint32_t m_slotMask = 0;
+	};
+
+	//The archive asset loaders (shaders, textures, models) look in before the file system. One at a time.
+	//Returns false if the file doesn't exist or isn't a valid archive, and loaders keep reading loose files
+	bool mountAssetArchive(const std::string& filePath);
+	void unmountAssetArchive();
+	const AssetArchive& getMountedAssetArchive();
+	//False if nothing is mounted or the mounted archive doesn't have path
+	bool readMountedAsset(const std::string& path, AssetData* out);
+
+	//8 bit image ready to upload, bottom row first as every texture loader flips them.
+	//TEXTURE entries of the mounted archive need no decoding: pixels point straight into its mapping unless compressed.
+	//Other images are decoded by stb_image, from the archive or from the file
+	class AssetImage {
+	public:
+		AssetImage() {};
+		~AssetImage();
+		AssetImage(const AssetImage&) = delete;
+		AssetImage& operator=(const AssetImage&) = delete;
+		bool load(const char* filePath);
+		inline const unsigned char* getPixels()const { return m_pixels; }
+		inline int getWidth()const { return m_width; }
+		inline int getHeight()const { return m_height; }
+		inline int getNumComponents()const { return m_numComponents; }
+		//Pixels are read from the archive in place
+		inline bool isZeroCopy()const { return m_pixels != nullptr && m_decoded == nullptr && m_asset.storage.empty(); }
+	private:
+		AssetData m_asset;
+		unsigned char* m_decoded = nullptr; //Owned by stb_image
+		const unsigned char* m_pixels = nullptr;
+		int m_width = 0;
+		int m_height = 0;
+		int m_numComponents = 0;
+	};
+
+	struct AssetPackSettings {
+		bool compress = false; //LZ4 each entry, keeping it only where it saves at least minSavings
+		float minSavings = 0.1f;
+		bool decodeImages = true; //Store .png/.jpg/.tga/.bmp decoded, trading archive size for no decode at load
+	};
+
+	struct AssetPackInput {
+		std::string name; //What loaders will ask for, e.g. "assets/lit.vert"
+		std::string filePath; //Where to read it from now
+	};
+
+	struct AssetPackStats {
+		int numEntries = 0;
+		int numCompressed = 0;
+		int numTextures = 0;
+		size_t inputBytes = 0; //Source files as read
+		size_t archiveBytes = 0;
+		float milliseconds = 0.0f;
+	};
+
+	//Writes an archive that AssetArchive can open. Fails on unreadable inputs or two inputs with the same name
+	bool writeAssetArchive(const std::string& filePath, const std::vector<AssetPackInput>& inputs, const AssetPackSettings& settings = AssetPackSettings(), AssetPackStats* stats = nullptr);
+
+	struct AssetLoadBenchmarkResult {
+		int numAssets = 0;
+		bool coldCache = false; //False where the OS file cache can't be dropped, so cold runs may also read from memory
+		int looseFilesOpened = 0;
+		size_t looseBytes = 0; //Read from the loose files
+		size_t archiveBytes = 0; //Read from the archive, compressed
+		float looseColdMilliseconds = 0.0f;
+		float archiveColdMilliseconds = 0.0f;
+		float looseWarmMilliseconds = 0.0f; //Average over warm runs
+		float archiveWarmMilliseconds = 0.0f;
+	};
+
+	//Loads every asset of an archive the way startup does, once from loose files (named as in the archive, relative to
+	//the working directory) and once from the archive: all bytes read, compressed entries expanded, images decoded
+	//unless stored as TEXTURE. Cold runs first drop both from the OS file cache (posix_fadvise, Linux only).
+	//A mounted archive is unmounted for the duration, since mapped pages can't be dropped
+	AssetLoadBenchmarkResult benchmarkAssetLoading(const std::string& archivePath, int warmIterations = 10);
+}
@@ -17,6 +17,10 @@ namespace ew {
 		bool orthographic = false;
 		float orthoHeight = 6.0f;
 		float aspectRatio = 1.77f;
+		//Maps the near plane to depth 1 and the far plane to 0, with an infinite far plane for perspective.
+		//Floating point depth keeps its precision far away this way. Expects glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE),
+		//a float depth buffer cleared to 0 and GL_GREATER depth testing
+		bool reversedZ = false;
 
 		inline glm::mat4 viewMatrix()const {
 			glm::vec3 toTarget = glm::normalize(target - position);
@@ -36,7 +40,22 @@ namespace ew {
 				float l = -r;
 				float t = orthoHeight / 2;
 				float b = -t;
-				return glm::ortho(l, r, b, t, nearPlane, farPlane);
+				glm::mat4 projection = glm::ortho(l, r, b, t, nearPlane, farPlane);
+				if (reversedZ) {
+					projection[2][2] = 1.0f / (farPlane - nearPlane);
+					projection[3][2] = farPlane / (farPlane - nearPlane);
+				}
+				return projection;
+			}
+			else if (reversedZ) {
+				//Depth = nearPlane / view distance
+				float f = 1.0f / glm::tan(glm::radians(fov) * 0.5f);
+				glm::mat4 projection = glm::mat4(0.0f);
+				projection[0][0] = f / aspectRatio;
+				projection[1][1] = f;
+				projection[2][3] = -1.0f;
+				projection[3][2] = nearPlane;
+				return projection;
 			}
 			else {
 				return glm::perspective(glm::radians(fov), aspectRatio, nearPlane, farPlane);
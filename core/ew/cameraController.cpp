@@ -4,20 +4,40 @@
 
 #include "cameraController.h"
 namespace ew {
-	void CameraController::move(GLFWwindow* window, ew::Camera* camera, float deltaTime) {
+	CameraInput CameraController::sampleInput(GLFWwindow* window) {
+		CameraInput input;
 		//Only allow movement if right mouse is held
-		if (!glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2)) {
+		input.active = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2);
+		if (!input.active) {
 			//Release cursor
 			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+			return input;
+		}
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		glfwGetCursorPos(window, &input.mouseX, &input.mouseY);
+		input.forward = glfwGetKey(window, GLFW_KEY_W);
+		input.back = glfwGetKey(window, GLFW_KEY_S);
+		input.right = glfwGetKey(window, GLFW_KEY_D);
+		input.left = glfwGetKey(window, GLFW_KEY_A);
+		input.up = glfwGetKey(window, GLFW_KEY_E);
+		input.down = glfwGetKey(window, GLFW_KEY_Q);
+		input.sprint = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT);
+		return input;
+	}
+
+	void CameraController::move(GLFWwindow* window, ew::Camera* camera, float deltaTime) {
+		move(sampleInput(window), camera, deltaTime);
+	}
+
+	void CameraController::move(const CameraInput& input, ew::Camera* camera, float deltaTime) {
+		if (!input.active) {
 			firstMouse = true;
 			return;
 		}
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	
 		//MOUSE AIMING
 		{
-			double mouseX, mouseY;
-			glfwGetCursorPos(window, &mouseX, &mouseY);
+			double mouseX = input.mouseX, mouseY = input.mouseY;
 
 			//First frame, set prevMouse values
 			if (firstMouse) {
@@ -54,24 +74,24 @@ namespace ew {
 			glm::vec3 up = glm::normalize(glm::cross(right, forward));
 
 			//Keyboard movement
-			float speed = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) ? sprintMoveSpeed : moveSpeed;
+			float speed = input.sprint ? sprintMoveSpeed : moveSpeed;
 			float moveDelta = speed * deltaTime;
-			if (glfwGetKey(window, GLFW_KEY_W)) {
+			if (input.forward) {
 				camera->position += forward * moveDelta;
 			}
-			if (glfwGetKey(window, GLFW_KEY_S)) {
+			if (input.back) {
 				camera->position -= forward * moveDelta;
 			}
-			if (glfwGetKey(window, GLFW_KEY_D)) {
+			if (input.right) {
 				camera->position += right * moveDelta;
 			}
-			if (glfwGetKey(window, GLFW_KEY_A)) {
+			if (input.left) {
 				camera->position -= right * moveDelta;
 			}
-			if (glfwGetKey(window, GLFW_KEY_E)) {
+			if (input.up) {
 				camera->position += up * moveDelta;
 			}
-			if (glfwGetKey(window, GLFW_KEY_Q)) {
+			if (input.down) {
 				camera->position -= up * moveDelta;
 			}
 
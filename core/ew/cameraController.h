@@ -7,6 +7,16 @@
 #include "camera.h"
 
 namespace ew {
+	//Input read by the controller. GLFW input can only be polled on the main thread, so it is
+	//sampled there and may be handed to a controller running on another thread
+	struct CameraInput {
+		bool active = false; //Right mouse held
+		double mouseX = 0.0;
+		double mouseY = 0.0;
+		bool forward = false, back = false, right = false, left = false, up = false, down = false;
+		bool sprint = false;
+	};
+
 	struct CameraController {
 		float moveSpeed = 3.0f; //Default speed
 		float sprintMoveSpeed = 6.0f; //Speed when left shift is held
@@ -19,5 +29,8 @@ namespace ew {
 
 		//Using input from window, aim and rotate camera
 		void move(GLFWwindow* window, ew::Camera* camera, float deltaTime);
+		void move(const CameraInput& input, ew::Camera* camera, float deltaTime);
+		//Polls input and captures the cursor while the right mouse button is held. Main thread only
+		static CameraInput sampleInput(GLFWwindow* window);
 	};
 }
\ No newline at end of file
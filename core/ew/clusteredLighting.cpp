@@ -0,0 +1,302 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "clusteredLighting.h"
+#include "gpuResources.h"
+#include "jobSystem.h"
+#include "external/glad.h"
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define EW_CLUSTER_SSE
+#endif
+
+namespace ew {
+	static const int TILES_PER_SLICE = ClusteredLighting::GRID_X * ClusteredLighting::GRID_Y;
+	static_assert(TILES_PER_SLICE % 4 == 0, "Tiles are tested in groups of 4");
+
+	/// <summary>
+	/// Tests one sphere against 4 consecutive tiles of a slice. distanceZ2 is the squared distance from
+	/// the sphere center to the slice's depth range, which is shared by every tile in the slice.
+	/// Returns a 4 bit mask of overlapping tiles
+	/// </summary>
+	static inline int testTiles(const float* minX, const float* maxX, const float* minY, const float* maxY,
+		float cx, float cy, float radius2MinusZ2) {
+#ifdef EW_CLUSTER_SSE
+		const __m128 zero = _mm_setzero_ps();
+		__m128 x = _mm_set1_ps(cx);
+		__m128 y = _mm_set1_ps(cy);
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX), x), _mm_sub_ps(x, _mm_loadu_ps(maxX))), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minY), y), _mm_sub_ps(y, _mm_loadu_ps(maxY))), zero);
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		return _mm_movemask_ps(_mm_cmple_ps(d2, _mm_set1_ps(radius2MinusZ2)));
+#else
+		int mask = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			float dx = std::max(std::max(minX[i] - cx, cx - maxX[i]), 0.0f);
+			float dy = std::max(std::max(minY[i] - cy, cy - maxY[i]), 0.0f);
+			mask |= (dx * dx + dy * dy <= radius2MinusZ2) << i;
+		}
+		return mask;
+#endif
+	}
+
+	ClusteredLighting::~ClusteredLighting()
+	{
+		if (m_buffers[0] != 0) {
+			for (int i = 0; i < 3; i++)
+			{
+				untrackGpuResource(GpuResourceType::BUFFER, m_buffers[i]);
+			}
+			glDeleteBuffers(3, m_buffers);
+		}
+	}
+
+	void ClusteredLighting::buildSliceBounds(const Camera& camera)
+	{
+		float key[6] = { camera.fov, camera.aspectRatio, camera.nearPlane, camera.farPlane, camera.orthographic ? 1.0f : 0.0f, camera.orthoHeight };
+		if (!m_slices.empty() && std::equal(key, key + 6, m_boundsKey)) {
+			return;
+		}
+		std::copy(key, key + 6, m_boundsKey);
+		m_slices.resize(GRID_Z);
+
+		float nearPlane = camera.nearPlane;
+		float farPlane = camera.farPlane;
+		float logRatio = logf(farPlane / nearPlane);
+		m_depthScale = GRID_Z / logRatio;
+		m_depthBias = -GRID_Z * logf(nearPlane) / logRatio;
+
+		//Half extents of the view volume at depth 1 (perspective) or at any depth (orthographic)
+		float halfHeight = camera.orthographic ? camera.orthoHeight * 0.5f : tanf(glm::radians(camera.fov) * 0.5f);
+		float halfWidth = halfHeight * camera.aspectRatio;
+		for (int z = 0; z < GRID_Z; z++)
+		{
+			SliceBounds& slice = m_slices[z];
+			slice.nearDepth = nearPlane * powf(farPlane / nearPlane, (float)z / GRID_Z);
+			slice.farDepth = nearPlane * powf(farPlane / nearPlane, (float)(z + 1) / GRID_Z);
+			float depthScale0 = camera.orthographic ? 1.0f : slice.nearDepth;
+			float depthScale1 = camera.orthographic ? 1.0f : slice.farDepth;
+			for (int y = 0; y < GRID_Y; y++)
+			{
+				float ny0 = (-1.0f + 2.0f * y / GRID_Y) * halfHeight;
+				float ny1 = (-1.0f + 2.0f * (y + 1) / GRID_Y) * halfHeight;
+				for (int x = 0; x < GRID_X; x++)
+				{
+					float nx0 = (-1.0f + 2.0f * x / GRID_X) * halfWidth;
+					float nx1 = (-1.0f + 2.0f * (x + 1) / GRID_X) * halfWidth;
+					int tile = x + y * GRID_X;
+					//Bounds of the tile's corners at the near and far depth of the slice
+					slice.minX[tile] = std::min(std::min(nx0 * depthScale0, nx0 * depthScale1), std::min(nx1 * depthScale0, nx1 * depthScale1));
+					slice.maxX[tile] = std::max(std::max(nx0 * depthScale0, nx0 * depthScale1), std::max(nx1 * depthScale0, nx1 * depthScale1));
+					slice.minY[tile] = std::min(std::min(ny0 * depthScale0, ny0 * depthScale1), std::min(ny1 * depthScale0, ny1 * depthScale1));
+					slice.maxY[tile] = std::max(std::max(ny0 * depthScale0, ny0 * depthScale1), std::max(ny1 * depthScale0, ny1 * depthScale1));
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Assigns lights to every cluster in slices [firstSlice, endSlice). Light indices are appended to indices,
+	/// and cluster offsets are written relative to the start of indices
+	/// </summary>
+	void ClusteredLighting::assignSlices(int firstSlice, int endSlice, std::vector<uint32_t>& indices)
+	{
+		const int NUM_GROUPS = TILES_PER_SLICE / 4;
+		std::vector<uint32_t> sliceLights;
+		std::vector<uint8_t> masks;
+		uint32_t counts[TILES_PER_SLICE];
+		uint32_t cursors[TILES_PER_SLICE];
+		for (int s = firstSlice; s < endSlice; s++)
+		{
+			const SliceBounds& slice = m_slices[s];
+			sliceLights.clear();
+			for (size_t i = 0; i < m_lightBounds.size(); i++)
+			{
+				if (m_lightBounds[i].firstSlice <= s && m_lightBounds[i].lastSlice >= s) {
+					sliceLights.push_back((uint32_t)i);
+				}
+			}
+			//First pass tests and counts, second pass writes indices into place
+			masks.resize(sliceLights.size() * NUM_GROUPS);
+			std::fill(counts, counts + TILES_PER_SLICE, 0);
+			for (size_t l = 0; l < sliceLights.size(); l++)
+			{
+				const LightBounds& light = m_lightBounds[sliceLights[l]];
+				//View space z is negative in front of the camera
+				float dz = std::max(std::max(-slice.farDepth - light.center.z, light.center.z + slice.nearDepth), 0.0f);
+				float radius2 = light.radius * light.radius - dz * dz;
+				uint8_t* lightMasks = &masks[l * NUM_GROUPS];
+				for (int g = 0; g < NUM_GROUPS; g++)
+				{
+					int tile = g * 4;
+					int mask = radius2 < 0.0f ? 0 : testTiles(slice.minX + tile, slice.maxX + tile, slice.minY + tile, slice.maxY + tile, light.center.x, light.center.y, radius2);
+					lightMasks[g] = (uint8_t)mask;
+					for (int bit = 0; bit < 4; bit++)
+					{
+						counts[tile + bit] += (mask >> bit) & 1;
+					}
+				}
+			}
+			uint32_t offset = (uint32_t)indices.size();
+			for (int t = 0; t < TILES_PER_SLICE; t++)
+			{
+				uint32_t* cluster = &m_clusters[(s * TILES_PER_SLICE + t) * 2];
+				cluster[0] = offset;
+				cluster[1] = counts[t];
+				cursors[t] = offset;
+				offset += counts[t];
+			}
+			indices.resize(offset);
+			for (size_t l = 0; l < sliceLights.size(); l++)
+			{
+				const uint8_t* lightMasks = &masks[l * NUM_GROUPS];
+				for (int g = 0; g < NUM_GROUPS; g++)
+				{
+					int mask = lightMasks[g];
+					for (int bit = 0; mask != 0; bit++, mask >>= 1)
+					{
+						if (mask & 1) {
+							indices[cursors[g * 4 + bit]++] = sliceLights[l];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void ClusteredLighting::update(const Camera& camera, const std::vector<Light>& lights, JobSystem* jobs)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		buildSliceBounds(camera);
+		m_view = camera.viewMatrix();
+
+		//Convert lights and find their view space bounds
+		size_t numLights = lights.size();
+		m_gpuLights.resize(numLights);
+		m_lightBounds.resize(numLights);
+		float nearPlane = camera.nearPlane;
+		float farPlane = camera.farPlane;
+		for (size_t i = 0; i < numLights; i++)
+		{
+			const Light& light = lights[i];
+			GpuLight& gpuLight = m_gpuLights[i];
+			glm::vec3 direction = glm::normalize(light.direction);
+			glm::vec3 center = light.position;
+			float radius = light.radius;
+			if (light.spotAngle > 0.0f) {
+				float angle = glm::radians(std::min(light.spotAngle, 89.0f));
+				float cosOuter = cosf(angle);
+				gpuLight.color = glm::vec4(light.color * light.intensity, cosf(angle * (1.0f - light.spotSoftness)));
+				gpuLight.directionCosOuter = glm::vec4(direction, cosOuter);
+				//Smallest sphere around the cone
+				if (angle > glm::quarter_pi<float>()) {
+					center += direction * (light.radius * cosOuter);
+					radius = light.radius * sinf(angle);
+				}
+				else {
+					radius = light.radius / (2.0f * cosOuter);
+					center += direction * radius;
+				}
+			}
+			else {
+				gpuLight.color = glm::vec4(light.color * light.intensity, -2.0f);
+				gpuLight.directionCosOuter = glm::vec4(direction, -2.0f);
+			}
+			gpuLight.positionRadius = glm::vec4(light.position, light.radius);
+
+			LightBounds& bounds = m_lightBounds[i];
+			bounds.center = glm::vec3(m_view * glm::vec4(center, 1.0f));
+			bounds.radius = radius;
+			float depth = -bounds.center.z;
+			if (depth + radius < nearPlane || depth - radius > farPlane) {
+				bounds.firstSlice = 1;
+				bounds.lastSlice = 0;
+				continue;
+			}
+			float minDepth = std::max(depth - radius, nearPlane);
+			float maxDepth = std::min(depth + radius, farPlane);
+			bounds.firstSlice = std::max(0, (int)floorf(logf(minDepth) * m_depthScale + m_depthBias));
+			bounds.lastSlice = std::min(GRID_Z - 1, (int)floorf(logf(maxDepth) * m_depthScale + m_depthBias));
+		}
+
+		//Each range owns a contiguous run of slices, so no two jobs write the same cluster
+		m_clusters.resize(NUM_CLUSTERS * 2);
+		int threads = jobs != nullptr ? jobs->getNumThreads() : 1;
+		threads = (int)numLights < parallelThreshold ? 1 : std::min(threads, GRID_Z);
+		m_numThreadsUsed = threads;
+		std::vector<std::vector<uint32_t>> threadIndices(threads);
+		auto sliceStart = [&](int thread) { return GRID_Z * thread / threads; };
+		parallelFor(threads > 1 ? jobs : nullptr, threads, [&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++)
+			{
+				assignSlices(sliceStart((int)t), sliceStart((int)t + 1), threadIndices[t]);
+			}
+		});
+
+		//Concatenate and rebase offsets
+		size_t totalIndices = 0;
+		for (const std::vector<uint32_t>& indices : threadIndices) totalIndices += indices.size();
+		m_lightIndices.resize(totalIndices);
+		m_maxLightsPerCluster = 0;
+		uint32_t base = 0;
+		for (int t = 0; t < threads; t++)
+		{
+			std::copy(threadIndices[t].begin(), threadIndices[t].end(), m_lightIndices.begin() + base);
+			for (int c = sliceStart(t) * TILES_PER_SLICE; c < sliceStart(t + 1) * TILES_PER_SLICE; c++)
+			{
+				m_clusters[c * 2] += base;
+				m_maxLightsPerCluster = std::max(m_maxLightsPerCluster, (int)m_clusters[c * 2 + 1]);
+			}
+			base += (uint32_t)threadIndices[t].size();
+		}
+		auto assignTime = std::chrono::high_resolution_clock::now();
+
+		upload(0, m_gpuLights.data(), m_gpuLights.size() * sizeof(GpuLight));
+		upload(1, m_clusters.data(), m_clusters.size() * sizeof(uint32_t));
+		upload(2, m_lightIndices.data(), m_lightIndices.size() * sizeof(uint32_t));
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_assignMilliseconds = std::chrono::duration<float, std::milli>(assignTime - startTime).count();
+		m_uploadMilliseconds = std::chrono::duration<float, std::milli>(endTime - assignTime).count();
+	}
+
+	/// <summary>
+	/// Orphans the buffer's storage and writes new contents, so the driver never waits on
+	/// frames still reading the old data. Capacity only grows
+	/// </summary>
+	void ClusteredLighting::upload(int buffer, const void* data, size_t size)
+	{
+		if (m_buffers[0] == 0) {
+			glCreateBuffers(3, m_buffers);
+			const char* labels[3] = { "Clustered lights", "Clusters", "Cluster light indices" };
+			for (int i = 0; i < 3; i++)
+			{
+				trackGpuResource(GpuResourceType::BUFFER, m_buffers[i], 0, labels[i]);
+			}
+		}
+		//Zero sized storage buffers can't be bound
+		m_bufferSizes[buffer] = std::max(std::max(m_bufferSizes[buffer], size), (size_t)16);
+		glNamedBufferData(m_buffers[buffer], m_bufferSizes[buffer], nullptr, GL_DYNAMIC_DRAW);
+		resizeGpuResource(GpuResourceType::BUFFER, m_buffers[buffer], m_bufferSizes[buffer]);
+		if (size > 0) {
+			glNamedBufferSubData(m_buffers[buffer], 0, size, data);
+		}
+	}
+
+	void ClusteredLighting::bind(const Shader& shader, const glm::vec2& viewportSize)const
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, m_buffers[i]);
+		}
+		shader.setMat4("_View", m_view);
+		shader.setVec3("_ClusterDims", glm::vec3(GRID_X, GRID_Y, GRID_Z));
+		shader.setVec2("_ClusterDepthParams", m_depthScale, m_depthBias);
+		shader.setVec2("_ViewportSize", viewportSize);
+	}
+}
@@ -0,0 +1,103 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "camera.h"
+#include "shader.h"
+
+namespace ew {
+	class JobSystem;
+	struct Light {
+		glm::vec3 position = glm::vec3(0.0f);
+		float radius = 5.0f; //Light has no effect past this distance
+		glm::vec3 color = glm::vec3(1.0f);
+		float intensity = 1.0f;
+		glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f); //Spot lights only
+		float spotAngle = 0.0f; //Outer half angle in degrees. 0 = point light
+		float spotSoftness = 0.2f; //Fraction of the cone that fades out
+	};
+
+	//Matches Light in the lit shader (std430)
+	struct GpuLight {
+		glm::vec4 positionRadius; //World space
+		glm::vec4 color; //rgb = color * intensity, a = cos of inner spot angle
+		glm::vec4 directionCosOuter; //w = cos of outer spot angle, below -1 for point lights
+	};
+
+	//Clustered forward lighting. The camera frustum is split into a grid of froxels (screen tiles x
+	//exponential depth slices), and every light is assigned to the froxels its bounding sphere touches.
+	//The lit shader finds its froxel from gl_FragCoord and view depth and only loops over those lights.
+	//Assignment runs on the CPU: depth slices are split between jobs, and each light is tested against
+	//4 tiles at a time with SSE where available.
+	//Shader storage bindings: 0 = lights, 1 = per cluster (offset, count), 2 = light indices
+	class ClusteredLighting {
+	public:
+		static const int GRID_X = 16;
+		static const int GRID_Y = 9;
+		static const int GRID_Z = 24;
+		static const int NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+		int parallelThreshold = 64; //Fewer lights than this are assigned on the calling thread
+
+		ClusteredLighting() {};
+		~ClusteredLighting();
+		ClusteredLighting(const ClusteredLighting&) = delete;
+		ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+		//Assigns lights to clusters for this camera and uploads the results. Slices are spread over jobs,
+		//or assigned on this thread when jobs is null
+		void update(const Camera& camera, const std::vector<Light>& lights, JobSystem* jobs = nullptr);
+		//Binds the storage buffers and sets cluster uniforms. viewportSize is the size of the
+		//viewport being rendered, in pixels
+		void bind(const Shader& shader, const glm::vec2& viewportSize)const;
+
+		//CPU time of the last assignment, excluding upload
+		inline float getAssignMilliseconds()const { return m_assignMilliseconds; }
+		inline float getUploadMilliseconds()const { return m_uploadMilliseconds; }
+		inline int getNumLights()const { return (int)m_gpuLights.size(); }
+		inline int getNumLightIndices()const { return (int)m_lightIndices.size(); }
+		inline int getMaxLightsPerCluster()const { return m_maxLightsPerCluster; }
+		inline int getNumThreadsUsed()const { return m_numThreadsUsed; }
+	private:
+		//Cluster bounds in view space, stored per slice as structure of arrays for SIMD
+		struct SliceBounds {
+			float minX[GRID_X * GRID_Y];
+			float maxX[GRID_X * GRID_Y];
+			float minY[GRID_X * GRID_Y];
+			float maxY[GRID_X * GRID_Y];
+			float nearDepth; //Positive distance in front of the camera
+			float farDepth;
+		};
+		//View space light bounding spheres
+		struct LightBounds {
+			glm::vec3 center;
+			float radius;
+			int firstSlice;
+			int lastSlice;
+		};
+		std::vector<SliceBounds> m_slices;
+		std::vector<LightBounds> m_lightBounds;
+		std::vector<GpuLight> m_gpuLights;
+		std::vector<uint32_t> m_clusters; //offset, count pairs
+		std::vector<uint32_t> m_lightIndices;
+		glm::mat4 m_view = glm::mat4(1.0f);
+		float m_depthScale = 0.0f;
+		float m_depthBias = 0.0f;
+		//Camera parameters the slice bounds were built for
+		float m_boundsKey[6] = {};
+
+		unsigned int m_buffers[3] = {};
+		size_t m_bufferSizes[3] = {};
+
+		float m_assignMilliseconds = 0.0f;
+		float m_uploadMilliseconds = 0.0f;
+		int m_maxLightsPerCluster = 0;
+		int m_numThreadsUsed = 0;
+
+		void buildSliceBounds(const Camera& camera);
+		void assignSlices(int firstSlice, int endSlice, std::vector<uint32_t>& indices);
+		void upload(int buffer, const void* data, size_t size);
+	};
+}
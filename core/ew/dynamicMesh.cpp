@@ -0,0 +1,243 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "dynamicMesh.h"
+#include "gpuResources.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+
+namespace ew {
+	DynamicMesh::DynamicMesh(const MeshData& meshData, DynamicMeshMode mode)
+	{
+		load(meshData, mode);
+	}
+
+	DynamicMesh::~DynamicMesh()
+	{
+		release();
+	}
+
+	DynamicMesh::DynamicMesh(DynamicMesh&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	DynamicMesh& DynamicMesh::operator=(DynamicMesh&& other) noexcept
+	{
+		if (this != &other) {
+			release();
+			m_mode = other.m_mode;
+			m_vertices = std::move(other.m_vertices);
+			m_vao = other.m_vao;
+			m_vbo = other.m_vbo;
+			m_ebo = other.m_ebo;
+			m_numIndices = other.m_numIndices;
+			m_mapped = other.m_mapped;
+			for (int i = 0; i < NUM_REGIONS; i++)
+			{
+				m_fences[i] = other.m_fences[i];
+				m_dirty[i] = other.m_dirty[i];
+				other.m_fences[i] = nullptr;
+			}
+			m_region = other.m_region;
+			other.m_vertices.clear();
+			other.m_vao = other.m_vbo = other.m_ebo = 0;
+			other.m_numIndices = 0;
+			other.m_mapped = nullptr;
+		}
+		return *this;
+	}
+
+	void DynamicMesh::release()
+	{
+		for (int i = 0; i < NUM_REGIONS; i++)
+		{
+			if (m_fences[i] != nullptr) {
+				glDeleteSync((GLsync)m_fences[i]);
+				m_fences[i] = nullptr;
+			}
+			m_dirty[i] = DirtyRange();
+		}
+		if (m_vao == 0) {
+			return;
+		}
+		if (m_mapped != nullptr) {
+			glUnmapNamedBuffer(m_vbo);
+			m_mapped = nullptr;
+		}
+		untrackGpuResource(GpuResourceType::VERTEX_ARRAY, m_vao);
+		untrackGpuResource(GpuResourceType::BUFFER, m_vbo);
+		untrackGpuResource(GpuResourceType::BUFFER, m_ebo);
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ebo);
+		m_vao = m_vbo = m_ebo = 0;
+		m_numIndices = 0;
+		m_region = 0;
+	}
+
+	void DynamicMesh::load(const MeshData& meshData, DynamicMeshMode mode)
+	{
+		release();
+		m_mode = mode;
+		m_vertices = meshData.vertices;
+		m_numIndices = (int)meshData.indices.size();
+		if (m_vertices.empty() || meshData.indices.empty()) {
+			printf("DynamicMesh needs vertices and indices\n");
+			return;
+		}
+		size_t regionBytes = sizeof(Vertex) * m_vertices.size();
+
+		glCreateBuffers(1, &m_vbo);
+		glCreateBuffers(1, &m_ebo);
+		glNamedBufferStorage(m_ebo, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), 0);
+		if (mode == DynamicMeshMode::PERSISTENT) {
+			//Coherent, so writes become visible to the GPU without explicit flushes
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glNamedBufferStorage(m_vbo, regionBytes * NUM_REGIONS, nullptr, flags);
+			m_mapped = (Vertex*)glMapNamedBufferRange(m_vbo, 0, regionBytes * NUM_REGIONS, flags);
+			for (int i = 0; i < NUM_REGIONS; i++)
+			{
+				memcpy(m_mapped + i * m_vertices.size(), m_vertices.data(), regionBytes);
+			}
+		}
+		else {
+			glNamedBufferData(m_vbo, regionBytes, m_vertices.data(), GL_STREAM_DRAW);
+		}
+
+		glCreateVertexArrays(1, &m_vao);
+		glVertexArrayVertexBuffer(m_vao, 0, m_vbo, 0, sizeof(Vertex));
+		glVertexArrayElementBuffer(m_vao, m_ebo);
+		//Same attribute locations as Mesh
+		glEnableVertexArrayAttrib(m_vao, 0);
+		glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+		glVertexArrayAttribBinding(m_vao, 0, 0);
+		glEnableVertexArrayAttrib(m_vao, 1);
+		glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+		glVertexArrayAttribBinding(m_vao, 1, 0);
+		glEnableVertexArrayAttrib(m_vao, 2);
+		glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uv));
+		glVertexArrayAttribBinding(m_vao, 2, 0);
+
+		trackGpuResource(GpuResourceType::VERTEX_ARRAY, m_vao, 0, "Dynamic mesh");
+		trackGpuResource(GpuResourceType::BUFFER, m_vbo, mode == DynamicMeshMode::PERSISTENT ? regionBytes * NUM_REGIONS : regionBytes, "Dynamic mesh vertices");
+		trackGpuResource(GpuResourceType::BUFFER, m_ebo, sizeof(unsigned int) * meshData.indices.size(), "Dynamic mesh indices");
+	}
+
+	void DynamicMesh::markDirty(size_t offset, size_t count)
+	{
+		size_t end = std::min(offset + count, m_vertices.size());
+		if (offset >= end) {
+			return;
+		}
+		//Every region is missing the change until it is next written
+		for (int i = 0; i < NUM_REGIONS; i++)
+		{
+			DirtyRange& range = m_dirty[i];
+			if (range.begin == range.end) {
+				range.begin = offset;
+				range.end = end;
+			}
+			else {
+				range.begin = std::min(range.begin, offset);
+				range.end = std::max(range.end, end);
+			}
+		}
+	}
+
+	void DynamicMesh::updateVertices(size_t offset, const Vertex* vertices, size_t count)
+	{
+		if (offset >= m_vertices.size()) {
+			return;
+		}
+		count = std::min(count, m_vertices.size() - offset);
+		memcpy(m_vertices.data() + offset, vertices, sizeof(Vertex) * count);
+		markDirty(offset, count);
+	}
+
+	void DynamicMesh::waitForRegion(int region)
+	{
+		GLsync fence = (GLsync)m_fences[region];
+		if (fence == nullptr) {
+			return;
+		}
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		//Flush on the first real wait, otherwise the fence may never be submitted
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (result == GL_TIMEOUT_EXPIRED) {
+			result = glClientWaitSync(fence, flags, 1000000); //1 ms
+			flags = 0;
+		}
+		if (result == GL_WAIT_FAILED) {
+			printf("DynamicMesh: waiting on a region fence failed\n");
+		}
+		glDeleteSync(fence);
+		m_fences[region] = nullptr;
+	}
+
+	void DynamicMesh::flush()
+	{
+		if (m_vao == 0) {
+			return;
+		}
+		auto startTime = std::chrono::high_resolution_clock::now();
+		m_waitMilliseconds = 0.0f;
+		if (m_mode == DynamicMeshMode::PERSISTENT) {
+			//Region being drawn is up to date, nothing to do
+			if (m_dirty[m_region].begin == m_dirty[m_region].end) {
+				m_flushMilliseconds = 0.0f;
+				return;
+			}
+			int next = (m_region + 1) % NUM_REGIONS;
+			waitForRegion(next);
+			auto waitTime = std::chrono::high_resolution_clock::now();
+			m_waitMilliseconds = std::chrono::duration<float, std::milli>(waitTime - startTime).count();
+			DirtyRange& range = m_dirty[next];
+			Vertex* region = m_mapped + next * m_vertices.size();
+			memcpy(region + range.begin, m_vertices.data() + range.begin, sizeof(Vertex) * (range.end - range.begin));
+			m_uploadBytes = sizeof(Vertex) * (range.end - range.begin);
+			range = DirtyRange();
+			m_region = next;
+		}
+		else {
+			if (m_dirty[0].begin == m_dirty[0].end) {
+				m_flushMilliseconds = 0.0f;
+				return;
+			}
+			//New storage for the same name, so the driver doesn't wait for draws still reading the old one.
+			//Its contents are undefined, so everything is uploaded
+			size_t bytes = sizeof(Vertex) * m_vertices.size();
+			glNamedBufferData(m_vbo, bytes, nullptr, GL_STREAM_DRAW);
+			glNamedBufferSubData(m_vbo, 0, bytes, m_vertices.data());
+			m_uploadBytes = bytes;
+			m_dirty[0] = DirtyRange();
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_flushMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+
+	void DynamicMesh::draw()
+	{
+		if (m_vao == 0) {
+			return;
+		}
+		glBindVertexArray(m_vao);
+		if (m_mode == DynamicMeshMode::PERSISTENT) {
+			glDrawElementsBaseVertex(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL, (GLint)(m_region * m_vertices.size()));
+			//The region can't be rewritten until this draw has consumed it
+			if (m_fences[m_region] != nullptr) {
+				glDeleteSync((GLsync)m_fences[m_region]);
+			}
+			m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		else {
+			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+		}
+	}
+}
@@ -0,0 +1,74 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	enum class DynamicMeshMode {
+		PERSISTENT = 0, //Persistently mapped immutable storage split into regions, reused once fenced
+		ORPHAN = 1 //Storage is orphaned and the whole vertex array uploaded again on every flush
+	};
+
+	//Mesh whose vertices change often, e.g. a CPU animated surface. Indices are fixed at load time.
+	//A CPU copy of the vertices is kept. Edit it in place with getVertices() + markDirty(), or use updateVertices(),
+	//then flush() once per frame before drawing. Only dirty ranges are written in PERSISTENT mode.
+	//In PERSISTENT mode the buffer holds NUM_REGIONS copies of the vertices. Each flush writes the next region
+	//while the GPU may still read the others, and only waits if that region's last draw hasn't finished,
+	//so the storage is never reallocated and the driver never has to copy or stall
+	class DynamicMesh {
+	public:
+		static const int NUM_REGIONS = 3;
+
+		DynamicMesh() {};
+		DynamicMesh(const MeshData& meshData, DynamicMeshMode mode = DynamicMeshMode::PERSISTENT);
+		~DynamicMesh();
+		DynamicMesh(DynamicMesh&& other) noexcept;
+		DynamicMesh& operator=(DynamicMesh&& other) noexcept;
+		DynamicMesh(const DynamicMesh&) = delete;
+		DynamicMesh& operator=(const DynamicMesh&) = delete;
+		//Replaces the mesh, reallocating storage
+		void load(const MeshData& meshData, DynamicMeshMode mode = DynamicMeshMode::PERSISTENT);
+
+		//CPU copy of the vertices. Call markDirty() for any range edited through it
+		inline Vertex* getVertices() { return m_vertices.data(); }
+		void markDirty(size_t offset, size_t count);
+		//Copies count vertices to offset and marks them dirty
+		void updateVertices(size_t offset, const Vertex* vertices, size_t count);
+		//Uploads dirty vertices. Draws after this use them
+		void flush();
+		void draw();
+
+		inline DynamicMeshMode getMode()const { return m_mode; }
+		inline int getNumVertices()const { return (int)m_vertices.size(); }
+		inline int getNumIndices()const { return m_numIndices; }
+		//Bytes written by the last flush that uploaded anything
+		inline size_t getUploadBytes()const { return m_uploadBytes; }
+		//CPU time of the last flush, including any wait
+		inline float getFlushMilliseconds()const { return m_flushMilliseconds; }
+		//Time the last flush spent waiting for the GPU to release a region
+		inline float getWaitMilliseconds()const { return m_waitMilliseconds; }
+	private:
+		//Vertex range [begin, end) that a region is missing
+		struct DirtyRange {
+			size_t begin = 0;
+			size_t end = 0;
+		};
+		DynamicMeshMode m_mode = DynamicMeshMode::PERSISTENT;
+		std::vector<Vertex> m_vertices;
+		unsigned int m_vao = 0;
+		unsigned int m_vbo = 0;
+		unsigned int m_ebo = 0;
+		int m_numIndices = 0;
+		Vertex* m_mapped = nullptr; //All regions, PERSISTENT only
+		void* m_fences[NUM_REGIONS] = {}; //GLsync of the last draw reading each region
+		DirtyRange m_dirty[NUM_REGIONS]; //ORPHAN only uses the first
+		int m_region = 0; //Region drawn
+		size_t m_uploadBytes = 0;
+		float m_flushMilliseconds = 0.0f;
+		float m_waitMilliseconds = 0.0f;
+		void release();
+		void waitForRegion(int region);
+	};
+}
@@ -0,0 +1,53 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "dynamicResolution.h"
+
+namespace ew {
+	void DynamicResolution::update(float gpuMilliseconds)
+	{
+		m_scaleHistory[m_historyOffset] = getScale();
+		m_timeHistory[m_historyOffset] = gpuMilliseconds;
+		m_historyOffset = (m_historyOffset + 1) % HISTORY_SIZE;
+
+		if (!enabled) {
+			m_numAccumulated = 0;
+			return;
+		}
+		//Results still belong to the previous scale
+		if (m_framesToSkip > 0) {
+			m_framesToSkip--;
+			return;
+		}
+		m_accumulatedMilliseconds += gpuMilliseconds;
+		m_numAccumulated++;
+		if (m_numAccumulated < adjustInterval) {
+			return;
+		}
+		float average = m_accumulatedMilliseconds / m_numAccumulated;
+		m_accumulatedMilliseconds = 0.0f;
+		m_numAccumulated = 0;
+		if (average <= 0.0f) {
+			return;
+		}
+		float ratio = targetMilliseconds / average;
+		if (glm::abs(ratio - 1.0f) < headroom) {
+			return;
+		}
+		//Cost scales with pixel count, i.e. scale squared. Only go halfway to avoid oscillating
+		float desired = m_scale * glm::sqrt(ratio);
+		float newScale = glm::clamp(m_scale + (desired - m_scale) * 0.5f, minScale, maxScale);
+		//Snap to 1/64 steps so tiny changes don't keep resizing the viewport
+		newScale = glm::round(newScale * 64.0f) / 64.0f;
+		if (newScale != m_scale) {
+			m_scale = newScale;
+			m_framesToSkip = latencyFrames;
+		}
+	}
+	glm::ivec2 DynamicResolution::getViewportSize(int width, int height) const
+	{
+		float scale = getScale();
+		return glm::ivec2(glm::max(1, (int)(width * scale)), glm::max(1, (int)(height * scale)));
+	}
+}
@@ -0,0 +1,42 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ew {
+	//Picks a render scale for the 3D scene from measured GPU frame time.
+	//Measurements are averaged over a window of frames, then the scale is moved
+	//toward the value that would hit the budget, assuming cost is proportional to pixel count.
+	class DynamicResolution {
+	public:
+		static const int HISTORY_SIZE = 120;
+		bool enabled = true;
+		float targetMilliseconds = 8.0f; //GPU budget for the measured work
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		int adjustInterval = 8; //Frames averaged between adjustments
+		int latencyFrames = 4; //Frames to ignore after a change, while older GPU results drain
+		float headroom = 0.05f; //Fractional deadband around the target where the scale is left alone
+
+		//Call once per frame with the latest resolved GPU time
+		void update(float gpuMilliseconds);
+		inline float getScale()const { return enabled ? m_scale : maxScale; }
+		//Size of the scene viewport for a given output size
+		glm::ivec2 getViewportSize(int width, int height)const;
+
+		//History is a ring buffer. getHistoryOffset() is the index of the oldest sample
+		inline const float* getScaleHistory()const { return m_scaleHistory; }
+		inline const float* getTimeHistory()const { return m_timeHistory; }
+		inline int getHistoryOffset()const { return m_historyOffset; }
+	private:
+		float m_scale = 1.0f;
+		float m_accumulatedMilliseconds = 0.0f;
+		int m_numAccumulated = 0;
+		int m_framesToSkip = 0;
+		float m_scaleHistory[HISTORY_SIZE] = {};
+		float m_timeHistory[HISTORY_SIZE] = {};
+		int m_historyOffset = 0;
+	};
+}
@@ -0,0 +1,192 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "framePipeline.h"
+#include <algorithm>
+
+namespace ew {
+	static inline float movingAverage(float average, float value, bool first) {
+		return first ? value : average * 0.9f + value * 0.1f;
+	}
+
+	void interpolateSnapshots(const FrameSnapshot& a, const FrameSnapshot& b, float t, FrameSnapshot* out)
+	{
+		out->time = a.time + (b.time - a.time) * t;
+		out->inputTime = t > 0.0f ? b.inputTime : a.inputTime;
+		out->camera = b.camera;
+		out->camera.position = a.camera.position + (b.camera.position - a.camera.position) * t;
+		out->camera.target = a.camera.target + (b.camera.target - a.camera.target) * t;
+		out->transforms.resize(b.transforms.size());
+		for (size_t i = 0; i < b.transforms.size(); i++)
+		{
+			const Transform& ta = a.transforms[i];
+			const Transform& tb = b.transforms[i];
+			Transform& transform = out->transforms[i];
+			transform.position = ta.position + (tb.position - ta.position) * t;
+			transform.rotation = glm::slerp(ta.rotation, tb.rotation, t);
+			transform.scale = ta.scale + (tb.scale - ta.scale) * t;
+		}
+	}
+
+	FramePipeline::~FramePipeline()
+	{
+		stop();
+	}
+
+	void FramePipeline::start(const FrameSnapshot& initial, const UpdateFunc& update, float timestep, bool threaded)
+	{
+		stop();
+		m_update = update;
+		m_timestep = timestep;
+		m_threaded = threaded;
+		m_clockStart = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(initial.time));
+		m_state = initial;
+		m_history[0] = initial;
+		m_numSteps = 1;
+		m_frameStartTime = -1.0;
+		if (threaded) {
+			m_running = true;
+			m_thread = std::thread(&FramePipeline::simulationLoop, this);
+		}
+	}
+
+	void FramePipeline::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_wake.notify_all();
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+	}
+
+	void FramePipeline::setThreaded(bool threaded)
+	{
+		if (threaded == m_threaded) {
+			return;
+		}
+		stop();
+		FrameSnapshot latest = m_history[(m_numSteps - 1) % HISTORY_SIZE];
+		start(latest, m_update, m_timestep, threaded);
+	}
+
+	void FramePipeline::setInput(const CameraInput& input)
+	{
+		double time = now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_input = input;
+		m_inputTime = time;
+	}
+
+	void FramePipeline::queueEdit(const EditFunc& edit)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_edits.push_back(edit);
+	}
+
+	double FramePipeline::now()const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_clockStart).count();
+	}
+
+	void FramePipeline::simulationLoop()
+	{
+		while (true) {
+			//The render thread needs the next step as soon as its render time (the clock minus one step) passes
+			//the current one, so computing it when the clock reaches the current step keeps it ready a step early
+			auto wakeTime = m_clockStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_state.time));
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait_until(lock, wakeTime, [&]() { return !m_running; });
+				if (!m_running) {
+					return;
+				}
+			}
+			step();
+		}
+	}
+
+	void FramePipeline::step()
+	{
+		std::vector<EditFunc> edits;
+		CameraInput input;
+		double inputTime;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			edits.swap(m_edits);
+			input = m_input;
+			inputTime = m_inputTime;
+		}
+		for (const EditFunc& edit : edits) {
+			edit(m_state);
+		}
+		auto startTime = std::chrono::steady_clock::now();
+		m_update(m_state, input, m_timestep);
+		auto endTime = std::chrono::steady_clock::now();
+		m_state.time += m_timestep;
+		m_state.inputTime = inputTime;
+
+		m_stepMilliseconds = movingAverage(m_stepMilliseconds.load(), std::chrono::duration<float, std::milli>(endTime - startTime).count(), m_numSteps == 1);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_history[m_numSteps % HISTORY_SIZE] = m_state;
+		m_numSteps++;
+	}
+
+	const FrameSnapshot& FramePipeline::beginFrame()
+	{
+		double time = now();
+		if (m_frameStartTime >= 0.0) {
+			m_frameMilliseconds = (float)((time - m_frameStartTime) * 1000.0);
+			m_averageFrameMilliseconds = movingAverage(m_averageFrameMilliseconds, m_frameMilliseconds, m_averageFrameMilliseconds == 0.0f);
+		}
+		m_frameStartTime = time;
+
+		if (!m_threaded) {
+			auto startTime = std::chrono::steady_clock::now();
+			//Catch up to the clock. Capped so a long stall doesn't trigger a burst of steps; the clock is moved back instead
+			const int MAX_STEPS = 8;
+			int numSteps = 0;
+			while (m_state.time + m_timestep <= time && numSteps < MAX_STEPS) {
+				step();
+				numSteps++;
+			}
+			if (numSteps == MAX_STEPS && m_state.time + m_timestep <= time) {
+				m_clockStart += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time - m_state.time));
+				time = m_state.time;
+			}
+			auto endTime = std::chrono::steady_clock::now();
+			m_renderUpdateMilliseconds = movingAverage(m_renderUpdateMilliseconds, std::chrono::duration<float, std::milli>(endTime - startTime).count(), false);
+		}
+		else {
+			m_renderUpdateMilliseconds = 0.0f;
+		}
+
+		double renderTime = time - m_timestep;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			//Newest step at or before the render time, and the one after it
+			long long newest = m_numSteps - 1;
+			long long oldest = std::max(0LL, m_numSteps - HISTORY_SIZE);
+			long long a = newest;
+			while (a > oldest && m_history[a % HISTORY_SIZE].time > renderTime) {
+				a--;
+			}
+			long long b = std::min(a + 1, newest);
+			m_bracket[0] = m_history[a % HISTORY_SIZE];
+			m_bracket[1] = m_history[b % HISTORY_SIZE];
+		}
+		double span = m_bracket[1].time - m_bracket[0].time;
+		m_interpolation = span > 0.0 ? (float)std::min(std::max((renderTime - m_bracket[0].time) / span, 0.0), 1.0) : 0.0f;
+		interpolateSnapshots(m_bracket[0], m_bracket[1], m_interpolation, &m_frame);
+		return m_frame;
+	}
+
+	void FramePipeline::endFrame()
+	{
+		m_latencyMilliseconds = (float)((now() - m_frame.inputTime) * 1000.0);
+		m_averageLatencyMilliseconds = movingAverage(m_averageLatencyMilliseconds, m_latencyMilliseconds, m_averageLatencyMilliseconds == 0.0f);
+	}
+}
@@ -0,0 +1,107 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include "camera.h"
+#include "transform.h"
+#include "cameraController.h"
+
+namespace ew {
+	//Simulation state handed to the renderer. Published snapshots are never modified
+	struct FrameSnapshot {
+		double time = 0.0; //Simulation time, in seconds
+		double inputTime = 0.0; //Pipeline clock when the input used by this step was sampled
+		Camera camera;
+		std::vector<Transform> transforms;
+	};
+	//Blends camera and transforms, t = 0 gives a and t = 1 gives b. Both must have the same number of transforms
+	void interpolateSnapshots(const FrameSnapshot& a, const FrameSnapshot& b, float t, FrameSnapshot* out);
+
+	//Runs the simulation at a fixed timestep, decoupled from the frame rate.
+	//In threaded mode the simulation runs on its own thread, one step ahead of the clock, so the next step
+	//is computed while the render thread submits the current frame. Otherwise steps run inside beginFrame().
+	//Either way the render thread sees the state one timestep in the past, interpolated between the two
+	//published steps around it, so motion stays smooth at any frame rate
+	class FramePipeline {
+	public:
+		typedef std::function<void(FrameSnapshot& state, const CameraInput& input, float timestep)> UpdateFunc;
+		typedef std::function<void(FrameSnapshot& state)> EditFunc;
+
+		FramePipeline() {};
+		~FramePipeline();
+		//Restarts the simulation from initial. The clock continues from initial.time
+		void start(const FrameSnapshot& initial, const UpdateFunc& update, float timestep = 1.0f / 60.0f, bool threaded = true);
+		void stop();
+		//Switches modes, continuing from the latest published step
+		void setThreaded(bool threaded);
+		//Render thread. Latest input, read by the next simulation step
+		void setInput(const CameraInput& input);
+		//Render thread. Applied to the simulation state before its next step, e.g. for UI changes
+		void queueEdit(const EditFunc& edit);
+		//Render thread. Returns the state to render this frame, valid until the next call
+		const FrameSnapshot& beginFrame();
+		//Render thread. Call once the frame has been submitted
+		void endFrame();
+
+		inline bool isThreaded()const { return m_threaded; }
+		inline float getTimestep()const { return m_timestep; }
+		//Time between the last two beginFrame() calls, in milliseconds
+		inline float getFrameMilliseconds()const { return m_frameMilliseconds; }
+		inline float getAverageFrameMilliseconds()const { return m_averageFrameMilliseconds; }
+		//Time from sampling the newest input in the last frame to endFrame(), in milliseconds
+		inline float getLatencyMilliseconds()const { return m_latencyMilliseconds; }
+		inline float getAverageLatencyMilliseconds()const { return m_averageLatencyMilliseconds; }
+		//Average simulation cost per step
+		inline float getStepMilliseconds()const { return m_stepMilliseconds.load(); }
+		//Average simulation cost paid by the render thread per frame. 0 when threaded
+		inline float getRenderThreadUpdateMilliseconds()const { return m_renderUpdateMilliseconds; }
+		//Blend factor between the two steps around the last frame
+		inline float getInterpolation()const { return m_interpolation; }
+	private:
+		//Enough history that the render time is always bracketed while the simulation runs ahead
+		static const int HISTORY_SIZE = 4;
+		UpdateFunc m_update;
+		float m_timestep = 1.0f / 60.0f;
+		bool m_threaded = false;
+		std::chrono::steady_clock::time_point m_clockStart;
+
+		//Shared between threads, guarded by m_mutex
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		bool m_running = false;
+		FrameSnapshot m_history[HISTORY_SIZE];
+		long long m_numSteps = 0; //Steps published. Step i lives in m_history[i % HISTORY_SIZE]
+		CameraInput m_input;
+		double m_inputTime = 0.0;
+		std::vector<EditFunc> m_edits;
+		std::atomic<float> m_stepMilliseconds{ 0.0f }; //Written by the simulation, read by the render thread
+
+		//Simulation side
+		std::thread m_thread;
+		FrameSnapshot m_state;
+
+		//Render side
+		FrameSnapshot m_bracket[2];
+		FrameSnapshot m_frame;
+		double m_frameStartTime = -1.0;
+		float m_frameMilliseconds = 0.0f;
+		float m_averageFrameMilliseconds = 0.0f;
+		float m_latencyMilliseconds = 0.0f;
+		float m_averageLatencyMilliseconds = 0.0f;
+		float m_renderUpdateMilliseconds = 0.0f;
+		float m_interpolation = 0.0f;
+
+		double now()const;
+		void simulationLoop();
+		//Applies pending edits, runs one step and publishes it. Called without m_mutex held
+		void step();
+	};
+}
@@ -0,0 +1,1503 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "glCapture.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <initializer_list>
+#include <memory>
+
+namespace ew {
+	//Capture file layout: CaptureHeader, then records until the end of the file. A record is the command as a varint,
+	//varints for its plain and object arguments, the return value if recorded, then a length prefixed blob per
+	//pointer argument. Signed integers are zigzag encoded, floats are stored as their bits
+	struct CaptureHeader {
+		char magic[8] = { 'E', 'W', 'G', 'L', 'C', 'A', 'P', '1' };
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t numFrames = 0;
+		uint32_t reserved = 0;
+	};
+
+	static const int MAX_ARGUMENTS = 16;
+
+#define EW_GL_CAPTURE_INFO(name, kinds, flags) { "gl" #name, kinds, flags },
+	static const GlCommandInfo commandInfos[(int)GlCommand::COUNT] = {
+		EW_GL_CAPTURE_COMMANDS(EW_GL_CAPTURE_INFO)
+		{ "SetupEnd", "", GL_CAPTURE_NO_REPLAY },
+		{ "FrameEnd", "", GL_CAPTURE_NO_REPLAY },
+		{ "ProgramBinary", "p--d", GL_CAPTURE_STATE }
+	};
+#undef EW_GL_CAPTURE_INFO
+
+	const GlCommandInfo& getGlCommandInfo(GlCommand command)
+	{
+		return commandInfos[(int)command];
+	}
+
+	static bool isPointerKind(char kind) {
+		return strchr("odznNcL", kind) != nullptr;
+	}
+
+	//Arguments before the '>'
+	static constexpr int countArguments(const char* kinds) {
+		int count = 0;
+		while (kinds[count] != '\0' && kinds[count] != '>') {
+			count++;
+		}
+		return count;
+	}
+
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static uint64_t zigzag(int64_t v) {
+		return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+	}
+
+	static int64_t unzigzag(uint64_t v) {
+		return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+	}
+
+	//Converts each GL argument type to and from a 64 bit slot
+	template<typename T, typename Enable = void> struct Slot;
+	template<typename T> struct Slot<T, typename std::enable_if<std::is_pointer<T>::value>::type> {
+		static uint64_t to(T v) { return (uint64_t)(uintptr_t)v; }
+		static T from(uint64_t s) { return (T)(uintptr_t)s; }
+	};
+	template<typename T> struct Slot<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type> {
+		static uint64_t to(T v) { return zigzag((int64_t)v); }
+		static T from(uint64_t s) { return (T)unzigzag(s); }
+	};
+	template<typename T> struct Slot<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type> {
+		static uint64_t to(T v) { return (uint64_t)v; }
+		static T from(uint64_t s) { return (T)s; }
+	};
+	template<typename T> struct Slot<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+		static uint64_t to(T v) {
+			uint64_t s = 0;
+			memcpy(&s, &v, sizeof(T));
+			return s;
+		}
+		static T from(uint64_t s) {
+			T v;
+			memcpy(&v, &s, sizeof(T));
+			return v;
+		}
+	};
+
+	template<typename R> struct ReturnSlot {
+		template<typename Fn, typename... Args> static uint64_t call(Fn fn, Args... args) { return Slot<R>::to(fn(args...)); }
+		static R result(uint64_t s) { return Slot<R>::from(s); }
+	};
+	template<> struct ReturnSlot<void> {
+		template<typename Fn, typename... Args> static uint64_t call(Fn fn, Args... args) {
+			fn(args...);
+			return 0;
+		}
+		static void result(uint64_t) {}
+	};
+
+	//Calls a GL function with arguments decoded from slots
+	template<typename Fn> struct GlFunction;
+	template<typename R, typename... Args> struct GlFunction<R(GLAD_API_PTR*)(Args...)> {
+		static const int ARITY = sizeof...(Args);
+		typedef R(GLAD_API_PTR* Function)(Args...);
+		static uint64_t invoke(Function fn, const uint64_t* slots) {
+			return invokeIndexed(fn, slots, std::index_sequence_for<Args...>());
+		}
+		template<size_t... I> static uint64_t invokeIndexed(Function fn, const uint64_t* slots, std::index_sequence<I...>) {
+			(void)slots;
+			return ReturnSlot<R>::call(fn, Slot<Args>::from(slots[I])...);
+		}
+	};
+
+#define EW_GL_CAPTURE_ARITY(name, kinds, flags) \
+	static_assert(GlFunction<decltype(glad_gl##name)>::ARITY == countArguments(kinds), "gl" #name " needs one kind per argument");
+	EW_GL_CAPTURE_COMMANDS(EW_GL_CAPTURE_ARITY)
+#undef EW_GL_CAPTURE_ARITY
+
+	static void writeVarint(std::vector<unsigned char>* out, uint64_t v) {
+		while (v >= 0x80) {
+			out->push_back((unsigned char)(v | 0x80));
+			v >>= 7;
+		}
+		out->push_back((unsigned char)v);
+	}
+
+	static void writeBlob(std::vector<unsigned char>* out, const void* data, size_t size) {
+		writeVarint(out, size);
+		if (size > 0) {
+			const unsigned char* bytes = (const unsigned char*)data;
+			out->insert(out->end(), bytes, bytes + size);
+		}
+	}
+
+	static int componentsPerPixel(GLenum format) {
+		switch (format) {
+		case GL_RG:
+		case GL_RG_INTEGER:
+			return 2;
+		case GL_RGB:
+		case GL_BGR:
+		case GL_RGB_INTEGER:
+			return 3;
+		case GL_RGBA:
+		case GL_BGRA:
+		case GL_RGBA_INTEGER:
+			return 4;
+		default:
+			return 1;
+		}
+	}
+
+	static int bytesPerComponent(GLenum type) {
+		switch (type) {
+		case GL_UNSIGNED_BYTE:
+		case GL_BYTE:
+			return 1;
+		case GL_UNSIGNED_SHORT:
+		case GL_SHORT:
+		case GL_HALF_FLOAT:
+			return 2;
+		case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+			return 8;
+		default:
+			return 4;
+		}
+	}
+
+	//Bytes GL reads for an image upload, with rows aligned to alignment
+	static size_t imageBytes(int64_t width, int64_t height, int64_t depth, GLenum format, GLenum type, int alignment) {
+		if (width <= 0 || height <= 0 || depth <= 0) {
+			return 0;
+		}
+		size_t rowBytes = (size_t)width * componentsPerPixel(format) * bytesPerComponent(type);
+		size_t alignedRow = (rowBytes + alignment - 1) / alignment * alignment;
+		return alignedRow * (size_t)(height * depth - 1) + rowBytes;
+	}
+
+	//=== Capture ===
+
+	enum class CaptureMode { OFF, IDLE, CAPTURING, PASSTHROUGH };
+
+	struct PendingBind {
+		uint64_t key = 0;
+		std::vector<unsigned char> record;
+	};
+
+	//Buffer range mapped for writing. Writes through it are found by comparing with a copy
+	struct MappedRange {
+		unsigned int buffer = 0;
+		int64_t offset = 0;
+		int64_t length = 0;
+		unsigned char* pointer = nullptr;
+		std::vector<unsigned char> shadow;
+	};
+
+	static CaptureMode captureMode = CaptureMode::OFF;
+	static std::thread::id captureThread;
+	static std::vector<unsigned char> setupLog; //STATE commands, without their data
+	static std::map<unsigned int, std::pair<size_t, size_t>> bufferDataRecords; //Offset and size in setupLog of each buffer's latest NamedBufferData
+	static std::vector<PendingBind> pendingBinds;
+	static std::vector<unsigned char> recordBuffer;
+	static FILE* captureFile = nullptr;
+	static std::string capturePath;
+	static int framesLeft = 0;
+	static size_t captureBytes = 0;
+	static std::set<unsigned int> liveBuffers;
+	static std::set<unsigned int> liveTextures;
+	static std::set<unsigned int> knownPrograms;
+	static std::map<unsigned int, std::map<int, std::string>> uniformNames;
+	static std::map<unsigned int, std::map<int, std::vector<unsigned char>>> uniformValues;
+	static unsigned int currentProgram = 0;
+	static int unpackAlignment = 4;
+	static std::vector<MappedRange> mappedRanges;
+
+	//Size of a command's 'd' argument
+	static size_t dataBytes(GlCommand command, const uint64_t* s) {
+		switch (command) {
+		case GlCommand::NamedBufferStorage:
+		case GlCommand::NamedBufferData:
+		case GlCommand::BufferData:
+			return (size_t)unzigzag(s[1]);
+		case GlCommand::NamedBufferSubData:
+			return (size_t)unzigzag(s[2]);
+		case GlCommand::PROGRAM_BINARY:
+			return (size_t)unzigzag(s[2]);
+		case GlCommand::TexImage2D:
+			return imageBytes(unzigzag(s[3]), unzigzag(s[4]), 1, (GLenum)s[6], (GLenum)s[7], unpackAlignment);
+		case GlCommand::TextureSubImage2D:
+			return imageBytes(unzigzag(s[4]), unzigzag(s[5]), 1, (GLenum)s[6], (GLenum)s[7], unpackAlignment);
+		case GlCommand::TextureSubImage3D:
+			return imageBytes(unzigzag(s[5]), unzigzag(s[6]), unzigzag(s[7]), (GLenum)s[8], (GLenum)s[9], unpackAlignment);
+		case GlCommand::ClearTexSubImage:
+			//A single texel, or nothing to clear to zero
+			return imageBytes(1, 1, 1, (GLenum)s[8], (GLenum)s[9], 1);
+		case GlCommand::TexParameterfv:
+		case GlCommand::SamplerParameterfv:
+			return s[1] == GL_TEXTURE_BORDER_COLOR ? 4 * sizeof(float) : sizeof(float);
+		case GlCommand::NamedFramebufferDrawBuffers:
+			return (size_t)unzigzag(s[1]) * sizeof(GLenum);
+		case GlCommand::Uniform1fv:
+			return (size_t)unzigzag(s[1]) * sizeof(float);
+		case GlCommand::UniformMatrix3fv:
+			return (size_t)unzigzag(s[1]) * 9 * sizeof(float);
+		case GlCommand::UniformMatrix4fv:
+			return (size_t)unzigzag(s[1]) * 16 * sizeof(float);
+		default:
+			return 0;
+		}
+	}
+
+	/// <summary>
+	/// Serializes a call. Slots hold the arguments as the application passed them, pointers included,
+	/// and the return value after them
+	/// </summary>
+	/// <param name="includeData">False leaves 'd' arguments empty, for setup that is snapshotted when a capture starts</param>
+	static void encodeCall(GlCommand command, const uint64_t* slots, bool includeData, std::vector<unsigned char>* out) {
+		const char* kinds = commandInfos[(int)command].kinds;
+		int numArguments = countArguments(kinds);
+		out->clear();
+		writeVarint(out, (uint64_t)command);
+		for (int i = 0; i < numArguments; i++)
+		{
+			if (!isPointerKind(kinds[i])) {
+				writeVarint(out, slots[i]);
+			}
+		}
+		if (kinds[numArguments] == '>') {
+			writeVarint(out, slots[numArguments]);
+		}
+		for (int i = 0; i < numArguments; i++)
+		{
+			const void* pointer = (const void*)(uintptr_t)slots[i];
+			switch (kinds[i]) {
+			case 'd':
+				writeBlob(out, pointer, includeData && pointer != nullptr ? dataBytes(command, slots) : 0);
+				break;
+			case 'z':
+				writeBlob(out, pointer, pointer != nullptr ? strlen((const char*)pointer) : 0);
+				break;
+			case 'n':
+			case 'N':
+				writeBlob(out, pointer, (size_t)std::max<int64_t>(unzigzag(slots[i - 1]), 0) * sizeof(GLuint));
+				break;
+			case 'c': {
+				int64_t count = std::max<int64_t>(unzigzag(slots[i - 1]), 0);
+				const GLchar* const* strings = (const GLchar* const*)pointer;
+				const GLint* lengths = (const GLint*)(uintptr_t)slots[i + 1];
+				writeVarint(out, (uint64_t)count);
+				for (int64_t j = 0; j < count; j++)
+				{
+					size_t length = lengths != nullptr && lengths[j] >= 0 ? (size_t)lengths[j] : strlen(strings[j]);
+					writeBlob(out, strings[j], length);
+				}
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+
+	static void writeToCapture(const std::vector<unsigned char>& record) {
+		fwrite(record.data(), 1, record.size(), captureFile);
+		captureBytes += record.size();
+	}
+
+	//Writes a call the application did not make, e.g. to restore state, to the capture only
+	static void emitToCapture(GlCommand command, std::initializer_list<uint64_t> slots) {
+		uint64_t values[MAX_ARGUMENTS] = {};
+		std::copy(slots.begin(), slots.end(), values);
+		encodeCall(command, values, true, &recordBuffer);
+		writeToCapture(recordBuffer);
+	}
+
+	static void flushPendingBinds() {
+		for (const PendingBind& bind : pendingBinds) {
+			setupLog.insert(setupLog.end(), bind.record.begin(), bind.record.end());
+		}
+		pendingBinds.clear();
+	}
+
+	/// <summary>
+	/// Keeps only the latest NamedBufferData of each buffer in the setup log. Buffers respecified every frame
+	/// (e.g. orphaned uploads) would otherwise grow it without bound. Contents are snapshotted when a capture starts,
+	/// so only the last specification matters
+	/// </summary>
+	static void replaceBufferDataRecord(unsigned int buffer, const std::vector<unsigned char>& record) {
+		auto it = bufferDataRecords.find(buffer);
+		if (it != bufferDataRecords.end()) {
+			size_t offset = it->second.first;
+			size_t size = it->second.second;
+			if (size == record.size()) {
+				std::copy(record.begin(), record.end(), setupLog.begin() + offset);
+				return;
+			}
+			setupLog.erase(setupLog.begin() + offset, setupLog.begin() + offset + size);
+			for (auto& other : bufferDataRecords) {
+				if (other.second.first > offset) {
+					other.second.first -= size;
+				}
+			}
+		}
+		bufferDataRecords[buffer] = std::make_pair(setupLog.size(), record.size());
+		setupLog.insert(setupLog.end(), record.begin(), record.end());
+	}
+
+	/// <summary>
+	/// Records a program linked on another thread (e.g. by ShaderCache) as a binary, the first time this thread uses it
+	/// </summary>
+	static void ensureProgramKnown(unsigned int program) {
+		if (program == 0 || knownPrograms.count(program)) {
+			return;
+		}
+		knownPrograms.insert(program);
+		//The queries are not part of the application's stream
+		CaptureMode mode = captureMode;
+		captureMode = CaptureMode::PASSTHROUGH;
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		std::vector<unsigned char> binary(std::max(length, 0));
+		GLenum format = 0;
+		if (length > 0) {
+			glGetProgramBinary(program, length, &length, &format, binary.data());
+		}
+		captureMode = mode;
+		if (length <= 0) {
+			printf("GL capture: program %u has no binary, replays will miss it\n", program);
+			return;
+		}
+		uint64_t slots[4] = { Slot<GLuint>::to(program), Slot<GLenum>::to(format), Slot<GLint>::to(length), Slot<const void*>::to(binary.data()) };
+		encodeCall(GlCommand::PROGRAM_BINARY, slots, true, &recordBuffer);
+		flushPendingBinds();
+		setupLog.insert(setupLog.end(), recordBuffer.begin(), recordBuffer.end());
+		if (captureMode == CaptureMode::CAPTURING) {
+			writeToCapture(recordBuffer);
+		}
+	}
+
+	//Writes whatever changed in a mapped range since it was last compared as buffer uploads
+	static void flushMappedRange(MappedRange* range) {
+		const size_t CHUNK = 4096;
+		size_t length = (size_t)range->length;
+		size_t start = 0;
+		while (start < length) {
+			size_t size = std::min(CHUNK, length - start);
+			if (memcmp(range->pointer + start, range->shadow.data() + start, size) == 0) {
+				start += size;
+				continue;
+			}
+			//Merge following changed chunks into one upload
+			size_t end = start + size;
+			while (end < length) {
+				size_t next = std::min(CHUNK, length - end);
+				if (memcmp(range->pointer + end, range->shadow.data() + end, next) == 0) {
+					break;
+				}
+				end += next;
+			}
+			memcpy(range->shadow.data() + start, range->pointer + start, end - start);
+			emitToCapture(GlCommand::NamedBufferSubData, { Slot<GLuint>::to(range->buffer), Slot<GLintptr>::to((GLintptr)(range->offset + start)),
+				Slot<GLsizeiptr>::to((GLsizeiptr)(end - start)), Slot<const void*>::to(range->pointer + start) });
+			start = end;
+		}
+	}
+
+	static void flushMappedRanges() {
+		for (MappedRange& range : mappedRanges) {
+			flushMappedRange(&range);
+		}
+	}
+
+	static void removeMappedRanges(unsigned int buffer) {
+		mappedRanges.erase(std::remove_if(mappedRanges.begin(), mappedRanges.end(),
+			[buffer](const MappedRange& range) { return range.buffer == buffer; }), mappedRanges.end());
+	}
+
+	//Commands the capture layer has to see even when they are not recorded
+	static bool needsBookkeeping(GlCommand command) {
+		return command == GlCommand::UseProgram || command == GlCommand::GetUniformLocation
+			|| command == GlCommand::MapNamedBufferRange || command == GlCommand::UnmapNamedBuffer;
+	}
+
+	static bool shouldRecord(GlCommand command) {
+		if (captureMode != CaptureMode::IDLE && captureMode != CaptureMode::CAPTURING) {
+			return false;
+		}
+		if (std::this_thread::get_id() != captureThread) {
+			return false;
+		}
+		const int KEPT = GL_CAPTURE_STATE | GL_CAPTURE_BIND | GL_CAPTURE_UNIFORM;
+		return captureMode == CaptureMode::CAPTURING || (commandInfos[(int)command].flags & KEPT) != 0 || needsBookkeeping(command);
+	}
+
+	//Bookkeeping that has to happen before the real call
+	static void beforeCall(GlCommand command, const uint64_t* slots) {
+		const char* kinds = commandInfos[(int)command].kinds;
+		if (command != GlCommand::DeleteProgram) {
+			for (int i = 0; i < countArguments(kinds); i++)
+			{
+				if (kinds[i] == 'p') {
+					ensureProgramKnown((unsigned int)slots[i]);
+				}
+			}
+		}
+		if (captureMode != CaptureMode::CAPTURING) {
+			return;
+		}
+		if (commandInfos[(int)command].flags & GL_CAPTURE_TIMED) {
+			flushMappedRanges();
+		}
+		if (command == GlCommand::UnmapNamedBuffer) {
+			for (MappedRange& range : mappedRanges) {
+				if (range.buffer == (unsigned int)slots[0]) {
+					flushMappedRange(&range);
+				}
+			}
+		}
+	}
+
+	//Tracks the objects and state a capture's snapshot needs, then records the call
+	static void recordCall(GlCommand command, const uint64_t* slots) {
+		const GlCommandInfo& info = commandInfos[(int)command];
+		switch (command) {
+		case GlCommand::CreateBuffers:
+		case GlCommand::GenBuffers:
+		case GlCommand::CreateTextures:
+		case GlCommand::GenTextures: {
+			bool buffers = command == GlCommand::CreateBuffers || command == GlCommand::GenBuffers;
+			int countIndex = command == GlCommand::CreateTextures ? 1 : 0;
+			const GLuint* names = (const GLuint*)(uintptr_t)slots[countIndex + 1];
+			for (int64_t i = 0; i < unzigzag(slots[countIndex]); i++) {
+				(buffers ? liveBuffers : liveTextures).insert(names[i]);
+			}
+			break;
+		}
+		case GlCommand::DeleteBuffers:
+		case GlCommand::DeleteTextures: {
+			const GLuint* names = (const GLuint*)(uintptr_t)slots[1];
+			for (int64_t i = 0; i < unzigzag(slots[0]); i++) {
+				if (command == GlCommand::DeleteBuffers) {
+					liveBuffers.erase(names[i]);
+					bufferDataRecords.erase(names[i]);
+					removeMappedRanges(names[i]);
+				}
+				else {
+					liveTextures.erase(names[i]);
+				}
+			}
+			break;
+		}
+		case GlCommand::CreateProgram:
+			knownPrograms.insert((unsigned int)slots[0]);
+			break;
+		case GlCommand::DeleteProgram:
+			knownPrograms.erase((unsigned int)slots[0]);
+			uniformNames.erase((unsigned int)slots[0]);
+			uniformValues.erase((unsigned int)slots[0]);
+			break;
+		case GlCommand::UseProgram:
+			currentProgram = (unsigned int)slots[0];
+			break;
+		case GlCommand::GetUniformLocation: {
+			int location = (int)unzigzag(slots[2]);
+			std::map<int, std::string>& names = uniformNames[(unsigned int)slots[0]];
+			if (location >= 0 && names.find(location) == names.end()) {
+				names[location] = (const char*)(uintptr_t)slots[1];
+			}
+			break;
+		}
+		case GlCommand::PixelStorei:
+			if (slots[0] == GL_UNPACK_ALIGNMENT) {
+				unpackAlignment = (int)unzigzag(slots[1]);
+			}
+			break;
+		case GlCommand::MapNamedBufferRange: {
+			unsigned char* pointer = (unsigned char*)(uintptr_t)slots[4];
+			if (pointer != nullptr && (slots[3] & GL_MAP_WRITE_BIT)) {
+				MappedRange range;
+				range.buffer = (unsigned int)slots[0];
+				range.offset = unzigzag(slots[1]);
+				range.length = unzigzag(slots[2]);
+				range.pointer = pointer;
+				if (captureMode == CaptureMode::CAPTURING) {
+					range.shadow.assign(pointer, pointer + range.length);
+				}
+				mappedRanges.push_back(std::move(range));
+			}
+			break;
+		}
+		case GlCommand::UnmapNamedBuffer:
+			removeMappedRanges((unsigned int)slots[0]);
+			break;
+		default:
+			break;
+		}
+
+		if (captureMode == CaptureMode::CAPTURING) {
+			encodeCall(command, slots, true, &recordBuffer);
+			writeToCapture(recordBuffer);
+		}
+		bool elementBinding = command == GlCommand::BindBuffer && slots[0] == GL_ELEMENT_ARRAY_BUFFER;
+		if ((info.flags & GL_CAPTURE_STATE) || elementBinding) {
+			//The element array binding belongs to the bound vertex array, so it can't be deferred
+			flushPendingBinds();
+			encodeCall(command, slots, false, &recordBuffer);
+			if (command == GlCommand::NamedBufferData) {
+				replaceBufferDataRecord((unsigned int)slots[0], recordBuffer);
+			}
+			else {
+				setupLog.insert(setupLog.end(), recordBuffer.begin(), recordBuffer.end());
+			}
+		}
+		else if (info.flags & GL_CAPTURE_BIND) {
+			//Other bindings only matter to the next STATE command, so only the latest of each target is kept
+			uint64_t key = ((uint64_t)command << 32) | (command == GlCommand::BindVertexArray ? 0 : slots[0]);
+			pendingBinds.erase(std::remove_if(pendingBinds.begin(), pendingBinds.end(),
+				[key](const PendingBind& bind) { return bind.key == key; }), pendingBinds.end());
+			PendingBind bind;
+			bind.key = key;
+			encodeCall(command, slots, false, &bind.record);
+			pendingBinds.push_back(std::move(bind));
+		}
+		else if ((info.flags & GL_CAPTURE_UNIFORM) && currentProgram != 0) {
+			int location = (int)unzigzag(slots[0]);
+			if (location >= 0) {
+				encodeCall(command, slots, true, &uniformValues[currentProgram][location]);
+			}
+		}
+	}
+
+	template<GlCommand C, typename Fn> struct CaptureHook;
+	template<GlCommand C, typename R, typename... Args> struct CaptureHook<C, R(GLAD_API_PTR*)(Args...)> {
+		typedef R(GLAD_API_PTR* Function)(Args...);
+		static Function real;
+		static R GLAD_API_PTR call(Args... args) {
+			if (!shouldRecord(C)) {
+				return real(args...);
+			}
+			uint64_t slots[MAX_ARGUMENTS] = { Slot<Args>::to(args)... };
+			beforeCall(C, slots);
+			slots[sizeof...(Args)] = ReturnSlot<R>::call(real, args...);
+			recordCall(C, slots);
+			return ReturnSlot<R>::result(slots[sizeof...(Args)]);
+		}
+	};
+	template<GlCommand C, typename R, typename... Args>
+	typename CaptureHook<C, R(GLAD_API_PTR*)(Args...)>::Function CaptureHook<C, R(GLAD_API_PTR*)(Args...)>::real = nullptr;
+
+	void installGlCapture()
+	{
+		if (captureMode != CaptureMode::OFF) {
+			return;
+		}
+		if (glad_glCreateBuffers == nullptr) {
+			printf("GL capture: install after gladLoadGL\n");
+			return;
+		}
+		captureThread = std::this_thread::get_id();
+#define EW_GL_CAPTURE_INSTALL(name, kinds, flags) \
+		CaptureHook<GlCommand::name, decltype(glad_gl##name)>::real = glad_gl##name; \
+		glad_gl##name = &CaptureHook<GlCommand::name, decltype(glad_gl##name)>::call;
+		EW_GL_CAPTURE_COMMANDS(EW_GL_CAPTURE_INSTALL)
+#undef EW_GL_CAPTURE_INSTALL
+		captureMode = CaptureMode::IDLE;
+	}
+
+	//Format and type textures are read back and restored in, and the bytes per texel that takes
+	static bool getReadbackFormat(unsigned int texture, int level, GLenum* format, GLenum* type, int* bytesPerTexel) {
+		GLint compressed = 0, depthSize = 0, stencilSize = 0, depthType = 0, redType = 0, redSize = 0;
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED, &compressed);
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_DEPTH_SIZE, &depthSize);
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_STENCIL_SIZE, &stencilSize);
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_DEPTH_TYPE, &depthType);
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_RED_TYPE, &redType);
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_RED_SIZE, &redSize);
+		if (compressed) {
+			return false;
+		}
+		if (depthSize > 0 && stencilSize > 0) {
+			bool floatDepth = depthType == GL_FLOAT;
+			*format = GL_DEPTH_STENCIL;
+			*type = floatDepth ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_UNSIGNED_INT_24_8;
+			*bytesPerTexel = floatDepth ? 8 : 4;
+		}
+		else if (depthSize > 0) {
+			*format = GL_DEPTH_COMPONENT;
+			*type = GL_FLOAT;
+			*bytesPerTexel = 4;
+		}
+		else if (redType == GL_UNSIGNED_INT || redType == GL_INT) {
+			*format = GL_RGBA_INTEGER;
+			*type = (GLenum)redType;
+			*bytesPerTexel = 16;
+		}
+		else if (redType == GL_UNSIGNED_NORMALIZED && redSize <= 8) {
+			*format = GL_RGBA;
+			*type = GL_UNSIGNED_BYTE;
+			*bytesPerTexel = 4;
+		}
+		else {
+			*format = GL_RGBA;
+			*type = GL_FLOAT;
+			*bytesPerTexel = 16;
+		}
+		return true;
+	}
+
+	//Writes the contents of every live buffer and texture
+	static void snapshotContents() {
+		std::vector<unsigned char> data;
+		for (unsigned int buffer : liveBuffers) {
+			if (!glIsBuffer(buffer)) {
+				continue;
+			}
+			GLint64 size = 0;
+			glGetNamedBufferParameteri64v(buffer, GL_BUFFER_SIZE, &size);
+			if (size <= 0) {
+				continue;
+			}
+			data.resize((size_t)size);
+			glGetNamedBufferSubData(buffer, 0, (GLsizeiptr)size, data.data());
+			emitToCapture(GlCommand::NamedBufferSubData, { Slot<GLuint>::to(buffer), Slot<GLintptr>::to(0),
+				Slot<GLsizeiptr>::to((GLsizeiptr)size), Slot<const void*>::to(data.data()) });
+		}
+
+		//Read back tightly packed, so uploads need an alignment of 1 too
+		GLint packAlignment = 4;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		int appUnpackAlignment = unpackAlignment;
+		unpackAlignment = 1;
+		emitToCapture(GlCommand::PixelStorei, { Slot<GLenum>::to(GL_UNPACK_ALIGNMENT), Slot<GLint>::to(1) });
+		for (unsigned int texture : liveTextures) {
+			if (!glIsTexture(texture)) {
+				continue;
+			}
+			GLint target = 0;
+			glGetTextureParameteriv(texture, GL_TEXTURE_TARGET, &target);
+			bool layered = target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D || target == GL_TEXTURE_CUBE_MAP || target == GL_TEXTURE_CUBE_MAP_ARRAY;
+			if (target != GL_TEXTURE_2D && !layered) {
+				continue;
+			}
+			for (int level = 0; level < 16; level++)
+			{
+				GLint width = 0, height = 0, depth = 0;
+				glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &width);
+				glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &height);
+				glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_DEPTH, &depth);
+				if (width == 0) {
+					break;
+				}
+				if (target == GL_TEXTURE_CUBE_MAP) {
+					depth = 6;
+				}
+				GLenum format, type;
+				int bytesPerTexel;
+				if (!getReadbackFormat(texture, level, &format, &type, &bytesPerTexel)) {
+					printf("GL capture: compressed texture %u is not restored\n", texture);
+					break;
+				}
+				size_t size = (size_t)width * height * depth * bytesPerTexel;
+				data.resize(size);
+				glGetTextureImage(texture, level, format, type, (GLsizei)size, data.data());
+				if (layered) {
+					emitToCapture(GlCommand::TextureSubImage3D, { Slot<GLuint>::to(texture), Slot<GLint>::to(level), 0, 0, 0,
+						Slot<GLsizei>::to(width), Slot<GLsizei>::to(height), Slot<GLsizei>::to(depth), format, type, Slot<const void*>::to(data.data()) });
+				}
+				else {
+					emitToCapture(GlCommand::TextureSubImage2D, { Slot<GLuint>::to(texture), Slot<GLint>::to(level), 0, 0,
+						Slot<GLsizei>::to(width), Slot<GLsizei>::to(height), format, type, Slot<const void*>::to(data.data()) });
+				}
+			}
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+		unpackAlignment = appUnpackAlignment;
+		emitToCapture(GlCommand::PixelStorei, { Slot<GLenum>::to(GL_UNPACK_ALIGNMENT), Slot<GLint>::to(appUnpackAlignment) });
+	}
+
+	//Writes the latest value of every uniform set since its program was created
+	static void snapshotUniforms() {
+		for (auto& program : uniformValues) {
+			std::map<int, std::string>& names = uniformNames[program.first];
+			emitToCapture(GlCommand::UseProgram, { Slot<GLuint>::to(program.first) });
+			for (auto& uniform : program.second) {
+				auto name = names.find(uniform.first);
+				if (name == names.end()) {
+					continue;
+				}
+				emitToCapture(GlCommand::GetUniformLocation, { Slot<GLuint>::to(program.first), Slot<const GLchar*>::to(name->second.c_str()), Slot<GLint>::to(uniform.first) });
+				writeToCapture(uniform.second);
+			}
+		}
+	}
+
+	//Writes the global state and bindings frames might depend on without setting them
+	static void snapshotState() {
+		const GLenum capabilities[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_FRAMEBUFFER_SRGB,
+			GL_PROGRAM_POINT_SIZE, GL_POLYGON_OFFSET_FILL, GL_MULTISAMPLE, GL_TEXTURE_CUBE_MAP_SEAMLESS };
+		for (GLenum capability : capabilities) {
+			emitToCapture(glIsEnabled(capability) ? GlCommand::Enable : GlCommand::Disable, { capability });
+		}
+		GLint values[4] = {};
+		GLfloat color[4] = {};
+		GLdouble clearDepth = 1.0;
+		glGetIntegerv(GL_CULL_FACE_MODE, values);
+		emitToCapture(GlCommand::CullFace, { (GLenum)values[0] });
+		glGetIntegerv(GL_DEPTH_FUNC, values);
+		emitToCapture(GlCommand::DepthFunc, { (GLenum)values[0] });
+		glGetIntegerv(GL_DEPTH_WRITEMASK, values);
+		emitToCapture(GlCommand::DepthMask, { (GLboolean)values[0] });
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, color);
+		emitToCapture(GlCommand::ClearColor, { Slot<float>::to(color[0]), Slot<float>::to(color[1]), Slot<float>::to(color[2]), Slot<float>::to(color[3]) });
+		glGetDoublev(GL_DEPTH_CLEAR_VALUE, &clearDepth);
+		emitToCapture(GlCommand::ClearDepth, { Slot<double>::to(clearDepth) });
+		glGetIntegerv(GL_CLIP_ORIGIN, &values[0]);
+		glGetIntegerv(GL_CLIP_DEPTH_MODE, &values[1]);
+		emitToCapture(GlCommand::ClipControl, { (GLenum)values[0], (GLenum)values[1] });
+		GLfloat polygonOffset[2] = {};
+		glGetFloatv(GL_POLYGON_OFFSET_FACTOR, &polygonOffset[0]);
+		glGetFloatv(GL_POLYGON_OFFSET_UNITS, &polygonOffset[1]);
+		emitToCapture(GlCommand::PolygonOffset, { Slot<float>::to(polygonOffset[0]), Slot<float>::to(polygonOffset[1]) });
+		glGetIntegerv(GL_VIEWPORT, values);
+		emitToCapture(GlCommand::Viewport, { Slot<GLint>::to(values[0]), Slot<GLint>::to(values[1]), Slot<GLsizei>::to(values[2]), Slot<GLsizei>::to(values[3]) });
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, values);
+		emitToCapture(GlCommand::BindFramebuffer, { GL_READ_FRAMEBUFFER, (GLuint)values[0] });
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, values);
+		emitToCapture(GlCommand::BindFramebuffer, { GL_DRAW_FRAMEBUFFER, (GLuint)values[0] });
+
+		GLint activeTexture = GL_TEXTURE0;
+		glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+		const GLenum textureBindings[] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_3D };
+		for (GLuint unit = 0; unit < 16; unit++)
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+			for (GLenum binding : textureBindings) {
+				glGetIntegerv(binding, values);
+				if (values[0] != 0) {
+					emitToCapture(GlCommand::BindTextureUnit, { unit, (GLuint)values[0] });
+				}
+			}
+			glGetIntegerv(GL_SAMPLER_BINDING, values);
+			emitToCapture(GlCommand::BindSampler, { unit, (GLuint)values[0] });
+		}
+		glActiveTexture((GLenum)activeTexture);
+		for (GLuint index = 0; index < 8; index++)
+		{
+			glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, index, values);
+			emitToCapture(GlCommand::BindBufferBase, { GL_SHADER_STORAGE_BUFFER, index, (GLuint)values[0] });
+			glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, index, values);
+			emitToCapture(GlCommand::BindBufferBase, { GL_UNIFORM_BUFFER, index, (GLuint)values[0] });
+		}
+		glGetIntegerv(GL_ARRAY_BUFFER_BINDING, values);
+		emitToCapture(GlCommand::BindBuffer, { GL_ARRAY_BUFFER, (GLuint)values[0] });
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, values);
+		emitToCapture(GlCommand::BindVertexArray, { (GLuint)values[0] });
+		emitToCapture(GlCommand::UseProgram, { currentProgram });
+	}
+
+	bool startGlCapture(const std::string& filePath, int numFrames, int width, int height)
+	{
+		if (captureMode == CaptureMode::OFF) {
+			printf("GL capture: installGlCapture() must be called before capturing\n");
+			return false;
+		}
+		if (captureMode == CaptureMode::CAPTURING || numFrames <= 0) {
+			return false;
+		}
+		captureFile = fopen(filePath.c_str(), "wb");
+		if (captureFile == nullptr) {
+			printf("GL capture: failed to open %s\n", filePath.c_str());
+			return false;
+		}
+		capturePath = filePath;
+		CaptureHeader header;
+		header.width = (uint32_t)width;
+		header.height = (uint32_t)height;
+		header.numFrames = (uint32_t)numFrames;
+		fwrite(&header, sizeof(header), 1, captureFile);
+		captureBytes = sizeof(header);
+		fwrite(setupLog.data(), 1, setupLog.size(), captureFile);
+		captureBytes += setupLog.size();
+
+		//Queries made while snapshotting go straight to GL
+		captureMode = CaptureMode::PASSTHROUGH;
+		snapshotContents();
+		snapshotUniforms();
+		snapshotState();
+		for (MappedRange& range : mappedRanges) {
+			range.shadow.assign(range.pointer, range.pointer + range.length);
+		}
+		emitToCapture(GlCommand::SETUP_END, {});
+		framesLeft = numFrames;
+		captureMode = CaptureMode::CAPTURING;
+		return true;
+	}
+
+	void endGlCaptureFrame()
+	{
+		if (captureMode != CaptureMode::CAPTURING) {
+			return;
+		}
+		flushMappedRanges();
+		emitToCapture(GlCommand::FRAME_END, {});
+		if (--framesLeft > 0) {
+			return;
+		}
+		fclose(captureFile);
+		captureFile = nullptr;
+		captureMode = CaptureMode::IDLE;
+		printf("GL capture: %.2f MB written to %s\n", captureBytes / (1024.0 * 1024.0), capturePath.c_str());
+	}
+
+	bool isGlCapturing()
+	{
+		return captureMode == CaptureMode::CAPTURING;
+	}
+
+	//=== Replay ===
+
+	struct CaptureReader {
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+		size_t position = 0;
+		bool failed = false;
+		inline bool atEnd()const { return position >= size || failed; }
+		uint64_t varint() {
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (position >= size) {
+					failed = true;
+					return 0;
+				}
+				unsigned char byte = data[position++];
+				value |= (uint64_t)(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0) {
+					return value;
+				}
+			}
+			failed = true;
+			return 0;
+		}
+		const unsigned char* blob(size_t* length) {
+			*length = (size_t)varint();
+			if (failed || *length > size - position) {
+				failed = true;
+				*length = 0;
+				return nullptr;
+			}
+			const unsigned char* start = data + position;
+			position += *length;
+			return start;
+		}
+	};
+
+#define EW_GL_CAPTURE_INVOKER(name, kinds, flags) \
+	[](const uint64_t* slots) -> uint64_t { return GlFunction<decltype(glad_gl##name)>::invoke(glad_gl##name, slots); },
+	static uint64_t(*const invokers[])(const uint64_t*) = {
+		EW_GL_CAPTURE_COMMANDS(EW_GL_CAPTURE_INVOKER)
+	};
+#undef EW_GL_CAPTURE_INVOKER
+
+	bool readGlCaptureHeader(const std::string& filePath, int* width, int* height, int* numFrames)
+	{
+		FILE* file = fopen(filePath.c_str(), "rb");
+		if (file == nullptr) {
+			printf("Failed to open %s\n", filePath.c_str());
+			return false;
+		}
+		CaptureHeader header, expected;
+		bool valid = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0;
+		fclose(file);
+		if (!valid) {
+			printf("%s is not a GL capture\n", filePath.c_str());
+			return false;
+		}
+		*width = (int)header.width;
+		*height = (int)header.height;
+		*numFrames = (int)header.numFrames;
+		return true;
+	}
+
+	//Decoded call, with pointer arguments pointing into the capture or scratch memory
+	struct ReplayCall {
+		GlCommand command = GlCommand::Finish;
+		int numArguments = 0;
+		uint64_t captured[MAX_ARGUMENTS] = {}; //Arguments as recorded, names unmapped
+		uint64_t slots[MAX_ARGUMENTS] = {};
+		std::vector<const unsigned char*> blobs;
+		std::vector<size_t> blobLengths;
+		std::vector<std::string> strings; //'z' and 'c' arguments, null terminated
+		std::vector<const GLchar*> stringPointers;
+		std::vector<GLint> stringLengths;
+	};
+
+	//State of one replay: what captured names and locations became
+	struct ReplayState {
+		std::unordered_map<uint64_t, uint64_t> names[128];
+		std::map<std::pair<uint64_t, int64_t>, int64_t> locations;
+		std::unordered_map<uint64_t, uint64_t> sourceHashes; //Captured shader or program name to hash of its sources
+		uint64_t currentProgram = 0; //Captured name
+		std::vector<unsigned char> scratch = std::vector<unsigned char>(1 << 20);
+		std::vector<GLuint> nameScratch;
+		std::vector<GLuint> nameArgument;
+		bool warnedBinary = false;
+	};
+
+	static bool decodeCall(CaptureReader* reader, ReplayCall* call) {
+		const char* kinds = commandInfos[(int)call->command].kinds;
+		call->numArguments = countArguments(kinds);
+		call->blobs.clear();
+		call->blobLengths.clear();
+		call->strings.clear();
+		for (int i = 0; i < call->numArguments; i++)
+		{
+			call->captured[i] = isPointerKind(kinds[i]) ? 0 : reader->varint();
+		}
+		if (kinds[call->numArguments] == '>') {
+			call->captured[call->numArguments] = reader->varint();
+		}
+		for (int i = 0; i < call->numArguments; i++)
+		{
+			size_t length = 0;
+			const unsigned char* blob = nullptr;
+			switch (kinds[i]) {
+			case 'd':
+			case 'n':
+			case 'N':
+				blob = reader->blob(&length);
+				break;
+			case 'z':
+				blob = reader->blob(&length);
+				call->strings.push_back(std::string((const char*)blob, length));
+				break;
+			case 'c': {
+				uint64_t count = reader->varint();
+				for (uint64_t j = 0; j < count && !reader->failed; j++)
+				{
+					blob = reader->blob(&length);
+					call->strings.push_back(std::string((const char*)blob, length));
+				}
+				blob = nullptr;
+				length = 0;
+				break;
+			}
+			default:
+				break;
+			}
+			call->blobs.push_back(blob);
+			call->blobLengths.push_back(length);
+		}
+		return !reader->failed;
+	}
+
+	//Kind of the objects a command creates or deletes by an array of names
+	static char objectKind(GlCommand command) {
+		switch (command) {
+		case GlCommand::CreateBuffers:
+		case GlCommand::GenBuffers:
+		case GlCommand::DeleteBuffers:
+			return 'b';
+		case GlCommand::CreateTextures:
+		case GlCommand::GenTextures:
+		case GlCommand::DeleteTextures:
+			return 't';
+		case GlCommand::CreateVertexArrays:
+		case GlCommand::GenVertexArrays:
+		case GlCommand::DeleteVertexArrays:
+			return 'v';
+		case GlCommand::CreateFramebuffers:
+		case GlCommand::DeleteFramebuffers:
+			return 'f';
+		case GlCommand::CreateSamplers:
+			return 'm';
+		default:
+			return 'q';
+		}
+	}
+
+	static uint64_t mapName(ReplayState* state, char kind, uint64_t name) {
+		auto found = state->names[(int)kind].find(name);
+		return found == state->names[(int)kind].end() ? name : found->second;
+	}
+
+	/// <summary>
+	/// Replaces captured names, locations and pointers with this replay's
+	/// </summary>
+	/// <returns>False if the call can't be replayed, e.g. it waits on a sync object that was never created</returns>
+	static bool prepareCall(ReplayState* state, ReplayCall* call) {
+		const char* kinds = commandInfos[(int)call->command].kinds;
+		size_t nextString = 0;
+		for (int i = 0; i < call->numArguments; i++)
+		{
+			uint64_t value = call->captured[i];
+			switch (kinds[i]) {
+			case 'b': case 't': case 'v': case 'f': case 'p': case 's': case 'm': case 'q':
+				value = mapName(state, kinds[i], value);
+				break;
+			case 'y': {
+				auto found = state->names['y'].find(value);
+				if (found == state->names['y'].end()) {
+					return false;
+				}
+				value = found->second;
+				break;
+			}
+			case 'l': {
+				auto found = state->locations.find({ state->currentProgram, unzigzag(value) });
+				if (found != state->locations.end()) {
+					value = zigzag(found->second);
+				}
+				break;
+			}
+			case 'o':
+				value = Slot<void*>::to(state->scratch.data());
+				break;
+			case 'd':
+				value = Slot<const void*>::to(call->blobLengths[i] > 0 ? call->blobs[i] : nullptr);
+				break;
+			case 'z':
+				value = Slot<const char*>::to(call->strings[nextString++].c_str());
+				break;
+			case 'n':
+				state->nameScratch.resize(call->blobLengths[i] / sizeof(GLuint) + 1);
+				value = Slot<GLuint*>::to(state->nameScratch.data());
+				break;
+			case 'N': {
+				size_t count = call->blobLengths[i] / sizeof(GLuint);
+				state->nameArgument.resize(count + 1);
+				for (size_t j = 0; j < count; j++)
+				{
+					GLuint name;
+					memcpy(&name, call->blobs[i] + j * sizeof(GLuint), sizeof(GLuint));
+					state->nameArgument[j] = (GLuint)mapName(state, objectKind(call->command), name);
+				}
+				value = Slot<GLuint*>::to(state->nameArgument.data());
+				break;
+			}
+			case 'c':
+				call->stringPointers.clear();
+				call->stringLengths.clear();
+				for (; nextString < call->strings.size(); nextString++)
+				{
+					call->stringPointers.push_back(call->strings[nextString].c_str());
+					call->stringLengths.push_back((GLint)call->strings[nextString].size());
+				}
+				value = Slot<const GLchar* const*>::to(call->stringPointers.data());
+				break;
+			case 'L':
+				value = Slot<const GLint*>::to(call->stringLengths.data());
+				break;
+			default:
+				break;
+			}
+			call->slots[i] = value;
+		}
+		//Mapped writes are replayed as uploads, which immutable storage only accepts with this flag
+		if (call->command == GlCommand::NamedBufferStorage) {
+			call->slots[3] |= GL_DYNAMIC_STORAGE_BIT;
+		}
+		return true;
+	}
+
+	//Records what the call's created names and returned values correspond to in the capture
+	static void afterCall(ReplayState* state, const ReplayCall& call, uint64_t returned) {
+		const char* kinds = commandInfos[(int)call.command].kinds;
+		for (int i = 0; i < call.numArguments; i++)
+		{
+			if (kinds[i] != 'n') {
+				continue;
+			}
+			char kind = objectKind(call.command);
+			size_t count = call.blobLengths[i] / sizeof(GLuint);
+			for (size_t j = 0; j < count; j++)
+			{
+				GLuint name;
+				memcpy(&name, call.blobs[i] + j * sizeof(GLuint), sizeof(GLuint));
+				state->names[(int)kind][name] = state->nameScratch[j];
+			}
+		}
+		if (kinds[call.numArguments] == '>') {
+			char kind = kinds[call.numArguments + 1];
+			uint64_t captured = call.captured[call.numArguments];
+			if (kind == 'l') {
+				state->locations[{ call.captured[0], unzigzag(captured) }] = unzigzag(returned);
+			}
+			else {
+				state->names[(int)kind][captured] = returned;
+			}
+		}
+		switch (call.command) {
+		case GlCommand::UseProgram:
+			state->currentProgram = call.captured[0];
+			break;
+		case GlCommand::ShaderSource: {
+			uint64_t hash = hashBytes(nullptr, 0);
+			for (const std::string& string : call.strings) {
+				hash = hashBytes(string.data(), string.size(), hash);
+			}
+			state->sourceHashes[call.captured[0]] = hash;
+			break;
+		}
+		case GlCommand::AttachShader: {
+			uint64_t shaderHash = state->sourceHashes[call.captured[1]];
+			uint64_t& programHash = state->sourceHashes[call.captured[0]];
+			//Order independent, shaders can be attached in any order
+			programHash ^= shaderHash;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	static void replayProgramBinary(ReplayState* state, const ReplayCall& call) {
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, (GLenum)call.captured[1], call.blobs[3], (GLsizei)call.blobLengths[3]);
+		GLint linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked && !state->warnedBinary) {
+			printf("A program binary was rejected, captures only replay on the GPU and driver that made them\n");
+			state->warnedBinary = true;
+		}
+		state->names[(int)'p'][call.captured[0]] = program;
+		state->sourceHashes[call.captured[0]] = hashBytes(call.blobs[3], call.blobLengths[3]);
+	}
+
+	//Identifies a call independently of object names, so the same draw matches across captures
+	static uint64_t getSignature(ReplayState* state, const ReplayCall& call) {
+		const char* kinds = commandInfos[(int)call.command].kinds;
+		uint64_t hash = hashBytes(&call.command, sizeof(call.command));
+		for (int i = 0; i < call.numArguments; i++)
+		{
+			if (kinds[i] == '-') {
+				hash = hashBytes(&call.captured[i], sizeof(uint64_t), hash);
+			}
+		}
+		uint64_t programHash = state->sourceHashes[state->currentProgram];
+		return hashBytes(&programHash, sizeof(programHash), hash);
+	}
+
+	struct TimedCall {
+		size_t call;
+		GLuint queries[2];
+	};
+
+	bool replayGlCapture(const std::string& filePath, GlReplayResult* result)
+	{
+		FILE* file = fopen(filePath.c_str(), "rb");
+		if (file == nullptr) {
+			printf("Failed to open %s\n", filePath.c_str());
+			return false;
+		}
+		fseek(file, 0, SEEK_END);
+		long fileSize = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		std::vector<unsigned char> data(fileSize > 0 ? (size_t)fileSize : 0);
+		size_t numRead = fread(data.data(), 1, data.size(), file);
+		fclose(file);
+		CaptureHeader header, expected;
+		if (numRead != data.size() || data.size() < sizeof(header)) {
+			printf("%s is not a GL capture\n", filePath.c_str());
+			return false;
+		}
+		memcpy(&header, data.data(), sizeof(header));
+		if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+			printf("%s is not a GL capture\n", filePath.c_str());
+			return false;
+		}
+		*result = GlReplayResult();
+		result->width = (int)header.width;
+		result->height = (int)header.height;
+		result->numFrames = (int)header.numFrames;
+
+		std::unique_ptr<ReplayState> state(new ReplayState());
+		CaptureReader reader;
+		reader.data = data.data();
+		reader.size = data.size();
+		reader.position = sizeof(header);
+		ReplayCall call;
+		bool inFrames = false;
+		int frame = 0;
+		std::vector<GLuint> queryPool;
+		std::vector<TimedCall> timedCalls;
+		typedef std::chrono::high_resolution_clock Clock;
+		Clock::time_point frameStart = Clock::now();
+
+		while (!reader.atEnd()) {
+			uint64_t command = reader.varint();
+			if (command >= (uint64_t)GlCommand::COUNT) {
+				printf("Unknown command %llu at byte %zu of %s\n", (unsigned long long)command, reader.position, filePath.c_str());
+				return false;
+			}
+			call.command = (GlCommand)command;
+			if (!decodeCall(&reader, &call)) {
+				printf("%s is truncated\n", filePath.c_str());
+				return false;
+			}
+			const GlCommandInfo& info = commandInfos[command];
+			if (call.command == GlCommand::SETUP_END || call.command == GlCommand::FRAME_END) {
+				glFinish();
+				Clock::time_point now = Clock::now();
+				if (inFrames) {
+					float gpuMilliseconds = 0.0f;
+					for (const TimedCall& timed : timedCalls) {
+						GLuint64 begin = 0, end = 0;
+						glGetQueryObjectui64v(timed.queries[0], GL_QUERY_RESULT, &begin);
+						glGetQueryObjectui64v(timed.queries[1], GL_QUERY_RESULT, &end);
+						result->calls[timed.call].gpuMicroseconds = (end - begin) / 1000.0f;
+						gpuMilliseconds += (end - begin) / 1000000.0f;
+					}
+					timedCalls.clear();
+					result->frameCpuMilliseconds.push_back(std::chrono::duration<float, std::milli>(now - frameStart).count());
+					result->frameGpuMilliseconds.push_back(gpuMilliseconds);
+					frame++;
+				}
+				inFrames = true;
+				frameStart = now;
+				continue;
+			}
+			if (info.flags & GL_CAPTURE_NO_REPLAY) {
+				continue;
+			}
+			if (call.command == GlCommand::PROGRAM_BINARY) {
+				replayProgramBinary(state.get(), call);
+				continue;
+			}
+			if (!prepareCall(state.get(), &call)) {
+				continue;
+			}
+			bool timed = inFrames && (info.flags & GL_CAPTURE_TIMED);
+			TimedCall timedCall = {};
+			if (timed) {
+				size_t numQueries = timedCalls.size() * 2;
+				while (queryPool.size() < numQueries + 2) {
+					GLuint query;
+					glGenQueries(1, &query);
+					queryPool.push_back(query);
+				}
+				timedCall.call = result->calls.size();
+				timedCall.queries[0] = queryPool[numQueries];
+				timedCall.queries[1] = queryPool[numQueries + 1];
+				glQueryCounter(timedCall.queries[0], GL_TIMESTAMP);
+			}
+			Clock::time_point callStart = Clock::now();
+			uint64_t returned = invokers[command](call.slots);
+			Clock::time_point callEnd = Clock::now();
+			if (timed) {
+				glQueryCounter(timedCall.queries[1], GL_TIMESTAMP);
+				timedCalls.push_back(timedCall);
+			}
+			afterCall(state.get(), call, returned);
+			if (inFrames) {
+				GlReplayCall replayed;
+				replayed.command = call.command;
+				replayed.frame = frame;
+				replayed.cpuMicroseconds = std::chrono::duration<float, std::micro>(callEnd - callStart).count();
+				replayed.signature = getSignature(state.get(), call);
+				result->calls.push_back(replayed);
+			}
+		}
+		if (!queryPool.empty()) {
+			glDeleteQueries((GLsizei)queryPool.size(), queryPool.data());
+		}
+		if (frame != result->numFrames) {
+			printf("%s has %d of %d frames\n", filePath.c_str(), frame, result->numFrames);
+			result->numFrames = frame;
+		}
+		return !reader.failed;
+	}
+
+	void printGlReplayReport(const GlReplayResult& result, int numTop)
+	{
+		struct CommandTotal {
+			int count = 0;
+			double cpuMicroseconds = 0.0;
+			double gpuMicroseconds = 0.0;
+		};
+		CommandTotal totals[(int)GlCommand::COUNT];
+		for (const GlReplayCall& call : result.calls) {
+			CommandTotal& total = totals[(int)call.command];
+			total.count++;
+			total.cpuMicroseconds += call.cpuMicroseconds;
+			total.gpuMicroseconds += std::max(call.gpuMicroseconds, 0.0f);
+		}
+		std::vector<int> commands;
+		for (int i = 0; i < (int)GlCommand::COUNT; i++)
+		{
+			if (totals[i].count > 0) {
+				commands.push_back(i);
+			}
+		}
+		std::sort(commands.begin(), commands.end(), [&totals](int a, int b) {
+			if (totals[a].gpuMicroseconds != totals[b].gpuMicroseconds) {
+				return totals[a].gpuMicroseconds > totals[b].gpuMicroseconds;
+			}
+			return totals[a].cpuMicroseconds > totals[b].cpuMicroseconds;
+		});
+
+		int numFrames = std::max((int)result.frameCpuMilliseconds.size(), 1);
+		float cpuMilliseconds = 0.0f, gpuMilliseconds = 0.0f;
+		for (size_t i = 0; i < result.frameCpuMilliseconds.size(); i++)
+		{
+			cpuMilliseconds += result.frameCpuMilliseconds[i];
+			gpuMilliseconds += result.frameGpuMilliseconds[i];
+		}
+		printf("%d frames at %dx%d, %zu calls. Per frame: %.3f ms CPU, %.3f ms GPU in timed calls\n", (int)result.frameCpuMilliseconds.size(),
+			result.width, result.height, result.calls.size(), cpuMilliseconds / numFrames, gpuMilliseconds / numFrames);
+		printf("\n%-32s %8s %12s %12s %12s\n", "Command", "Calls", "CPU us", "GPU us", "GPU us/call");
+		for (int command : commands) {
+			const CommandTotal& total = totals[command];
+			printf("%-32s %8d %12.1f %12.1f %12.2f\n", commandInfos[command].name, total.count,
+				total.cpuMicroseconds, total.gpuMicroseconds, total.gpuMicroseconds / total.count);
+		}
+
+		std::vector<size_t> order(result.calls.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		size_t numShown = std::min(order.size(), (size_t)std::max(numTop, 0));
+		std::partial_sort(order.begin(), order.begin() + numShown, order.end(), [&result](size_t a, size_t b) {
+			return result.calls[a].gpuMicroseconds > result.calls[b].gpuMicroseconds;
+		});
+		printf("\nMost expensive calls on the GPU\n%-6s %-8s %-32s %12s %12s %18s\n", "Frame", "Call", "Command", "GPU us", "CPU us", "Signature");
+		for (size_t i = 0; i < numShown && result.calls[order[i]].gpuMicroseconds >= 0.0f; i++)
+		{
+			const GlReplayCall& call = result.calls[order[i]];
+			printf("%-6d %-8zu %-32s %12.2f %12.2f %016llx\n", call.frame, order[i], commandInfos[(int)call.command].name,
+				call.gpuMicroseconds, call.cpuMicroseconds, (unsigned long long)call.signature);
+		}
+		std::partial_sort(order.begin(), order.begin() + numShown, order.end(), [&result](size_t a, size_t b) {
+			return result.calls[a].cpuMicroseconds > result.calls[b].cpuMicroseconds;
+		});
+		printf("\nMost expensive calls on the CPU\n%-6s %-8s %-32s %12s\n", "Frame", "Call", "Command", "CPU us");
+		for (size_t i = 0; i < numShown; i++)
+		{
+			const GlReplayCall& call = result.calls[order[i]];
+			printf("%-6d %-8zu %-32s %12.2f\n", call.frame, order[i], commandInfos[(int)call.command].name, call.cpuMicroseconds);
+		}
+	}
+
+	//Timed calls of the first frame, the ones a diff compares
+	static std::vector<const GlReplayCall*> getFirstFrameTimedCalls(const GlReplayResult& result) {
+		std::vector<const GlReplayCall*> calls;
+		for (const GlReplayCall& call : result.calls) {
+			if (call.frame != 0) {
+				break;
+			}
+			if (call.gpuMicroseconds >= 0.0f) {
+				calls.push_back(&call);
+			}
+		}
+		return calls;
+	}
+
+	void printGlReplayDiff(const GlReplayResult& a, const GlReplayResult& b, int numTop)
+	{
+		std::vector<const GlReplayCall*> callsA = getFirstFrameTimedCalls(a);
+		std::vector<const GlReplayCall*> callsB = getFirstFrameTimedCalls(b);
+		size_t n = callsA.size(), m = callsB.size();
+		std::vector<std::pair<size_t, size_t>> matches;
+		if (n * m <= 4000000) {
+			//Longest common subsequence of signatures
+			std::vector<uint32_t> lengths((n + 1) * (m + 1), 0);
+			for (size_t i = n; i-- > 0;)
+			{
+				for (size_t j = m; j-- > 0;)
+				{
+					lengths[i * (m + 1) + j] = callsA[i]->signature == callsB[j]->signature ? lengths[(i + 1) * (m + 1) + j + 1] + 1
+						: std::max(lengths[(i + 1) * (m + 1) + j], lengths[i * (m + 1) + j + 1]);
+				}
+			}
+			size_t i = 0, j = 0;
+			while (i < n && j < m) {
+				if (callsA[i]->signature == callsB[j]->signature) {
+					matches.push_back({ i++, j++ });
+				}
+				else if (lengths[(i + 1) * (m + 1) + j] >= lengths[i * (m + 1) + j + 1]) {
+					i++;
+				}
+				else {
+					j++;
+				}
+			}
+		}
+		else {
+			printf("Too many calls to align, comparing by index\n");
+			for (size_t i = 0; i < std::min(n, m); i++)
+			{
+				if (callsA[i]->signature == callsB[i]->signature) {
+					matches.push_back({ i, i });
+				}
+			}
+		}
+
+		std::vector<bool> matchedA(n, false), matchedB(m, false);
+		for (const auto& match : matches) {
+			matchedA[match.first] = true;
+			matchedB[match.second] = true;
+		}
+		float gpuA = 0.0f, gpuB = 0.0f;
+		for (const GlReplayCall* call : callsA) {
+			gpuA += call->gpuMicroseconds;
+		}
+		for (const GlReplayCall* call : callsB) {
+			gpuB += call->gpuMicroseconds;
+		}
+		printf("First frame: %zu timed calls in A, %zu in B. %zu matched, %zu only in A, %zu only in B\n",
+			n, m, matches.size(), n - matches.size(), m - matches.size());
+		printf("GPU time in timed calls: %.3f ms -> %.3f ms (%+.3f ms)\n", gpuA / 1000.0f, gpuB / 1000.0f, (gpuB - gpuA) / 1000.0f);
+
+		std::sort(matches.begin(), matches.end(), [&](const std::pair<size_t, size_t>& x, const std::pair<size_t, size_t>& y) {
+			return fabsf(callsB[x.second]->gpuMicroseconds - callsA[x.first]->gpuMicroseconds)
+				> fabsf(callsB[y.second]->gpuMicroseconds - callsA[y.first]->gpuMicroseconds);
+		});
+		printf("\nLargest changes in matched calls\n%-32s %8s %8s %12s %12s %12s\n", "Command", "Call A", "Call B", "A GPU us", "B GPU us", "Change");
+		for (size_t i = 0; i < std::min(matches.size(), (size_t)std::max(numTop, 0)); i++)
+		{
+			const GlReplayCall* callA = callsA[matches[i].first];
+			const GlReplayCall* callB = callsB[matches[i].second];
+			printf("%-32s %8zu %8zu %12.2f %12.2f %+12.2f\n", commandInfos[(int)callA->command].name, matches[i].first, matches[i].second,
+				callA->gpuMicroseconds, callB->gpuMicroseconds, callB->gpuMicroseconds - callA->gpuMicroseconds);
+		}
+		int numShown = 0;
+		printf("\nOnly in A\n");
+		for (size_t i = 0; i < n && numShown < numTop; i++)
+		{
+			if (!matchedA[i]) {
+				printf("%-32s %8zu %12.2f us\n", commandInfos[(int)callsA[i]->command].name, i, callsA[i]->gpuMicroseconds);
+				numShown++;
+			}
+		}
+		numShown = 0;
+		printf("\nOnly in B\n");
+		for (size_t j = 0; j < m && numShown < numTop; j++)
+		{
+			if (!matchedB[j]) {
+				printf("%-32s %8zu %12.2f us\n", commandInfos[(int)callsB[j]->command].name, j, callsB[j]->gpuMicroseconds);
+				numShown++;
+			}
+		}
+	}
+}
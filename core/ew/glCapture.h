@@ -0,0 +1,189 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace ew {
+	//GL entry points the capture layer wraps, as X(name without the gl prefix, argument kinds, flags).
+	//Argument kinds, one character per argument, then '>' and the kind of the return value if it is recorded:
+	//'-' plain value
+	//'b' buffer, 't' texture, 'v' vertex array, 'f' framebuffer, 'p' program, 's' shader, 'm' sampler, 'q' query, 'y' sync,
+	//'l' uniform location of the current program, 'o' output pointer (replayed into scratch memory)
+	//'d' data, 'z' string, 'n' names written by the call, 'N' names read by the call (counts are the argument before),
+	//'c' array of strings (count before), 'L' their lengths
+#define EW_GL_CAPTURE_COMMANDS(X) \
+	X(CreateBuffers, "-n", GL_CAPTURE_STATE) \
+	X(CreateTextures, "--n", GL_CAPTURE_STATE) \
+	X(CreateVertexArrays, "-n", GL_CAPTURE_STATE) \
+	X(CreateFramebuffers, "-n", GL_CAPTURE_STATE) \
+	X(CreateSamplers, "-n", GL_CAPTURE_STATE) \
+	X(GenQueries, "-n", GL_CAPTURE_STATE) \
+	X(GenBuffers, "-n", GL_CAPTURE_STATE) \
+	X(GenVertexArrays, "-n", GL_CAPTURE_STATE) \
+	X(GenTextures, "-n", GL_CAPTURE_STATE) \
+	X(DeleteBuffers, "-N", GL_CAPTURE_STATE) \
+	X(DeleteVertexArrays, "-N", GL_CAPTURE_STATE) \
+	X(DeleteTextures, "-N", GL_CAPTURE_STATE) \
+	X(DeleteFramebuffers, "-N", GL_CAPTURE_STATE) \
+	X(CreateShader, "->s", GL_CAPTURE_STATE) \
+	X(CreateProgram, ">p", GL_CAPTURE_STATE) \
+	X(DeleteShader, "s", GL_CAPTURE_STATE) \
+	X(DeleteProgram, "p", GL_CAPTURE_STATE) \
+	X(ShaderSource, "s-cL", GL_CAPTURE_STATE) \
+	X(CompileShader, "s", GL_CAPTURE_STATE) \
+	X(AttachShader, "ps", GL_CAPTURE_STATE) \
+	X(LinkProgram, "p", GL_CAPTURE_STATE) \
+	X(GetUniformLocation, "pz>l", GL_CAPTURE_FRAME) \
+	X(NamedBufferStorage, "b-d-", GL_CAPTURE_STATE) \
+	X(NamedBufferData, "b-d-", GL_CAPTURE_STATE) \
+	X(NamedBufferSubData, "b--d", GL_CAPTURE_FRAME) \
+	X(BufferData, "--d-", GL_CAPTURE_STATE) \
+	X(BindBuffer, "-b", GL_CAPTURE_BIND) \
+	X(BindBufferBase, "--b", GL_CAPTURE_FRAME) \
+	X(MapNamedBufferRange, "b---", GL_CAPTURE_FRAME | GL_CAPTURE_NO_REPLAY) \
+	X(UnmapNamedBuffer, "b", GL_CAPTURE_FRAME | GL_CAPTURE_NO_REPLAY) \
+	X(BindVertexArray, "v", GL_CAPTURE_BIND) \
+	X(VertexArrayVertexBuffer, "v-b--", GL_CAPTURE_STATE) \
+	X(VertexArrayElementBuffer, "vb", GL_CAPTURE_STATE) \
+	X(EnableVertexArrayAttrib, "v-", GL_CAPTURE_STATE) \
+	X(VertexArrayAttribFormat, "v-----", GL_CAPTURE_STATE) \
+	X(VertexArrayAttribIFormat, "v----", GL_CAPTURE_STATE) \
+	X(VertexArrayAttribBinding, "v--", GL_CAPTURE_STATE) \
+	X(VertexAttribPointer, "------", GL_CAPTURE_STATE) \
+	X(EnableVertexAttribArray, "-", GL_CAPTURE_STATE) \
+	X(BindTexture, "-t", GL_CAPTURE_BIND) \
+	X(TexImage2D, "--------d", GL_CAPTURE_STATE) \
+	X(TexParameteri, "---", GL_CAPTURE_STATE) \
+	X(TexParameterfv, "--d", GL_CAPTURE_STATE) \
+	X(GenerateMipmap, "-", GL_CAPTURE_FRAME) \
+	X(TextureStorage2D, "t----", GL_CAPTURE_STATE) \
+	X(TextureStorage3D, "t-----", GL_CAPTURE_STATE) \
+	X(TextureSubImage2D, "t-------d", GL_CAPTURE_FRAME) \
+	X(TextureSubImage3D, "t---------d", GL_CAPTURE_FRAME) \
+	X(TextureParameteri, "t--", GL_CAPTURE_STATE) \
+	X(GenerateTextureMipmap, "t", GL_CAPTURE_FRAME) \
+	X(PixelStorei, "--", GL_CAPTURE_STATE) \
+	X(BindTextureUnit, "-t", GL_CAPTURE_FRAME) \
+	X(BindImageTexture, "-t-----", GL_CAPTURE_FRAME) \
+	X(SamplerParameteri, "m--", GL_CAPTURE_STATE) \
+	X(SamplerParameterfv, "m-d", GL_CAPTURE_STATE) \
+	X(BindSampler, "-m", GL_CAPTURE_FRAME) \
+	X(NamedFramebufferTexture, "f-t-", GL_CAPTURE_STATE) \
+	X(NamedFramebufferDrawBuffer, "f-", GL_CAPTURE_STATE) \
+	X(NamedFramebufferDrawBuffers, "f-d", GL_CAPTURE_STATE) \
+	X(NamedFramebufferReadBuffer, "f-", GL_CAPTURE_STATE) \
+	X(CheckNamedFramebufferStatus, "f-", GL_CAPTURE_FRAME) \
+	X(BindFramebuffer, "-f", GL_CAPTURE_FRAME) \
+	X(BlitNamedFramebuffer, "ff----------", GL_CAPTURE_TIMED) \
+	X(Enable, "-", GL_CAPTURE_FRAME) \
+	X(Disable, "-", GL_CAPTURE_FRAME) \
+	X(IsEnabled, "-", GL_CAPTURE_FRAME) \
+	X(CullFace, "-", GL_CAPTURE_FRAME) \
+	X(DepthFunc, "-", GL_CAPTURE_FRAME) \
+	X(DepthMask, "-", GL_CAPTURE_FRAME) \
+	X(ClipControl, "--", GL_CAPTURE_FRAME) \
+	X(PolygonOffset, "--", GL_CAPTURE_FRAME) \
+	X(Viewport, "----", GL_CAPTURE_FRAME) \
+	X(ClearColor, "----", GL_CAPTURE_FRAME) \
+	X(ClearDepth, "-", GL_CAPTURE_FRAME) \
+	X(GetIntegerv, "-o", GL_CAPTURE_FRAME) \
+	X(Clear, "-", GL_CAPTURE_TIMED) \
+	X(ClearTexSubImage, "t---------d", GL_CAPTURE_TIMED) \
+	X(DrawArrays, "---", GL_CAPTURE_TIMED) \
+	X(DrawArraysInstanced, "----", GL_CAPTURE_TIMED) \
+	X(DrawElements, "----", GL_CAPTURE_TIMED) \
+	X(DrawElementsInstanced, "-----", GL_CAPTURE_TIMED) \
+	X(DrawElementsBaseVertex, "-----", GL_CAPTURE_TIMED) \
+	X(DispatchCompute, "---", GL_CAPTURE_TIMED) \
+	X(MemoryBarrier, "-", GL_CAPTURE_FRAME) \
+	X(UseProgram, "p", GL_CAPTURE_FRAME) \
+	X(GetProgramiv, "p-o", GL_CAPTURE_FRAME) \
+	X(GetShaderiv, "s-o", GL_CAPTURE_FRAME) \
+	X(GetProgramInfoLog, "p-oo", GL_CAPTURE_FRAME) \
+	X(GetShaderInfoLog, "s-oo", GL_CAPTURE_FRAME) \
+	X(Uniform1i, "l-", GL_CAPTURE_UNIFORM) \
+	X(Uniform1f, "l-", GL_CAPTURE_UNIFORM) \
+	X(Uniform2f, "l--", GL_CAPTURE_UNIFORM) \
+	X(Uniform3f, "l---", GL_CAPTURE_UNIFORM) \
+	X(Uniform4f, "l----", GL_CAPTURE_UNIFORM) \
+	X(Uniform1fv, "l-d", GL_CAPTURE_UNIFORM) \
+	X(UniformMatrix3fv, "l--d", GL_CAPTURE_UNIFORM) \
+	X(UniformMatrix4fv, "l--d", GL_CAPTURE_UNIFORM) \
+	X(BeginQuery, "-q", GL_CAPTURE_FRAME) \
+	X(EndQuery, "-", GL_CAPTURE_FRAME) \
+	X(QueryCounter, "q-", GL_CAPTURE_FRAME) \
+	X(GetQueryObjectiv, "q-o", GL_CAPTURE_FRAME) \
+	X(GetQueryObjectui64v, "q-o", GL_CAPTURE_FRAME) \
+	X(FenceSync, "-->y", GL_CAPTURE_FRAME) \
+	X(ClientWaitSync, "y--", GL_CAPTURE_FRAME) \
+	X(DeleteSync, "y", GL_CAPTURE_FRAME) \
+	X(Finish, "", GL_CAPTURE_FRAME)
+
+	//How a command is recorded
+	enum GlCaptureFlags {
+		GL_CAPTURE_FRAME = 0, //Only recorded in captured frames
+		GL_CAPTURE_STATE = 1, //Creates or sets up an object. Always recorded, so a capture can recreate everything it uses
+		GL_CAPTURE_BIND = 2, //Outside of captured frames only the latest binding before a STATE command is kept
+		GL_CAPTURE_UNIFORM = 4, //Outside of captured frames only the latest value of each uniform is kept
+		GL_CAPTURE_TIMED = 8, //Does GPU work. Timed individually on replay
+		GL_CAPTURE_NO_REPLAY = 16 //Recorded for reference, skipped on replay
+	};
+
+#define EW_GL_CAPTURE_ENUM(name, kinds, flags) name,
+	enum class GlCommand : uint16_t {
+		EW_GL_CAPTURE_COMMANDS(EW_GL_CAPTURE_ENUM)
+		//Written by the capture layer itself
+		SETUP_END, //Everything before it recreates the state at the start of the first captured frame
+		FRAME_END,
+		PROGRAM_BINARY, //Program linked on another thread: "p--d" (name, binary format, length, binary)
+		COUNT
+	};
+#undef EW_GL_CAPTURE_ENUM
+
+	struct GlCommandInfo {
+		const char* name;
+		const char* kinds;
+		int flags;
+	};
+	const GlCommandInfo& getGlCommandInfo(GlCommand command);
+
+	//Replaces glad's function pointers with recording wrappers. Every hooked call pays for this even while idle, so
+	//only install it when capturing is wanted. Call once, right after gladLoadGL, so objects created before a
+	//capture starts are recorded too. Only calls from this thread are recorded.
+	//Outside of captured frames only object setup is kept in memory: contents, uniforms and bindings are
+	//snapshotted when a capture starts
+	void installGlCapture();
+	//Records the next numFrames frames to filePath. width and height are the size of the default framebuffer
+	bool startGlCapture(const std::string& filePath, int numFrames, int width, int height);
+	//Call once per frame, before swapping buffers
+	void endGlCaptureFrame();
+	bool isGlCapturing();
+
+	struct GlReplayCall {
+		GlCommand command = GlCommand::Finish;
+		int frame = 0;
+		float cpuMicroseconds = 0.0f; //Time spent in the driver call
+		float gpuMicroseconds = -1.0f; //Timed commands only
+		uint64_t signature = 0; //Command, plain arguments and the sources of the current program. Same across captures
+	};
+	struct GlReplayResult {
+		int width = 0;
+		int height = 0;
+		int numFrames = 0;
+		std::vector<GlReplayCall> calls; //Captured frames only
+		std::vector<float> frameCpuMilliseconds;
+		std::vector<float> frameGpuMilliseconds;
+	};
+	//Reads the default framebuffer size and number of frames, so the replayer can create a matching context
+	bool readGlCaptureHeader(const std::string& filePath, int* width, int* height, int* numFrames);
+	//Re-executes a capture in the current context, timing every call of the captured frames
+	bool replayGlCapture(const std::string& filePath, GlReplayResult* result);
+	//Time per command type and the numTop most expensive calls
+	void printGlReplayReport(const GlReplayResult& result, int numTop = 20);
+	//Aligns the first frame's timed calls of two replays by signature and prints what was added, removed and changed
+	void printGlReplayDiff(const GlReplayResult& a, const GlReplayResult& b, int numTop = 20);
+}
@@ -0,0 +1,267 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "gpuResources.h"
+#include <imgui.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <algorithm>
+
+namespace ew {
+	static const int NUM_TYPES = (int)GpuResourceType::COUNT;
+	static const int MAX_WARNINGS = 8;
+
+	struct GpuResourceRegistry {
+		std::unordered_map<uint64_t, GpuResourceInfo> resources;
+		int counts[NUM_TYPES] = {};
+		size_t bytes[NUM_TYPES] = {};
+		size_t budgets[NUM_TYPES] = {};
+		bool overBudget[NUM_TYPES] = {};
+		unsigned long long nextSerial = 1;
+		unsigned long long markSerial = 0; //Objects with a larger serial were created after the mark
+		std::vector<std::string> warnings; //Most recent last
+		std::vector<GpuResourceInfo> leakCheck; //Result of the last leak check in the window
+		bool leakChecked = false;
+	};
+
+	//Never destroyed, so owners with static storage can still unregister while the process exits
+	static GpuResourceRegistry& registry() {
+		static GpuResourceRegistry* s_registry = new GpuResourceRegistry();
+		return *s_registry;
+	}
+
+	static inline uint64_t resourceKey(GpuResourceType type, unsigned int handle) {
+		return ((uint64_t)type << 32) | handle;
+	}
+
+	static void checkBudget(GpuResourceType type) {
+		GpuResourceRegistry& r = registry();
+		int t = (int)type;
+		bool over = r.budgets[t] > 0 && r.bytes[t] > r.budgets[t];
+		//Warn when crossing the budget, not on every allocation past it
+		if (over && !r.overBudget[t]) {
+			char warning[256];
+			snprintf(warning, sizeof(warning), "%s memory %.2f MB is over the %.2f MB budget", getGpuResourceTypeName(type),
+				r.bytes[t] / (1024.0 * 1024.0), r.budgets[t] / (1024.0 * 1024.0));
+			printf("GPU budget warning: %s\n", warning);
+			r.warnings.push_back(warning);
+			if ((int)r.warnings.size() > MAX_WARNINGS) {
+				r.warnings.erase(r.warnings.begin());
+			}
+		}
+		r.overBudget[t] = over;
+	}
+
+	const char* getGpuResourceTypeName(GpuResourceType type)
+	{
+		switch (type) {
+		case GpuResourceType::BUFFER:
+			return "Buffers";
+		case GpuResourceType::TEXTURE:
+			return "Textures";
+		case GpuResourceType::PROGRAM:
+			return "Programs";
+		case GpuResourceType::VERTEX_ARRAY:
+			return "Vertex arrays";
+		case GpuResourceType::FRAMEBUFFER:
+			return "Framebuffers";
+		default:
+			return "Unknown";
+		}
+	}
+
+	void trackGpuResource(GpuResourceType type, unsigned int handle, size_t bytes, const std::string& label)
+	{
+		if (handle == 0) {
+			return;
+		}
+		GpuResourceRegistry& r = registry();
+		int t = (int)type;
+		GpuResourceInfo& info = r.resources[resourceKey(type, handle)];
+		if (info.serial != 0) {
+			//GL reused the name of an object that was deleted without being untracked
+			printf("GPU resource %s %u tracked twice (%s, previously %s)\n", getGpuResourceTypeName(type), handle, label.c_str(), info.label.c_str());
+			r.bytes[t] -= info.bytes;
+			r.counts[t]--;
+		}
+		info.type = type;
+		info.handle = handle;
+		info.bytes = bytes;
+		info.label = label;
+		info.serial = r.nextSerial++;
+		r.bytes[t] += bytes;
+		r.counts[t]++;
+		checkBudget(type);
+	}
+
+	void resizeGpuResource(GpuResourceType type, unsigned int handle, size_t bytes)
+	{
+		GpuResourceRegistry& r = registry();
+		auto it = r.resources.find(resourceKey(type, handle));
+		if (it == r.resources.end()) {
+			return;
+		}
+		int t = (int)type;
+		r.bytes[t] = r.bytes[t] - it->second.bytes + bytes;
+		it->second.bytes = bytes;
+		checkBudget(type);
+	}
+
+	void untrackGpuResource(GpuResourceType type, unsigned int handle)
+	{
+		GpuResourceRegistry& r = registry();
+		auto it = r.resources.find(resourceKey(type, handle));
+		if (it == r.resources.end()) {
+			return;
+		}
+		int t = (int)type;
+		r.bytes[t] -= it->second.bytes;
+		r.counts[t]--;
+		r.resources.erase(it);
+		checkBudget(type);
+	}
+
+	int getGpuResourceCount(GpuResourceType type)
+	{
+		return registry().counts[(int)type];
+	}
+
+	size_t getGpuResourceBytes(GpuResourceType type)
+	{
+		return registry().bytes[(int)type];
+	}
+
+	size_t getTotalGpuResourceBytes()
+	{
+		size_t total = 0;
+		for (int i = 0; i < NUM_TYPES; i++)
+		{
+			total += registry().bytes[i];
+		}
+		return total;
+	}
+
+	void setGpuResourceBudget(GpuResourceType type, size_t bytes)
+	{
+		registry().budgets[(int)type] = bytes;
+		checkBudget(type);
+	}
+
+	size_t getGpuResourceBudget(GpuResourceType type)
+	{
+		return registry().budgets[(int)type];
+	}
+
+	bool isOverGpuResourceBudget(GpuResourceType type)
+	{
+		return registry().overBudget[(int)type];
+	}
+
+	std::vector<GpuResourceInfo> getLiveGpuResources()
+	{
+		std::vector<GpuResourceInfo> resources;
+		resources.reserve(registry().resources.size());
+		for (const auto& it : registry().resources) {
+			resources.push_back(it.second);
+		}
+		std::sort(resources.begin(), resources.end(), [](const GpuResourceInfo& a, const GpuResourceInfo& b) {
+			return a.serial < b.serial;
+		});
+		return resources;
+	}
+
+	void markGpuResources()
+	{
+		registry().markSerial = registry().nextSerial - 1;
+	}
+
+	static std::vector<GpuResourceInfo> getResourcesSinceMark() {
+		std::vector<GpuResourceInfo> resources = getLiveGpuResources();
+		unsigned long long mark = registry().markSerial;
+		resources.erase(std::remove_if(resources.begin(), resources.end(), [mark](const GpuResourceInfo& info) {
+			return info.serial <= mark;
+		}), resources.end());
+		return resources;
+	}
+
+	int printGpuLeakReport(bool sinceMark)
+	{
+		std::vector<GpuResourceInfo> resources = sinceMark ? getResourcesSinceMark() : getLiveGpuResources();
+		size_t totalBytes = 0;
+		for (const GpuResourceInfo& info : resources) {
+			totalBytes += info.bytes;
+		}
+		printf("\nGPU leak report: %d live objects%s, %.2f MB\n", (int)resources.size(), sinceMark ? " created since mark" : "", totalBytes / (1024.0 * 1024.0));
+		for (const GpuResourceInfo& info : resources) {
+			printf("  %-13s %6u %10.1f KB  %s\n", getGpuResourceTypeName(info.type), info.handle, info.bytes / 1024.0, info.label.c_str());
+		}
+		return (int)resources.size();
+	}
+
+	GpuLeakReport::~GpuLeakReport()
+	{
+		printGpuLeakReport(false);
+	}
+
+	void drawGpuResourceWindow()
+	{
+		GpuResourceRegistry& r = registry();
+		ImGui::Begin("GPU Resources");
+		ImGui::Text("Total %.2f MB in %d objects", getTotalGpuResourceBytes() / (1024.0 * 1024.0), (int)r.resources.size());
+		if (ImGui::BeginTable("GpuResourceTable", 4)) {
+			ImGui::TableSetupColumn("Type");
+			ImGui::TableSetupColumn("Count");
+			ImGui::TableSetupColumn("MB");
+			ImGui::TableSetupColumn("Budget MB");
+			ImGui::TableHeadersRow();
+			for (int i = 0; i < NUM_TYPES; i++)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", getGpuResourceTypeName((GpuResourceType)i));
+				ImGui::TableNextColumn();
+				ImGui::Text("%d", r.counts[i]);
+				ImGui::TableNextColumn();
+				if (r.overBudget[i]) {
+					ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%.2f", r.bytes[i] / (1024.0 * 1024.0));
+				}
+				else {
+					ImGui::Text("%.2f", r.bytes[i] / (1024.0 * 1024.0));
+				}
+				ImGui::TableNextColumn();
+				int budgetMegabytes = (int)(r.budgets[i] / (1024 * 1024));
+				std::string id = std::string("##Budget") + std::to_string(i);
+				if (ImGui::InputInt(id.c_str(), &budgetMegabytes, 1, 16)) {
+					setGpuResourceBudget((GpuResourceType)i, (size_t)std::max(budgetMegabytes, 0) * 1024 * 1024);
+				}
+			}
+			ImGui::EndTable();
+		}
+		for (const std::string& warning : r.warnings) {
+			ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "%s", warning.c_str());
+		}
+
+		//Leak check: mark, do something that should free what it allocates (e.g. reload assets), then check
+		ImGui::Separator();
+		if (ImGui::Button("Mark")) {
+			markGpuResources();
+			r.leakChecked = false;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Check Leaks")) {
+			r.leakCheck = getResourcesSinceMark();
+			r.leakChecked = true;
+			printGpuLeakReport(true);
+		}
+		if (r.leakChecked) {
+			ImGui::Text("%d objects created since mark are alive", (int)r.leakCheck.size());
+			for (const GpuResourceInfo& info : r.leakCheck) {
+				ImGui::BulletText("%s %u, %.1f KB: %s", getGpuResourceTypeName(info.type), info.handle, info.bytes / 1024.0, info.label.c_str());
+			}
+		}
+		ImGui::End();
+	}
+}
@@ -0,0 +1,63 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+namespace ew {
+	enum class GpuResourceType {
+		BUFFER = 0,
+		TEXTURE = 1,
+		PROGRAM = 2,
+		VERTEX_ARRAY = 3,
+		FRAMEBUFFER = 4,
+		COUNT
+	};
+	const char* getGpuResourceTypeName(GpuResourceType type);
+
+	struct GpuResourceInfo {
+		GpuResourceType type = GpuResourceType::BUFFER;
+		unsigned int handle = 0;
+		size_t bytes = 0; //Estimated from sizes and formats, drivers may pad
+		std::string label;
+		unsigned long long serial = 0; //Order of creation
+	};
+
+	//Central accounting of live GL objects. Owners register objects when they create them and unregister them
+	//when they delete them, so anything still registered at shutdown was leaked.
+	//Budgets are per type; crossing one prints a warning and shows up in drawGpuResourceWindow().
+	//Call from the GL thread only
+	void trackGpuResource(GpuResourceType type, unsigned int handle, size_t bytes, const std::string& label);
+	//Updates the size of an already tracked object, e.g. after reallocating a buffer's storage
+	void resizeGpuResource(GpuResourceType type, unsigned int handle, size_t bytes);
+	void untrackGpuResource(GpuResourceType type, unsigned int handle);
+
+	int getGpuResourceCount(GpuResourceType type);
+	size_t getGpuResourceBytes(GpuResourceType type);
+	size_t getTotalGpuResourceBytes();
+	//0 = no budget
+	void setGpuResourceBudget(GpuResourceType type, size_t bytes);
+	size_t getGpuResourceBudget(GpuResourceType type);
+	bool isOverGpuResourceBudget(GpuResourceType type);
+	//Live objects, oldest first
+	std::vector<GpuResourceInfo> getLiveGpuResources();
+
+	//Remembers which objects are alive now. Objects created after the mark and still alive are reported by
+	//printGpuLeakReport(true), which is how leaks from reloading assets show up
+	void markGpuResources();
+	//Prints live objects, or only those created since the last mark. Returns the number printed
+	int printGpuLeakReport(bool sinceMark = false);
+	//Prints every object still alive when it is destroyed. Make it the first global of the program's file:
+	//globals are destroyed in reverse order, so every other global has released its objects by the time it reports
+	class GpuLeakReport {
+	public:
+		GpuLeakReport() {};
+		~GpuLeakReport();
+	};
+
+	//ImGui window with per type counts, bytes and budgets, and a leak check against the last mark
+	void drawGpuResourceWindow();
+}
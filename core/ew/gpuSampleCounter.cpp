@@ -0,0 +1,42 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "gpuSampleCounter.h"
+#include "external/glad.h"
+
+namespace ew {
+	void GpuSampleCounter::begin()
+	{
+		if (!m_initialized) {
+			glGenQueries(NUM_FRAMES, m_queries);
+			m_initialized = true;
+		}
+		//Slot is about to be reused, so read back whatever it counted NUM_FRAMES ago
+		if (m_issued[m_current]) {
+			resolve(m_current);
+		}
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_current]);
+	}
+	void GpuSampleCounter::end()
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		m_issued[m_current] = true;
+		m_current = (m_current + 1) % NUM_FRAMES;
+	}
+	void GpuSampleCounter::resolve(int index)
+	{
+		m_issued[index] = false;
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		//Still in flight after several frames - drop it rather than block
+		if (!available) {
+			return;
+		}
+		GLuint64 samples;
+		glGetQueryObjectui64v(m_queries[index], GL_QUERY_RESULT, &samples);
+		m_samples = samples;
+		m_averageSamples = m_numResults == 0 ? (float)samples : m_averageSamples * 0.9f + samples * 0.1f;
+		m_numResults++;
+	}
+}
@@ -0,0 +1,34 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <stdint.h>
+
+namespace ew {
+	//Counts samples that pass the depth and stencil tests between begin() and end() using GL_SAMPLES_PASSED queries.
+	//With early depth testing this is the number of fragments shaded.
+	//Like GpuTimer, a ring of queries is kept so reading back a result never stalls the pipeline.
+	//Only one counter can be active at a time
+	class GpuSampleCounter {
+	public:
+		GpuSampleCounter() {};
+		void begin();
+		void end();
+		//Most recently resolved count
+		inline uint64_t getSamples()const { return m_samples; }
+		//Exponential moving average of resolved counts
+		inline float getAverageSamples()const { return m_averageSamples; }
+		inline unsigned int getNumResults()const { return m_numResults; }
+	private:
+		static const int NUM_FRAMES = 4; //Frames of latency before a result is read back
+		bool m_initialized = false;
+		unsigned int m_queries[NUM_FRAMES] = {};
+		bool m_issued[NUM_FRAMES] = {};
+		int m_current = 0;
+		uint64_t m_samples = 0;
+		float m_averageSamples = 0.0f;
+		unsigned int m_numResults = 0;
+		void resolve(int index);
+	};
+}
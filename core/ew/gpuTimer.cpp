@@ -0,0 +1,78 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "gpuTimer.h"
+#include "external/glad.h"
+#include <string.h>
+#include <utility>
+
+namespace ew {
+	GpuTimer::~GpuTimer()
+	{
+		release();
+	}
+	GpuTimer::GpuTimer(GpuTimer&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+	GpuTimer& GpuTimer::operator=(GpuTimer&& other) noexcept
+	{
+		if (this != &other) {
+			release();
+			m_initialized = other.m_initialized;
+			memcpy(m_queries, other.m_queries, sizeof(m_queries));
+			memcpy(m_issued, other.m_issued, sizeof(m_issued));
+			m_current = other.m_current;
+			m_milliseconds = other.m_milliseconds;
+			m_averageMilliseconds = other.m_averageMilliseconds;
+			m_numSamples = other.m_numSamples;
+			other.m_initialized = false;
+			memset(other.m_issued, 0, sizeof(other.m_issued));
+		}
+		return *this;
+	}
+	void GpuTimer::release()
+	{
+		if (m_initialized) {
+			glDeleteQueries(NUM_FRAMES * 2, &m_queries[0][0]);
+			m_initialized = false;
+		}
+		memset(m_queries, 0, sizeof(m_queries));
+		memset(m_issued, 0, sizeof(m_issued));
+	}
+	void GpuTimer::begin()
+	{
+		if (!m_initialized) {
+			glGenQueries(NUM_FRAMES * 2, &m_queries[0][0]);
+			m_initialized = true;
+		}
+		//Slot is about to be reused, so read back whatever it measured NUM_FRAMES ago
+		if (m_issued[m_current]) {
+			resolve(m_current);
+		}
+		glQueryCounter(m_queries[m_current][0], GL_TIMESTAMP);
+	}
+	void GpuTimer::end()
+	{
+		glQueryCounter(m_queries[m_current][1], GL_TIMESTAMP);
+		m_issued[m_current] = true;
+		m_current = (m_current + 1) % NUM_FRAMES;
+	}
+	void GpuTimer::resolve(int index)
+	{
+		m_issued[index] = false;
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[index][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		//Still in flight after several frames - drop it rather than block
+		if (!available) {
+			return;
+		}
+		GLuint64 start, stop;
+		glGetQueryObjectui64v(m_queries[index][0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(m_queries[index][1], GL_QUERY_RESULT, &stop);
+		m_milliseconds = (float)((stop - start) / 1000000.0);
+		m_averageMilliseconds = m_numSamples == 0 ? m_milliseconds : m_averageMilliseconds * 0.9f + m_milliseconds * 0.1f;
+		m_numSamples++;
+	}
+}
@@ -0,0 +1,40 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+
+namespace ew {
+	//Measures GPU time between begin() and end() using timestamp queries.
+	//A ring of query pairs is kept so that reading back a result never stalls the pipeline.
+	//Timestamps (rather than GL_TIME_ELAPSED) are used so timers may be nested or overlapped.
+	class GpuTimer {
+	public:
+		GpuTimer() {};
+		~GpuTimer();
+		//Move-only, since the timer owns its queries
+		GpuTimer(GpuTimer&& other) noexcept;
+		GpuTimer& operator=(GpuTimer&& other) noexcept;
+		GpuTimer(const GpuTimer&) = delete;
+		GpuTimer& operator=(const GpuTimer&) = delete;
+		void begin();
+		void end();
+		//Most recently resolved GPU time, in milliseconds
+		inline float getMilliseconds()const { return m_milliseconds; }
+		//Exponential moving average of resolved GPU times, in milliseconds
+		inline float getAverageMilliseconds()const { return m_averageMilliseconds; }
+		//Number of results resolved so far
+		inline unsigned int getNumSamples()const { return m_numSamples; }
+	private:
+		static const int NUM_FRAMES = 4; //Frames of latency before a result is read back
+		bool m_initialized = false;
+		unsigned int m_queries[NUM_FRAMES][2] = {};
+		bool m_issued[NUM_FRAMES] = {};
+		int m_current = 0;
+		float m_milliseconds = 0.0f;
+		float m_averageMilliseconds = 0.0f;
+		unsigned int m_numSamples = 0;
+		void resolve(int index);
+		void release();
+	};
+}
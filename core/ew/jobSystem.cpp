@@ -0,0 +1,414 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "jobSystem.h"
+#include "procGen.h"
+#include "model.h"
+#include <assimp/scene.h>
+#include <stdio.h>
+#include <chrono>
+#include <algorithm>
+
+namespace ew {
+	bool WorkStealingQueue::push(Job* job)
+	{
+		long long b = m_bottom.load(std::memory_order_relaxed);
+		long long t = m_top.load(std::memory_order_acquire);
+		if (b - t >= CAPACITY) {
+			return false;
+		}
+		m_jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+		//Publishes the job to thieves, who read bottom with acquire
+		m_bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	Job* WorkStealingQueue::pop()
+	{
+		long long b = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = m_top.load(std::memory_order_relaxed);
+		if (t > b) {
+			//Empty
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		Job* job = m_jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (t == b) {
+			//Last job, race thieves for it
+			if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				job = nullptr;
+			}
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* WorkStealingQueue::steal()
+	{
+		long long t = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = m_bottom.load(std::memory_order_acquire);
+		if (t >= b) {
+			return nullptr;
+		}
+		Job* job = m_jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			//Lost to the owner or another thief
+			return nullptr;
+		}
+		return job;
+	}
+
+	//Identifies worker threads. Several job systems can exist, so the index is only valid for t_jobSystem
+	static thread_local JobSystem* t_jobSystem = nullptr;
+	static thread_local int t_workerIndex = -1;
+	static thread_local Job* t_currentJob = nullptr;
+
+	static inline unsigned int nextRandom(unsigned int* state) {
+		//xorshift32
+		unsigned int x = *state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		*state = x;
+		return x;
+	}
+
+	JobSystem::JobSystem(int numThreads)
+	{
+		if (numThreads <= 0) {
+			numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+		}
+		m_mainThreadId = std::this_thread::get_id();
+		for (int i = 0; i < numThreads; i++)
+		{
+			m_queues.push_back(new WorkStealingQueue());
+		}
+		for (int i = 1; i < numThreads; i++)
+		{
+			m_threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		m_running = false;
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_wake.notify_all();
+		}
+		for (std::thread& thread : m_threads) {
+			thread.join();
+		}
+		for (WorkStealingQueue* queue : m_queues) {
+			delete queue;
+		}
+	}
+
+	Job* JobSystem::create(const JobFunc& func, Job* parent)
+	{
+		Job* job = new Job();
+		job->func = func;
+		job->parent = parent;
+		if (parent != nullptr) {
+			parent->unfinished.fetch_add(1);
+		}
+		return job;
+	}
+
+	void JobSystem::run(Job* job)
+	{
+		int worker = workerIndex();
+		if (worker < 0) {
+			std::lock_guard<std::mutex> lock(m_externalMutex);
+			m_externalJobs.push_back(job);
+		}
+		else if (!m_queues[worker]->push(job)) {
+			//Deque is full, nobody is short of work
+			executeJob(job);
+			return;
+		}
+		wakeWorker();
+	}
+
+	void JobSystem::runOnMainThread(Job* job)
+	{
+		std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+		m_mainThreadJobs.push_back(job);
+	}
+
+	void JobSystem::wait(Job* job)
+	{
+		if (job->parent != nullptr) {
+			printf("JobSystem::wait: can't wait on a child job\n");
+			return;
+		}
+		int worker = workerIndex();
+		unsigned int random = 0x9E3779B9u ^ (unsigned int)(worker + 1);
+		while (job->unfinished.load(std::memory_order_acquire) > 0) {
+			//Help out instead of blocking. External threads can't take jobs, they only wait
+			Job* next = worker >= 0 ? findJob(worker, &random) : nullptr;
+			if (next != nullptr) {
+				executeJob(next);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+		delete job;
+	}
+
+	void JobSystem::execute(const JobFunc& func)
+	{
+		Job* job = create(func);
+		run(job);
+		wait(job);
+	}
+
+	void JobSystem::parallelFor(size_t count, const RangeFunc& func, size_t minGrain)
+	{
+		if (count == 0) {
+			return;
+		}
+		minGrain = std::max(minGrain, (size_t)1);
+		if (getNumThreads() == 1 || count <= minGrain) {
+			func(0, count);
+			return;
+		}
+		execute([&]() { runRange(&func, 0, count, minGrain); });
+	}
+
+	void JobSystem::runRange(const RangeFunc* func, size_t begin, size_t end, size_t minGrain)
+	{
+		int worker = workerIndex();
+		while (end - begin > minGrain) {
+			if (m_queues[worker]->empty()) {
+				//Nothing left for thieves to take, so offer them half of the range
+				size_t mid = begin + (end - begin) / 2;
+				Job* child = create([=]() { runRange(func, mid, end, minGrain); }, getCurrentJob());
+				run(child);
+				end = mid;
+			}
+			else {
+				(*func)(begin, begin + minGrain);
+				begin += minGrain;
+			}
+		}
+		(*func)(begin, end);
+	}
+
+	void JobSystem::runMainThreadJobs()
+	{
+		if (!isMainThread()) {
+			printf("JobSystem::runMainThreadJobs: must be called from the main thread\n");
+			return;
+		}
+		while (Job* job = popMainThreadJob()) {
+			executeJob(job);
+		}
+	}
+
+	Job* JobSystem::getCurrentJob()
+	{
+		return t_currentJob;
+	}
+
+	bool JobSystem::isMainThread() const
+	{
+		return std::this_thread::get_id() == m_mainThreadId;
+	}
+
+	int JobSystem::workerIndex() const
+	{
+		if (t_jobSystem == this) {
+			return t_workerIndex;
+		}
+		return isMainThread() ? 0 : -1;
+	}
+
+	void JobSystem::workerLoop(int worker)
+	{
+		t_jobSystem = this;
+		t_workerIndex = worker;
+		unsigned int random = 0x9E3779B9u ^ (unsigned int)(worker * 7919 + 1);
+		int idle = 0;
+		while (m_running.load(std::memory_order_relaxed)) {
+			Job* job = findJob(worker, &random);
+			if (job != nullptr) {
+				executeJob(job);
+				idle = 0;
+				continue;
+			}
+			//Spin briefly since new work usually arrives in bursts, then sleep. The timeout covers wakeups
+			//that race with going to sleep
+			if (++idle < 64) {
+				std::this_thread::yield();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_numSleeping++;
+			m_wake.wait_for(lock, std::chrono::milliseconds(1));
+			m_numSleeping--;
+		}
+		t_jobSystem = nullptr;
+		t_workerIndex = -1;
+	}
+
+	Job* JobSystem::findJob(int worker, unsigned int* random)
+	{
+		Job* job = m_queues[worker]->pop();
+		if (job != nullptr) {
+			return job;
+		}
+		if (worker == 0 && isMainThread()) {
+			job = popMainThreadJob();
+			if (job != nullptr) {
+				return job;
+			}
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_externalMutex, std::try_to_lock);
+			if (lock.owns_lock() && !m_externalJobs.empty()) {
+				job = m_externalJobs.front();
+				m_externalJobs.pop_front();
+				return job;
+			}
+		}
+		//Steal, starting from a random victim
+		int numQueues = (int)m_queues.size();
+		int start = (int)(nextRandom(random) % numQueues);
+		for (int i = 0; i < numQueues; i++)
+		{
+			int victim = (start + i) % numQueues;
+			if (victim == worker) {
+				continue;
+			}
+			job = m_queues[victim]->steal();
+			if (job != nullptr) {
+				m_numSteals.fetch_add(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	Job* JobSystem::popMainThreadJob()
+	{
+		std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+		if (m_mainThreadJobs.empty()) {
+			return nullptr;
+		}
+		Job* job = m_mainThreadJobs.front();
+		m_mainThreadJobs.pop_front();
+		return job;
+	}
+
+	void JobSystem::executeJob(Job* job)
+	{
+		Job* previous = t_currentJob;
+		t_currentJob = job;
+		if (job->func) {
+			job->func();
+		}
+		t_currentJob = previous;
+		finish(job);
+	}
+
+	void JobSystem::finish(Job* job)
+	{
+		//Read before the decrement, a root job may be freed by wait() as soon as it reaches 0
+		Job* parent = job->parent;
+		if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+			return;
+		}
+		if (parent != nullptr) {
+			//Nobody holds on to children, root jobs are freed by wait()
+			delete job;
+			finish(parent);
+		}
+	}
+
+	void JobSystem::wakeWorker()
+	{
+		if (m_numSleeping.load(std::memory_order_relaxed) > 0) {
+			m_wake.notify_one();
+		}
+	}
+
+	void parallelFor(JobSystem* jobs, size_t count, const JobSystem::RangeFunc& func, size_t minGrain)
+	{
+		if (jobs == nullptr) {
+			if (count > 0) {
+				func(0, count);
+			}
+			return;
+		}
+		jobs->parallelFor(count, func, minGrain);
+	}
+
+	/// <summary>
+	/// Copies meshData into an aiMesh the way an importer fills one, so processAiMesh can be timed on any size of mesh
+	/// </summary>
+	static void createAiMesh(const MeshData& meshData, aiMesh* aiMesh) {
+		aiMesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+		aiMesh->mNumVertices = (unsigned int)meshData.vertices.size();
+		aiMesh->mVertices = new aiVector3D[aiMesh->mNumVertices];
+		aiMesh->mNormals = new aiVector3D[aiMesh->mNumVertices];
+		aiMesh->mTextureCoords[0] = new aiVector3D[aiMesh->mNumVertices];
+		aiMesh->mNumUVComponents[0] = 2;
+		for (unsigned int i = 0; i < aiMesh->mNumVertices; i++)
+		{
+			const Vertex& v = meshData.vertices[i];
+			aiMesh->mVertices[i] = aiVector3D(v.pos.x, v.pos.y, v.pos.z);
+			aiMesh->mNormals[i] = aiVector3D(v.normal.x, v.normal.y, v.normal.z);
+			aiMesh->mTextureCoords[0][i] = aiVector3D(v.uv.x, v.uv.y, 0.0f);
+		}
+		aiMesh->mNumFaces = (unsigned int)(meshData.indices.size() / 3);
+		aiMesh->mFaces = new aiFace[aiMesh->mNumFaces];
+		for (unsigned int i = 0; i < aiMesh->mNumFaces; i++)
+		{
+			aiFace& face = aiMesh->mFaces[i];
+			face.mNumIndices = 3;
+			face.mIndices = new unsigned int[3];
+			for (int j = 0; j < 3; j++)
+			{
+				face.mIndices[j] = meshData.indices[i * 3 + j];
+			}
+		}
+	}
+
+	JobBenchmarkResult benchmarkJobSystem(int numThreads, int sphereSubdivisions, int aiMeshSubdivisions, int iterations)
+	{
+		iterations = std::max(iterations, 1);
+		JobBenchmarkResult result;
+		JobSystem jobs(numThreads);
+		result.numThreads = jobs.getNumThreads();
+
+		//Warm up so thread startup isn't timed
+		createSphere(1.0f, 8, &jobs);
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			createSphere(1.0f, sphereSubdivisions, &jobs);
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		result.sphereMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count() / iterations;
+
+		aiMesh aiMesh;
+		createAiMesh(createSphere(1.0f, aiMeshSubdivisions, &jobs), &aiMesh);
+		result.aiMeshVertices = (int)aiMesh.mNumVertices;
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			processAiMesh(&aiMesh, &jobs);
+		}
+		endTime = std::chrono::high_resolution_clock::now();
+		result.aiMeshMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count() / iterations;
+		result.numSteals = jobs.getNumSteals();
+		return result;
+	}
+}
@@ -0,0 +1,117 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+namespace ew {
+	struct Job {
+		std::function<void()> func;
+		Job* parent = nullptr;
+		std::atomic<int> unfinished{ 1 }; //This job plus its unfinished children
+	};
+
+	//Chase-Lev work stealing deque. The owning worker pushes and pops at the bottom,
+	//other workers steal from the top. Fixed capacity; push fails when full
+	class WorkStealingQueue {
+	public:
+		static const int CAPACITY = 4096; //Power of 2
+		bool push(Job* job);
+		Job* pop();
+		Job* steal();
+		inline bool empty()const { return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed); }
+	private:
+		alignas(64) std::atomic<long long> m_top{ 0 };
+		alignas(64) std::atomic<long long> m_bottom{ 0 };
+		std::atomic<Job*> m_jobs[CAPACITY];
+	};
+
+	//Work stealing job scheduler. Each worker, including the main thread, has its own deque. Idle workers
+	//steal from random victims. A job isn't finished until all the children created under it have finished,
+	//which is how dependencies are expressed: wait on a parent to wait for a whole tree of jobs.
+	//Jobs that need the GL context can be pinned to the main thread, which runs them while waiting or
+	//in runMainThreadJobs().
+	//The thread that constructs the JobSystem is the main thread
+	class JobSystem {
+	public:
+		typedef std::function<void()> JobFunc;
+		typedef std::function<void(size_t begin, size_t end)> RangeFunc;
+
+		//numThreads includes the main thread. 0 = use hardware concurrency
+		JobSystem(int numThreads = 0);
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		//The new job is a child of parent, if any. Children must be created before their parent finishes,
+		//typically from inside the parent's function (see getCurrentJob())
+		Job* create(const JobFunc& func, Job* parent = nullptr);
+		void run(Job* job);
+		//Job will only be executed by the main thread
+		void runOnMainThread(Job* job);
+		//Executes other jobs until job and all of its children have finished, then frees it.
+		//Only jobs without a parent may be waited on; children are freed when they finish
+		void wait(Job* job);
+		//Shorthand for create + run + wait
+		void execute(const JobFunc& func);
+		//Calls func over [0, count) in ranges of at least minGrain items. Ranges are split lazily:
+		//a worker only splits off half of its remaining range while its own deque is empty, so splitting
+		//stops as soon as every worker has work to steal and the grain adapts to the load
+		void parallelFor(size_t count, const RangeFunc& func, size_t minGrain = 1);
+		//Main thread only. Runs jobs pinned to the main thread, e.g. once per frame
+		void runMainThreadJobs();
+
+		inline int getNumThreads()const { return (int)m_queues.size(); }
+		//Job being executed on the calling thread, or null
+		static Job* getCurrentJob();
+		bool isMainThread()const;
+		//Jobs taken from another worker's deque since construction
+		inline long long getNumSteals()const { return m_numSteals.load(); }
+	private:
+		std::vector<std::thread> m_threads;
+		std::vector<WorkStealingQueue*> m_queues; //Index 0 belongs to the main thread
+		std::thread::id m_mainThreadId;
+		//Jobs run from threads that aren't workers
+		std::mutex m_externalMutex;
+		std::deque<Job*> m_externalJobs;
+		std::mutex m_mainThreadMutex;
+		std::deque<Job*> m_mainThreadJobs;
+		std::atomic<bool> m_running{ true };
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wake;
+		std::atomic<int> m_numSleeping{ 0 };
+		std::atomic<long long> m_numSteals{ 0 };
+
+		int workerIndex()const;
+		void workerLoop(int worker);
+		Job* findJob(int worker, unsigned int* random);
+		Job* popMainThreadJob();
+		void executeJob(Job* job);
+		void finish(Job* job);
+		void wakeWorker();
+		void runRange(const RangeFunc* func, size_t begin, size_t end, size_t minGrain);
+	};
+
+	//Runs func over [0, count) with jobs, or in a single call on this thread when jobs is null
+	void parallelFor(JobSystem* jobs, size_t count, const JobSystem::RangeFunc& func, size_t minGrain = 1);
+
+	struct JobBenchmarkResult {
+		int numThreads = 0;
+		float sphereMilliseconds = 0.0f; //createSphere
+		float aiMeshMilliseconds = 0.0f; //processAiMesh on a generated sphere
+		int aiMeshVertices = 0;
+		long long numSteals = 0;
+	};
+
+	//Times createSphere at sphereSubdivisions, and processAiMesh on an Assimp copy of a sphere of aiMeshSubdivisions,
+	//with numThreads threads. Both are generated, so the work is heavy enough to scale and needs no assets.
+	//Timings are averages over iterations
+	JobBenchmarkResult benchmarkJobSystem(int numThreads, int sphereSubdivisions, int aiMeshSubdivisions, int iterations = 10);
+}
@@ -0,0 +1,544 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "lightProbes.h"
+#include "jobSystem.h"
+#include "gpuResources.h"
+#include "assetArchive.h"
+#include "external/glad.h"
+#include "external/stb_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define EW_PROBES_SSE
+#endif
+
+namespace ew {
+	static const float PI = 3.14159265f;
+	//Basis normalization constants
+	static const float SH_K[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+	//Clamped cosine convolution per band (Ramamoorthi and Hanrahan, "An Efficient Representation for
+	//Irradiance Environment Maps"), divided by pi
+	static const float SH_BAND_SCALE[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	//Rows of the map are split into this many blocks per probe, so a single probe still spreads over threads
+	static const int ROW_BLOCKS = 16;
+
+	//Uniform block layout, in vec4s. Matches LightProbes in lightProbes.glsl
+	static const int UNIFORM_HEADER = 3; //Grid min, inverse spacing, counts
+	static const int UNIFORM_OBJECTS = UNIFORM_HEADER;
+	static const int UNIFORM_PROBES = UNIFORM_OBJECTS + LightProbeGrid::MAX_OBJECTS * 9;
+	static const int UNIFORM_SIZE = UNIFORM_PROBES + LightProbeGrid::MAX_PROBES * 9;
+
+	/// <summary>
+	/// Polynomial part of the basis functions
+	/// </summary>
+	static inline void shBasis(float x, float y, float z, float* b) {
+		b[0] = 1.0f;
+		b[1] = y;
+		b[2] = z;
+		b[3] = x;
+		b[4] = x * y;
+		b[5] = y * z;
+		b[6] = 3.0f * z * z - 1.0f;
+		b[7] = x * z;
+		b[8] = x * x - y * y;
+	}
+
+	glm::vec3 evaluateIrradiance(const SH9& sh, const glm::vec3& normal)
+	{
+		float b[9];
+		shBasis(normal.x, normal.y, normal.z, b);
+		glm::vec3 result = glm::vec3(0.0f);
+		for (int i = 0; i < 9; i++)
+		{
+			result += sh.coefficients[i] * b[i];
+		}
+		return result;
+	}
+
+	bool loadEnvironmentMap(const std::string& filePath, EnvironmentMap* map)
+	{
+		//Row 0 has to stay the top of the sky
+		stbi_set_flip_vertically_on_load(false);
+		int width, height, numComponents;
+		AssetData asset;
+		float* data = readMountedAsset(filePath, &asset) ? stbi_loadf_from_memory((const stbi_uc*)asset.data, (int)asset.size, &width, &height, &numComponents, 3)
+			: stbi_loadf(filePath.c_str(), &width, &height, &numComponents, 3);
+		if (data == NULL) {
+			printf("Failed to load environment map %s\n", filePath.c_str());
+			return false;
+		}
+		map->width = width;
+		map->height = height;
+		map->pixels.assign(data, data + (size_t)width * height * 3);
+		stbi_image_free(data);
+		return true;
+	}
+
+	/// <summary>
+	/// Unit direction through the center of texel (x, y) of an equirectangular map
+	/// </summary>
+	static glm::vec3 texelDirection(int x, int y, int width, int height) {
+		float theta = (y + 0.5f) / height * PI;
+		float phi = ((x + 0.5f) / width - 0.5f) * 2.0f * PI;
+		return glm::vec3(sinf(theta) * sinf(phi), cosf(theta), -sinf(theta) * cosf(phi));
+	}
+
+	EnvironmentMap createSkyEnvironmentMap(int width, const glm::vec3& sunDirection)
+	{
+		EnvironmentMap map;
+		map.width = std::max(width, 2);
+		map.height = map.width / 2;
+		map.pixels.resize((size_t)map.width * map.height * 3);
+		glm::vec3 sun = glm::normalize(sunDirection);
+		const glm::vec3 zenith = glm::vec3(0.15f, 0.25f, 0.5f);
+		const glm::vec3 horizon = glm::vec3(0.45f, 0.42f, 0.38f);
+		const glm::vec3 ground = glm::vec3(0.06f, 0.05f, 0.04f);
+		for (int y = 0; y < map.height; y++)
+		{
+			for (int x = 0; x < map.width; x++)
+			{
+				glm::vec3 dir = texelDirection(x, y, map.width, map.height);
+				glm::vec3 color = dir.y >= 0.0f ? glm::mix(horizon, zenith, sqrtf(dir.y)) : glm::mix(horizon * 0.3f, ground, sqrtf(-dir.y));
+				//Soft lobe rather than a disk, so the sun's energy doesn't depend on the map's resolution
+				color += glm::vec3(1.0f, 0.9f, 0.7f) * (20.0f * powf(std::max(glm::dot(dir, sun), 0.0f), 256.0f));
+				float* pixel = &map.pixels[((size_t)y * map.width + x) * 3];
+				pixel[0] = color.r;
+				pixel[1] = color.g;
+				pixel[2] = color.b;
+			}
+		}
+		return map;
+	}
+
+	EnvironmentMap resizeEnvironmentMap(const EnvironmentMap& map, int width)
+	{
+		EnvironmentMap result;
+		result.width = std::max(width, 2);
+		result.height = result.width / 2;
+		result.pixels.resize((size_t)result.width * result.height * 3);
+		for (int y = 0; y < result.height; y++)
+		{
+			int y0 = y * map.height / result.height;
+			int y1 = std::max((y + 1) * map.height / result.height, y0 + 1);
+			for (int x = 0; x < result.width; x++)
+			{
+				int x0 = x * map.width / result.width;
+				int x1 = std::max((x + 1) * map.width / result.width, x0 + 1);
+				float sum[3] = {};
+				for (int sy = y0; sy < y1; sy++)
+				{
+					for (int sx = x0; sx < x1; sx++)
+					{
+						const float* pixel = &map.pixels[((size_t)sy * map.width + sx) * 3];
+						sum[0] += pixel[0];
+						sum[1] += pixel[1];
+						sum[2] += pixel[2];
+					}
+				}
+				float scale = 1.0f / ((x1 - x0) * (y1 - y0));
+				float* pixel = &result.pixels[((size_t)y * result.width + x) * 3];
+				pixel[0] = sum[0] * scale;
+				pixel[1] = sum[1] * scale;
+				pixel[2] = sum[2] * scale;
+			}
+		}
+		return result;
+	}
+
+	//Everything about the map that doesn't depend on the probe, built once per bake
+	struct IntegrationTables {
+		int width = 0;
+		int height = 0;
+		std::vector<float> sinPhi; //Per column
+		std::vector<float> cosPhi;
+		std::vector<float> sinTheta; //Per row
+		std::vector<float> cosTheta;
+		std::vector<float> rowWeight; //Solid angle of each texel in the row
+		std::vector<float> planes[3]; //R, G and B, premultiplied by solid angle
+		glm::vec3 bounceRadiance = glm::vec3(0.0f); //Seen in directions blocked by an occluder, per steradian
+	};
+
+	static void buildTables(const EnvironmentMap& map, const glm::vec3& occluderAlbedo, IntegrationTables* tables) {
+		int width = map.width;
+		int height = map.height;
+		tables->width = width;
+		tables->height = height;
+		tables->sinPhi.resize(width);
+		tables->cosPhi.resize(width);
+		for (int x = 0; x < width; x++)
+		{
+			float phi = ((x + 0.5f) / width - 0.5f) * 2.0f * PI;
+			tables->sinPhi[x] = sinf(phi);
+			tables->cosPhi[x] = cosf(phi);
+		}
+		tables->sinTheta.resize(height);
+		tables->cosTheta.resize(height);
+		tables->rowWeight.resize(height);
+		for (int y = 0; y < height; y++)
+		{
+			float theta = (y + 0.5f) / height * PI;
+			tables->sinTheta[y] = sinf(theta);
+			tables->cosTheta[y] = cosf(theta);
+			tables->rowWeight[y] = (2.0f * PI / width) * (PI / height) * sinf(theta);
+		}
+		double total[3] = {};
+		for (int c = 0; c < 3; c++)
+		{
+			tables->planes[c].resize((size_t)width * height);
+		}
+		for (int y = 0; y < height; y++)
+		{
+			float weight = tables->rowWeight[y];
+			for (int x = 0; x < width; x++)
+			{
+				size_t i = (size_t)y * width + x;
+				for (int c = 0; c < 3; c++)
+				{
+					float value = map.pixels[i * 3 + c] * weight;
+					tables->planes[c][i] = value;
+					total[c] += value;
+				}
+			}
+		}
+		tables->bounceRadiance = occluderAlbedo * glm::vec3((float)total[0], (float)total[1], (float)total[2]) / (4.0f * PI);
+	}
+
+	//Occluder box relative to the probe
+	struct ProbeOccluder {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	/// <summary>
+	/// Slab test of the ray from the probe in direction 1 / invDir against a box relative to the probe
+	/// </summary>
+	static inline bool rayHitsBox(const glm::vec3& invDir, const ProbeOccluder& box) {
+		glm::vec3 t1 = box.min * invDir;
+		glm::vec3 t2 = box.max * invDir;
+		float tMin = std::max(std::max(std::min(t1.x, t2.x), std::min(t1.y, t2.y)), std::min(t1.z, t2.z));
+		float tMax = std::min(std::min(std::max(t1.x, t2.x), std::max(t1.y, t2.y)), std::max(t1.z, t2.z));
+		return tMax >= std::max(tMin, 0.0f);
+	}
+
+	/// <summary>
+	/// Adds texels [begin, end) of row y to sums (9 coefficients x RGB)
+	/// </summary>
+	static void integrateRowScalar(const IntegrationTables& t, int y, int begin, int end, const std::vector<ProbeOccluder>& occluders, double* sums) {
+		float rowSums[27] = {};
+		float sinTheta = t.sinTheta[y];
+		float dy = t.cosTheta[y];
+		glm::vec3 bounce = t.bounceRadiance * t.rowWeight[y];
+		size_t row = (size_t)y * t.width;
+		for (int x = begin; x < end; x++)
+		{
+			float dx = sinTheta * t.sinPhi[x];
+			float dz = -sinTheta * t.cosPhi[x];
+			float radiance[3] = { t.planes[0][row + x], t.planes[1][row + x], t.planes[2][row + x] };
+			if (!occluders.empty()) {
+				glm::vec3 invDir = 1.0f / glm::vec3(dx, dy, dz);
+				for (const ProbeOccluder& box : occluders) {
+					if (rayHitsBox(invDir, box)) {
+						radiance[0] = bounce.r;
+						radiance[1] = bounce.g;
+						radiance[2] = bounce.b;
+						break;
+					}
+				}
+			}
+			float b[9];
+			shBasis(dx, dy, dz, b);
+			for (int i = 0; i < 9; i++)
+			{
+				rowSums[i * 3 + 0] += b[i] * radiance[0];
+				rowSums[i * 3 + 1] += b[i] * radiance[1];
+				rowSums[i * 3 + 2] += b[i] * radiance[2];
+			}
+		}
+		//Rows are summed in float, the whole map in double
+		for (int i = 0; i < 27; i++)
+		{
+			sums[i] += rowSums[i];
+		}
+	}
+
+#ifdef EW_PROBES_SSE
+	static inline float horizontalSum(__m128 v) {
+		__m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sum = _mm_add_ps(v, shuffled);
+		shuffled = _mm_movehl_ps(shuffled, sum);
+		return _mm_cvtss_f32(_mm_add_ss(sum, shuffled));
+	}
+
+	/// <summary>
+	/// Same as integrateRowScalar, 4 texels at a time. The remainder of the row is integrated by the scalar path
+	/// </summary>
+	static void integrateRowSse(const IntegrationTables& t, int y, const std::vector<ProbeOccluder>& occluders, double* sums) {
+		__m128 acc[27];
+		for (int i = 0; i < 27; i++)
+		{
+			acc[i] = _mm_setzero_ps();
+		}
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 three = _mm_set1_ps(3.0f);
+		const __m128 sinTheta = _mm_set1_ps(t.sinTheta[y]);
+		const __m128 negSinTheta = _mm_set1_ps(-t.sinTheta[y]);
+		const __m128 dy = _mm_set1_ps(t.cosTheta[y]);
+		const __m128 invDy = _mm_div_ps(one, dy);
+		const float rowWeight = t.rowWeight[y];
+		const __m128 bounce[3] = { _mm_set1_ps(t.bounceRadiance.r * rowWeight), _mm_set1_ps(t.bounceRadiance.g * rowWeight), _mm_set1_ps(t.bounceRadiance.b * rowWeight) };
+		size_t row = (size_t)y * t.width;
+		int simdEnd = t.width & ~3;
+		for (int x = 0; x < simdEnd; x += 4)
+		{
+			__m128 dx = _mm_mul_ps(sinTheta, _mm_loadu_ps(&t.sinPhi[x]));
+			__m128 dz = _mm_mul_ps(negSinTheta, _mm_loadu_ps(&t.cosPhi[x]));
+			__m128 radiance[3] = { _mm_loadu_ps(&t.planes[0][row + x]), _mm_loadu_ps(&t.planes[1][row + x]), _mm_loadu_ps(&t.planes[2][row + x]) };
+			if (!occluders.empty()) {
+				__m128 invDx = _mm_div_ps(one, dx);
+				__m128 invDz = _mm_div_ps(one, dz);
+				__m128 hit = zero;
+				for (const ProbeOccluder& box : occluders) {
+					__m128 t1x = _mm_mul_ps(_mm_set1_ps(box.min.x), invDx);
+					__m128 t2x = _mm_mul_ps(_mm_set1_ps(box.max.x), invDx);
+					__m128 t1y = _mm_mul_ps(_mm_set1_ps(box.min.y), invDy);
+					__m128 t2y = _mm_mul_ps(_mm_set1_ps(box.max.y), invDy);
+					__m128 t1z = _mm_mul_ps(_mm_set1_ps(box.min.z), invDz);
+					__m128 t2z = _mm_mul_ps(_mm_set1_ps(box.max.z), invDz);
+					__m128 tMin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_min_ps(t1z, t2z));
+					__m128 tMax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_max_ps(t1z, t2z));
+					hit = _mm_or_ps(hit, _mm_cmpge_ps(tMax, _mm_max_ps(tMin, zero)));
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					radiance[c] = _mm_or_ps(_mm_and_ps(hit, bounce[c]), _mm_andnot_ps(hit, radiance[c]));
+				}
+			}
+			__m128 b[9];
+			b[0] = one;
+			b[1] = dy;
+			b[2] = dz;
+			b[3] = dx;
+			b[4] = _mm_mul_ps(dx, dy);
+			b[5] = _mm_mul_ps(dy, dz);
+			b[6] = _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dz, dz)), one);
+			b[7] = _mm_mul_ps(dx, dz);
+			b[8] = _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			for (int i = 0; i < 9; i++)
+			{
+				acc[i * 3 + 0] = _mm_add_ps(acc[i * 3 + 0], _mm_mul_ps(b[i], radiance[0]));
+				acc[i * 3 + 1] = _mm_add_ps(acc[i * 3 + 1], _mm_mul_ps(b[i], radiance[1]));
+				acc[i * 3 + 2] = _mm_add_ps(acc[i * 3 + 2], _mm_mul_ps(b[i], radiance[2]));
+			}
+		}
+		for (int i = 0; i < 27; i++)
+		{
+			sums[i] += horizontalSum(acc[i]);
+		}
+		if (simdEnd < t.width) {
+			integrateRowScalar(t, y, simdEnd, t.width, occluders, sums);
+		}
+	}
+#endif
+
+	static void integrateRows(const IntegrationTables& t, int rowBegin, int rowEnd, const std::vector<ProbeOccluder>& occluders, bool simd, double* sums) {
+		for (int y = rowBegin; y < rowEnd; y++)
+		{
+#ifdef EW_PROBES_SSE
+			if (simd) {
+				integrateRowSse(t, y, occluders, sums);
+				continue;
+			}
+#endif
+			integrateRowScalar(t, y, 0, t.width, occluders, sums);
+		}
+	}
+
+	LightProbeGrid::~LightProbeGrid()
+	{
+		if (m_buffer != 0) {
+			untrackGpuResource(GpuResourceType::BUFFER, m_buffer);
+			glDeleteBuffers(1, &m_buffer);
+		}
+	}
+
+	bool LightProbeGrid::bake(const EnvironmentMap& map, const ProbeGridSettings& settings, const std::vector<Bounds>& occluders, JobSystem* jobs, bool simd)
+	{
+		if (map.width <= 0 || map.height <= 0) {
+			printf("Light probes need a non-empty environment map\n");
+			return false;
+		}
+		glm::ivec3 count = glm::max(settings.count, glm::ivec3(1));
+		int numProbes = count.x * count.y * count.z;
+		if (numProbes > MAX_PROBES) {
+			printf("Light probe grid has %d probes, at most %d are supported\n", numProbes, MAX_PROBES);
+			return false;
+		}
+		auto startTime = std::chrono::high_resolution_clock::now();
+		m_settings = settings;
+		m_settings.count = count;
+		m_spacing = glm::vec3(1.0f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (count[axis] > 1) {
+				m_spacing[axis] = (settings.max[axis] - settings.min[axis]) / (count[axis] - 1);
+			}
+		}
+
+		IntegrationTables tables;
+		buildTables(map, settings.occluderAlbedo, &tables);
+
+		//Without occluders every probe sees the same thing
+		int numIntegrated = occluders.empty() ? 1 : numProbes;
+		std::vector<std::vector<ProbeOccluder>> probeOccluders(numIntegrated);
+		m_probes.assign(numProbes, SH9());
+		for (int probe = 0; probe < numIntegrated && !occluders.empty(); probe++)
+		{
+			glm::vec3 position = getProbePosition(probe);
+			for (const Bounds& bounds : occluders) {
+				//A probe inside an occluder would only see its inside
+				bool inside = glm::all(glm::greaterThan(position, bounds.min)) && glm::all(glm::lessThan(position, bounds.max));
+				if (!inside) {
+					probeOccluders[probe].push_back({ bounds.min - position, bounds.max - position });
+				}
+			}
+		}
+
+		int rowsPerBlock = (map.height + ROW_BLOCKS - 1) / ROW_BLOCKS;
+		int numBlocks = (map.height + rowsPerBlock - 1) / rowsPerBlock;
+		std::vector<double> partialSums((size_t)numIntegrated * numBlocks * 27, 0.0);
+		parallelFor(jobs, (size_t)numIntegrated * numBlocks, [&](size_t begin, size_t end) {
+			for (size_t task = begin; task < end; task++)
+			{
+				int probe = (int)(task / numBlocks);
+				int block = (int)(task % numBlocks);
+				int rowBegin = block * rowsPerBlock;
+				int rowEnd = std::min(rowBegin + rowsPerBlock, map.height);
+				integrateRows(tables, rowBegin, rowEnd, probeOccluders[probe], simd, &partialSums[task * 27]);
+			}
+		});
+
+		//Blocks are added in order, so results don't depend on the thread count
+		for (int probe = 0; probe < numIntegrated; probe++)
+		{
+			double sums[27] = {};
+			for (int block = 0; block < numBlocks; block++)
+			{
+				const double* partial = &partialSums[((size_t)probe * numBlocks + block) * 27];
+				for (int i = 0; i < 27; i++)
+				{
+					sums[i] += partial[i];
+				}
+			}
+			SH9& sh = m_probes[probe];
+			for (int i = 0; i < 9; i++)
+			{
+				//Once for projecting, once for evaluating
+				float scale = SH_K[i] * SH_K[i] * SH_BAND_SCALE[i];
+				sh.coefficients[i] = glm::vec3((float)sums[i * 3 + 0], (float)sums[i * 3 + 1], (float)sums[i * 3 + 2]) * scale;
+			}
+		}
+		for (int probe = numIntegrated; probe < numProbes; probe++)
+		{
+			m_probes[probe] = m_probes[0];
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		m_stats.numProbes = numProbes;
+		m_stats.mapWidth = map.width;
+		m_stats.mapHeight = map.height;
+		m_stats.numThreads = jobs != nullptr ? jobs->getNumThreads() : 1;
+#ifdef EW_PROBES_SSE
+		m_stats.simd = simd;
+#else
+		m_stats.simd = false;
+#endif
+		m_stats.bakeMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		upload();
+		return true;
+	}
+
+	SH9 LightProbeGrid::sample(const glm::vec3& position)const
+	{
+		SH9 result;
+		if (m_probes.empty()) {
+			return result;
+		}
+		const glm::ivec3& count = m_settings.count;
+		glm::vec3 grid = glm::clamp((position - m_settings.min) / m_spacing, glm::vec3(0.0f), glm::vec3(count - 1));
+		glm::ivec3 i0 = glm::ivec3(glm::floor(grid));
+		glm::ivec3 i1 = glm::min(i0 + 1, count - 1);
+		glm::vec3 f = grid - glm::vec3(i0);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::ivec3 i = glm::ivec3((corner & 1) ? i1.x : i0.x, (corner & 2) ? i1.y : i0.y, (corner & 4) ? i1.z : i0.z);
+			float weight = ((corner & 1) ? f.x : 1.0f - f.x) * ((corner & 2) ? f.y : 1.0f - f.y) * ((corner & 4) ? f.z : 1.0f - f.z);
+			const SH9& probe = m_probes[i.x + (i.y + i.z * count.y) * count.x];
+			for (int c = 0; c < 9; c++)
+			{
+				result.coefficients[c] += probe.coefficients[c] * weight;
+			}
+		}
+		return result;
+	}
+
+	void LightProbeGrid::setObject(int slot, const glm::vec3& position)
+	{
+		if (slot >= 0 && slot < MAX_OBJECTS) {
+			m_objects[slot] = sample(position);
+		}
+	}
+
+	void LightProbeGrid::upload()
+	{
+		if (m_buffer == 0) {
+			glCreateBuffers(1, &m_buffer);
+			glNamedBufferStorage(m_buffer, UNIFORM_SIZE * sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+			trackGpuResource(GpuResourceType::BUFFER, m_buffer, UNIFORM_SIZE * sizeof(glm::vec4), "Light probes");
+		}
+		std::vector<glm::vec4> data(UNIFORM_SIZE, glm::vec4(0.0f));
+		glm::vec3 invSpacing = glm::vec3(0.0f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (m_settings.count[axis] > 1) {
+				invSpacing[axis] = 1.0f / m_spacing[axis];
+			}
+		}
+		data[0] = glm::vec4(m_settings.min, 0.0f);
+		data[1] = glm::vec4(invSpacing, 0.0f);
+		glm::ivec4 count = glm::ivec4(m_settings.count, (int)m_probes.size());
+		memcpy(&data[2], &count, sizeof(count));
+		for (size_t probe = 0; probe < m_probes.size(); probe++)
+		{
+			for (int i = 0; i < 9; i++)
+			{
+				data[UNIFORM_PROBES + probe * 9 + i] = glm::vec4(m_probes[probe].coefficients[i], 0.0f);
+			}
+		}
+		glNamedBufferSubData(m_buffer, 0, data.size() * sizeof(glm::vec4), data.data());
+	}
+
+	void LightProbeGrid::bind()
+	{
+		if (m_buffer == 0) {
+			return;
+		}
+		glm::vec4 objects[MAX_OBJECTS * 9];
+		for (int slot = 0; slot < MAX_OBJECTS; slot++)
+		{
+			for (int i = 0; i < 9; i++)
+			{
+				objects[slot * 9 + i] = glm::vec4(m_objects[slot].coefficients[i], 0.0f);
+			}
+		}
+		glNamedBufferSubData(m_buffer, UNIFORM_OBJECTS * sizeof(glm::vec4), sizeof(objects), objects);
+		glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING, m_buffer);
+	}
+}
@@ -0,0 +1,95 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+namespace ew {
+	class JobSystem;
+
+	//L2 spherical harmonics irradiance, 9 RGB coefficients ordered (l, m) = (0,0), (1,-1), (1,0), (1,1), (2,-2), (2,-1), (2,0), (2,1), (2,2).
+	//Coefficients are stored convolved with the clamped cosine, divided by pi and premultiplied by the basis
+	//normalization, so evaluating is only the polynomial part of the basis (see evaluateIrradiance)
+	struct SH9 {
+		glm::vec3 coefficients[9] = {};
+	};
+	//Diffuse ambient light for a surface facing normal, albedo 1. Same as shIrradiance in lightProbes.glsl
+	glm::vec3 evaluateIrradiance(const SH9& sh, const glm::vec3& normal);
+
+	//Equirectangular radiance, linear RGB. Row 0 is straight up (+Y), the center column faces -Z
+	struct EnvironmentMap {
+		int width = 0;
+		int height = 0;
+		std::vector<float> pixels; //RGB, row by row
+	};
+	//Loads an HDR (or LDR, linearized) image with stbi_loadf
+	bool loadEnvironmentMap(const std::string& filePath, EnvironmentMap* map);
+	//Analytic sky for when no map is available: horizon to zenith gradient, dark ground and a bright sun
+	EnvironmentMap createSkyEnvironmentMap(int width, const glm::vec3& sunDirection = glm::vec3(0.4f, 0.8f, -0.45f));
+	//Box filtered (or point sampled when enlarging) copy that is width x width / 2
+	EnvironmentMap resizeEnvironmentMap(const EnvironmentMap& map, int width);
+
+	struct ProbeGridSettings {
+		glm::vec3 min = glm::vec3(-4.0f, -1.4f, -4.0f); //World position of the first probe
+		glm::vec3 max = glm::vec3(4.0f, 2.6f, 4.0f); //World position of the last probe
+		glm::ivec3 count = glm::ivec3(5, 3, 5); //Probes along each axis, at most MAX_PROBES in total
+		glm::vec3 occluderAlbedo = glm::vec3(0.5f); //Color of light bounced off occluders
+	};
+
+	struct ProbeBakeStats {
+		int numProbes = 0;
+		int mapWidth = 0;
+		int mapHeight = 0;
+		int numThreads = 1;
+		bool simd = false;
+		float bakeMilliseconds = 0.0f; //CPU time of bake, including building the integration tables
+	};
+
+	//Grid of irradiance probes lit by an environment map. Every probe integrates the whole map into L2 SH.
+	//Directions blocked by an occluder box see the occluder instead of the sky: its albedo times the map's
+	//average radiance, a single crude bounce. So probes under and beside geometry darken and pick up its color,
+	//which a constant ambient term can't do.
+	//The integrator splits probes x row blocks of the map between job system threads, and projects 4 texels at
+	//a time with SSE where available, including the ray/box tests against occluders.
+	//Shading reads a uniform block (std140, binding UNIFORM_BINDING) holding the grid, plus per-object SH that
+	//the CPU interpolates from it at each object's position. lightProbes.glsl interpolates the grid per vertex
+	class LightProbeGrid {
+	public:
+		static const int MAX_PROBES = 96; //Whole uniform block stays below the 16KB every GL 4.5 driver allows
+		static const int MAX_OBJECTS = 8;
+		static const int UNIFORM_BINDING = 0;
+
+		LightProbeGrid() {};
+		~LightProbeGrid();
+		LightProbeGrid(const LightProbeGrid&) = delete;
+		LightProbeGrid& operator=(const LightProbeGrid&) = delete;
+		//Integrates every probe and uploads the grid. occluders are world space boxes.
+		//jobs may be null to bake on the calling thread
+		bool bake(const EnvironmentMap& map, const ProbeGridSettings& settings, const std::vector<Bounds>& occluders, JobSystem* jobs, bool simd = true);
+		//Trilinear interpolation between the 8 surrounding probes, clamped to the grid
+		SH9 sample(const glm::vec3& position)const;
+		//Samples the grid at position for the object's slot. Slots are uploaded by bind
+		void setObject(int slot, const glm::vec3& position);
+		//Uploads object slots and binds the uniform block
+		void bind();
+
+		inline const ProbeBakeStats& getStats()const { return m_stats; }
+		inline const ProbeGridSettings& getSettings()const { return m_settings; }
+		inline int getNumProbes()const { return (int)m_probes.size(); }
+		inline const SH9& getProbe(int i)const { return m_probes[i]; }
+		inline glm::vec3 getProbePosition(int i)const { return m_settings.min + glm::vec3(i % m_settings.count.x, (i / m_settings.count.x) % m_settings.count.y, i / (m_settings.count.x * m_settings.count.y)) * m_spacing; }
+	private:
+		ProbeGridSettings m_settings;
+		glm::vec3 m_spacing = glm::vec3(1.0f);
+		std::vector<SH9> m_probes; //x fastest, then y, then z
+		SH9 m_objects[MAX_OBJECTS];
+		unsigned int m_buffer = 0;
+		ProbeBakeStats m_stats;
+
+		void upload();
+	};
+}
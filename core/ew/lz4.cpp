@@ -0,0 +1,188 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "lz4.h"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace ew {
+	static const size_t MIN_MATCH = 4;
+	static const size_t LAST_LITERALS = 5; //Block always ends with at least this many literals
+	static const size_t MATCH_FIND_LIMIT = 12; //No match may start within this many bytes of the end
+	static const size_t MAX_OFFSET = 65535;
+	static const int HASH_BITS = 12;
+
+	static inline uint32_t read32(const unsigned char* p) {
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint32_t hash4(uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	/// <summary>
+	/// Writes a length that didn't fit in its token nibble as a run of 255s and a remainder
+	/// </summary>
+	static inline unsigned char* writeLength(unsigned char* op, size_t length) {
+		while (length >= 255) {
+			*op++ = 255;
+			length -= 255;
+		}
+		*op++ = (unsigned char)length;
+		return op;
+	}
+
+	/// <summary>
+	/// Appends one sequence: literals, then a match unless matchLength is 0 (the final literals).
+	/// Returns null if it would overrun the output
+	/// </summary>
+	static unsigned char* writeSequence(unsigned char* op, unsigned char* opEnd, const unsigned char* literals, size_t numLiterals, size_t offset, size_t matchLength) {
+		size_t worstCase = 1 + numLiterals / 255 + 1 + numLiterals + 2 + matchLength / 255 + 1;
+		if ((size_t)(opEnd - op) < worstCase) {
+			return nullptr;
+		}
+		unsigned char* token = op++;
+		*token = (unsigned char)((numLiterals < 15 ? numLiterals : 15) << 4);
+		if (numLiterals >= 15) {
+			op = writeLength(op, numLiterals - 15);
+		}
+		memcpy(op, literals, numLiterals);
+		op += numLiterals;
+		if (matchLength == 0) {
+			return op;
+		}
+		*op++ = (unsigned char)(offset & 0xff);
+		*op++ = (unsigned char)(offset >> 8);
+		size_t length = matchLength - MIN_MATCH;
+		*token |= (unsigned char)(length < 15 ? length : 15);
+		if (length >= 15) {
+			op = writeLength(op, length - 15);
+		}
+		return op;
+	}
+
+	size_t lz4CompressBound(size_t srcSize) {
+		return srcSize + srcSize / 255 + 16;
+	}
+
+	size_t lz4Compress(const char* src, size_t srcSize, char* dst, size_t dstCapacity) {
+		const unsigned char* base = (const unsigned char*)src;
+		const unsigned char* ip = base;
+		const unsigned char* anchor = base;
+		const unsigned char* end = base + srcSize;
+		unsigned char* op = (unsigned char*)dst;
+		unsigned char* opEnd = op + dstCapacity;
+
+		if (srcSize > MATCH_FIND_LIMIT) {
+			const unsigned char* matchStartLimit = end - MATCH_FIND_LIMIT;
+			const unsigned char* matchEndLimit = end - LAST_LITERALS;
+			//Positions relative to base. 0 doubles as "empty", which only costs a failed compare
+			std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+			while (ip < matchStartLimit) {
+				uint32_t h = hash4(read32(ip));
+				const unsigned char* ref = base + table[h];
+				table[h] = (uint32_t)(ip - base);
+				if (ref >= ip || (size_t)(ip - ref) > MAX_OFFSET || read32(ref) != read32(ip)) {
+					ip++;
+					continue;
+				}
+				//Grow the match backwards into pending literals, then forwards
+				while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+					ip--;
+					ref--;
+				}
+				size_t length = MIN_MATCH;
+				while (ip + length < matchEndLimit && ip[length] == ref[length]) {
+					length++;
+				}
+				op = writeSequence(op, opEnd, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), length);
+				if (op == nullptr) {
+					return 0;
+				}
+				ip += length;
+				anchor = ip;
+				//Index inside the match too, so runs that repeat it are found
+				if (ip - 2 > base && ip - 2 < matchStartLimit) {
+					table[hash4(read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+				}
+			}
+		}
+		op = writeSequence(op, opEnd, anchor, (size_t)(end - anchor), 0, 0);
+		if (op == nullptr) {
+			return 0;
+		}
+		return (size_t)(op - (unsigned char*)dst);
+	}
+
+	/// <summary>
+	/// Reads the extra bytes of a length whose token nibble was 15. False if the input ends first
+	/// </summary>
+	static inline bool readLength(const unsigned char** ip, const unsigned char* end, size_t* length) {
+		unsigned char b;
+		do {
+			if (*ip >= end) {
+				return false;
+			}
+			b = *(*ip)++;
+			*length += b;
+		} while (b == 255);
+		return true;
+	}
+
+	bool lz4Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize) {
+		const unsigned char* ip = (const unsigned char*)src;
+		const unsigned char* end = ip + srcSize;
+		unsigned char* op = (unsigned char*)dst;
+		unsigned char* opEnd = op + dstSize;
+		while (ip < end) {
+			unsigned char token = *ip++;
+			size_t numLiterals = token >> 4;
+			if (numLiterals == 15 && !readLength(&ip, end, &numLiterals)) {
+				return false;
+			}
+			if (numLiterals > (size_t)(end - ip) || numLiterals > (size_t)(opEnd - op)) {
+				return false;
+			}
+			memcpy(op, ip, numLiterals);
+			ip += numLiterals;
+			op += numLiterals;
+			//Last sequence has no match
+			if (ip == end) {
+				break;
+			}
+			if (end - ip < 2) {
+				return false;
+			}
+			size_t offset = ip[0] | ((size_t)ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > (size_t)(op - (unsigned char*)dst)) {
+				return false;
+			}
+			size_t length = token & 15;
+			if (length == 15 && !readLength(&ip, end, &length)) {
+				return false;
+			}
+			length += MIN_MATCH;
+			if (length > (size_t)(opEnd - op)) {
+				return false;
+			}
+			const unsigned char* match = op - offset;
+			if (offset >= length) {
+				memcpy(op, match, length);
+				op += length;
+			}
+			else {
+				//Overlapping copy repeats the last offset bytes
+				for (size_t i = 0; i < length; i++)
+				{
+					*op++ = match[i];
+				}
+			}
+		}
+		return op == opEnd;
+	}
+}
@@ -0,0 +1,19 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <stddef.h>
+
+namespace ew {
+	//LZ4 block format (no frame header or checksums), compatible with the reference LZ4_compress_default/LZ4_decompress_safe.
+	//The compressor is a greedy single hash table matcher: fast and simple rather than the best ratio.
+
+	//Largest possible compressed size of srcSize bytes
+	size_t lz4CompressBound(size_t srcSize);
+	//Returns the compressed size, or 0 if it doesn't fit in dstCapacity
+	size_t lz4Compress(const char* src, size_t srcSize, char* dst, size_t dstCapacity);
+	//Decompresses a whole block that must expand to exactly dstSize bytes. Malformed input fails instead of
+	//reading or writing out of bounds
+	bool lz4Decompress(const char* src, size_t srcSize, char* dst, size_t dstSize);
+}
@@ -0,0 +1,108 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "mappedFile.h"
+#include <stdio.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace ew {
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::open(const std::string& filePath)
+	{
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			printf("Failed to open file %s", filePath.c_str());
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		m_file = file;
+		m_size = (size_t)fileSize.QuadPart;
+		//Zero length files can't be mapped, but are still valid to open
+		if (m_size == 0) {
+			static const char empty = 0;
+			m_data = &empty;
+			return true;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			printf("Failed to map file %s", filePath.c_str());
+			close();
+			return false;
+		}
+		m_mapping = mapping;
+		m_data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		m_fd = ::open(filePath.c_str(), O_RDONLY);
+		if (m_fd < 0) {
+			printf("Failed to open file %s", filePath.c_str());
+			return false;
+		}
+		struct stat st;
+		fstat(m_fd, &st);
+		m_size = (size_t)st.st_size;
+		if (m_size == 0) {
+			static const char empty = 0;
+			m_data = &empty;
+			return true;
+		}
+		void* mapped = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+		if (mapped == MAP_FAILED) {
+			printf("Failed to map file %s", filePath.c_str());
+			close();
+			return false;
+		}
+		//Whole file is about to be read, so start paging it in now
+		madvise(mapped, m_size, MADV_WILLNEED);
+		m_data = (const char*)mapped;
+#endif
+		if (m_data == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+#ifdef _WIN32
+		if (m_data != nullptr && m_size > 0) {
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping != nullptr) {
+			CloseHandle((HANDLE)m_mapping);
+			m_mapping = nullptr;
+		}
+		if (m_file != nullptr) {
+			CloseHandle((HANDLE)m_file);
+			m_file = nullptr;
+		}
+#else
+		if (m_data != nullptr && m_size > 0) {
+			munmap((void*)m_data, m_size);
+		}
+		if (m_fd >= 0) {
+			::close(m_fd);
+			m_fd = -1;
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
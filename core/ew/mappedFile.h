@@ -0,0 +1,32 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <stddef.h>
+
+namespace ew {
+	//Read-only memory mapping of a whole file
+	class MappedFile {
+	public:
+		MappedFile() {};
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		bool open(const std::string& filePath);
+		void close();
+		inline const char* data()const { return m_data; }
+		inline size_t size()const { return m_size; }
+		inline bool isOpen()const { return m_data != nullptr; }
+	private:
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_fd = -1;
+#endif
+	};
+}
@@ -6,55 +6,149 @@
 */
 
 #include "mesh.h"
+#include "gpuResources.h"
 #include "external/glad.h"
+#include <utility>
+#include <vector>
 
 namespace ew {
-	Mesh::Mesh(const MeshData& meshData)
+	//Second stream of split meshes
+	struct VertexAttributes {
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	Mesh::Mesh(const MeshData& meshData, VertexLayout layout)
+	{
+		load(meshData, layout);
+	}
+	Mesh::~Mesh()
 	{
-		load(meshData);
+		release();
+	}
+	Mesh::Mesh(Mesh&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+	Mesh& Mesh::operator=(Mesh&& other) noexcept
+	{
+		if (this != &other) {
+			release();
+			m_initialized = other.m_initialized;
+			m_layout = other.m_layout;
+			m_vao = other.m_vao;
+			m_positionVao = other.m_positionVao;
+			m_vbo = other.m_vbo;
+			m_attributeVbo = other.m_attributeVbo;
+			m_ebo = other.m_ebo;
+			m_numVertices = other.m_numVertices;
+			m_numIndices = other.m_numIndices;
+			other.m_initialized = false;
+			other.m_vao = other.m_positionVao = other.m_vbo = other.m_attributeVbo = other.m_ebo = 0;
+			other.m_numVertices = other.m_numIndices = 0;
+		}
+		return *this;
+	}
+	void Mesh::release()
+	{
+		if (!m_initialized) {
+			return;
+		}
+		untrackGpuResource(GpuResourceType::VERTEX_ARRAY, m_vao);
+		untrackGpuResource(GpuResourceType::VERTEX_ARRAY, m_positionVao);
+		untrackGpuResource(GpuResourceType::BUFFER, m_vbo);
+		untrackGpuResource(GpuResourceType::BUFFER, m_ebo);
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteVertexArrays(1, &m_positionVao);
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ebo);
+		if (m_attributeVbo != 0) {
+			untrackGpuResource(GpuResourceType::BUFFER, m_attributeVbo);
+			glDeleteBuffers(1, &m_attributeVbo);
+		}
+		m_vao = m_positionVao = m_vbo = m_attributeVbo = m_ebo = 0;
+		m_numVertices = m_numIndices = 0;
+		m_initialized = false;
 	}
 	void Mesh::load(const MeshData& meshData)
 	{
+		load(meshData, m_layout);
+	}
+	void Mesh::load(const MeshData& meshData, VertexLayout layout)
+	{
+		if (m_initialized && layout != m_layout) {
+			release();
+		}
+		bool split = layout == VertexLayout::SPLIT;
 		if (!m_initialized) {
-			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
-
-			glGenBuffers(1, &m_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-
-			glGenBuffers(1, &m_ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-			glEnableVertexAttribArray(0);
+			m_layout = layout;
+			glCreateVertexArrays(1, &m_vao);
+			glCreateVertexArrays(1, &m_positionVao);
+			glCreateBuffers(1, &m_vbo);
+			glCreateBuffers(1, &m_ebo);
 
+			//Buffer binding 0 holds positions, and every other attribute too when interleaved
+			GLsizei positionStride = split ? sizeof(glm::vec3) : sizeof(Vertex);
+			GLuint positionOffset = split ? 0 : offsetof(Vertex, pos);
+			unsigned int vaos[2] = { m_vao, m_positionVao };
+			for (unsigned int vao : vaos) {
+				glVertexArrayVertexBuffer(vao, 0, m_vbo, 0, positionStride);
+				glVertexArrayElementBuffer(vao, m_ebo);
+				//Position attribute
+				glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, positionOffset);
+				glVertexArrayAttribBinding(vao, 0, 0);
+				glEnableVertexArrayAttrib(vao, 0);
+			}
+			if (split) {
+				glCreateBuffers(1, &m_attributeVbo);
+				glVertexArrayVertexBuffer(m_vao, 1, m_attributeVbo, 0, sizeof(VertexAttributes));
+			}
 			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-			glEnableVertexAttribArray(1);
-
+			glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, split ? offsetof(VertexAttributes, normal) : offsetof(Vertex, normal));
+			glVertexArrayAttribBinding(m_vao, 1, split ? 1 : 0);
+			glEnableVertexArrayAttrib(m_vao, 1);
 			//UV attribute
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(2);
+			glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, split ? offsetof(VertexAttributes, uv) : offsetof(Vertex, uv));
+			glVertexArrayAttribBinding(m_vao, 2, split ? 1 : 0);
+			glEnableVertexArrayAttrib(m_vao, 2);
 
+			trackGpuResource(GpuResourceType::VERTEX_ARRAY, m_vao, 0, "Mesh");
+			trackGpuResource(GpuResourceType::VERTEX_ARRAY, m_positionVao, 0, "Mesh positions only");
+			trackGpuResource(GpuResourceType::BUFFER, m_vbo, 0, split ? "Mesh positions" : "Mesh vertices");
+			if (split) {
+				trackGpuResource(GpuResourceType::BUFFER, m_attributeVbo, 0, "Mesh normals and UVs");
+			}
+			trackGpuResource(GpuResourceType::BUFFER, m_ebo, 0, "Mesh indices");
 			m_initialized = true;
 		}
 
-		glBindVertexArray(m_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-
-		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+		//Empty arrays leave the old contents in place
+		size_t numVertices = meshData.vertices.size();
+		if (numVertices > 0 && split) {
+			std::vector<glm::vec3> positions(numVertices);
+			std::vector<VertexAttributes> attributes(numVertices);
+			for (size_t i = 0; i < numVertices; i++)
+			{
+				const Vertex& v = meshData.vertices[i];
+				positions[i] = v.pos;
+				attributes[i].normal = v.normal;
+				attributes[i].uv = v.uv;
+			}
+			glNamedBufferData(m_vbo, sizeof(glm::vec3) * numVertices, positions.data(), GL_STATIC_DRAW);
+			glNamedBufferData(m_attributeVbo, sizeof(VertexAttributes) * numVertices, attributes.data(), GL_STATIC_DRAW);
+			resizeGpuResource(GpuResourceType::BUFFER, m_vbo, sizeof(glm::vec3) * numVertices);
+			resizeGpuResource(GpuResourceType::BUFFER, m_attributeVbo, sizeof(VertexAttributes) * numVertices);
+		}
+		else if (numVertices > 0) {
+			glNamedBufferData(m_vbo, sizeof(Vertex) * numVertices, meshData.vertices.data(), GL_STATIC_DRAW);
+			resizeGpuResource(GpuResourceType::BUFFER, m_vbo, sizeof(Vertex) * numVertices);
 		}
 		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+			glNamedBufferData(m_ebo, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+			resizeGpuResource(GpuResourceType::BUFFER, m_ebo, sizeof(unsigned int) * meshData.indices.size());
 		}
-		m_numVertices = meshData.vertices.size();
+		m_numVertices = numVertices;
 		m_numIndices = meshData.indices.size();
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 	void Mesh::draw(ew::DrawMode drawMode) const
 	{
@@ -67,4 +161,44 @@ namespace ew {
 		}
 		
 	}
-}
\ No newline at end of file
+	void Mesh::drawInstanced(int numInstances, ew::DrawMode drawMode) const
+	{
+		glBindVertexArray(m_vao);
+		if (drawMode == DrawMode::TRIANGLES) {
+			glDrawElementsInstanced(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL, numInstances);
+		}
+		else {
+			glDrawArraysInstanced(GL_POINTS, 0, m_numVertices, numInstances);
+		}
+	}
+	void Mesh::drawRangeInstanced(int firstIndex, int numIndices, int numInstances) const
+	{
+		glBindVertexArray(m_vao);
+		glDrawElementsInstanced(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, (const void*)(sizeof(unsigned int) * firstIndex), numInstances);
+	}
+
+	void Mesh::drawPositions() const
+	{
+		glBindVertexArray(m_positionVao);
+		glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+	}
+	void Mesh::drawPositionsInstanced(int numInstances) const
+	{
+		glBindVertexArray(m_positionVao);
+		glDrawElementsInstanced(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL, numInstances);
+	}
+
+	Bounds computeBounds(const MeshData& meshData)
+	{
+		Bounds bounds;
+		if (meshData.vertices.empty()) {
+			return bounds;
+		}
+		bounds.min = bounds.max = meshData.vertices[0].pos;
+		for (const Vertex& v : meshData.vertices) {
+			bounds.min = glm::min(bounds.min, v.pos);
+			bounds.max = glm::max(bounds.max, v.pos);
+		}
+		return bounds;
+	}
+}
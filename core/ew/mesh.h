@@ -18,25 +18,59 @@ namespace ew {
 		std::vector<unsigned int> indices;
 	};
 
+	//Axis aligned bounding box
+	struct Bounds {
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+	};
+	Bounds computeBounds(const MeshData& meshData);
+
 	enum class DrawMode {
 		TRIANGLES = 0,
 		POINTS = 1
 	};
 
+	enum class VertexLayout {
+		INTERLEAVED = 0, //Position, normal and UV of each vertex together in one buffer
+		SPLIT = 1 //Positions in one buffer, normals and UVs in a second. Position only draws fetch 12 bytes per vertex instead of 32
+	};
+
+	//Owns its vertex arrays and buffers, which are deleted with it. Move-only so handles are never shared.
+	//Besides the full vertex array there is one reading only positions (attribute 0), for depth only passes
 	class Mesh {
 	public:
 		Mesh() {};
-		Mesh(const MeshData& meshData);
+		Mesh(const MeshData& meshData, VertexLayout layout = VertexLayout::INTERLEAVED);
+		~Mesh();
+		Mesh(Mesh&& other) noexcept;
+		Mesh& operator=(Mesh&& other) noexcept;
+		Mesh(const Mesh&) = delete;
+		Mesh& operator=(const Mesh&) = delete;
+		//Keeps the current layout
 		void load(const MeshData& meshData);
+		//Recreates the buffers when the layout changes
+		void load(const MeshData& meshData, VertexLayout layout);
 		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		//Draws numInstances copies in one call. Shaders tell them apart with gl_InstanceID
+		void drawInstanced(int numInstances, DrawMode drawMode = DrawMode::TRIANGLES)const;
+		//Draws numInstances copies of the triangles in [firstIndex, firstIndex + numIndices)
+		void drawRangeInstanced(int firstIndex, int numIndices, int numInstances)const;
+		//Same as draw and drawInstanced, with only the position stream bound
+		void drawPositions()const;
+		void drawPositionsInstanced(int numInstances)const;
 		inline int getNumVertices()const { return m_numVertices; }
 		inline int getNumIndices()const { return m_numIndices; }
+		inline VertexLayout getLayout()const { return m_layout; }
 	private:
 		bool m_initialized = false;
+		VertexLayout m_layout = VertexLayout::INTERLEAVED;
 		unsigned int m_vao = 0;
-		unsigned int m_vbo = 0;
+		unsigned int m_positionVao = 0;
+		unsigned int m_vbo = 0; //Every attribute when interleaved, positions when split
+		unsigned int m_attributeVbo = 0; //Normals and UVs when split
 		unsigned int m_ebo = 0;
 		unsigned int m_numVertices = 0;
 		unsigned int m_numIndices = 0;
+		void release();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,189 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "meshWeld.h"
+#include <math.h>
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+namespace ew {
+	struct WeldKey {
+		int64_t v[8]; //pos xyz, normal xyz, uv xy
+		inline bool operator==(const WeldKey& other)const {
+			for (int i = 0; i < 8; i++)
+			{
+				if (v[i] != other.v[i]) return false;
+			}
+			return true;
+		}
+	};
+
+	/// <summary>
+	/// Rounds value to a multiple of epsilon. Computed in double and clamped before the cast, since converting a value
+	/// out of range (large coordinates, tiny epsilons, infinities) is undefined. NaN maps to the lower limit
+	/// </summary>
+	static inline int64_t quantize(float value, float invEpsilon) {
+		const double LIMIT = 4.0e18;
+		double q = floor((double)value * invEpsilon + 0.5);
+		if (!(q > -LIMIT)) return (int64_t)-LIMIT;
+		if (q > LIMIT) return (int64_t)LIMIT;
+		return (int64_t)q;
+	}
+
+	static inline uint64_t hashKey(const WeldKey& key) {
+		//64 bit multiply-xorshift mix over the 8 lanes
+		uint64_t h = 0x9E3779B97F4A7C15ull;
+		for (int i = 0; i < 8; i++)
+		{
+			h ^= (uint64_t)key.v[i];
+			h *= 0xFF51AFD7ED558CCDull;
+			h ^= h >> 32;
+		}
+		return h;
+	}
+
+	static size_t nextPowerOfTwo(size_t v) {
+		size_t p = 16;
+		while (p < v) p <<= 1;
+		return p;
+	}
+
+	/// <summary>
+	/// Finds the first occurrence of each unique key among vertices whose hash falls in one partition.
+	/// Writes remap[i] = index of the first vertex with the same key.
+	/// </summary>
+	static void weldPartition(const std::vector<WeldKey>& keys, const std::vector<uint64_t>& hashes,
+		int partition, int partitionShift, std::vector<uint32_t>& remap) {
+		const uint32_t EMPTY = 0xFFFFFFFFu;
+		size_t numVertices = keys.size();
+		auto partitionOf = [&](uint64_t h) { return partitionShift >= 64 ? 0 : (int)(h >> partitionShift); };
+
+		size_t count = 0;
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			if (partitionOf(hashes[i]) == partition) count++;
+		}
+		//Open addressing, linear probing, load factor <= 0.5
+		size_t capacity = nextPowerOfTwo(count * 2);
+		size_t mask = capacity - 1;
+		std::vector<uint32_t> table(capacity, EMPTY);
+
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			if (partitionOf(hashes[i]) != partition) {
+				continue;
+			}
+			size_t slot = (size_t)hashes[i] & mask;
+			while (true) {
+				uint32_t existing = table[slot];
+				if (existing == EMPTY) {
+					table[slot] = (uint32_t)i;
+					remap[i] = (uint32_t)i;
+					break;
+				}
+				if (hashes[existing] == hashes[i] && keys[existing] == keys[i]) {
+					remap[i] = existing;
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+		}
+	}
+
+	WeldStats weldVertices(MeshData* mesh, const WeldSettings& settings)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		WeldStats stats;
+		size_t numVertices = mesh->vertices.size();
+		stats.verticesBefore = numVertices;
+		if (mesh->indices.empty()) {
+			mesh->indices.resize(numVertices);
+			for (size_t i = 0; i < numVertices; i++)
+			{
+				mesh->indices[i] = (unsigned int)i;
+			}
+		}
+
+		int numThreads = 1;
+		if (numVertices >= settings.parallelThreshold) {
+			numThreads = settings.numThreads > 0 ? settings.numThreads : (int)std::thread::hardware_concurrency();
+			numThreads = std::max(1, std::min(numThreads, 64));
+		}
+
+		//Quantize and hash. Embarrassingly parallel
+		std::vector<WeldKey> keys(numVertices);
+		std::vector<uint64_t> hashes(numVertices);
+		float invPos = 1.0f / settings.positionEpsilon;
+		float invNormal = 1.0f / settings.normalEpsilon;
+		float invUV = 1.0f / settings.uvEpsilon;
+		auto hashRange = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				const Vertex& v = mesh->vertices[i];
+				WeldKey& k = keys[i];
+				k.v[0] = quantize(v.pos.x, invPos);
+				k.v[1] = quantize(v.pos.y, invPos);
+				k.v[2] = quantize(v.pos.z, invPos);
+				k.v[3] = quantize(v.normal.x, invNormal);
+				k.v[4] = quantize(v.normal.y, invNormal);
+				k.v[5] = quantize(v.normal.z, invNormal);
+				k.v[6] = quantize(v.uv.x, invUV);
+				k.v[7] = quantize(v.uv.y, invUV);
+				hashes[i] = hashKey(k);
+			}
+		};
+
+		//Partition by the top bits of the hash so each thread owns a disjoint set of keys
+		int partitionBits = 0;
+		while ((1 << partitionBits) < numThreads) partitionBits++;
+		int numPartitions = 1 << partitionBits;
+		int partitionShift = 64 - partitionBits;
+		std::vector<uint32_t> remap(numVertices);
+
+		if (numThreads == 1) {
+			hashRange(0, numVertices);
+			weldPartition(keys, hashes, 0, 64, remap);
+		}
+		else {
+			std::vector<std::thread> threads;
+			size_t chunk = (numVertices + numThreads - 1) / numThreads;
+			for (int t = 0; t < numThreads; t++)
+			{
+				size_t begin = std::min(numVertices, t * chunk);
+				size_t end = std::min(numVertices, begin + chunk);
+				threads.emplace_back(hashRange, begin, end);
+			}
+			for (std::thread& thread : threads) thread.join();
+			threads.clear();
+			for (int p = 0; p < numPartitions; p++)
+			{
+				threads.emplace_back(weldPartition, std::cref(keys), std::cref(hashes), p, partitionShift, std::ref(remap));
+			}
+			for (std::thread& thread : threads) thread.join();
+		}
+
+		//Compact. A vertex is unique if it maps to itself
+		std::vector<uint32_t> newIndex(numVertices);
+		std::vector<Vertex> vertices;
+		vertices.reserve(numVertices);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			if (remap[i] == i) {
+				newIndex[i] = (uint32_t)vertices.size();
+				vertices.push_back(mesh->vertices[i]);
+			}
+		}
+		for (unsigned int& index : mesh->indices) {
+			index = newIndex[remap[index]];
+		}
+		mesh->vertices.swap(vertices);
+
+		stats.verticesAfter = mesh->vertices.size();
+		auto endTime = std::chrono::high_resolution_clock::now();
+		stats.milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		return stats;
+	}
+}
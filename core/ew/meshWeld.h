@@ -0,0 +1,30 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	struct WeldSettings {
+		//Attributes are quantized to multiples of these before comparison
+		float positionEpsilon = 1e-5f;
+		float normalEpsilon = 1e-3f;
+		float uvEpsilon = 1e-5f;
+		//Meshes with at least this many vertices are hashed on multiple threads
+		size_t parallelThreshold = 65536;
+		//0 = use hardware concurrency
+		int numThreads = 0;
+	};
+
+	struct WeldStats {
+		size_t verticesBefore = 0;
+		size_t verticesAfter = 0;
+		float milliseconds = 0.0f;
+	};
+
+	//Merges vertices whose quantized position, normal and uv are identical and remaps indices.
+	//The first occurrence of each vertex is kept, so output order is stable.
+	//Meshes without indices are treated as triangle lists and get an index buffer.
+	WeldStats weldVertices(MeshData* mesh, const WeldSettings& settings = WeldSettings());
+}
@@ -3,24 +3,109 @@
 */
 
 #include "model.h"
+#include "objLoader.h"
+#include "jobSystem.h"
+#include "assetArchive.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <stdio.h>
+#include <chrono>
+#include <algorithm>
+#include <ctype.h>
 
 namespace ew {
-	ew::Mesh processAiMesh(aiMesh* aiMesh);
-
 	Model::Model(const std::string& filePath)
 	{
-		Assimp::Importer importer;
-		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
-		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
+		load(filePath, WeldSettings(), nullptr);
+	}
+
+	Model::Model(const std::string& filePath, const WeldSettings& weldSettings, JobSystem* jobs)
+	{
+		load(filePath, weldSettings, jobs);
+	}
+
+	void Model::load(const std::string& filePath, const WeldSettings& weldSettings, JobSystem* jobs)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::vector<MeshData> meshes;
+		if (!loadModelMeshData(filePath, &meshes, weldSettings, &m_importStats, jobs)) {
+			return;
+		}
+		m_meshes.reserve(meshes.size());
+		for (size_t i = 0; i < meshes.size(); i++)
 		{
-			aiMesh* aiMesh = aiScene->mMeshes[i];
-			m_meshes.push_back(processAiMesh(aiMesh));
+			m_meshes.push_back(ew::Mesh(meshes[i]));
 		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_importStats.importMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+
+	/// <summary>
+	/// OBJ files skip Assimp and go through the memory mapped parallel loader.
+	/// Returns false for other formats, or if the file couldn't be loaded, so Assimp gets a go at it
+	/// </summary>
+	static bool loadNativeObj(const std::string& filePath, std::vector<MeshData>* meshes, const WeldSettings& weldSettings, ModelImportStats* stats, JobSystem* jobs)
+	{
+		size_t dot = filePath.find_last_of('.');
+		if (dot == std::string::npos) {
+			return false;
+		}
+		std::string extension = filePath.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+		if (extension != "obj") {
+			return false;
+		}
+		ObjLoadSettings settings;
+		settings.jobs = jobs;
+		settings.weld = weldSettings;
+		ObjLoadStats objStats;
+		AssetData asset;
+		bool loaded = readMountedAsset(filePath, &asset) ? parseObj(asset.data, asset.size, meshes, settings, &objStats) : loadObj(filePath, meshes, settings, &objStats);
+		if (!loaded) {
+			return false;
+		}
+		stats->verticesBefore = objStats.verticesBefore;
+		stats->verticesAfter = objStats.verticesAfter;
+		stats->weldMilliseconds = objStats.weldMilliseconds;
+		stats->nativeObj = true;
+		stats->parseMegabytesPerSecond = objStats.parseMegabytesPerSecond;
+		return true;
+	}
+
+	bool loadModelMeshData(const std::string& filePath, std::vector<MeshData>* meshes, const WeldSettings& weldSettings, ModelImportStats* stats, JobSystem* jobs)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		ModelImportStats importStats;
+		meshes->clear();
+		if (!loadNativeObj(filePath, meshes, weldSettings, &importStats, jobs)) {
+			Assimp::Importer importer;
+			const aiScene* aiScene = readAssimpScene(importer, filePath, aiProcess_Triangulate);
+			if (aiScene == NULL) {
+				printf("Failed to load model %s: %s", filePath.c_str(), importer.GetErrorString());
+				return false;
+			}
+			meshes->reserve(aiScene->mNumMeshes);
+			for (size_t i = 0; i < aiScene->mNumMeshes; i++)
+			{
+				aiMesh* aiMesh = aiScene->mMeshes[i];
+				ew::MeshData meshData = processAiMesh(aiMesh, jobs);
+				//Assimp delivers one vertex per face corner. Weld them back into shared vertices
+				WeldStats weldStats = weldVertices(&meshData, weldSettings);
+				importStats.verticesBefore += weldStats.verticesBefore;
+				importStats.verticesAfter += weldStats.verticesAfter;
+				importStats.weldMilliseconds += weldStats.milliseconds;
+				meshes->push_back(std::move(meshData));
+			}
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		importStats.importMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		if (stats != nullptr) {
+			*stats = importStats;
+		}
+		return true;
 	}
 
 	void Model::draw()
@@ -35,30 +120,68 @@ namespace ew {
 		return glm::vec3(v.x, v.y, v.z);
 	}
 
-	//Utility functions local to this file
-	ew::Mesh processAiMesh(aiMesh* aiMesh) {
+	//Utility functions
+	const aiScene* readAssimpScene(Assimp::Importer& importer, const std::string& filePath, unsigned int flags) {
+		AssetData asset;
+		if (!readMountedAsset(filePath, &asset)) {
+			return importer.ReadFile(filePath, flags);
+		}
+		//Extension tells Assimp which importer to use
+		size_t dot = filePath.find_last_of('.');
+		std::string hint = dot == std::string::npos ? "" : filePath.substr(dot + 1);
+		return importer.ReadFileFromMemory(asset.data, asset.size, flags, hint.c_str());
+	}
+
+	ew::MeshData processAiMesh(aiMesh* aiMesh, JobSystem* jobs) {
 		ew::MeshData meshData;
-		for (size_t i = 0; i < aiMesh->mNumVertices; i++)
-		{
-			ew::Vertex vertex;
-			vertex.pos = convertAIVec3(aiMesh->mVertices[i]);
-			if (aiMesh->HasNormals()) {
-				vertex.normal = convertAIVec3(aiMesh->mNormals[i]);
+		meshData.vertices.resize(aiMesh->mNumVertices);
+		parallelFor(jobs, aiMesh->mNumVertices, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				ew::Vertex& vertex = meshData.vertices[i];
+				vertex.pos = convertAIVec3(aiMesh->mVertices[i]);
+				//Missing attributes must be zeroed, otherwise welding compares garbage
+				vertex.normal = aiMesh->HasNormals() ? convertAIVec3(aiMesh->mNormals[i]) : glm::vec3(0.0f);
+				vertex.uv = aiMesh->HasTextureCoords(0) ? glm::vec2(convertAIVec3(aiMesh->mTextureCoords[0][i])) : glm::vec2(0.0f);
 			}
-			if (aiMesh->HasTextureCoords(0)) {
-				vertex.uv = glm::vec2(convertAIVec3(aiMesh->mTextureCoords[0][i]));
+		}, 1024);
+		//Convert faces to indices. Faces can have any number of indices, so each block of faces
+		//is counted first to find where its indices start
+		const size_t FACES_PER_BLOCK = 4096;
+		size_t numBlocks = (aiMesh->mNumFaces + FACES_PER_BLOCK - 1) / FACES_PER_BLOCK;
+		std::vector<size_t> blockOffsets(numBlocks + 1, 0);
+		parallelFor(jobs, numBlocks, [&](size_t blockBegin, size_t blockEnd) {
+			for (size_t block = blockBegin; block < blockEnd; block++)
+			{
+				size_t faceEnd = std::min((block + 1) * FACES_PER_BLOCK, (size_t)aiMesh->mNumFaces);
+				size_t numIndices = 0;
+				for (size_t i = block * FACES_PER_BLOCK; i < faceEnd; i++)
+				{
+					numIndices += aiMesh->mFaces[i].mNumIndices;
+				}
+				blockOffsets[block + 1] = numIndices;
 			}
-			meshData.vertices.push_back(vertex);
-		}
-		//Convert faces to indices
-		for (size_t i = 0; i < aiMesh->mNumFaces; i++)
+		});
+		for (size_t block = 0; block < numBlocks; block++)
 		{
-			for (size_t j = 0; j < aiMesh->mFaces[i].mNumIndices; j++)
+			blockOffsets[block + 1] += blockOffsets[block];
+		}
+		meshData.indices.resize(blockOffsets[numBlocks]);
+		parallelFor(jobs, numBlocks, [&](size_t blockBegin, size_t blockEnd) {
+			for (size_t block = blockBegin; block < blockEnd; block++)
 			{
-				meshData.indices.push_back(aiMesh->mFaces[i].mIndices[j]);
+				size_t faceEnd = std::min((block + 1) * FACES_PER_BLOCK, (size_t)aiMesh->mNumFaces);
+				unsigned int* indices = meshData.indices.data() + blockOffsets[block];
+				for (size_t i = block * FACES_PER_BLOCK; i < faceEnd; i++)
+				{
+					for (size_t j = 0; j < aiMesh->mFaces[i].mNumIndices; j++)
+					{
+						*indices++ = aiMesh->mFaces[i].mIndices[j];
+					}
+				}
 			}
-		}
-		return ew::Mesh(meshData);
+		});
+		return meshData;
 	}
 
 }
@@ -5,14 +5,49 @@
 #pragma once
 #include "mesh.h"
 #include "shader.h"
+#include "meshWeld.h"
 #include <vector>
 
+struct aiMesh;
+struct aiScene;
+namespace Assimp {
+	class Importer;
+}
+
 namespace ew {
+	class JobSystem;
+
+	struct ModelImportStats {
+		size_t verticesBefore = 0; //As delivered by the importer
+		size_t verticesAfter = 0; //After welding
+		float weldMilliseconds = 0.0f;
+		float importMilliseconds = 0.0f; //Total, including welding and GPU upload
+		bool nativeObj = false; //Loaded by ew::loadObj instead of Assimp
+		float parseMegabytesPerSecond = 0.0f; //Parse throughput without welding, native OBJ path only
+	};
+
 	class Model {
 	public:
 		Model(const std::string& filePath);
+		//Parsing is spread over jobs when given
+		Model(const std::string& filePath, const WeldSettings& weldSettings, JobSystem* jobs = nullptr);
 		void draw();
+		inline const ModelImportStats& getImportStats()const { return m_importStats; }
 	private:
 		std::vector<ew::Mesh> m_meshes;
+		ModelImportStats m_importStats;
+		void load(const std::string& filePath, const WeldSettings& weldSettings, JobSystem* jobs);
 	};
+
+	//Loads and welds a model's meshes without touching OpenGL, for CPU side use (e.g. SoftwareRenderer).
+	//OBJ chunks or Assimp meshes are converted with jobs when given
+	bool loadModelMeshData(const std::string& filePath, std::vector<MeshData>* meshes, const WeldSettings& weldSettings = WeldSettings(), ModelImportStats* stats = nullptr, JobSystem* jobs = nullptr);
+
+	//Converts an Assimp mesh to MeshData. Missing normals and UVs are zeroed.
+	//Vertices and faces are converted in parallel when jobs is given
+	ew::MeshData processAiMesh(aiMesh* aiMesh, JobSystem* jobs = nullptr);
+
+	//importer.ReadFile, reading from the mounted asset archive when it has the file.
+	//From memory, Assimp can't follow references to other files such as OBJ material libraries
+	const aiScene* readAssimpScene(Assimp::Importer& importer, const std::string& filePath, unsigned int flags);
 }
\ No newline at end of file
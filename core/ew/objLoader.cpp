@@ -0,0 +1,503 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "objLoader.h"
+#include "mappedFile.h"
+#include "jobSystem.h"
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+namespace ew {
+	//Face indices are stored as int64. Absolute (positive) OBJ indices are stored 0-based.
+	//Negative OBJ indices are relative to the vertex count at that line, which is only known
+	//per chunk during parsing, so they are stored offset by RELATIVE_BIAS and resolved after merging.
+	static const int64_t RELATIVE_BIAS = (int64_t)1 << 40;
+	static const int64_t MISSING_INDEX = INT64_MIN;
+
+	struct ObjEvent {
+		size_t cornerOffset; //Number of corners parsed in this chunk before the event
+		char type; //'o', 'g' or 'u' (usemtl)
+		std::string name;
+	};
+
+	struct ObjSegment {
+		size_t cornerBegin;
+		size_t cornerEnd;
+		int submesh;
+	};
+
+	struct ObjChunk {
+		const char* begin;
+		const char* end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> uvs;
+		std::vector<int64_t> corners; //v, vt, vn per triangle corner
+		std::vector<ObjEvent> events;
+		std::vector<ObjSegment> segments;
+		size_t positionBase = 0;
+		size_t normalBase = 0;
+		size_t uvBase = 0;
+		std::vector<std::vector<Vertex>> segmentVertices;
+	};
+
+	static inline bool isSpace(char c) {
+		return c == ' ' || c == '\t';
+	}
+
+	static inline const char* skipSpace(const char* p, const char* end) {
+		while (p < end && isSpace(*p)) p++;
+		return p;
+	}
+
+	static inline const char* skipLine(const char* p, const char* end) {
+		while (p < end && *p != '\n') p++;
+		return p < end ? p + 1 : end;
+	}
+
+	static const double POWERS_OF_TEN[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	/// <summary>
+	/// Parses a decimal float (with optional sign, fraction and exponent). Much faster than strtof
+	/// since it doesn't handle locales, hex or inf/nan. Accurate to within an ulp or so for OBJ data.
+	/// </summary>
+	static inline const char* parseFloat(const char* p, const char* end, float* out) {
+		p = skipSpace(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int numDigits = 0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			//Digits past what fits in the mantissa only affect the exponent
+			if (numDigits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				numDigits++;
+			}
+			else {
+				exponent++;
+			}
+			p++;
+		}
+		if (p < end && *p == '.') {
+			p++;
+			while (p < end && *p >= '0' && *p <= '9') {
+				if (numDigits < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					numDigits++;
+					exponent--;
+				}
+				p++;
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExponent = *p == '-';
+				p++;
+			}
+			int e = 0;
+			while (p < end && *p >= '0' && *p <= '9') {
+				e = e < 10000 ? e * 10 + (*p - '0') : e;
+				p++;
+			}
+			exponent += negativeExponent ? -e : e;
+		}
+		double value = (double)mantissa;
+		if (exponent < 0) {
+			while (exponent < -22) {
+				value /= 1e22;
+				exponent += 22;
+			}
+			value /= POWERS_OF_TEN[-exponent];
+		}
+		else {
+			while (exponent > 22) {
+				value *= 1e22;
+				exponent -= 22;
+			}
+			value *= POWERS_OF_TEN[exponent];
+		}
+		*out = (float)(negative ? -value : value);
+		return p;
+	}
+
+	static inline const char* parseIndex(const char* p, const char* end, size_t count, int64_t* out) {
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		int64_t value = 0;
+		bool any = false;
+		while (p < end && *p >= '0' && *p <= '9') {
+			value = value * 10 + (*p - '0');
+			any = true;
+			p++;
+		}
+		if (!any || value == 0) {
+			*out = MISSING_INDEX;
+		}
+		else if (negative) {
+			*out = (int64_t)count - value - RELATIVE_BIAS;
+		}
+		else {
+			*out = value - 1;
+		}
+		return p;
+	}
+
+	static inline size_t resolveIndex(int64_t index, size_t base) {
+		if (index == MISSING_INDEX) {
+			return SIZE_MAX;
+		}
+		if (index < -(RELATIVE_BIAS / 2)) {
+			return (size_t)((int64_t)base + index + RELATIVE_BIAS);
+		}
+		return (size_t)index;
+	}
+
+	static std::string parseName(const char* p, const char* end) {
+		p = skipSpace(p, end);
+		const char* nameEnd = p;
+		while (nameEnd < end && *nameEnd != '\n' && *nameEnd != '\r') nameEnd++;
+		while (nameEnd > p && isSpace(nameEnd[-1])) nameEnd--;
+		return std::string(p, nameEnd);
+	}
+
+	static void parseChunk(ObjChunk* chunk) {
+		const char* p = chunk->begin;
+		const char* end = chunk->end;
+		//Corners of the current polygon, before triangulation
+		std::vector<int64_t> polygon;
+		while (p < end) {
+			p = skipSpace(p, end);
+			if (p >= end) {
+				break;
+			}
+			char c = *p;
+			if (c == 'v' && p + 1 < end) {
+				char next = p[1];
+				if (isSpace(next)) {
+					glm::vec3 v;
+					p = parseFloat(p + 2, end, &v.x);
+					p = parseFloat(p, end, &v.y);
+					p = parseFloat(p, end, &v.z);
+					chunk->positions.push_back(v);
+				}
+				else if (next == 'n' && p + 2 < end && isSpace(p[2])) {
+					glm::vec3 n;
+					p = parseFloat(p + 3, end, &n.x);
+					p = parseFloat(p, end, &n.y);
+					p = parseFloat(p, end, &n.z);
+					chunk->normals.push_back(n);
+				}
+				else if (next == 't' && p + 2 < end && isSpace(p[2])) {
+					glm::vec2 uv;
+					p = parseFloat(p + 3, end, &uv.x);
+					p = parseFloat(p, end, &uv.y);
+					chunk->uvs.push_back(uv);
+				}
+			}
+			else if (c == 'f' && p + 1 < end && isSpace(p[1])) {
+				polygon.clear();
+				p += 2;
+				while (true) {
+					p = skipSpace(p, end);
+					if (p >= end || *p == '\n' || *p == '\r') {
+						break;
+					}
+					int64_t v, vt = MISSING_INDEX, vn = MISSING_INDEX;
+					p = parseIndex(p, end, chunk->positions.size(), &v);
+					if (p < end && *p == '/') {
+						p++;
+						if (p < end && *p != '/') {
+							p = parseIndex(p, end, chunk->uvs.size(), &vt);
+						}
+						if (p < end && *p == '/') {
+							p = parseIndex(p + 1, end, chunk->normals.size(), &vn);
+						}
+					}
+					polygon.push_back(v);
+					polygon.push_back(vt);
+					polygon.push_back(vn);
+					//Unknown token - skip it rather than loop forever
+					while (p < end && !isSpace(*p) && *p != '\n' && *p != '\r') p++;
+				}
+				//Fan triangulation, same as aiProcess_Triangulate for convex polygons
+				size_t numCorners = polygon.size() / 3;
+				for (size_t i = 2; i < numCorners; i++)
+				{
+					chunk->corners.insert(chunk->corners.end(), polygon.begin(), polygon.begin() + 3);
+					chunk->corners.insert(chunk->corners.end(), polygon.begin() + (i - 1) * 3, polygon.begin() + i * 3);
+					chunk->corners.insert(chunk->corners.end(), polygon.begin() + i * 3, polygon.begin() + (i + 1) * 3);
+				}
+			}
+			else if ((c == 'o' || c == 'g') && p + 1 < end && isSpace(p[1])) {
+				chunk->events.push_back({ chunk->corners.size() / 3, c, parseName(p + 2, end) });
+			}
+			else if (c == 'u' && end - p > 7 && strncmp(p, "usemtl", 6) == 0 && isSpace(p[6])) {
+				chunk->events.push_back({ chunk->corners.size() / 3, 'u', parseName(p + 7, end) });
+			}
+			p = skipLine(p, end);
+		}
+	}
+
+	bool loadObj(const std::string& filePath, std::vector<MeshData>* meshes, const ObjLoadSettings& settings, ObjLoadStats* stats)
+	{
+		MappedFile file;
+		if (!file.open(filePath)) {
+			return false;
+		}
+		return parseObj(file.data(), file.size(), meshes, settings, stats);
+	}
+
+	bool parseObj(const char* data, size_t size, std::vector<MeshData>* meshes, const ObjLoadSettings& settings, ObjLoadStats* stats)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		//Split into line-aligned chunks, one per thread
+		int numThreads = settings.jobs != nullptr ? settings.jobs->getNumThreads() : 1;
+		size_t minChunk = std::max<size_t>(1, settings.minChunkBytes);
+		int numChunks = (int)std::min<size_t>((size_t)numThreads, size / minChunk + 1);
+		std::vector<ObjChunk> chunks(numChunks);
+		const char* fileEnd = data + size;
+		const char* chunkStart = data;
+		for (int i = 0; i < numChunks; i++)
+		{
+			const char* chunkEnd = i == numChunks - 1 ? fileEnd : skipLine(data + size / numChunks * (i + 1), fileEnd);
+			chunkEnd = std::max(chunkEnd, chunkStart);
+			chunks[i].begin = chunkStart;
+			chunks[i].end = chunkEnd;
+			chunkStart = chunkEnd;
+		}
+
+		parallelFor(settings.jobs, numChunks, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				parseChunk(&chunks[i]);
+			}
+		});
+
+		//Prefix sums of attribute counts, and assign corner runs to sub-meshes.
+		//A new sub-mesh starts when the object, group or material changes and more faces follow
+		size_t numPositions = 0, numNormals = 0, numUVs = 0;
+		std::string object, group, material;
+		int currentSubmesh = -1;
+		int numSubmeshes = 0;
+		for (ObjChunk& chunk : chunks) {
+			chunk.positionBase = numPositions;
+			chunk.normalBase = numNormals;
+			chunk.uvBase = numUVs;
+			numPositions += chunk.positions.size();
+			numNormals += chunk.normals.size();
+			numUVs += chunk.uvs.size();
+
+			size_t numTriangles = chunk.corners.size() / 9;
+			size_t triangle = 0;
+			for (size_t e = 0; e <= chunk.events.size(); e++)
+			{
+				size_t segmentEnd = e < chunk.events.size() ? chunk.events[e].cornerOffset / 3 : numTriangles;
+				if (segmentEnd > triangle) {
+					if (currentSubmesh < 0) {
+						currentSubmesh = numSubmeshes++;
+					}
+					chunk.segments.push_back({ triangle * 9, segmentEnd * 9, currentSubmesh });
+					triangle = segmentEnd;
+				}
+				if (e < chunk.events.size()) {
+					const ObjEvent& ev = chunk.events[e];
+					std::string& field = ev.type == 'u' ? material : (ev.type == 'g' ? group : object);
+					if (field != ev.name) {
+						field = ev.name;
+						currentSubmesh = -1;
+					}
+				}
+			}
+		}
+
+		//Gather attributes into global arrays so indices can cross chunk boundaries
+		std::vector<glm::vec3> positions(numPositions);
+		std::vector<glm::vec3> normals(numNormals);
+		std::vector<glm::vec2> uvs(numUVs);
+		parallelFor(settings.jobs, numChunks, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				ObjChunk& chunk = chunks[i];
+				std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+				std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase);
+				std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.uvBase);
+			}
+		});
+
+		//Expand corners to vertices
+		parallelFor(settings.jobs, numChunks, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				ObjChunk& chunk = chunks[i];
+				chunk.segmentVertices.resize(chunk.segments.size());
+				for (size_t s = 0; s < chunk.segments.size(); s++)
+				{
+					const ObjSegment& segment = chunk.segments[s];
+					std::vector<Vertex>& vertices = chunk.segmentVertices[s];
+					vertices.resize((segment.cornerEnd - segment.cornerBegin) / 3);
+					for (size_t c = segment.cornerBegin, out = 0; c < segment.cornerEnd; c += 3, out++)
+					{
+						Vertex& v = vertices[out];
+						size_t vi = resolveIndex(chunk.corners[c], chunk.positionBase);
+						size_t ti = resolveIndex(chunk.corners[c + 1], chunk.uvBase);
+						size_t ni = resolveIndex(chunk.corners[c + 2], chunk.normalBase);
+						v.pos = vi < numPositions ? positions[vi] : glm::vec3(0.0f);
+						v.uv = ti < numUVs ? uvs[ti] : glm::vec2(0.0f);
+						v.normal = ni < numNormals ? normals[ni] : glm::vec3(0.0f);
+					}
+				}
+				//Raw parse data is no longer needed
+				std::vector<int64_t>().swap(chunk.corners);
+			}
+		});
+
+		meshes->clear();
+		meshes->resize(numSubmeshes);
+		for (ObjChunk& chunk : chunks) {
+			for (size_t s = 0; s < chunk.segments.size(); s++)
+			{
+				std::vector<Vertex>& dst = (*meshes)[chunk.segments[s].submesh].vertices;
+				dst.insert(dst.end(), chunk.segmentVertices[s].begin(), chunk.segmentVertices[s].end());
+			}
+		}
+		chunks.clear();
+		auto parseEndTime = std::chrono::high_resolution_clock::now();
+
+		ObjLoadStats result;
+		result.fileBytes = size;
+		result.numThreads = numChunks;
+		for (MeshData& mesh : *meshes) {
+			result.numTriangles += mesh.vertices.size() / 3;
+			WeldStats weldStats = weldVertices(&mesh, settings.weld);
+			result.verticesBefore += weldStats.verticesBefore;
+			result.verticesAfter += weldStats.verticesAfter;
+			result.weldMilliseconds += weldStats.milliseconds;
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		result.parseMilliseconds = std::chrono::duration<float, std::milli>(parseEndTime - startTime).count();
+		result.totalMilliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		float megabytes = size / (1024.0f * 1024.0f);
+		result.parseMegabytesPerSecond = result.parseMilliseconds > 0.0f ? megabytes / (result.parseMilliseconds / 1000.0f) : 0.0f;
+		result.totalMegabytesPerSecond = result.totalMilliseconds > 0.0f ? megabytes / (result.totalMilliseconds / 1000.0f) : 0.0f;
+		if (stats != nullptr) {
+			*stats = result;
+		}
+		return true;
+	}
+
+	std::string generateObjGrid(size_t targetBytes)
+	{
+		//About 110 bytes per grid vertex: its v and vt lines and one f line
+		const size_t BYTES_PER_VERTEX = 110;
+		int size = std::max(2, (int)sqrt((double)targetBytes / BYTES_PER_VERTEX));
+		std::string text;
+		text.reserve(targetBytes + targetBytes / 8);
+		char line[128];
+		text += "o Grid\nvn 0 1 0\n";
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				float u = (float)x / (size - 1);
+				float v = (float)z / (size - 1);
+				int length = snprintf(line, sizeof(line), "v %.6f 0 %.6f\nvt %.6f %.6f\n", u * 100.0f - 50.0f, v * 100.0f - 50.0f, u, v);
+				text.append(line, length);
+			}
+		}
+		for (int z = 0; z < size - 1; z++)
+		{
+			for (int x = 0; x < size - 1; x++)
+			{
+				//1-based, counter-clockwise seen from above
+				int a = z * size + x + 1;
+				int b = a + size;
+				int length = snprintf(line, sizeof(line), "f %d/%d/1 %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, b + 1, b + 1, a + 1, a + 1);
+				text.append(line, length);
+			}
+		}
+		return text;
+	}
+
+	bool writeObjGrid(const std::string& filePath, size_t targetBytes)
+	{
+		std::string text = generateObjGrid(targetBytes);
+		FILE* file = fopen(filePath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to open %s for writing\n", filePath.c_str());
+			return false;
+		}
+		bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+		ok = fclose(file) == 0 && ok;
+		if (!ok) {
+			printf("Failed to write %s\n", filePath.c_str());
+		}
+		return ok;
+	}
+
+	ObjLoadBenchmarkResult benchmarkObjLoading(const std::string& filePath, int numThreads, int iterations)
+	{
+		iterations = std::max(iterations, 1);
+		ObjLoadBenchmarkResult result;
+		std::string text;
+		{
+			MappedFile file;
+			if (!file.open(filePath)) {
+				printf("Failed to open %s\n", filePath.c_str());
+				return result;
+			}
+			text.assign(file.data(), file.size());
+		}
+		JobSystem jobs(numThreads);
+		ObjLoadSettings settings;
+		settings.jobs = &jobs;
+		double parseMs = 0.0, weldMs = 0.0, totalMs = 0.0, memoryParseMs = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			ObjLoadStats stats;
+			{
+				//Stops timing before the meshes are freed
+				std::vector<MeshData> meshes;
+				auto startTime = std::chrono::high_resolution_clock::now();
+				loadObj(filePath, &meshes, settings, &stats);
+				totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			}
+			parseMs += stats.parseMilliseconds;
+			weldMs += stats.weldMilliseconds;
+			result.file = stats;
+
+			std::vector<MeshData> meshes;
+			ObjLoadStats memoryStats;
+			parseObj(text.data(), text.size(), &meshes, settings, &memoryStats);
+			memoryParseMs += memoryStats.parseMilliseconds;
+		}
+		ObjLoadStats& r = result.file;
+		r.parseMilliseconds = (float)(parseMs / iterations);
+		r.weldMilliseconds = (float)(weldMs / iterations);
+		r.totalMilliseconds = (float)(totalMs / iterations);
+		result.memoryParseMilliseconds = (float)(memoryParseMs / iterations);
+		float megabytes = text.size() / (1024.0f * 1024.0f);
+		r.parseMegabytesPerSecond = r.parseMilliseconds > 0.0f ? megabytes / (r.parseMilliseconds / 1000.0f) : 0.0f;
+		r.totalMegabytesPerSecond = r.totalMilliseconds > 0.0f ? megabytes / (r.totalMilliseconds / 1000.0f) : 0.0f;
+		result.memoryParseMegabytesPerSecond = result.memoryParseMilliseconds > 0.0f ? megabytes / (result.memoryParseMilliseconds / 1000.0f) : 0.0f;
+		return result;
+	}
+}
@@ -0,0 +1,56 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "meshWeld.h"
+
+namespace ew {
+	class JobSystem;
+
+	struct ObjLoadSettings {
+		JobSystem* jobs = nullptr; //Parses chunks with jobs, or on the calling thread when null
+		size_t minChunkBytes = 256 * 1024; //Files are not split finer than this
+		WeldSettings weld;
+	};
+
+	struct ObjLoadStats {
+		size_t fileBytes = 0;
+		int numThreads = 0;
+		size_t numTriangles = 0;
+		size_t verticesBefore = 0; //One per face corner
+		size_t verticesAfter = 0;
+		float parseMilliseconds = 0.0f; //Parsing (which faults in mapped pages) and index resolution
+		float weldMilliseconds = 0.0f;
+		float totalMilliseconds = 0.0f;
+		float parseMegabytesPerSecond = 0.0f; //File size over parse time, without welding
+		float totalMegabytesPerSecond = 0.0f; //File size over total time
+	};
+
+	//Loads a Wavefront OBJ without going through Assimp. The file is memory mapped and split into
+	//line-aligned chunks that are parsed in parallel. Produces one MeshData per object/group/material
+	//run (matching how Assimp splits OBJ meshes), with polygons fan-triangulated and vertices welded.
+	bool loadObj(const std::string& filePath, std::vector<MeshData>* meshes, const ObjLoadSettings& settings = ObjLoadSettings(), ObjLoadStats* stats = nullptr);
+	//Same as loadObj, for OBJ text already in memory, e.g. read from an asset archive
+	bool parseObj(const char* data, size_t size, std::vector<MeshData>* meshes, const ObjLoadSettings& settings = ObjLoadSettings(), ObjLoadStats* stats = nullptr);
+
+	//OBJ text of one grid of quads with positions, uvs and normals, about targetBytes long.
+	//Corners repeat each vertex 4 times, so welding has as much work as in a real file
+	std::string generateObjGrid(size_t targetBytes);
+
+	//Writes generateObjGrid(targetBytes) to filePath, for benchmarkObjLoading
+	bool writeObjGrid(const std::string& filePath, size_t targetBytes);
+
+	struct ObjLoadBenchmarkResult {
+		ObjLoadStats file; //loadObj. totalMilliseconds also counts mapping and unmapping the file
+		float memoryParseMilliseconds = 0.0f; //parseObj on the same text already in memory, without page faults
+		float memoryParseMegabytesPerSecond = 0.0f;
+	};
+	//Loads an OBJ file through loadObj with a JobSystem of numThreads (0 = hardware concurrency), then parses a copy
+	//of it from memory for comparison. A file that was just written is usually still in the OS file cache, so this
+	//measures mapping and page faults rather than disk reads. Averages over iterations; counts are per load
+	ObjLoadBenchmarkResult benchmarkObjLoading(const std::string& filePath, int numThreads = 0, int iterations = 3);
+}
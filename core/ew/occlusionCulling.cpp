@@ -0,0 +1,440 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "occlusionCulling.h"
+#include "procGen.h"
+#include "jobSystem.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <math.h>
+#include <float.h>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define EW_OCCLUSION_SSE
+#endif
+
+namespace ew {
+	static inline size_t numTriangles(const MeshData& meshData) {
+		return meshData.indices.empty() ? meshData.vertices.size() / 3 : meshData.indices.size() / 3;
+	}
+
+	OcclusionCuller::OcclusionCuller(int width, int height)
+	{
+		m_tilesX = std::max(1, (width + TILE_SIZE - 1) / TILE_SIZE);
+		m_tilesY = std::max(1, (height + TILE_SIZE - 1) / TILE_SIZE);
+		m_width = m_tilesX * TILE_SIZE;
+		m_height = m_tilesY * TILE_SIZE;
+		//Each level halves the previous one, rounding up, down to 1x1
+		glm::ivec2 size = glm::ivec2(m_width, m_height);
+		while (true) {
+			m_levelSizes.push_back(size);
+			m_levels.push_back(std::vector<float>(size.x * size.y, 1.0f));
+			if (size.x == 1 && size.y == 1) {
+				break;
+			}
+			size = glm::ivec2((size.x + 1) / 2, (size.y + 1) / 2);
+		}
+	}
+
+	void OcclusionCuller::beginFrame(const glm::mat4& viewProjection)
+	{
+		m_viewProjection = viewProjection;
+		m_occluders.clear();
+	}
+
+	void OcclusionCuller::addOccluder(const MeshData* meshData, const glm::mat4& model)
+	{
+		m_occluders.push_back({ meshData, model });
+	}
+
+	void OcclusionCuller::rasterize(JobSystem* jobs)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		//Triangles are split evenly between bins regardless of which occluder they belong to
+		std::vector<size_t> occluderStarts(m_occluders.size() + 1, 0);
+		for (size_t i = 0; i < m_occluders.size(); i++)
+		{
+			occluderStarts[i + 1] = occluderStarts[i] + numTriangles(*m_occluders[i].meshData);
+		}
+		size_t totalTriangles = occluderStarts.back();
+		m_numTriangles = (int)totalTriangles;
+
+		int threads = jobs != nullptr ? jobs->getNumThreads() : 1;
+		m_numThreadsUsed = threads;
+		//One set of bins per thread, so jobs never share one. Small occluder sets aren't worth more than one
+		int numBins = (int)std::min<size_t>((size_t)threads, std::max<size_t>(1, totalTriangles / 256));
+		m_bins.resize(numBins);
+		for (WorkerBins& bins : m_bins) {
+			bins.triangles.clear();
+			bins.tiles.resize(m_tilesX * m_tilesY);
+			for (std::vector<uint32_t>& tile : bins.tiles) tile.clear();
+		}
+		parallelFor(jobs, numBins, [&](size_t begin, size_t end) {
+			for (size_t bin = begin; bin < end; bin++)
+			{
+				binTriangles(totalTriangles * bin / numBins, totalTriangles * (bin + 1) / numBins, occluderStarts, m_bins[bin]);
+			}
+		});
+		auto binTime = std::chrono::high_resolution_clock::now();
+
+		//Tiles own disjoint pixels, so jobs need no synchronization
+		std::fill(m_levels[0].begin(), m_levels[0].end(), 1.0f);
+		parallelFor(jobs, m_tilesX * m_tilesY, [&](size_t begin, size_t end) {
+			for (size_t tile = begin; tile < end; tile++)
+			{
+				rasterizeTile((int)tile);
+			}
+		});
+		auto rasterTime = std::chrono::high_resolution_clock::now();
+
+		buildPyramid();
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_binMilliseconds = std::chrono::duration<float, std::milli>(binTime - startTime).count();
+		m_rasterMilliseconds = std::chrono::duration<float, std::milli>(rasterTime - binTime).count();
+		m_pyramidMilliseconds = std::chrono::duration<float, std::milli>(endTime - rasterTime).count();
+	}
+
+	void OcclusionCuller::binTriangles(size_t firstTriangle, size_t endTriangle, const std::vector<size_t>& occluderStarts, WorkerBins& bins)
+	{
+		if (firstTriangle >= endTriangle) {
+			return;
+		}
+		//Vertices are transformed once per occluder rather than once per triangle corner
+		std::vector<glm::vec4> clipVertices;
+		auto transformOccluder = [&](size_t occluder) {
+			const Occluder& o = m_occluders[occluder];
+			glm::mat4 mvp = m_viewProjection * o.model;
+			clipVertices.resize(o.meshData->vertices.size());
+			for (size_t i = 0; i < clipVertices.size(); i++)
+			{
+				clipVertices[i] = mvp * glm::vec4(o.meshData->vertices[i].pos, 1.0f);
+			}
+		};
+		//Occluder containing the first triangle
+		size_t occluder = std::upper_bound(occluderStarts.begin(), occluderStarts.end(), firstTriangle) - occluderStarts.begin() - 1;
+		transformOccluder(occluder);
+		for (size_t t = firstTriangle; t < endTriangle; t++)
+		{
+			while (t >= occluderStarts[occluder + 1]) {
+				transformOccluder(++occluder);
+			}
+			const MeshData& meshData = *m_occluders[occluder].meshData;
+			size_t local = t - occluderStarts[occluder];
+			glm::vec4 clip[3];
+			for (int i = 0; i < 3; i++)
+			{
+				size_t index = meshData.indices.empty() ? local * 3 + i : meshData.indices[local * 3 + i];
+				clip[i] = clipVertices[index];
+			}
+			binTriangle(clip, bins);
+		}
+	}
+
+	/// <summary>
+	/// Clips a clip space triangle against the near plane, projects it and adds it to the bins
+	/// of every tile its screen bounds touch
+	/// </summary>
+	void OcclusionCuller::binTriangle(const glm::vec4* clip, WorkerBins& bins)
+	{
+		//Trivial reject when all vertices are outside the same frustum plane
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) return;
+			if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w) return;
+		}
+		//Near plane clipping (z >= -w) leaves at most 4 vertices
+		glm::vec4 polygon[4];
+		int numVertices = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec4& a = clip[i];
+			const glm::vec4& b = clip[(i + 1) % 3];
+			float da = a.z + a.w;
+			float db = b.z + b.w;
+			if (da >= 0.0f) {
+				polygon[numVertices++] = a;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				polygon[numVertices++] = a + (b - a) * (da / (da - db));
+			}
+		}
+		if (numVertices < 3) {
+			return;
+		}
+		glm::vec3 screen[4];
+		for (int i = 0; i < numVertices; i++)
+		{
+			float invW = 1.0f / std::max(polygon[i].w, 1e-6f);
+			screen[i].x = (polygon[i].x * invW * 0.5f + 0.5f) * m_width;
+			screen[i].y = (polygon[i].y * invW * 0.5f + 0.5f) * m_height;
+			screen[i].z = polygon[i].z * invW * 0.5f + 0.5f;
+		}
+		for (int i = 2; i < numVertices; i++)
+		{
+			ScreenTriangle triangle = { { screen[0], screen[i - 1], screen[i] } };
+			glm::vec3* v = triangle.v;
+			float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+			if (area == 0.0f || (area < 0.0f && backfaceCulling)) {
+				continue;
+			}
+			//Rasterizer expects counter-clockwise triangles
+			if (area < 0.0f) {
+				std::swap(v[1], v[2]);
+			}
+			//Clamped as floats first, vertices near the near plane can project very far off screen
+			float boundsMinX = std::min(std::min(v[0].x, v[1].x), v[2].x);
+			float boundsMinY = std::min(std::min(v[0].y, v[1].y), v[2].y);
+			float boundsMaxX = std::max(std::max(v[0].x, v[1].x), v[2].x);
+			float boundsMaxY = std::max(std::max(v[0].y, v[1].y), v[2].y);
+			if (boundsMaxX < 0.0f || boundsMaxY < 0.0f || boundsMinX >= m_width || boundsMinY >= m_height) {
+				continue;
+			}
+			int minX = (int)std::max(boundsMinX, 0.0f);
+			int minY = (int)std::max(boundsMinY, 0.0f);
+			int maxX = (int)std::min(boundsMaxX, m_width - 1.0f);
+			int maxY = (int)std::min(boundsMaxY, m_height - 1.0f);
+			uint32_t index = (uint32_t)bins.triangles.size();
+			bins.triangles.push_back(triangle);
+			for (int ty = minY / TILE_SIZE; ty <= maxY / TILE_SIZE; ty++)
+			{
+				for (int tx = minX / TILE_SIZE; tx <= maxX / TILE_SIZE; tx++)
+				{
+					bins.tiles[tx + ty * m_tilesX].push_back(index);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Rasterizes every triangle binned to a tile, keeping the nearest depth per pixel.
+	/// Coverage uses edge functions sampled at pixel centers, depth is interpolated linearly in screen space
+	/// </summary>
+	void OcclusionCuller::rasterizeTile(int tile)
+	{
+		int tileX = (tile % m_tilesX) * TILE_SIZE;
+		int tileY = (tile / m_tilesX) * TILE_SIZE;
+		float* depth = m_levels[0].data();
+		for (const WorkerBins& bins : m_bins) {
+			for (uint32_t index : bins.tiles[tile]) {
+				const glm::vec3* v = bins.triangles[index].v;
+				//Edge i runs from v[i] to v[i + 1]. Positive inside
+				float a[3], b[3], c[3];
+				for (int i = 0; i < 3; i++)
+				{
+					const glm::vec3& p = v[i];
+					const glm::vec3& q = v[(i + 1) % 3];
+					a[i] = p.y - q.y;
+					b[i] = q.x - p.x;
+					c[i] = p.x * q.y - p.y * q.x;
+				}
+				float area = c[0] + c[1] + c[2];
+				//Edge i is opposite vertex (i + 2) % 3
+				float invArea = 1.0f / area;
+				float za = (a[1] * v[0].z + a[2] * v[1].z + a[0] * v[2].z) * invArea;
+				float zb = (b[1] * v[0].z + b[2] * v[1].z + b[0] * v[2].z) * invArea;
+				float zc = (c[1] * v[0].z + c[2] * v[1].z + c[0] * v[2].z) * invArea;
+
+				//Triangle bounds within the tile. Rows are walked in groups of 4 pixels
+				int minX = (int)std::max((float)tileX, std::min(std::min(v[0].x, v[1].x), v[2].x)) & ~3;
+				int minY = (int)std::max((float)tileY, std::min(std::min(v[0].y, v[1].y), v[2].y));
+				int maxX = (int)std::min(tileX + TILE_SIZE - 1.0f, std::max(std::max(v[0].x, v[1].x), v[2].x));
+				int maxY = (int)std::min(tileY + TILE_SIZE - 1.0f, std::max(std::max(v[0].y, v[1].y), v[2].y));
+				for (int y = minY; y <= maxY; y++)
+				{
+					float py = y + 0.5f;
+					float px = minX + 0.5f;
+					float e0 = a[0] * px + b[0] * py + c[0];
+					float e1 = a[1] * px + b[1] * py + c[1];
+					float e2 = a[2] * px + b[2] * py + c[2];
+					float z = za * px + zb * py + zc;
+					float* row = depth + y * m_width;
+#ifdef EW_OCCLUSION_SSE
+					const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+					const __m128 zero = _mm_setzero_ps();
+					__m128 edge0 = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(_mm_set1_ps(a[0]), lanes));
+					__m128 edge1 = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(_mm_set1_ps(a[1]), lanes));
+					__m128 edge2 = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(_mm_set1_ps(a[2]), lanes));
+					__m128 depth4 = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(_mm_set1_ps(za), lanes));
+					const __m128 step0 = _mm_set1_ps(a[0] * 4.0f);
+					const __m128 step1 = _mm_set1_ps(a[1] * 4.0f);
+					const __m128 step2 = _mm_set1_ps(a[2] * 4.0f);
+					const __m128 stepZ = _mm_set1_ps(za * 4.0f);
+					for (int x = minX; x <= maxX; x += 4)
+					{
+						__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+						if (_mm_movemask_ps(inside) != 0) {
+							__m128 current = _mm_loadu_ps(row + x);
+							__m128 nearest = _mm_min_ps(current, depth4);
+							_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+						}
+						edge0 = _mm_add_ps(edge0, step0);
+						edge1 = _mm_add_ps(edge1, step1);
+						edge2 = _mm_add_ps(edge2, step2);
+						depth4 = _mm_add_ps(depth4, stepZ);
+					}
+#else
+					for (int x = minX; x < ((maxX + 4) & ~3); x++)
+					{
+						if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+							row[x] = std::min(row[x], z);
+						}
+						e0 += a[0];
+						e1 += a[1];
+						e2 += a[2];
+						z += za;
+					}
+#endif
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::buildPyramid()
+	{
+		for (size_t level = 1; level < m_levels.size(); level++)
+		{
+			const std::vector<float>& src = m_levels[level - 1];
+			std::vector<float>& dst = m_levels[level];
+			glm::ivec2 srcSize = m_levelSizes[level - 1];
+			glm::ivec2 dstSize = m_levelSizes[level];
+			for (int y = 0; y < dstSize.y; y++)
+			{
+				//Odd sizes clamp to the last row/column
+				int y0 = y * 2;
+				int y1 = std::min(y0 + 1, srcSize.y - 1);
+				for (int x = 0; x < dstSize.x; x++)
+				{
+					int x0 = x * 2;
+					int x1 = std::min(x0 + 1, srcSize.x - 1);
+					dst[y * dstSize.x + x] = std::max(std::max(src[y0 * srcSize.x + x0], src[y0 * srcSize.x + x1]),
+						std::max(src[y1 * srcSize.x + x0], src[y1 * srcSize.x + x1]));
+				}
+			}
+		}
+	}
+
+	bool OcclusionCuller::isVisible(const Bounds& bounds, const glm::mat4& model)const
+	{
+		glm::mat4 mvp = m_viewProjection * model;
+		glm::vec3 ndcMin = glm::vec3(FLT_MAX);
+		glm::vec3 ndcMax = glm::vec3(-FLT_MAX);
+		int numBehindNear = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 corner = glm::vec3(i & 1 ? bounds.max.x : bounds.min.x, i & 2 ? bounds.max.y : bounds.min.y, i & 4 ? bounds.max.z : bounds.min.z);
+			glm::vec4 clip = mvp * glm::vec4(corner, 1.0f);
+			//Between the near plane and the camera, or behind the camera
+			if (clip.z < -clip.w) {
+				numBehindNear++;
+				continue;
+			}
+			//On the camera plane, can't be projected safely
+			if (clip.w <= 1e-5f) {
+				return true;
+			}
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		//Entirely on the camera's side of the near plane, or crossing it and unsafe to project
+		if (numBehindNear > 0) {
+			return numBehindNear < 8;
+		}
+		if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f) {
+			return false;
+		}
+		float nearestDepth = ndcMin.z * 0.5f + 0.5f;
+		float minX = glm::clamp((ndcMin.x * 0.5f + 0.5f) * m_width, 0.0f, m_width - 1.0f);
+		float maxX = glm::clamp((ndcMax.x * 0.5f + 0.5f) * m_width, 0.0f, m_width - 1.0f);
+		float minY = glm::clamp((ndcMin.y * 0.5f + 0.5f) * m_height, 0.0f, m_height - 1.0f);
+		float maxY = glm::clamp((ndcMax.y * 0.5f + 0.5f) * m_height, 0.0f, m_height - 1.0f);
+		//Level where the rectangle spans at most 2 texels per axis (3 if unaligned)
+		float size = std::max(maxX - minX, maxY - minY);
+		int level = size > 1.0f ? (int)ceilf(log2f(size)) - 1 : 0;
+		level = glm::clamp(level, 0, (int)m_levels.size() - 1);
+		const std::vector<float>& hiZ = m_levels[level];
+		int levelWidth = m_levelSizes[level].x;
+		int x0 = (int)minX >> level, x1 = (int)maxX >> level;
+		int y0 = (int)minY >> level, y1 = (int)maxY >> level;
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				if (nearestDepth <= hiZ[y * levelWidth + x]) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	OcclusionBenchmarkResult benchmarkOcclusionCulling(int numThreads, int width, int height, int iterations)
+	{
+		iterations = std::max(iterations, 1);
+		OcclusionCuller culler(width, height);
+		JobSystem jobs(numThreads);
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)culler.getWidth() / culler.getHeight(), 0.1f, 200.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		//A wall of boxes with gaps between them, backed by a field of high poly sphere occluders
+		MeshData box = createCube(1.0f);
+		MeshData sphere = createSphere(1.0f, 32);
+		std::vector<glm::mat4> boxTransforms;
+		std::vector<glm::mat4> sphereTransforms;
+		for (int i = -6; i <= 6; i++)
+		{
+			glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(i * 4.0f, 1.5f, -8.0f));
+			boxTransforms.push_back(glm::scale(m, glm::vec3(3.6f, 5.0f, 0.5f)));
+		}
+		for (int z = 0; z < 4; z++)
+		{
+			for (int x = -8; x <= 8; x++)
+			{
+				glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(x * 5.0f + z * 2.5f, 1.0f, -20.0f - z * 10.0f));
+				sphereTransforms.push_back(glm::scale(m, glm::vec3(2.0f)));
+			}
+		}
+		//Objects spread out behind the occluders
+		Bounds objectBounds = computeBounds(box);
+		std::vector<glm::mat4> objects;
+		for (int z = 0; z < 80; z++)
+		{
+			for (int x = -40; x < 40; x++)
+			{
+				objects.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(x * 1.5f, 0.5f, -9.0f - z * 1.5f)));
+			}
+		}
+
+		OcclusionBenchmarkResult result;
+		result.numObjects = (int)objects.size();
+		double binMs = 0.0, rasterMs = 0.0, pyramidMs = 0.0, testMs = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			culler.beginFrame(projection * view);
+			for (const glm::mat4& m : boxTransforms) culler.addOccluder(&box, m);
+			for (const glm::mat4& m : sphereTransforms) culler.addOccluder(&sphere, m);
+			culler.rasterize(&jobs);
+			binMs += culler.getBinMilliseconds();
+			rasterMs += culler.getRasterMilliseconds();
+			pyramidMs += culler.getPyramidMilliseconds();
+
+			auto startTime = std::chrono::high_resolution_clock::now();
+			int numCulled = 0;
+			for (const glm::mat4& m : objects) {
+				numCulled += culler.isVisible(objectBounds, m) ? 0 : 1;
+			}
+			auto endTime = std::chrono::high_resolution_clock::now();
+			testMs += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+			result.numCulled = numCulled;
+		}
+		result.numOccluderTriangles = culler.getNumOccluderTriangles();
+		result.binMilliseconds = (float)(binMs / iterations);
+		result.rasterMilliseconds = (float)(rasterMs / iterations);
+		result.pyramidMilliseconds = (float)(pyramidMs / iterations);
+		result.testMilliseconds = (float)(testMs / iterations);
+		return result;
+	}
+}
@@ -0,0 +1,100 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+namespace ew {
+	class JobSystem;
+
+	//CPU occlusion culling. A few simplified occluder meshes are rasterized into a small depth buffer,
+	//which is reduced into a hierarchical-Z pyramid (each texel holding the farthest depth below it).
+	//Object bounds are then projected and compared against the pyramid level where they cover
+	//about 2x2 texels, before anything is submitted to the GPU.
+	//Triangles are transformed and binned into screen tiles in parallel, then each tile is rasterized
+	//by one job, 4 pixels at a time with SSE where available.
+	//Occluders should be fully inside the objects they stand in for, otherwise visible objects may be culled
+	class OcclusionCuller {
+	public:
+		static const int TILE_SIZE = 32;
+		bool backfaceCulling = true; //Occluders with counter-clockwise front faces
+
+		//Size is rounded up to a multiple of TILE_SIZE
+		OcclusionCuller(int width = 256, int height = 128);
+		//Clears occluders queued by the previous frame
+		void beginFrame(const glm::mat4& viewProjection);
+		//meshData must stay alive until rasterize() returns
+		void addOccluder(const MeshData* meshData, const glm::mat4& model);
+		//Rasterizes queued occluders and builds the depth pyramid. Binning and tiles are spread over jobs,
+		//or run on this thread when jobs is null
+		void rasterize(JobSystem* jobs = nullptr);
+		//Tests local space bounds. Objects outside of the frustum, including those entirely behind the camera,
+		//are reported as not visible. Objects crossing the near plane are always visible
+		bool isVisible(const Bounds& bounds, const glm::mat4& model = glm::mat4(1.0f))const;
+
+		inline int getWidth()const { return m_width; }
+		inline int getHeight()const { return m_height; }
+		inline int getNumLevels()const { return (int)m_levels.size(); }
+		//Depth pyramid level. Level 0 is the rasterized depth buffer, values are 0-1 window depth
+		inline const float* getDepth(int level)const { return m_levels[level].data(); }
+		inline int getLevelWidth(int level)const { return m_levelSizes[level].x; }
+		inline int getLevelHeight(int level)const { return m_levelSizes[level].y; }
+
+		inline int getNumOccluderTriangles()const { return m_numTriangles; }
+		inline float getBinMilliseconds()const { return m_binMilliseconds; }
+		inline float getRasterMilliseconds()const { return m_rasterMilliseconds; }
+		inline float getPyramidMilliseconds()const { return m_pyramidMilliseconds; }
+		inline int getNumThreadsUsed()const { return m_numThreadsUsed; }
+	private:
+		struct Occluder {
+			const MeshData* meshData;
+			glm::mat4 model;
+		};
+		//Screen space triangle. x, y in pixels, z in 0-1 window depth
+		struct ScreenTriangle {
+			glm::vec3 v[3];
+		};
+		//Per worker output of the binning stage
+		struct WorkerBins {
+			std::vector<ScreenTriangle> triangles;
+			std::vector<std::vector<uint32_t>> tiles;
+		};
+		int m_width;
+		int m_height;
+		int m_tilesX;
+		int m_tilesY;
+		glm::mat4 m_viewProjection = glm::mat4(1.0f);
+		std::vector<Occluder> m_occluders;
+		std::vector<WorkerBins> m_bins;
+		std::vector<std::vector<float>> m_levels;
+		std::vector<glm::ivec2> m_levelSizes;
+		int m_numTriangles = 0;
+		int m_numThreadsUsed = 0;
+		float m_binMilliseconds = 0.0f;
+		float m_rasterMilliseconds = 0.0f;
+		float m_pyramidMilliseconds = 0.0f;
+
+		void binTriangles(size_t firstTriangle, size_t endTriangle, const std::vector<size_t>& occluderStarts, WorkerBins& bins);
+		void binTriangle(const glm::vec4* clip, WorkerBins& bins);
+		void rasterizeTile(int tile);
+		void buildPyramid();
+	};
+
+	struct OcclusionBenchmarkResult {
+		int numOccluderTriangles = 0;
+		int numObjects = 0;
+		int numCulled = 0;
+		float binMilliseconds = 0.0f;
+		float rasterMilliseconds = 0.0f;
+		float pyramidMilliseconds = 0.0f;
+		float testMilliseconds = 0.0f; //All objects
+	};
+
+	//Occluder heavy scene: rows of wall occluders in front of a dense grid of objects, viewed
+	//from the origin, rasterized with a JobSystem of numThreads. Timings are averages over iterations
+	OcclusionBenchmarkResult benchmarkOcclusionCulling(int numThreads, int width = 256, int height = 128, int iterations = 50);
+}
@@ -0,0 +1,364 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "pointShadows.h"
+#include "shader.h"
+#include "texture.h"
+#include "gpuResources.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+
+namespace ew {
+	//Cube map face order (+X, -X, +Y, -Y, +Z, -Z), with the up vectors sampling expects
+	static const glm::vec3 FACE_DIRECTIONS[6] = {
+		glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+	};
+	static const glm::vec3 FACE_UPS[6] = {
+		glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)
+	};
+
+	static Bounds transformBounds(const Bounds& bounds, const glm::mat4& matrix) {
+		//Arvo's method: each output axis takes the min and max of every matrix column times the box's extent on that axis
+		Bounds result;
+		result.min = result.max = glm::vec3(matrix[3]);
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec3 a = glm::vec3(matrix[i]) * bounds.min[i];
+			glm::vec3 b = glm::vec3(matrix[i]) * bounds.max[i];
+			result.min += glm::min(a, b);
+			result.max += glm::max(a, b);
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// Returns a 6 bit mask of the cube faces whose frustum overlaps bounds. relative is the box
+	/// relative to the light. Face +X holds the points where x >= |y| and x >= |z|, so it overlaps the box when
+	/// the box reaches into each of the four half spaces x - y >= 0, x + y >= 0, x - z >= 0 and x + z >= 0.
+	/// The largest value of a - b over the box is max(a) - min(b), so each plane is one subtraction
+	/// </summary>
+	static int getFaceMask(const Bounds& relative) {
+		int mask = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int b = (axis + 1) % 3;
+			int c = (axis + 2) % 3;
+			//Largest distance along the face direction, for the positive and negative face
+			float along[2] = { relative.max[axis], -relative.min[axis] };
+			for (int side = 0; side < 2; side++)
+			{
+				if (along[side] - relative.min[b] >= 0.0f && along[side] + relative.max[b] >= 0.0f &&
+					along[side] - relative.min[c] >= 0.0f && along[side] + relative.max[c] >= 0.0f) {
+					mask |= 1 << (axis * 2 + side);
+				}
+			}
+		}
+		return mask;
+	}
+
+	static bool sphereIntersectsBounds(const glm::vec3& center, float radius, const Bounds& bounds) {
+		glm::vec3 closest = glm::clamp(center, bounds.min, bounds.max);
+		glm::vec3 toClosest = closest - center;
+		return glm::dot(toClosest, toClosest) <= radius * radius;
+	}
+
+	PointShadows::~PointShadows()
+	{
+		release();
+	}
+
+	void PointShadows::release()
+	{
+		for (int i = 0; i < MAX_POINT_SHADOW_TIERS; i++)
+		{
+			deleteTexture(m_cubeMaps[i]);
+			m_cubeMaps[i] = 0;
+			if (m_framebuffers[i] != 0) {
+				untrackGpuResource(GpuResourceType::FRAMEBUFFER, m_framebuffers[i]);
+				glDeleteFramebuffers(1, &m_framebuffers[i]);
+				m_framebuffers[i] = 0;
+			}
+		}
+		if (m_buffers[0] != 0) {
+			for (int i = 0; i < 3; i++)
+			{
+				untrackGpuResource(GpuResourceType::BUFFER, m_buffers[i]);
+				m_bufferSizes[i] = 0;
+			}
+			glDeleteBuffers(3, m_buffers);
+			m_buffers[0] = m_buffers[1] = m_buffers[2] = 0;
+		}
+		m_numTiers = 0;
+	}
+
+	/// <summary>
+	/// Allocates a 16 bit depth cube map array per tier, with hardware comparison so the lit shader gets
+	/// bilinear PCF from one tap. Memory is fixed here: tiers never grow, lights that don't fit are unshadowed
+	/// </summary>
+	/// <returns>False if the settings have no tiers or no capacity</returns>
+	bool PointShadows::create(const PointShadowSettings& settings)
+	{
+		release();
+		m_settings = settings;
+		m_numTiers = std::min(std::max(settings.numTiers, 0), MAX_POINT_SHADOW_TIERS);
+		int numLayers = 0;
+		for (int tier = 0; tier < m_numTiers; tier++)
+		{
+			m_firstMatrix[tier] = numLayers * 6;
+			numLayers += std::max(settings.tierCapacity[tier], 0);
+		}
+		if (numLayers == 0 || settings.resolution <= 0) {
+			printf("Point shadow settings have no room for any light\n");
+			m_numTiers = 0;
+			return false;
+		}
+		for (int tier = 0; tier < m_numTiers; tier++)
+		{
+			int capacity = settings.tierCapacity[tier];
+			if (capacity <= 0) {
+				continue;
+			}
+			int resolution = getFaceResolution(tier);
+			glCreateTextures(GL_TEXTURE_CUBE_MAP_ARRAY, 1, &m_cubeMaps[tier]);
+			glTextureStorage3D(m_cubeMaps[tier], 1, GL_DEPTH_COMPONENT16, resolution, resolution, capacity * 6);
+			glTextureParameteri(m_cubeMaps[tier], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(m_cubeMaps[tier], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(m_cubeMaps[tier], GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTextureParameteri(m_cubeMaps[tier], GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+			trackGpuResource(GpuResourceType::TEXTURE, m_cubeMaps[tier], (size_t)resolution * resolution * sizeof(uint16_t) * 6 * capacity,
+				"Point shadows " + std::to_string(resolution) + " x" + std::to_string(capacity));
+
+			//Attaching the whole array makes the framebuffer layered, so gl_Layer picks the face
+			glCreateFramebuffers(1, &m_framebuffers[tier]);
+			trackGpuResource(GpuResourceType::FRAMEBUFFER, m_framebuffers[tier], 0, "Point shadows " + std::to_string(resolution));
+			glNamedFramebufferTexture(m_framebuffers[tier], GL_DEPTH_ATTACHMENT, m_cubeMaps[tier], 0);
+			glNamedFramebufferDrawBuffer(m_framebuffers[tier], GL_NONE);
+			glNamedFramebufferReadBuffer(m_framebuffers[tier], GL_NONE);
+			GLenum status = glCheckNamedFramebufferStatus(m_framebuffers[tier], GL_FRAMEBUFFER);
+			if (status != GL_FRAMEBUFFER_COMPLETE) {
+				printf("Point shadow framebuffer incomplete: 0x%x\n", status);
+			}
+		}
+		m_faceMatrices.assign(numLayers * 6, glm::mat4(1.0f));
+		return true;
+	}
+
+	void PointShadows::update(const Camera& camera, const std::vector<Light>& lights, const std::vector<ShadowCaster>& casters)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		m_stats = PointShadowStats();
+		m_stats.numLights = (int)lights.size();
+		m_stats.gpuMilliseconds = m_timer.getMilliseconds();
+
+		//Side planes only, as the near plane differs between depth conventions. A light lights nothing
+		//on screen unless its sphere reaches into them
+		glm::mat4 viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+		glm::vec4 rowX = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 rowY = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 rowW = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+		glm::vec4 frustum[4] = { rowW + rowX, rowW - rowX, rowW + rowY, rowW - rowY };
+		float halfHeight = camera.orthographic ? camera.orthoHeight * 0.5f : tanf(glm::radians(camera.fov) * 0.5f);
+
+		//Rank visible lights by the fraction of the screen height their sphere covers
+		m_ranking.clear();
+		for (int i = 0; i < (int)lights.size(); i++)
+		{
+			const Light& light = lights[i];
+			bool visible = true;
+			for (const glm::vec4& plane : frustum) {
+				if (glm::dot(glm::vec3(plane), light.position) + plane.w < -light.radius * glm::length(glm::vec3(plane))) {
+					visible = false;
+					break;
+				}
+			}
+			if (!visible) {
+				continue;
+			}
+			float coverage = light.radius / halfHeight;
+			if (!camera.orthographic) {
+				coverage /= std::max(glm::distance(light.position, camera.position), light.radius);
+			}
+			m_ranking.push_back({ coverage, i });
+		}
+		m_stats.numVisibleLights = (int)m_ranking.size();
+		std::sort(m_ranking.begin(), m_ranking.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+			return a.first > b.first;
+		});
+
+		m_gpuLights.resize(lights.size());
+		for (size_t i = 0; i < lights.size(); i++)
+		{
+			const Light& light = lights[i];
+			m_gpuLights[i].positionRadius = glm::vec4(light.position, light.radius);
+			m_gpuLights[i].color = glm::vec4(light.color * light.intensity, 0.0f);
+			m_gpuLights[i].shadow = glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f);
+		}
+		for (int tier = 0; tier < MAX_POINT_SHADOW_TIERS; tier++)
+		{
+			m_tierLights[tier].clear();
+		}
+		//Without tiers (before create, after release, or when create failed) every light stays unshadowed
+		if (m_numTiers == 0) {
+			m_casters.clear();
+			m_faceIndices.clear();
+			m_stats.cullMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			upload(0, m_faceMatrices.data(), 0);
+			upload(1, m_faceIndices.data(), 0);
+			upload(2, m_gpuLights.data(), m_gpuLights.size() * sizeof(GpuPointLight));
+			return;
+		}
+		//Largest lights pick first. A light whose tier is full moves down to a coarser one rather than
+		//taking a layer from a larger light
+		for (const std::pair<float, int>& ranked : m_ranking) {
+			int tier = 0;
+			if (ranked.first < m_settings.tierCoverage) {
+				tier = (int)floorf(log2f(m_settings.tierCoverage / std::max(ranked.first, 1e-6f)));
+			}
+			tier = std::min(tier, m_numTiers - 1);
+			while (tier < m_numTiers && (int)m_tierLights[tier].size() >= m_settings.tierCapacity[tier]) {
+				tier++;
+			}
+			if (tier >= m_numTiers) {
+				continue;
+			}
+			int layer = (int)m_tierLights[tier].size();
+			m_tierLights[tier].push_back(ranked.second);
+
+			const Light& light = lights[ranked.second];
+			float nearPlane = light.radius * m_settings.nearRatio;
+			glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, light.radius);
+			for (int face = 0; face < 6; face++)
+			{
+				glm::mat4 view = glm::lookAt(light.position, light.position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+				m_faceMatrices[m_firstMatrix[tier] + layer * 6 + face] = projection * view;
+			}
+			//A face spans 2 * distance world units at a distance along its axis, so texels grow with distance
+			float texelSize = 2.0f / getFaceResolution(tier);
+			m_gpuLights[ranked.second].shadow = glm::vec4((float)tier, (float)layer, nearPlane, m_settings.normalOffset * texelSize);
+			m_stats.numTierLights[tier]++;
+			m_stats.numShadowedLights++;
+		}
+
+		//Per tier, each caster becomes one draw instanced over the faces it touches
+		m_casters = casters;
+		m_casterBounds.resize(casters.size());
+		for (size_t i = 0; i < casters.size(); i++)
+		{
+			m_casterBounds[i] = transformBounds(casters[i].bounds, casters[i].worldMatrix);
+		}
+		m_faceIndices.clear();
+		for (int tier = 0; tier < MAX_POINT_SHADOW_TIERS; tier++)
+		{
+			m_draws[tier].clear();
+			for (int caster = 0; caster < (int)m_casters.size() && !m_tierLights[tier].empty(); caster++)
+			{
+				const Bounds& bounds = m_casterBounds[caster];
+				int firstFace = (int)m_faceIndices.size();
+				for (int layer = 0; layer < (int)m_tierLights[tier].size(); layer++)
+				{
+					const Light& light = lights[m_tierLights[tier][layer]];
+					if (!sphereIntersectsBounds(light.position, light.radius, bounds)) {
+						continue;
+					}
+					Bounds relative;
+					relative.min = bounds.min - light.position;
+					relative.max = bounds.max - light.position;
+					int faceMask = getFaceMask(relative);
+					for (int face = 0; face < 6; face++)
+					{
+						if (faceMask & (1 << face)) {
+							m_faceIndices.push_back((uint32_t)(layer * 6 + face));
+						}
+					}
+				}
+				int numFaces = (int)m_faceIndices.size() - firstFace;
+				if (numFaces > 0) {
+					m_draws[tier].push_back({ caster, firstFace, numFaces });
+				}
+			}
+			m_stats.numDraws += (int)m_draws[tier].size();
+		}
+		m_stats.numFaceRenders = (int)m_faceIndices.size();
+		m_stats.numUnculledFaceRenders = m_stats.numShadowedLights * 6 * (int)casters.size();
+		m_stats.cullMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		upload(0, m_faceMatrices.data(), m_faceMatrices.size() * sizeof(glm::mat4));
+		upload(1, m_faceIndices.data(), m_faceIndices.size() * sizeof(uint32_t));
+		upload(2, m_gpuLights.data(), m_gpuLights.size() * sizeof(GpuPointLight));
+	}
+
+	/// <summary>
+	/// Orphans the buffer's storage and writes new contents, so the driver never waits on
+	/// frames still reading the old data. Capacity only grows
+	/// </summary>
+	void PointShadows::upload(int buffer, const void* data, size_t size)
+	{
+		if (m_buffers[0] == 0) {
+			glCreateBuffers(3, m_buffers);
+			const char* labels[3] = { "Point shadow faces", "Point shadow face indices", "Point shadow lights" };
+			for (int i = 0; i < 3; i++)
+			{
+				trackGpuResource(GpuResourceType::BUFFER, m_buffers[i], 0, labels[i]);
+			}
+		}
+		//Zero sized storage buffers can't be bound
+		m_bufferSizes[buffer] = std::max(std::max(m_bufferSizes[buffer], size), (size_t)16);
+		glNamedBufferData(m_buffers[buffer], m_bufferSizes[buffer], nullptr, GL_DYNAMIC_DRAW);
+		resizeGpuResource(GpuResourceType::BUFFER, m_buffers[buffer], m_bufferSizes[buffer]);
+		if (size > 0) {
+			glNamedBufferSubData(m_buffers[buffer], 0, size, data);
+		}
+	}
+
+	void PointShadows::render(const Shader& shader)
+	{
+		if (m_buffers[0] == 0) {
+			return;
+		}
+		m_timer.begin();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FACE_BINDING, m_buffers[0]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FACE_INDEX_BINDING, m_buffers[1]);
+		shader.use();
+		//Slope scaled offset keeps steep surfaces from shadowing themselves, on top of the receiver's normal offset
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(1.5f, 2.0f);
+		for (int tier = 0; tier < m_numTiers; tier++)
+		{
+			int numLayers = (int)m_tierLights[tier].size();
+			if (numLayers == 0) {
+				continue;
+			}
+			int resolution = getFaceResolution(tier);
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[tier]);
+			glViewport(0, 0, resolution, resolution);
+			//Only the layers in use this frame
+			float farDepth = 1.0f;
+			glClearTexSubImage(m_cubeMaps[tier], 0, 0, 0, 0, resolution, resolution, numLayers * 6, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+			shader.setInt("_FirstMatrix", m_firstMatrix[tier]);
+			for (const Draw& draw : m_draws[tier]) {
+				const ShadowCaster& caster = m_casters[draw.caster];
+				shader.setMat4("_Model", caster.worldMatrix);
+				shader.setInt("_FirstFace", draw.firstFace);
+				caster.mesh->drawPositionsInstanced(draw.numFaces);
+			}
+		}
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		m_timer.end();
+	}
+
+	void PointShadows::bind(const Shader& shader, int firstUnit)const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, m_buffers[2]);
+		shader.setInt("_NumPointLights", (int)m_gpuLights.size());
+		//Every element gets its own unit, even unused tiers, since samplers of different types can't share one
+		for (int tier = 0; tier < MAX_POINT_SHADOW_TIERS; tier++)
+		{
+			glBindTextureUnit(firstUnit + tier, m_cubeMaps[tier]);
+			shader.setInt("_PointShadowMaps[" + std::to_string(tier) + "]", firstUnit + tier);
+		}
+	}
+}
@@ -0,0 +1,121 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "camera.h"
+#include "clusteredLighting.h"
+#include "gpuTimer.h"
+
+namespace ew {
+	class Shader;
+
+	const int MAX_POINT_SHADOW_TIERS = 4;
+
+	//A mesh drawn into point light shadow maps
+	struct ShadowCaster {
+		const Mesh* mesh = nullptr;
+		glm::mat4 worldMatrix = glm::mat4(1.0f);
+		Bounds bounds; //Local space
+	};
+
+	struct PointShadowSettings {
+		int resolution = 1024; //Cube face size of tier 0. Each following tier halves it
+		int numTiers = 3;
+		//Cube maps per tier. Together with resolution this fixes the memory used, whatever the number of lights
+		int tierCapacity[MAX_POINT_SHADOW_TIERS] = { 4, 12, 32, 0 };
+		//Lights whose sphere covers at least this fraction of the screen height ask for tier 0,
+		//each following tier takes lights half that size
+		float tierCoverage = 0.5f;
+		float nearRatio = 0.02f; //Near plane of the cube faces, as a fraction of the light's radius
+		float normalOffset = 1.5f; //Receivers are moved along their normal by this many shadow texels before comparing
+	};
+
+	struct PointShadowStats {
+		int numLights = 0; //Lights passed to update
+		int numVisibleLights = 0; //Lights whose sphere is in the camera frustum
+		int numShadowedLights = 0;
+		int numTierLights[MAX_POINT_SHADOW_TIERS] = {};
+		int numDraws = 0; //Instanced draw calls
+		int numFaceRenders = 0; //Casters rendered into a cube face, over all draws
+		int numUnculledFaceRenders = 0; //Casters times faces of every shadowed light, without per-face culling
+		float cullMilliseconds = 0.0f; //CPU time of update
+		float gpuMilliseconds = 0.0f; //Rendering every cube map, most recently resolved
+	};
+
+	//Omnidirectional shadows for point lights, rendered in a single pass per resolution tier.
+	//Shadowed lights get a layer of a depth cube map array. Every caster is drawn once per tier,
+	//instanced over the cube faces it touches: the vertex shader transforms each instance with its face's
+	//view projection and a geometry shader routes the triangle to the face with gl_Layer.
+	//Faces are culled per caster on the CPU, by testing its world bounds against the light's sphere and the
+	//four planes bounding the face's 90 degree frustum.
+	//Lights outside the camera frustum are not shadowed. The rest are ranked by how much of the screen their
+	//sphere covers, and take the finest tier their size asks for that still has a free layer.
+	//Shader storage bindings: 5 = face view projections, 6 = face indices of the draws, 7 = lights
+	class PointShadows {
+	public:
+		static const int FACE_BINDING = 5;
+		static const int FACE_INDEX_BINDING = 6;
+		static const int LIGHT_BINDING = 7;
+
+		PointShadows() {};
+		~PointShadows();
+		PointShadows(const PointShadows&) = delete;
+		PointShadows& operator=(const PointShadows&) = delete;
+		//Allocates every tier's cube map array
+		bool create(const PointShadowSettings& settings);
+		//Assigns shadow layers, culls casters per face and uploads the results. Casters must stay alive until render.
+		//Without a successful create every light is uploaded unshadowed
+		void update(const Camera& camera, const std::vector<Light>& lights, const std::vector<ShadowCaster>& casters);
+		//Renders the cube maps with pointShadow.vert/.geom from the casters' position streams, leaving the last tier's framebuffer bound.
+		//Expects the default depth convention
+		void render(const Shader& shader);
+		//Binds the lights and sets _NumPointLights and _PointShadowMaps, tier i using texture unit firstUnit + i.
+		//Takes MAX_POINT_SHADOW_TIERS units
+		void bind(const Shader& shader, int firstUnit)const;
+
+		inline const PointShadowStats& getStats()const { return m_stats; }
+		inline const PointShadowSettings& getSettings()const { return m_settings; }
+		//Tier placement settings are picked up by the next update. Sizes need create
+		inline PointShadowSettings& getSettings() { return m_settings; }
+		inline int getFaceResolution(int tier)const { return std::max(m_settings.resolution >> tier, 1); }
+	private:
+		//Matches PointLight in lit.frag
+		struct GpuPointLight {
+			glm::vec4 positionRadius;
+			glm::vec4 color; //rgb = color * intensity
+			glm::vec4 shadow; //x = tier, -1 for unshadowed, y = cube map layer, z = near plane, w = normal offset in world units per unit of distance
+		};
+		struct Draw {
+			int caster;
+			int firstFace; //In m_faceIndices
+			int numFaces;
+		};
+		PointShadowSettings m_settings;
+		int m_numTiers = 0;
+		unsigned int m_cubeMaps[MAX_POINT_SHADOW_TIERS] = {};
+		unsigned int m_framebuffers[MAX_POINT_SHADOW_TIERS] = {};
+		int m_firstMatrix[MAX_POINT_SHADOW_TIERS] = {}; //Tier's first face in m_faceMatrices
+		unsigned int m_buffers[3] = {};
+		size_t m_bufferSizes[3] = {};
+		std::vector<GpuPointLight> m_gpuLights;
+		std::vector<glm::mat4> m_faceMatrices; //Layer * 6 + face, per tier
+		std::vector<uint32_t> m_faceIndices; //Layer * 6 + face, which is the tier's gl_Layer
+		std::vector<Draw> m_draws[MAX_POINT_SHADOW_TIERS];
+		std::vector<int> m_tierLights[MAX_POINT_SHADOW_TIERS]; //Light index per layer
+		std::vector<std::pair<float, int>> m_ranking;
+		std::vector<ShadowCaster> m_casters;
+		std::vector<Bounds> m_casterBounds; //World space
+		GpuTimer m_timer;
+		PointShadowStats m_stats;
+
+		void release();
+		void upload(int buffer, const void* data, size_t size);
+	};
+}
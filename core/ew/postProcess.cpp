@@ -0,0 +1,313 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "postProcess.h"
+#include "external/glad.h"
+#include <math.h>
+
+namespace ew {
+	void drawFullscreen()
+	{
+		//postprocess.vert generates its vertices from gl_VertexID, but core profile still needs a VAO bound
+		static unsigned int vao = 0;
+		if (vao == 0) {
+			glCreateVertexArrays(1, &vao);
+		}
+		//Full screen passes never need depth, and the backbuffer's depth may hold anything
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		glDisable(GL_DEPTH_TEST);
+		glBindVertexArray(vao);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		if (depthTest) {
+			glEnable(GL_DEPTH_TEST);
+		}
+	}
+
+	/// <summary>
+	/// Fills weights[0..radius] with a normalized 1D gaussian, counting each side tap twice
+	/// </summary>
+	static void computeGaussianWeights(int radius, float* weights) {
+		float sigma = radius / 2.0f;
+		float total = 0.0f;
+		for (int i = 0; i <= radius; i++)
+		{
+			weights[i] = expf(-(float)(i * i) / (2.0f * sigma * sigma));
+			total += i == 0 ? weights[i] : weights[i] * 2.0f;
+		}
+		for (int i = 0; i <= radius; i++)
+		{
+			weights[i] /= total;
+		}
+	}
+
+	//GAUSSIAN
+	GaussianBlurEffect::GaussianBlurEffect(const std::string& assetDirectory)
+		:m_shader(assetDirectory + "postprocess.vert", assetDirectory + "blurGaussian.frag")
+	{
+	}
+	void GaussianBlurEffect::updateKernel()
+	{
+		int r = radius < 1 ? 1 : radius;
+		r = r > 2 * (MAX_TAPS - 1) ? 2 * (MAX_TAPS - 1) : r;
+		if (r == m_kernelRadius) {
+			return;
+		}
+		m_kernelRadius = r;
+		std::vector<float> weights(r + 1);
+		computeGaussianWeights(r, weights.data());
+
+		//Merge taps i and i+1 into one bilinear fetch at their weighted center
+		m_offsets[0] = 0.0f;
+		m_weights[0] = weights[0];
+		m_numTaps = 1;
+		for (int i = 1; i <= r; i += 2)
+		{
+			float w0 = weights[i];
+			float w1 = i + 1 <= r ? weights[i + 1] : 0.0f;
+			float w = w0 + w1;
+			m_offsets[m_numTaps] = (i * w0 + (i + 1) * w1) / w;
+			m_weights[m_numTaps] = w;
+			m_numTaps++;
+		}
+	}
+	int GaussianBlurEffect::addPasses(RenderGraph& graph, int input)
+	{
+		RenderTextureDesc desc;
+		desc.format = GL_RGBA16F;
+		desc.scale = resolutionScale;
+		int horizontal = graph.createTexture("GaussianH", desc);
+		int vertical = graph.createTexture("GaussianV", desc);
+
+		graph.addPass("Gaussian Blur H", [=](const RenderGraph& g) {
+			updateKernel();
+			m_shader.use();
+			m_shader.setInt("_ColorBuffer", 0);
+			m_shader.setInt("_NumTaps", m_numTaps);
+			m_shader.setFloatArray("_Offsets", m_offsets, m_numTaps);
+			m_shader.setFloatArray("_Weights", m_weights, m_numTaps);
+			//Offsets are in texels of the texture being sampled, which is full size even when the blur is downscaled
+			m_shader.setVec2("_Direction", 1.0f / g.getWidth(input), 0.0f);
+			glBindTextureUnit(0, g.getTexture(input));
+			drawFullscreen();
+		}).read(input).writeColor(horizontal);
+
+		graph.addPass("Gaussian Blur V", [=](const RenderGraph& g) {
+			m_shader.use();
+			m_shader.setVec2("_Direction", 0.0f, 1.0f / g.getHeight(horizontal));
+			glBindTextureUnit(0, g.getTexture(horizontal));
+			drawFullscreen();
+		}).read(horizontal).writeColor(vertical);
+		return vertical;
+	}
+
+	//DUAL KAWASE
+	DualKawaseBlurEffect::DualKawaseBlurEffect(const std::string& assetDirectory)
+		:m_downShader(assetDirectory + "postprocess.vert", assetDirectory + "blurKawaseDown.frag"),
+		m_upShader(assetDirectory + "postprocess.vert", assetDirectory + "blurKawaseUp.frag")
+	{
+	}
+	int DualKawaseBlurEffect::addPasses(RenderGraph& graph, int input)
+	{
+		int numIterations = iterations < 1 ? 1 : (iterations > 8 ? 8 : iterations);
+		RenderTextureDesc desc;
+		desc.format = GL_RGBA16F;
+		int source = input;
+		//Each level is half the size of the previous one
+		for (int i = 0; i < numIterations; i++)
+		{
+			desc.scale = 1.0f / (float)(2 << i);
+			int level = graph.createTexture("KawaseDown" + std::to_string(i), desc);
+			graph.addPass("Kawase Down " + std::to_string(i), [=](const RenderGraph& g) {
+				m_downShader.use();
+				m_downShader.setInt("_ColorBuffer", 0);
+				m_downShader.setFloat("_Offset", offset);
+				glBindTextureUnit(0, g.getTexture(source));
+				drawFullscreen();
+			}).read(source).writeColor(level);
+			source = level;
+		}
+		//Walk back up, ending at full size
+		for (int i = numIterations - 2; i >= -1; i--)
+		{
+			desc.scale = i >= 0 ? 1.0f / (float)(2 << i) : 1.0f;
+			int level = graph.createTexture("KawaseUp" + std::to_string(i + 1), desc);
+			graph.addPass("Kawase Up " + std::to_string(i + 1), [=](const RenderGraph& g) {
+				m_upShader.use();
+				m_upShader.setInt("_ColorBuffer", 0);
+				m_upShader.setFloat("_Offset", offset);
+				glBindTextureUnit(0, g.getTexture(source));
+				drawFullscreen();
+			}).read(source).writeColor(level);
+			source = level;
+		}
+		return source;
+	}
+
+	//COMPUTE
+	ComputeBlurEffect::ComputeBlurEffect(const std::string& assetDirectory)
+		:m_shader(assetDirectory + "blurCompute.comp")
+	{
+	}
+	void ComputeBlurEffect::updateKernel()
+	{
+		int r = radius < 1 ? 1 : (radius > MAX_RADIUS ? MAX_RADIUS : radius);
+		if (r == m_kernelRadius) {
+			return;
+		}
+		m_kernelRadius = r;
+		computeGaussianWeights(r, m_weights);
+	}
+	int ComputeBlurEffect::addPasses(RenderGraph& graph, int input)
+	{
+		RenderTextureDesc desc;
+		desc.format = GL_RGBA16F; //Must match the image format in blurCompute.comp
+		desc.scale = resolutionScale;
+		int horizontal = graph.createTexture("ComputeBlurH", desc);
+		int vertical = graph.createTexture("ComputeBlurV", desc);
+
+		auto dispatch = [this](const RenderGraph& g, int source, int dest, bool isHorizontal) {
+			updateKernel();
+			m_shader.use();
+			m_shader.setInt("_ColorBuffer", 0);
+			m_shader.setBool("_Horizontal", isHorizontal);
+			m_shader.setInt("_Radius", m_kernelRadius);
+			m_shader.setFloatArray("_Weights", m_weights, m_kernelRadius + 1);
+			glBindTextureUnit(0, g.getTexture(source));
+			glBindImageTexture(0, g.getTexture(dest), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+			int lineLength = isHorizontal ? g.getWidth(dest) : g.getHeight(dest);
+			int numLines = isHorizontal ? g.getHeight(dest) : g.getWidth(dest);
+			glDispatchCompute((lineLength + TILE_SIZE - 1) / TILE_SIZE, numLines, 1);
+		};
+		graph.addPass("Compute Blur H", [=](const RenderGraph& g) {
+			dispatch(g, input, horizontal, true);
+		}).read(input).writeImage(horizontal);
+		graph.addPass("Compute Blur V", [=](const RenderGraph& g) {
+			dispatch(g, horizontal, vertical, false);
+		}).read(horizontal).writeImage(vertical);
+		return vertical;
+	}
+
+	//BLOOM
+	BloomEffect::BloomEffect(const std::string& assetDirectory)
+		:blur(assetDirectory),
+		m_thresholdShader(assetDirectory + "postprocess.vert", assetDirectory + "bloomThreshold.frag"),
+		m_compositeShader(assetDirectory + "postprocess.vert", assetDirectory + "bloomComposite.frag")
+	{
+	}
+	int BloomEffect::addPasses(RenderGraph& graph, int input)
+	{
+		RenderTextureDesc desc;
+		desc.format = GL_RGBA16F;
+		desc.scale = 0.5f;
+		int bright = graph.createTexture("BloomBright", desc);
+		graph.addPass("Bloom Threshold", [=](const RenderGraph& g) {
+			m_thresholdShader.use();
+			m_thresholdShader.setInt("_ColorBuffer", 0);
+			m_thresholdShader.setFloat("_Threshold", threshold);
+			m_thresholdShader.setFloat("_Knee", knee);
+			glBindTextureUnit(0, g.getTexture(input));
+			drawFullscreen();
+		}).read(input).writeColor(bright);
+
+		int blurred = blur.addPasses(graph, bright);
+
+		desc.scale = 1.0f;
+		int result = graph.createTexture("BloomResult", desc);
+		graph.addPass("Bloom Composite", [=](const RenderGraph& g) {
+			m_compositeShader.use();
+			m_compositeShader.setInt("_ColorBuffer", 0);
+			m_compositeShader.setInt("_BloomBuffer", 1);
+			m_compositeShader.setFloat("_Intensity", intensity);
+			glBindTextureUnit(0, g.getTexture(input));
+			glBindTextureUnit(1, g.getTexture(blurred));
+			drawFullscreen();
+		}).read(input).read(blurred).writeColor(result);
+		return result;
+	}
+
+	//CHROMATIC ABERRATION
+	ChromaticAberrationEffect::ChromaticAberrationEffect(const std::string& assetDirectory)
+		:m_shader(assetDirectory + "postprocess.vert", assetDirectory + "chromaticAberration.frag")
+	{
+	}
+	int ChromaticAberrationEffect::addPasses(RenderGraph& graph, int input)
+	{
+		RenderTextureDesc desc;
+		desc.format = GL_RGBA8;
+		int result = graph.createTexture("Aberration", desc);
+		graph.addPass("Chromatic Aberration", [=](const RenderGraph& g) {
+			m_shader.use();
+			m_shader.setInt("_ColorBuffer", 0);
+			m_shader.setFloat("_Red", red);
+			m_shader.setFloat("_Blue", blue);
+			glBindTextureUnit(0, g.getTexture(input));
+			drawFullscreen();
+		}).read(input).writeColor(result);
+		return result;
+	}
+
+	//UPSCALE
+	UpscaleEffect::UpscaleEffect(const std::string& assetDirectory)
+		:m_shader(assetDirectory + "postprocess.vert", assetDirectory + "upscale.frag")
+	{
+	}
+	int UpscaleEffect::addPasses(RenderGraph& graph, int input)
+	{
+		RenderTextureDesc desc;
+		desc.format = GL_RGBA8;
+		int result = graph.createTexture("Upscaled", desc);
+		graph.addPass("Upscale", [=](const RenderGraph& g) {
+			m_shader.use();
+			m_shader.setInt("_ColorBuffer", 0);
+			m_shader.setVec2("_ViewportScale", viewportScale);
+			m_shader.setFloat("_Sharpness", sharpness);
+			glBindTextureUnit(0, g.getTexture(input));
+			drawFullscreen();
+		}).read(input).writeColor(result);
+		return result;
+	}
+
+	//CHAIN
+	PostProcessChain::PostProcessChain(const std::string& assetDirectory)
+		:m_presentShader(assetDirectory + "postprocess.vert", assetDirectory + "present.frag")
+	{
+	}
+	void PostProcessChain::addEffect(PostProcessEffect* effect)
+	{
+		m_effects.push_back(effect);
+	}
+	void PostProcessChain::addPasses(RenderGraph& graph, int input, int output)
+	{
+		m_firstPass.assign(m_effects.size(), -1);
+		m_endPass.assign(m_effects.size(), -1);
+		int current = input;
+		for (size_t i = 0; i < m_effects.size(); i++)
+		{
+			if (!m_effects[i]->enabled) {
+				continue;
+			}
+			m_firstPass[i] = graph.getNumPasses();
+			current = m_effects[i]->addPasses(graph, current);
+			m_endPass[i] = graph.getNumPasses();
+		}
+		graph.addPass("Present", [=](const RenderGraph& g) {
+			m_presentShader.use();
+			m_presentShader.setInt("_ColorBuffer", 0);
+			glBindTextureUnit(0, g.getTexture(current));
+			drawFullscreen();
+		}).read(current).writeColor(output);
+	}
+	float PostProcessChain::getEffectGpuMilliseconds(const RenderGraph& graph, int effect) const
+	{
+		if (effect >= (int)m_firstPass.size() || m_firstPass[effect] < 0) {
+			return 0.0f;
+		}
+		float total = 0.0f;
+		for (int i = m_firstPass[effect]; i < m_endPass[effect]; i++)
+		{
+			total += graph.getPassGpuMilliseconds(i);
+		}
+		return total;
+	}
+}
@@ -0,0 +1,131 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include "shader.h"
+#include "renderGraph.h"
+
+namespace ew {
+	//An effect adds one or more passes to a render graph. Intermediate targets are graph
+	//transients, so effects in a chain share memory wherever their lifetimes allow.
+	class PostProcessEffect {
+	public:
+		virtual ~PostProcessEffect() {};
+		virtual const char* getName()const = 0;
+		//Adds this effect's passes reading input. Returns the resource holding the result
+		virtual int addPasses(RenderGraph& graph, int input) = 0;
+		bool enabled = true;
+	};
+
+	//Separable gaussian. Adjacent taps are merged into one bilinear fetch, and the blur
+	//can run on a downsampled target
+	class GaussianBlurEffect : public PostProcessEffect {
+	public:
+		static const int MAX_TAPS = 16;
+		GaussianBlurEffect(const std::string& assetDirectory = "assets/");
+		const char* getName()const override { return "Gaussian Blur"; }
+		int addPasses(RenderGraph& graph, int input) override;
+		int radius = 8; //Kernel radius in texels of the blur target (max 2 * (MAX_TAPS - 1))
+		float resolutionScale = 0.5f; //Blur target size relative to the graph output
+	private:
+		Shader m_shader;
+		int m_kernelRadius = -1;
+		int m_numTaps = 0;
+		float m_offsets[MAX_TAPS] = {};
+		float m_weights[MAX_TAPS] = {};
+		void updateKernel();
+	};
+
+	//Dual Kawase blur. Downsamples through a chain of half size targets then upsamples back,
+	//giving a very wide blur for a handful of taps per pixel
+	class DualKawaseBlurEffect : public PostProcessEffect {
+	public:
+		DualKawaseBlurEffect(const std::string& assetDirectory = "assets/");
+		const char* getName()const override { return "Dual Kawase Blur"; }
+		int addPasses(RenderGraph& graph, int input) override;
+		int iterations = 4; //Number of downsample steps
+		float offset = 1.0f; //Tap spread, in half texels
+	private:
+		Shader m_downShader;
+		Shader m_upShader;
+	};
+
+	//Separable gaussian in compute. Each workgroup stages a row segment in shared memory
+	class ComputeBlurEffect : public PostProcessEffect {
+	public:
+		static const int MAX_RADIUS = 16; //Must match blurCompute.comp
+		static const int TILE_SIZE = 128; //Must match blurCompute.comp
+		ComputeBlurEffect(const std::string& assetDirectory = "assets/");
+		const char* getName()const override { return "Compute Blur"; }
+		int addPasses(RenderGraph& graph, int input) override;
+		int radius = 8;
+		float resolutionScale = 0.5f;
+	private:
+		Shader m_shader;
+		int m_kernelRadius = -1;
+		float m_weights[MAX_RADIUS + 1] = {};
+		void updateKernel();
+	};
+
+	//Thresholds bright pixels, blurs them with dual Kawase and adds them back on top of the input
+	class BloomEffect : public PostProcessEffect {
+	public:
+		BloomEffect(const std::string& assetDirectory = "assets/");
+		const char* getName()const override { return "Bloom"; }
+		int addPasses(RenderGraph& graph, int input) override;
+		float threshold = 0.8f;
+		float knee = 0.2f;
+		float intensity = 1.0f;
+		DualKawaseBlurEffect blur;
+	private:
+		Shader m_thresholdShader;
+		Shader m_compositeShader;
+	};
+
+	class ChromaticAberrationEffect : public PostProcessEffect {
+	public:
+		ChromaticAberrationEffect(const std::string& assetDirectory = "assets/");
+		const char* getName()const override { return "Chromatic Aberration"; }
+		int addPasses(RenderGraph& graph, int input) override;
+		float red = 0.0f; //UV offset of the red channel
+		float blue = 0.0f; //UV offset of the blue channel
+	private:
+		Shader m_shader;
+	};
+
+	//Upscales a scene rendered into a scaled viewport (see DynamicResolution) to full size
+	class UpscaleEffect : public PostProcessEffect {
+	public:
+		UpscaleEffect(const std::string& assetDirectory = "assets/");
+		const char* getName()const override { return "Upscale"; }
+		int addPasses(RenderGraph& graph, int input) override;
+		glm::vec2 viewportScale = glm::vec2(1.0f); //Fraction of the input that holds the rendered image
+		float sharpness = 0.0f; //0 = plain bilinear
+	private:
+		Shader m_shader;
+	};
+
+	//Runs enabled effects in order, then presents the result into the output resource
+	class PostProcessChain {
+	public:
+		PostProcessChain(const std::string& assetDirectory = "assets/");
+		//Effects are not owned by the chain
+		void addEffect(PostProcessEffect* effect);
+		void addPasses(RenderGraph& graph, int input, int output);
+		inline int getNumEffects()const { return (int)m_effects.size(); }
+		inline PostProcessEffect* getEffect(int effect)const { return m_effects[effect]; }
+		//Sum of the GPU time of the effect's passes. 0 if the effect is disabled
+		float getEffectGpuMilliseconds(const RenderGraph& graph, int effect)const;
+	private:
+		std::vector<PostProcessEffect*> m_effects;
+		std::vector<int> m_firstPass;
+		std::vector<int> m_endPass;
+		Shader m_presentShader;
+	};
+
+	//Draws a full screen quad with postprocess.vert
+	void drawFullscreen();
+}
@@ -3,6 +3,7 @@
 */
 
 #include "procGen.h"
+#include "jobSystem.h"
 #include <stdlib.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
@@ -95,62 +96,74 @@ namespace ew {
 		}
 		return mesh;
 	}
-	MeshData createSphere(float radius, int subdivisions)
+	MeshData createSphere(float radius, int subdivisions, JobSystem* jobs)
 	{
 		MeshData mesh;
+		//Vertices and indices are written in place so rows can be filled in parallel
+		size_t columns = subdivisions + 1;
+		size_t numSideRows = subdivisions > 2 ? subdivisions - 2 : 0;
+		size_t capIndices = (size_t)subdivisions * 3;
+		mesh.vertices.resize(columns * columns);
+		mesh.indices.resize(capIndices * 2 + numSideRows * subdivisions * 6);
+
 		//VERTICES
 		float thetaStep = glm::two_pi<float>() / subdivisions;
 		float phiStep = glm::pi<float>() / subdivisions;
-		for (size_t row = 0; row <= subdivisions; row++)
-		{
-			float phi = row * phiStep;
-			for (size_t col = 0; col <= subdivisions; col++)
+		parallelFor(jobs, columns, [&](size_t rowBegin, size_t rowEnd) {
+			for (size_t row = rowBegin; row < rowEnd; row++)
 			{
-				float theta = thetaStep * col;
-				Vertex v;
-				v.normal.x = cosf(theta) * sinf(phi);
-				v.normal.y = cosf(phi);
-				v.normal.z = sinf(theta) * sinf(phi);
-				v.pos = v.normal * radius;
-				v.uv.x = (float)col / subdivisions;
-				v.uv.y = 1.0 - ((float)row / subdivisions);
-				mesh.vertices.push_back(v);
+				float phi = row * phiStep;
+				for (size_t col = 0; col < columns; col++)
+				{
+					float theta = thetaStep * col;
+					Vertex& v = mesh.vertices[row * columns + col];
+					v.normal.x = cosf(theta) * sinf(phi);
+					v.normal.y = cosf(phi);
+					v.normal.z = sinf(theta) * sinf(phi);
+					v.pos = v.normal * radius;
+					v.uv.x = (float)col / subdivisions;
+					v.uv.y = 1.0 - ((float)row / subdivisions);
+				}
 			}
-		}
+		}, 16);
 		
 		//INDICES
-		unsigned int columns = subdivisions + 1;
+		unsigned int* indices = mesh.indices.data();
 		unsigned int sideStart = columns;
 		unsigned int poleStart = 0;
 		//Top cap
-		for (size_t i = 0; i < subdivisions; i++)
+		for (size_t i = 0; i < (size_t)subdivisions; i++)
 		{
-			mesh.indices.push_back(sideStart + i);
-			mesh.indices.push_back(poleStart + i);
-			mesh.indices.push_back(sideStart +i+1);
+			*indices++ = sideStart + i;
+			*indices++ = poleStart + i;
+			*indices++ = sideStart + i + 1;
 		}
 		//Rows of quads for sides
-		for (size_t row = 1; row < subdivisions - 1; row++)
-		{
-			for (size_t col = 0; col < subdivisions; col++)
+		parallelFor(jobs, numSideRows, [&](size_t rowBegin, size_t rowEnd) {
+			for (size_t row = rowBegin + 1; row < rowEnd + 1; row++)
 			{
-				unsigned int start = row * columns + col;
-				mesh.indices.push_back(start);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns + 1);
+				unsigned int* rowIndices = indices + (row - 1) * subdivisions * 6;
+				for (size_t col = 0; col < (size_t)subdivisions; col++)
+				{
+					unsigned int start = row * columns + col;
+					*rowIndices++ = start;
+					*rowIndices++ = start + 1;
+					*rowIndices++ = start + columns;
+					*rowIndices++ = start + columns;
+					*rowIndices++ = start + 1;
+					*rowIndices++ = start + columns + 1;
+				}
 			}
-		}
+		}, 16);
+		indices += numSideRows * subdivisions * 6;
 		//Bottom cap
 		poleStart = (columns * columns) - columns;
 		sideStart = poleStart - columns;
-		for (size_t i = 0; i < subdivisions; i++)
+		for (size_t i = 0; i < (size_t)subdivisions; i++)
 		{
-			mesh.indices.push_back(sideStart + i);
-			mesh.indices.push_back(sideStart + i + 1);
-			mesh.indices.push_back(poleStart + i);
+			*indices++ = sideStart + i;
+			*indices++ = sideStart + i + 1;
+			*indices++ = poleStart + i;
 		}
 		return mesh;
 	}
@@ -6,8 +6,11 @@
 #include "mesh.h"
 
 namespace ew {
+	class JobSystem;
+
 	MeshData createCube(float size);
 	MeshData createPlane(float width, float height, int subdivisions);
-	MeshData createSphere(float radius, int subdivisions);
+	//Rows are generated in parallel when jobs is given
+	MeshData createSphere(float radius, int subdivisions, JobSystem* jobs = nullptr);
 	MeshData createCylinder(float radius, float height, int subdivisions);
 }
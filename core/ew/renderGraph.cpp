@@ -0,0 +1,481 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "renderGraph.h"
+#include "gpuResources.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <chrono>
+#include <map>
+#include <utility>
+
+namespace ew {
+	/// <summary>
+	/// Approximate bytes per pixel of a sized internal format, used for memory reporting
+	/// </summary>
+	static size_t getBytesPerPixel(unsigned int format) {
+		switch (format) {
+		case GL_R8:
+			return 1;
+		case GL_RG8:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGBA32F:
+			return 16;
+		case GL_RGBA16F:
+		case GL_RG32F:
+			return 8;
+		case GL_RGB16F:
+			return 6;
+		default:
+			return 4;
+		}
+	}
+
+	static bool isDepthFormat(unsigned int format) {
+		return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32
+			|| format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(int resource)
+	{
+		m_graph->m_passes[m_pass].reads.push_back(resource);
+		m_graph->m_dirty = true;
+		return *this;
+	}
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::readImage(int resource)
+	{
+		m_graph->m_passes[m_pass].imageReads.push_back(resource);
+		m_graph->m_dirty = true;
+		return *this;
+	}
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::writeColor(int resource)
+	{
+		m_graph->m_passes[m_pass].colorWrites.push_back(resource);
+		m_graph->m_dirty = true;
+		return *this;
+	}
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::writeDepth(int resource)
+	{
+		m_graph->m_passes[m_pass].depthWrite = resource;
+		m_graph->m_dirty = true;
+		return *this;
+	}
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::writeImage(int resource)
+	{
+		m_graph->m_passes[m_pass].imageWrites.push_back(resource);
+		m_graph->m_dirty = true;
+		return *this;
+	}
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::sideEffects()
+	{
+		m_graph->m_passes[m_pass].sideEffects = true;
+		m_graph->m_dirty = true;
+		return *this;
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		release();
+	}
+
+	int RenderGraph::createTexture(const std::string& name, const RenderTextureDesc& desc)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		m_resources.push_back(resource);
+		m_dirty = true;
+		return (int)m_resources.size() - 1;
+	}
+
+	int RenderGraph::importTexture(const std::string& name, unsigned int texture, int width, int height, unsigned int format)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.imported = true;
+		resource.texture = texture;
+		resource.desc.format = format;
+		resource.desc.width = resource.width = width;
+		resource.desc.height = resource.height = height;
+		m_resources.push_back(resource);
+		m_dirty = true;
+		return (int)m_resources.size() - 1;
+	}
+
+	int RenderGraph::importBackbuffer(const std::string& name)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.imported = true;
+		resource.backbuffer = true;
+		m_resources.push_back(resource);
+		m_dirty = true;
+		return (int)m_resources.size() - 1;
+	}
+
+	RenderGraph::PassBuilder RenderGraph::addPass(const std::string& name, const ExecuteFunc& execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = execute;
+		m_passes.push_back(std::move(pass));
+		m_dirty = true;
+		return PassBuilder(this, (int)m_passes.size() - 1);
+	}
+
+	void RenderGraph::resize(int width, int height)
+	{
+		//Minimized window - keep the old allocations until there is something to draw to
+		if (width <= 0 || height <= 0) {
+			return;
+		}
+		if (width == m_width && height == m_height) {
+			return;
+		}
+		m_width = width;
+		m_height = height;
+		m_dirty = true;
+	}
+
+	unsigned int RenderGraph::getTexture(int resource) const
+	{
+		const Resource& r = m_resources[resource];
+		if (r.imported) {
+			return r.texture;
+		}
+		return r.physical >= 0 ? m_physicalTextures[r.physical].texture : 0;
+	}
+
+	int RenderGraph::getWidth(int resource) const
+	{
+		return m_resources[resource].width;
+	}
+
+	int RenderGraph::getHeight(int resource) const
+	{
+		return m_resources[resource].height;
+	}
+
+	bool RenderGraph::writesResource(const Pass& pass, int resource) const
+	{
+		if (pass.depthWrite == resource) {
+			return true;
+		}
+		for (int r : pass.colorWrites) {
+			if (r == resource) return true;
+		}
+		for (int r : pass.imageWrites) {
+			if (r == resource) return true;
+		}
+		return false;
+	}
+
+	/// <summary>
+	/// Marks passes that contribute to an imported resource (or have side effects). Everything else is culled.
+	/// </summary>
+	void RenderGraph::cullPasses()
+	{
+		int numPasses = (int)m_passes.size();
+		std::vector<bool> needed(numPasses, false);
+		for (int i = 0; i < numPasses; i++)
+		{
+			Pass& pass = m_passes[i];
+			needed[i] = pass.sideEffects;
+			for (size_t r = 0; r < m_resources.size(); r++)
+			{
+				if (m_resources[r].imported && writesResource(pass, (int)r)) {
+					needed[i] = true;
+				}
+			}
+		}
+		//Walk backwards so a needed pass can mark the writers it depends on before they are visited.
+		//Writes count as dependencies too, since passes load (not clear) their attachments
+		for (int i = numPasses - 1; i >= 0; i--)
+		{
+			if (!needed[i]) {
+				continue;
+			}
+			const Pass& pass = m_passes[i];
+			std::vector<int> used = pass.reads;
+			used.insert(used.end(), pass.imageReads.begin(), pass.imageReads.end());
+			used.insert(used.end(), pass.colorWrites.begin(), pass.colorWrites.end());
+			used.insert(used.end(), pass.imageWrites.begin(), pass.imageWrites.end());
+			if (pass.depthWrite >= 0) {
+				used.push_back(pass.depthWrite);
+			}
+			for (int resource : used) {
+				for (int j = i - 1; j >= 0; j--)
+				{
+					if (writesResource(m_passes[j], resource)) {
+						needed[j] = true;
+						break;
+					}
+				}
+			}
+		}
+		for (int i = 0; i < numPasses; i++)
+		{
+			m_passes[i].culled = !needed[i];
+		}
+	}
+
+	/// <summary>
+	/// Assigns a physical texture to each transient resource. Resources whose lifetimes don't overlap
+	/// and that share size and format are given the same texture.
+	/// </summary>
+	void RenderGraph::allocateTransients()
+	{
+		//Resolve sizes and lifetimes
+		for (Resource& r : m_resources) {
+			r.physical = -1;
+			r.firstPass = r.lastPass = -1;
+			if (r.backbuffer) {
+				r.width = m_width;
+				r.height = m_height;
+			}
+			else if (!r.imported) {
+				r.width = r.desc.width > 0 ? r.desc.width : (int)(m_width * r.desc.scale);
+				r.height = r.desc.height > 0 ? r.desc.height : (int)(m_height * r.desc.scale);
+				r.width = r.width < 1 ? 1 : r.width;
+				r.height = r.height < 1 ? 1 : r.height;
+			}
+		}
+		for (int i = 0; i < (int)m_passes.size(); i++)
+		{
+			const Pass& pass = m_passes[i];
+			if (pass.culled) {
+				continue;
+			}
+			auto touch = [&](int resource) {
+				Resource& r = m_resources[resource];
+				if (r.firstPass < 0) r.firstPass = i;
+				r.lastPass = i;
+			};
+			for (int r : pass.reads) touch(r);
+			for (int r : pass.imageReads) touch(r);
+			for (int r : pass.colorWrites) touch(r);
+			for (int r : pass.imageWrites) touch(r);
+			if (pass.depthWrite >= 0) touch(pass.depthWrite);
+		}
+
+		m_unaliasedBytes = 0;
+		for (int i = 0; i < (int)m_passes.size(); i++)
+		{
+			//Acquire textures for resources that start living in this pass
+			for (size_t ri = 0; ri < m_resources.size(); ri++)
+			{
+				Resource& r = m_resources[ri];
+				if (r.imported || r.firstPass != i) {
+					continue;
+				}
+				m_unaliasedBytes += (size_t)r.width * r.height * getBytesPerPixel(r.desc.format);
+				for (size_t p = 0; p < m_physicalTextures.size(); p++)
+				{
+					PhysicalTexture& t = m_physicalTextures[p];
+					if (!t.inUse && t.width == r.width && t.height == r.height && t.format == r.desc.format && t.mipLevels == r.desc.mipLevels) {
+						t.inUse = true;
+						r.physical = (int)p;
+						break;
+					}
+				}
+				if (r.physical < 0) {
+					PhysicalTexture t;
+					t.width = r.width;
+					t.height = r.height;
+					t.format = r.desc.format;
+					t.mipLevels = r.desc.mipLevels;
+					t.inUse = true;
+					m_physicalTextures.push_back(t);
+					r.physical = (int)m_physicalTextures.size() - 1;
+				}
+			}
+			//Return textures of resources that die after this pass
+			for (Resource& r : m_resources) {
+				if (!r.imported && r.lastPass == i && r.physical >= 0) {
+					m_physicalTextures[r.physical].inUse = false;
+				}
+			}
+		}
+
+		m_transientBytes = 0;
+		for (PhysicalTexture& t : m_physicalTextures) {
+			glCreateTextures(GL_TEXTURE_2D, 1, &t.texture);
+			glTextureStorage2D(t.texture, t.mipLevels, t.format, t.width, t.height);
+			glTextureParameteri(t.texture, GL_TEXTURE_MIN_FILTER, t.mipLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			glTextureParameteri(t.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(t.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(t.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			size_t levelBytes = (size_t)t.width * t.height * getBytesPerPixel(t.format);
+			//A full mip chain adds roughly a third
+			size_t bytes = t.mipLevels > 1 ? levelBytes * 4 / 3 : levelBytes;
+			m_transientBytes += bytes;
+			trackGpuResource(GpuResourceType::TEXTURE, t.texture, bytes, "Render graph transient");
+		}
+	}
+
+	/// <summary>
+	/// Render target writes and texture reads are ordered by GL implicitly, but imageStore writes are not.
+	/// Works out which glMemoryBarrier bits each pass needs based on how its inputs were last written.
+	/// </summary>
+	void RenderGraph::computeBarriers()
+	{
+		//Barrier bits each texture still needs before it is accessed each way, keyed by GL texture so aliased
+		//resources share hazard state. A barrier only covers the access types whose bits it sets
+		const unsigned int allAccessBits = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+		std::map<unsigned int, unsigned int> pendingBits;
+		//Two sweeps so that writes at the end of a frame are seen by the start of the next
+		for (int sweep = 0; sweep < 2; sweep++)
+		{
+			for (Pass& pass : m_passes) {
+				if (pass.culled) {
+					continue;
+				}
+				unsigned int bits = 0;
+				for (int r : pass.reads) {
+					bits |= pendingBits[getTexture(r)] & GL_TEXTURE_FETCH_BARRIER_BIT;
+				}
+				for (int r : pass.imageReads) {
+					bits |= pendingBits[getTexture(r)] & GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+				}
+				for (int r : pass.imageWrites) {
+					bits |= pendingBits[getTexture(r)] & GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+				}
+				for (int r : pass.colorWrites) {
+					bits |= pendingBits[getTexture(r)] & GL_FRAMEBUFFER_BARRIER_BIT;
+				}
+				if (pass.depthWrite >= 0) {
+					bits |= pendingBits[getTexture(pass.depthWrite)] & GL_FRAMEBUFFER_BARRIER_BIT;
+				}
+				//The barrier makes prior writes to every texture visible, but only to the access types it names
+				if (bits != 0) {
+					for (auto& pending : pendingBits) {
+						pending.second &= ~bits;
+					}
+				}
+				for (int r : pass.colorWrites) pendingBits[getTexture(r)] = 0;
+				if (pass.depthWrite >= 0) pendingBits[getTexture(pass.depthWrite)] = 0;
+				for (int r : pass.imageWrites) pendingBits[getTexture(r)] = allAccessBits;
+				if (sweep == 1) {
+					pass.barrierBits = bits;
+				}
+			}
+		}
+	}
+
+	void RenderGraph::createFramebuffers()
+	{
+		for (Pass& pass : m_passes) {
+			pass.fbo = 0;
+			pass.bindFramebuffer = false;
+			if (pass.culled || (pass.colorWrites.empty() && pass.depthWrite < 0)) {
+				continue;
+			}
+			pass.bindFramebuffer = true;
+			int sizeSource = pass.colorWrites.empty() ? pass.depthWrite : pass.colorWrites[0];
+			pass.viewportWidth = m_resources[sizeSource].width;
+			pass.viewportHeight = m_resources[sizeSource].height;
+
+			if (m_resources[sizeSource].backbuffer) {
+				if (pass.colorWrites.size() > 1 || pass.depthWrite >= 0) {
+					printf("Render graph pass %s mixes the backbuffer with other attachments\n", pass.name.c_str());
+				}
+				continue;
+			}
+			glCreateFramebuffers(1, &pass.fbo);
+			trackGpuResource(GpuResourceType::FRAMEBUFFER, pass.fbo, 0, "Render graph pass " + pass.name);
+			std::vector<GLenum> drawBuffers;
+			for (size_t i = 0; i < pass.colorWrites.size(); i++)
+			{
+				glNamedFramebufferTexture(pass.fbo, GL_COLOR_ATTACHMENT0 + (GLenum)i, getTexture(pass.colorWrites[i]), 0);
+				drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+			}
+			if (pass.depthWrite >= 0) {
+				unsigned int format = m_resources[pass.depthWrite].desc.format;
+				GLenum attachment = (format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+				if (!isDepthFormat(format)) {
+					printf("Render graph resource %s is not a depth format\n", m_resources[pass.depthWrite].name.c_str());
+				}
+				glNamedFramebufferTexture(pass.fbo, attachment, getTexture(pass.depthWrite), 0);
+			}
+			if (drawBuffers.empty()) {
+				glNamedFramebufferDrawBuffer(pass.fbo, GL_NONE);
+				glNamedFramebufferReadBuffer(pass.fbo, GL_NONE);
+			}
+			else {
+				glNamedFramebufferDrawBuffers(pass.fbo, (GLsizei)drawBuffers.size(), drawBuffers.data());
+			}
+			GLenum status = glCheckNamedFramebufferStatus(pass.fbo, GL_FRAMEBUFFER);
+			if (status != GL_FRAMEBUFFER_COMPLETE) {
+				printf("Render graph pass %s framebuffer incomplete: 0x%x\n", pass.name.c_str(), status);
+			}
+		}
+	}
+
+	void RenderGraph::release()
+	{
+		for (PhysicalTexture& t : m_physicalTextures) {
+			untrackGpuResource(GpuResourceType::TEXTURE, t.texture);
+			glDeleteTextures(1, &t.texture);
+		}
+		m_physicalTextures.clear();
+		for (Pass& pass : m_passes) {
+			if (pass.fbo != 0) {
+				untrackGpuResource(GpuResourceType::FRAMEBUFFER, pass.fbo);
+				glDeleteFramebuffers(1, &pass.fbo);
+				pass.fbo = 0;
+			}
+		}
+	}
+
+	void RenderGraph::reset()
+	{
+		release();
+		m_passes.clear();
+		m_resources.clear();
+		m_transientBytes = m_unaliasedBytes = 0;
+		m_dirty = true;
+	}
+
+	void RenderGraph::compile()
+	{
+		if (m_width <= 0 || m_height <= 0) {
+			printf("Render graph compiled without an output size. Call resize() first\n");
+		}
+		release();
+		cullPasses();
+		allocateTransients();
+		computeBarriers();
+		createFramebuffers();
+		m_dirty = false;
+	}
+
+	void RenderGraph::execute()
+	{
+		if (m_dirty) {
+			compile();
+		}
+		for (Pass& pass : m_passes) {
+			if (pass.culled) {
+				continue;
+			}
+			auto cpuStart = std::chrono::high_resolution_clock::now();
+			pass.timer.begin();
+			if (pass.barrierBits != 0) {
+				glMemoryBarrier(pass.barrierBits);
+			}
+			if (pass.bindFramebuffer) {
+				glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+				glViewport(0, 0, pass.viewportWidth, pass.viewportHeight);
+			}
+			pass.execute(*this);
+			pass.timer.end();
+			auto cpuEnd = std::chrono::high_resolution_clock::now();
+			pass.cpuMilliseconds = std::chrono::duration<float, std::milli>(cpuEnd - cpuStart).count();
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, m_width, m_height);
+	}
+}
@@ -0,0 +1,136 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include "gpuTimer.h"
+
+namespace ew {
+	//Describes a transient texture owned by the render graph
+	struct RenderTextureDesc {
+		unsigned int format = 0; //Sized internal format, e.g. GL_RGBA8, GL_DEPTH_COMPONENT16
+		float scale = 1.0f; //Size relative to the graph's output size. Ignored if width/height are set
+		int width = 0; //Fixed width in pixels, or 0 to use scale
+		int height = 0; //Fixed height in pixels, or 0 to use scale
+		int mipLevels = 1;
+	};
+
+	//Passes declare which textures they read and write. On compile the graph culls passes
+	//that don't contribute to an imported resource, aliases transient textures with
+	//non-overlapping lifetimes onto a shared pool, builds framebuffers and works out
+	//which memory barriers are needed between passes.
+	class RenderGraph {
+	public:
+		typedef std::function<void(const RenderGraph& graph)> ExecuteFunc;
+
+		class PassBuilder {
+		public:
+			PassBuilder(RenderGraph* graph, int pass) :m_graph(graph), m_pass(pass) {};
+			//Sampled with texture() / texelFetch()
+			PassBuilder& read(int resource);
+			//Read with imageLoad()
+			PassBuilder& readImage(int resource);
+			//Attached as a color target. Attachment index follows call order
+			PassBuilder& writeColor(int resource);
+			//Attached as the depth target
+			PassBuilder& writeDepth(int resource);
+			//Written with imageStore() (e.g. from a compute shader)
+			PassBuilder& writeImage(int resource);
+			//Pass is never culled, even if nothing reads its outputs
+			PassBuilder& sideEffects();
+		private:
+			RenderGraph* m_graph;
+			int m_pass;
+		};
+
+		RenderGraph() {};
+		~RenderGraph();
+		int createTexture(const std::string& name, const RenderTextureDesc& desc);
+		int importTexture(const std::string& name, unsigned int texture, int width, int height, unsigned int format);
+		int importBackbuffer(const std::string& name = "Backbuffer");
+		PassBuilder addPass(const std::string& name, const ExecuteFunc& execute);
+
+		//Sets the output size. Transient textures are reallocated on next execute()
+		void resize(int width, int height);
+		void compile();
+		void execute();
+		//Removes all passes and resources so the graph can be rebuilt
+		void reset();
+
+		//GL texture currently backing a resource. Only valid during/after compile
+		unsigned int getTexture(int resource)const;
+		int getWidth(int resource)const;
+		int getHeight(int resource)const;
+
+		//Stats
+		inline int getNumPasses()const { return (int)m_passes.size(); }
+		inline const std::string& getPassName(int pass)const { return m_passes[pass].name; }
+		inline bool isPassCulled(int pass)const { return m_passes[pass].culled; }
+		inline float getPassGpuMilliseconds(int pass)const { return m_passes[pass].timer.getAverageMilliseconds(); }
+		inline float getPassCpuMilliseconds(int pass)const { return m_passes[pass].cpuMilliseconds; }
+		inline int getNumPhysicalTextures()const { return (int)m_physicalTextures.size(); }
+		//Memory actually allocated for transient textures (the peak, since the pool never shrinks within a frame)
+		inline size_t getTransientBytes()const { return m_transientBytes; }
+		//Memory transient textures would need without aliasing
+		inline size_t getUnaliasedBytes()const { return m_unaliasedBytes; }
+		inline int getOutputWidth()const { return m_width; }
+		inline int getOutputHeight()const { return m_height; }
+	private:
+		struct Resource {
+			std::string name;
+			RenderTextureDesc desc;
+			bool imported = false;
+			bool backbuffer = false;
+			unsigned int texture = 0; //Imported texture handle
+			int width = 0;
+			int height = 0;
+			int physical = -1;
+			int firstPass = -1;
+			int lastPass = -1;
+		};
+		struct Pass {
+			std::string name;
+			ExecuteFunc execute;
+			std::vector<int> reads;
+			std::vector<int> imageReads;
+			std::vector<int> colorWrites;
+			std::vector<int> imageWrites;
+			int depthWrite = -1;
+			bool sideEffects = false;
+			bool culled = false;
+			unsigned int fbo = 0;
+			bool bindFramebuffer = false;
+			int viewportWidth = 0;
+			int viewportHeight = 0;
+			unsigned int barrierBits = 0;
+			GpuTimer timer;
+			float cpuMilliseconds = 0.0f;
+		};
+		struct PhysicalTexture {
+			unsigned int texture = 0;
+			int width = 0;
+			int height = 0;
+			unsigned int format = 0;
+			int mipLevels = 1;
+			bool inUse = false;
+		};
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+		std::vector<PhysicalTexture> m_physicalTextures;
+		int m_width = 0;
+		int m_height = 0;
+		bool m_dirty = true;
+		size_t m_transientBytes = 0;
+		size_t m_unaliasedBytes = 0;
+
+		bool writesResource(const Pass& pass, int resource)const;
+		void cullPasses();
+		void allocateTransients();
+		void computeBarriers();
+		void createFramebuffers();
+		void release();
+	};
+}
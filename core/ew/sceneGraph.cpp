@@ -0,0 +1,298 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "sceneGraph.h"
+#include "model.h"
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace ew {
+	int SceneGraph::addNode(const std::string& name, int parent, const Transform& localTransform)
+	{
+		if (parent >= getNumNodes()) {
+			printf("SceneGraph: parent %d of node %s does not exist\n", parent, name.c_str());
+			parent = NO_PARENT;
+		}
+		int node = getNumNodes();
+		m_names.push_back(name);
+		m_parents.push_back(parent);
+		m_localTransforms.push_back(localTransform);
+		m_worldMatrices.push_back(glm::mat4(1.0f));
+		m_dirty.push_back(1);
+		m_updated.push_back(0);
+		m_firstDirty = std::min(m_firstDirty, node);
+		return node;
+	}
+
+	int SceneGraph::addMesh(const MeshData& meshData)
+	{
+		m_meshes.push_back(ew::Mesh(meshData, m_vertexLayout));
+		m_meshBounds.push_back(computeBounds(meshData));
+		return (int)m_meshes.size() - 1;
+	}
+
+	void SceneGraph::addMeshInstance(int node, int mesh)
+	{
+		m_drawOrder.push_back((int)m_instances.size());
+		m_instances.push_back({ node, mesh });
+	}
+
+	void SceneGraph::setLocalTransform(int node, const Transform& localTransform)
+	{
+		m_localTransforms[node] = localTransform;
+		m_dirty[node] = 1;
+		m_firstDirty = std::min(m_firstDirty, node);
+	}
+
+	void SceneGraph::markAllDirty()
+	{
+		std::fill(m_dirty.begin(), m_dirty.end(), 1);
+		m_firstDirty = 0;
+	}
+
+	/// <summary>
+	/// Parents always precede children, so a node's world matrix can be computed as soon as it's reached.
+	/// A node needs recomputing if it is dirty itself or its parent was recomputed earlier in this pass.
+	/// Nothing before the first dirty node can have changed, so the pass starts there
+	/// </summary>
+	void SceneGraph::updateWorldMatrices()
+	{
+		m_numUpdatedNodes = 0;
+		int numNodes = getNumNodes();
+		int first = m_firstDirty;
+		for (int i = first; i < numNodes; i++)
+		{
+			int parent = m_parents[i];
+			//m_updated is only valid for nodes visited by this pass
+			bool parentUpdated = parent >= first && m_updated[parent];
+			bool update = m_dirty[i] || parentUpdated;
+			m_updated[i] = update;
+			if (!update) {
+				continue;
+			}
+			m_dirty[i] = 0;
+			glm::mat4 local = m_localTransforms[i].modelMatrix();
+			m_worldMatrices[i] = parent == NO_PARENT ? local : m_worldMatrices[parent] * local;
+			m_numUpdatedNodes++;
+		}
+		m_firstDirty = INT32_MAX;
+	}
+
+	/// <summary>
+	/// Sets the model matrix, and the normal matrix when the shader asks for one
+	/// </summary>
+	static void setModelUniforms(const Shader& shader, const glm::mat4& model, const std::string& modelUniform, const std::string& normalMatrixUniform) {
+		shader.setMat4(modelUniform, model);
+		if (!normalMatrixUniform.empty()) {
+			shader.setMat3(normalMatrixUniform, glm::transpose(glm::inverse(glm::mat3(model))));
+		}
+	}
+
+	void SceneGraph::draw(const Shader& shader, const std::string& modelUniform, const std::string& normalMatrixUniform)const
+	{
+		for (int i : m_drawOrder) {
+			const MeshInstance& instance = m_instances[i];
+			setModelUniforms(shader, m_worldMatrices[instance.node], modelUniform, normalMatrixUniform);
+			m_meshes[instance.mesh].draw();
+		}
+	}
+
+	void SceneGraph::draw(const Shader& shader, const glm::mat4& transform, const std::string& modelUniform, const std::string& normalMatrixUniform)const
+	{
+		for (int i : m_drawOrder) {
+			const MeshInstance& instance = m_instances[i];
+			setModelUniforms(shader, transform * m_worldMatrices[instance.node], modelUniform, normalMatrixUniform);
+			m_meshes[instance.mesh].draw();
+		}
+	}
+
+	int SceneGraph::draw(const Shader& shader, const VisibilityTest& isVisible, const std::string& modelUniform, const std::string& normalMatrixUniform)const
+	{
+		int numDrawn = 0;
+		for (int i : m_drawOrder) {
+			const MeshInstance& instance = m_instances[i];
+			const glm::mat4& world = m_worldMatrices[instance.node];
+			if (!isVisible(m_meshBounds[instance.mesh], world)) {
+				continue;
+			}
+			setModelUniforms(shader, world, modelUniform, normalMatrixUniform);
+			m_meshes[instance.mesh].draw();
+			numDrawn++;
+		}
+		return numDrawn;
+	}
+
+	void SceneGraph::drawPositions(const Shader& shader, const std::string& modelUniform)const
+	{
+		for (int i : m_drawOrder) {
+			const MeshInstance& instance = m_instances[i];
+			shader.setMat4(modelUniform, m_worldMatrices[instance.node]);
+			m_meshes[instance.mesh].drawPositions();
+		}
+	}
+
+	int SceneGraph::drawPositions(const Shader& shader, const VisibilityTest& isVisible, const std::string& modelUniform)const
+	{
+		int numDrawn = 0;
+		for (int i : m_drawOrder) {
+			const MeshInstance& instance = m_instances[i];
+			const glm::mat4& world = m_worldMatrices[instance.node];
+			if (!isVisible(m_meshBounds[instance.mesh], world)) {
+				continue;
+			}
+			shader.setMat4(modelUniform, world);
+			m_meshes[instance.mesh].drawPositions();
+			numDrawn++;
+		}
+		return numDrawn;
+	}
+
+	void SceneGraph::sortFrontToBack(const glm::vec3& eyePosition)
+	{
+		//Keys are computed once per instance rather than per comparison
+		m_sortKeys.resize(m_instances.size());
+		for (size_t i = 0; i < m_instances.size(); i++)
+		{
+			const Bounds& bounds = m_meshBounds[m_instances[i].mesh];
+			glm::vec3 center = glm::vec3(m_worldMatrices[m_instances[i].node] * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+			glm::vec3 toCenter = center - eyePosition;
+			m_sortKeys[i] = { glm::dot(toCenter, toCenter), (int)i };
+		}
+		std::sort(m_sortKeys.begin(), m_sortKeys.end());
+		for (size_t i = 0; i < m_sortKeys.size(); i++)
+		{
+			m_drawOrder[i] = m_sortKeys[i].second;
+		}
+	}
+
+	void SceneGraph::resetDrawOrder()
+	{
+		for (size_t i = 0; i < m_drawOrder.size(); i++)
+		{
+			m_drawOrder[i] = (int)i;
+		}
+	}
+
+	int SceneGraph::findNode(const std::string& name)const
+	{
+		for (int i = 0; i < getNumNodes(); i++)
+		{
+			if (m_names[i] == name) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	static Transform convertAiTransform(const aiMatrix4x4& m) {
+		aiVector3D scale, position;
+		aiQuaternion rotation;
+		m.Decompose(scale, rotation, position);
+		Transform transform;
+		transform.position = glm::vec3(position.x, position.y, position.z);
+		transform.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+		transform.scale = glm::vec3(scale.x, scale.y, scale.z);
+		return transform;
+	}
+
+	int SceneGraph::import(const std::string& filePath, int parent, const WeldSettings& weldSettings)
+	{
+		Assimp::Importer importer;
+		const aiScene* aiScene = readAssimpScene(importer, filePath, aiProcess_Triangulate);
+		if (aiScene == NULL || aiScene->mRootNode == NULL) {
+			printf("Failed to load scene %s: %s\n", filePath.c_str(), importer.GetErrorString());
+			return -1;
+		}
+		//Meshes are shared by every node that references them
+		int firstMesh = getNumMeshes();
+		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
+		{
+			ew::MeshData meshData = processAiMesh(aiScene->mMeshes[i]);
+			weldVertices(&meshData, weldSettings);
+			addMesh(meshData);
+		}
+		//Depth first traversal emits parents before children
+		std::vector<std::pair<const aiNode*, int>> stack;
+		stack.push_back({ aiScene->mRootNode, parent });
+		int root = -1;
+		while (!stack.empty()) {
+			const aiNode* aiNode = stack.back().first;
+			int nodeParent = stack.back().second;
+			stack.pop_back();
+			int node = addNode(aiNode->mName.C_Str(), nodeParent, convertAiTransform(aiNode->mTransformation));
+			if (root < 0) {
+				root = node;
+			}
+			for (unsigned int i = 0; i < aiNode->mNumMeshes; i++)
+			{
+				addMeshInstance(node, firstMesh + (int)aiNode->mMeshes[i]);
+			}
+			//Pushed in reverse so children keep their file order
+			for (unsigned int i = aiNode->mNumChildren; i > 0; i--)
+			{
+				stack.push_back({ aiNode->mChildren[i - 1], node });
+			}
+		}
+		return root;
+	}
+
+	SceneGraphBenchmarkResult benchmarkSceneGraphUpdate(int numNodes, int branching, float movingFraction, int iterations)
+	{
+		SceneGraphBenchmarkResult result;
+		result.numNodes = numNodes = std::max(numNodes, 1);
+		branching = std::max(branching, 1);
+		iterations = std::max(iterations, 1);
+
+		//Node i's parent is (i - 1) / branching, which is a breadth first layout of a complete tree
+		SceneGraph graph;
+		std::vector<int> depth(numNodes, 0);
+		Transform local;
+		local.position = glm::vec3(0.0f, 0.1f, 0.0f);
+		for (int i = 0; i < numNodes; i++)
+		{
+			int parent = i == 0 ? SceneGraph::NO_PARENT : (i - 1) / branching;
+			graph.addNode("", parent, local);
+			depth[i] = parent == SceneGraph::NO_PARENT ? 0 : depth[parent] + 1;
+			result.maxDepth = std::max(result.maxDepth, depth[i]);
+		}
+		graph.updateWorldMatrices();
+
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<int> nodeDistribution(0, numNodes - 1);
+		int numMoving = std::max(1, (int)(numNodes * movingFraction));
+		float angle = 0.0f;
+		double fullMs = 0.0, incrementalMs = 0.0;
+		double updatedNodes = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			graph.markAllDirty();
+			auto startTime = std::chrono::high_resolution_clock::now();
+			graph.updateWorldMatrices();
+			auto endTime = std::chrono::high_resolution_clock::now();
+			fullMs += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+			//Picking nodes and setting transforms is part of the incremental cost, as it would be in an app
+			startTime = std::chrono::high_resolution_clock::now();
+			for (int j = 0; j < numMoving; j++)
+			{
+				int node = nodeDistribution(random);
+				local.rotation = glm::angleAxis(angle += 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+				graph.setLocalTransform(node, local);
+			}
+			graph.updateWorldMatrices();
+			endTime = std::chrono::high_resolution_clock::now();
+			incrementalMs += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+			updatedNodes += graph.getNumUpdatedNodes();
+		}
+		result.fullUpdateMilliseconds = (float)(fullMs / iterations);
+		result.incrementalUpdateMilliseconds = (float)(incrementalMs / iterations);
+		result.averageUpdatedNodes = (float)(updatedNodes / iterations);
+		return result;
+	}
+}
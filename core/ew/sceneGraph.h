@@ -0,0 +1,102 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <functional>
+#include "mesh.h"
+#include "shader.h"
+#include "transform.h"
+#include "meshWeld.h"
+
+namespace ew {
+	//Node hierarchy stored as flat arrays, ordered so that every parent comes before its children.
+	//World matrices are only recomputed for nodes whose local transform changed and their descendants,
+	//in a single forward pass starting at the first dirty node.
+	//Meshes are owned by the graph and may be instanced by any number of nodes.
+	class SceneGraph {
+	public:
+		static const int NO_PARENT = -1;
+		//Returns false if an instance with these local bounds and world matrix can be skipped
+		typedef std::function<bool(const Bounds& bounds, const glm::mat4& worldMatrix)> VisibilityTest;
+		SceneGraph() {};
+		//Appends the node tree and meshes of a model file below parent. Returns the new root node, or -1 on failure
+		int import(const std::string& filePath, int parent = NO_PARENT, const WeldSettings& weldSettings = WeldSettings());
+		//Parent must already exist, which keeps the parent-before-child ordering
+		int addNode(const std::string& name, int parent = NO_PARENT, const Transform& localTransform = Transform());
+		int addMesh(const MeshData& meshData);
+		//Vertex layout of meshes added from now on, by addMesh and import
+		inline void setVertexLayout(VertexLayout layout) { m_vertexLayout = layout; }
+		void addMeshInstance(int node, int mesh);
+		void setLocalTransform(int node, const Transform& localTransform);
+		inline const Transform& getLocalTransform(int node)const { return m_localTransforms[node]; }
+		//Valid after updateWorldMatrices()
+		inline const glm::mat4& getWorldMatrix(int node)const { return m_worldMatrices[node]; }
+		void updateWorldMatrices();
+		//Forces every world matrix to be recomputed on the next update
+		void markAllDirty();
+		//Draws every mesh instance, setting modelUniform to the owning node's world matrix.
+		//normalMatrixUniform, when given, is set to the inverse transpose of its upper 3x3, so shaders don't invert it per vertex
+		void draw(const Shader& shader, const std::string& modelUniform = "_Model", const std::string& normalMatrixUniform = "")const;
+		//Draws every mesh instance with model matrices premultiplied by transform
+		void draw(const Shader& shader, const glm::mat4& transform, const std::string& modelUniform = "_Model", const std::string& normalMatrixUniform = "")const;
+		//Draws only instances passing isVisible. Returns the number of instances drawn
+		int draw(const Shader& shader, const VisibilityTest& isVisible, const std::string& modelUniform = "_Model", const std::string& normalMatrixUniform = "")const;
+		//Same as draw, binding only the meshes' position streams. For depth only passes
+		void drawPositions(const Shader& shader, const std::string& modelUniform = "_Model")const;
+		int drawPositions(const Shader& shader, const VisibilityTest& isVisible, const std::string& modelUniform = "_Model")const;
+		//Orders draws by distance from eyePosition to each instance's world space bounds center, nearest first,
+		//so opaque geometry fills the depth buffer early and hidden fragments fail the depth test.
+		//Uses the current world matrices. Draws follow instance order until this is called
+		void sortFrontToBack(const glm::vec3& eyePosition);
+		//Restores instance order
+		void resetDrawOrder();
+		int findNode(const std::string& name)const;
+		inline int getNumNodes()const { return (int)m_parents.size(); }
+		inline int getNumMeshes()const { return (int)m_meshes.size(); }
+		inline int getNumInstances()const { return (int)m_instances.size(); }
+		inline int getInstanceNode(int instance)const { return m_instances[instance].node; }
+		inline int getInstanceMesh(int instance)const { return m_instances[instance].mesh; }
+		inline const Bounds& getMeshBounds(int mesh)const { return m_meshBounds[mesh]; }
+		inline const Mesh& getMesh(int mesh)const { return m_meshes[mesh]; }
+		inline int getParent(int node)const { return m_parents[node]; }
+		inline const std::string& getName(int node)const { return m_names[node]; }
+		//Number of world matrices recomputed by the last update
+		inline int getNumUpdatedNodes()const { return m_numUpdatedNodes; }
+	private:
+		struct MeshInstance {
+			int node;
+			int mesh;
+		};
+		std::vector<std::string> m_names;
+		std::vector<int> m_parents;
+		std::vector<Transform> m_localTransforms;
+		std::vector<glm::mat4> m_worldMatrices;
+		std::vector<uint8_t> m_dirty; //Local transform changed since the last update
+		std::vector<uint8_t> m_updated; //World matrix recomputed by the current update
+		std::vector<ew::Mesh> m_meshes;
+		VertexLayout m_vertexLayout = VertexLayout::INTERLEAVED;
+		std::vector<Bounds> m_meshBounds;
+		std::vector<MeshInstance> m_instances;
+		std::vector<int> m_drawOrder; //Instance indices in the order they are drawn
+		std::vector<std::pair<float, int>> m_sortKeys;
+		int m_firstDirty = INT32_MAX;
+		int m_numUpdatedNodes = 0;
+	};
+
+	struct SceneGraphBenchmarkResult {
+		int numNodes = 0;
+		int maxDepth = 0;
+		float fullUpdateMilliseconds = 0.0f; //Every node dirty
+		float incrementalUpdateMilliseconds = 0.0f; //movingFraction of nodes dirty
+		float averageUpdatedNodes = 0.0f; //Per incremental update, including descendants of moved nodes
+	};
+
+	//Builds a node-only graph where every node has up to branching children (1 = a single deep chain,
+	//numNodes = one wide level under the root), then times full and incremental updates when a random
+	//movingFraction of nodes move each iteration
+	SceneGraphBenchmarkResult benchmarkSceneGraphUpdate(int numNodes, int branching, float movingFraction = 0.01f, int iterations = 100);
+}
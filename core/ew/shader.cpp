@@ -3,27 +3,131 @@
 */
 
 #include "shader.h"
+#include "gpuResources.h"
+#include "assetArchive.h"
 #include <fstream>
 #include <sstream>
+#include <set>
 #include "external/glad.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 namespace ew {
+	/// <summary>
+	/// Reads a whole source file, from the mounted asset archive if it has it
+	/// </summary>
+	static bool readSourceFile(const std::string& filePath, std::string* source) {
+		AssetData asset;
+		if (readMountedAsset(filePath, &asset)) {
+			source->assign(asset.data, asset.size);
+			return true;
+		}
+		std::ifstream fstream(filePath);
+		if (!fstream.is_open()) {
+			return false;
+		}
+		std::stringstream buffer;
+		buffer << fstream.rdbuf();
+		*source = buffer.str();
+		return true;
+	}
+
 	/// <summary>
 	/// Loads shader source code from a file.
 	/// </summary>
 	/// <param name="filePath"></param>
 	/// <returns></returns>
 	std::string loadShaderSourceFromFile(const std::string& filePath) {
-		std::ifstream fstream(filePath);
-		if (!fstream.is_open()) {
+		std::string source;
+		if (!readSourceFile(filePath, &source)) {
 			printf("Failed to load file %s", filePath.c_str());
 			return {};
 		}
-		std::stringstream buffer;
-		buffer << fstream.rdbuf();
-		return buffer.str();
+		return source;
+	}
+
+	/// <summary>
+	/// Appends a file's source to result, expanding its #include lines in place.
+	/// #line directives keep compile errors pointing at the right line. Their source string number is the
+	/// order files were first included in, 0 being the top level file
+	/// </summary>
+	static bool appendWithIncludes(const std::string& filePath, int fileIndex, std::set<std::string>* included, std::string* result) {
+		std::string source;
+		if (!readSourceFile(filePath, &source)) {
+			printf("Failed to load file %s\n", filePath.c_str());
+			return false;
+		}
+		std::istringstream stream(source);
+		size_t slash = filePath.find_last_of("/\\");
+		std::string directory = slash == std::string::npos ? "" : filePath.substr(0, slash + 1);
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(stream, line)) {
+			lineNumber++;
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+				*result += line + "\n";
+				continue;
+			}
+			size_t open = line.find('"', start + 8);
+			size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				printf("%s(%d): #include expects a \"file\"\n", filePath.c_str(), lineNumber);
+				return false;
+			}
+			std::string includePath = normalizeAssetPath(directory + line.substr(open + 1, close - open - 1));
+			//Also stops include cycles
+			if (included->insert(includePath).second) {
+				int includeIndex = (int)included->size() - 1;
+				*result += "#line 1 " + std::to_string(includeIndex) + "\n";
+				if (!appendWithIncludes(includePath, includeIndex, included, result)) {
+					return false;
+				}
+			}
+			*result += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Loads shader source code from a file, resolving #include "file" directives relative to the including file.
+	/// Included files must not have a #version directive
+	/// </summary>
+	/// <param name="filePath"></param>
+	/// <returns>Source with every include expanded, or an empty string if a file is missing</returns>
+	std::string loadShaderSourceWithIncludes(const std::string& filePath) {
+		std::set<std::string> included = { normalizeAssetPath(filePath) };
+		std::string result;
+		if (!appendWithIncludes(filePath, 0, &included, &result)) {
+			return {};
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// Inserts #define lines directly after the #version directive of a shader source.
+	/// </summary>
+	/// <param name="source">GLSL source code</param>
+	/// <param name="defines">Defines in the form "NAME" or "NAME VALUE"</param>
+	/// <returns>Source code with defines inserted</returns>
+	std::string insertDefines(const std::string& source, const std::vector<std::string>& defines) {
+		if (defines.empty()) {
+			return source;
+		}
+		std::string defineBlock;
+		for (const std::string& define : defines) {
+			defineBlock += "#define " + define + "\n";
+		}
+		//#version must remain the first statement, so defines go on the line after it
+		size_t insertPos = 0;
+		size_t versionPos = source.find("#version");
+		if (versionPos != std::string::npos) {
+			size_t lineEnd = source.find('\n', versionPos);
+			insertPos = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+		}
+		std::string result = source;
+		result.insert(insertPos, defineBlock);
+		return result;
 	}
 
 	/// <summary>
@@ -79,15 +183,150 @@ namespace ew {
 		return shaderProgram;
 	}
 	/// <summary>
+	/// Creates a shader program with vertex, geometry and fragment shaders
+	/// </summary>
+	/// <param name="vertexShaderSource">GLSL source code for the vertex shader</param>
+	/// <param name="geometryShaderSource">GLSL source code for the geometry shader</param>
+	/// <param name="fragmentShaderSource">GLSL source code for the fragment shader</param>
+	/// <returns></returns>
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* geometryShaderSource, const char* fragmentShaderSource) {
+		unsigned int vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
+		unsigned int geometryShader = createShader(GL_GEOMETRY_SHADER, geometryShaderSource);
+		unsigned int fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+
+		unsigned int shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, vertexShader);
+		glAttachShader(shaderProgram, geometryShader);
+		glAttachShader(shaderProgram, fragmentShader);
+		glLinkProgram(shaderProgram);
+		int success;
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+			printf("Failed to link shader program: %s", infoLog);
+		}
+		glDeleteShader(vertexShader);
+		glDeleteShader(geometryShader);
+		glDeleteShader(fragmentShader);
+		return shaderProgram;
+	}
+	/// <summary>
+	/// Creates a shader program with a single compute stage
+	/// </summary>
+	/// <param name="computeShaderSource">GLSL source code for the compute shader</param>
+	/// <returns></returns>
+	unsigned int createComputeShaderProgram(const char* computeShaderSource) {
+		unsigned int computeShader = createShader(GL_COMPUTE_SHADER, computeShaderSource);
+		unsigned int shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, computeShader);
+		glLinkProgram(shaderProgram);
+		int success;
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+			printf("Failed to link compute shader program: %s", infoLog);
+		}
+		glDeleteShader(computeShader);
+		return shaderProgram;
+	}
+	/// <summary>
 	/// Creates a shader instance with vertex + fragment stages
 	/// </summary>
 	/// <param name="vertexShader">File path to vertex shader</param>
 	/// <param name="fragmentShader">File path to fragment shader</param>
 	Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader)
 	{
-		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader.c_str());
-		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader.c_str());
+		std::string vertexShaderSource = ew::loadShaderSourceWithIncludes(vertexShader);
+		std::string fragmentShaderSource = ew::loadShaderSourceWithIncludes(fragmentShader);
 		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		track(vertexShader + " + " + fragmentShader);
+	}
+	/// <summary>
+	/// Creates a shader variant with the given preprocessor defines injected into both stages
+	/// </summary>
+	/// <param name="vertexShader">File path to vertex shader</param>
+	/// <param name="fragmentShader">File path to fragment shader</param>
+	/// <param name="defines">Defines in the form "NAME" or "NAME VALUE"</param>
+	Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines)
+	{
+		std::string vertexShaderSource = ew::insertDefines(ew::loadShaderSourceWithIncludes(vertexShader), defines);
+		std::string fragmentShaderSource = ew::insertDefines(ew::loadShaderSourceWithIncludes(fragmentShader), defines);
+		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		std::string label = vertexShader + " + " + fragmentShader;
+		for (const std::string& define : defines) {
+			label += " " + define;
+		}
+		track(label);
+	}
+	/// <summary>
+	/// Creates a shader instance with vertex + geometry + fragment stages
+	/// </summary>
+	/// <param name="vertexShader">File path to vertex shader</param>
+	/// <param name="geometryShader">File path to geometry shader</param>
+	/// <param name="fragmentShader">File path to fragment shader</param>
+	Shader::Shader(const std::string& vertexShader, const std::string& geometryShader, const std::string& fragmentShader)
+	{
+		std::string vertexShaderSource = ew::loadShaderSourceWithIncludes(vertexShader);
+		std::string geometryShaderSource = ew::loadShaderSourceWithIncludes(geometryShader);
+		std::string fragmentShaderSource = ew::loadShaderSourceWithIncludes(fragmentShader);
+		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), geometryShaderSource.c_str(), fragmentShaderSource.c_str());
+		track(vertexShader + " + " + geometryShader + " + " + fragmentShader);
+	}
+	/// <summary>
+	/// Creates a compute shader instance
+	/// </summary>
+	/// <param name="computeShader">File path to compute shader</param>
+	Shader::Shader(const std::string& computeShader)
+	{
+		std::string computeShaderSource = ew::loadShaderSourceWithIncludes(computeShader);
+		m_id = ew::createComputeShaderProgram(computeShaderSource.c_str());
+		track(computeShader);
+	}
+	/// <summary>
+	/// Wraps a program linked elsewhere, e.g. by ShaderCache's compile thread
+	/// </summary>
+	/// <param name="program">Linked program handle. Deleted with the shader</param>
+	/// <param name="label">Name shown in the GPU resource registry</param>
+	Shader::Shader(unsigned int program, const std::string& label)
+	{
+		m_id = program;
+		track(label);
+	}
+	Shader::~Shader()
+	{
+		if (m_id != 0) {
+			untrackGpuResource(GpuResourceType::PROGRAM, m_id);
+			glDeleteProgram(m_id);
+		}
+	}
+	Shader::Shader(Shader&& other) noexcept
+	{
+		m_id = other.m_id;
+		other.m_id = 0;
+	}
+	Shader& Shader::operator=(Shader&& other) noexcept
+	{
+		if (this != &other) {
+			if (m_id != 0) {
+				untrackGpuResource(GpuResourceType::PROGRAM, m_id);
+				glDeleteProgram(m_id);
+			}
+			m_id = other.m_id;
+			other.m_id = 0;
+		}
+		return *this;
+	}
+	/// <summary>
+	/// Registers the program with the GPU resource registry. The size of its binary is the best
+	/// estimate GL offers of the memory it takes up
+	/// </summary>
+	void Shader::track(const std::string& label)
+	{
+		GLint binaryLength = 0;
+		glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+		trackGpuResource(GpuResourceType::PROGRAM, m_id, (size_t)binaryLength, label);
 	}
 	void Shader::use()const
 	{
@@ -131,10 +370,18 @@ namespace ew {
 	{
 		setVec4(name, v.x, v.y, v.z, v.w);
 	}
+	void Shader::setMat3(const std::string& name, const glm::mat3& m) const
+	{
+		glUniformMatrix3fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
+	}
 	void Shader::setMat4(const std::string& name, const glm::mat4& m) const
 	{
 		glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
 	}
+	void Shader::setFloatArray(const std::string& name, const float* v, int count) const
+	{
+		glUniform1fv(glGetUniformLocation(m_id, name.c_str()), count, v);
+	}
 
 
 
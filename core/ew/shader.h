@@ -4,14 +4,32 @@
 
 #pragma once
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 namespace ew {
 	std::string loadShaderSourceFromFile(const std::string& filePath);
+	//Loads a shader and replaces each #include "file" line with that file, relative to the including file.
+	//Every file is included at most once
+	std::string loadShaderSourceWithIncludes(const std::string& filePath);
+	std::string insertDefines(const std::string& source, const std::vector<std::string>& defines);
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* geometryShaderSource, const char* fragmentShaderSource);
+	unsigned int createComputeShaderProgram(const char* computeShaderSource);
+	//Owns its program, which is deleted with it. Move-only so handles are never shared
 	class Shader {
 	public:
 		Shader(const std::string& vertexShader, const std::string& fragmentShader);
+		Shader(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines);
+		Shader(const std::string& vertexShader, const std::string& geometryShader, const std::string& fragmentShader);
+		explicit Shader(const std::string& computeShader);
+		//Takes ownership of an already linked program
+		Shader(unsigned int program, const std::string& label);
+		~Shader();
+		Shader(Shader&& other) noexcept;
+		Shader& operator=(Shader&& other) noexcept;
+		Shader(const Shader&) = delete;
+		Shader& operator=(const Shader&) = delete;
 		void use()const;
 		void setInt(const std::string& name, int v) const;
 		void setFloat(const std::string& name, float v) const;
@@ -22,9 +40,13 @@ namespace ew {
 		void setVec3(const std::string& name, const glm::vec3& v) const;
 		void setVec4(const std::string& name, float x, float y, float z, float w) const;
 		void setVec4(const std::string& name, const glm::vec4& v) const;
+		void setMat3(const std::string& name, const glm::mat3& m) const;
 		void setMat4(const std::string& name, const glm::mat4& m) const;
+		void setFloatArray(const std::string& name, const float* v, int count) const;
+		inline unsigned int getProgram()const { return m_id; }
 
 	private:
-		unsigned int m_id; //Shader program handle
+		unsigned int m_id = 0; //Shader program handle
+		void track(const std::string& label);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "shaderVariants.h"
+#include "external/glad.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <chrono>
+#include <utility>
+
+namespace ew {
+	/// <summary>
+	/// 64 bit FNV-1a hash
+	/// </summary>
+	static uint64_t hashSource(const std::string& source) {
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char c : source) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	ShaderCache::~ShaderCache()
+	{
+		stopBackgroundCompiler();
+	}
+
+	/// <summary>
+	/// Starts compiling asynchronous requests on a background thread
+	/// </summary>
+	/// <param name="mainWindow">Window whose context the programs are used in</param>
+	/// <returns>False if the shared context could not be created. Requests are then compiled when made</returns>
+	bool ShaderCache::startBackgroundCompiler(GLFWwindow* mainWindow)
+	{
+		if (m_compileWindow != nullptr) {
+			return true;
+		}
+		//Only the context is needed. It has the main window's hints, so the two are compatible
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		m_compileWindow = glfwCreateWindow(1, 1, "Shader compiler", NULL, mainWindow);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (m_compileWindow == nullptr) {
+			printf("ShaderCache failed to create a shared context, compiling on the main thread\n");
+			return false;
+		}
+		m_stopping = false;
+		m_compileThread = std::thread(&ShaderCache::compileLoop, this);
+		return true;
+	}
+
+	/// <summary>
+	/// Finishes every queued compile, then stops the thread and destroys its context
+	/// </summary>
+	void ShaderCache::stopBackgroundCompiler()
+	{
+		if (m_compileWindow == nullptr) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_jobAdded.notify_all();
+		m_compileThread.join();
+		glfwDestroyWindow(m_compileWindow);
+		m_compileWindow = nullptr;
+		update();
+	}
+
+	void ShaderCache::compileLoop()
+	{
+		glfwMakeContextCurrent(m_compileWindow);
+		while (true) {
+			CompileJob job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobAdded.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+				if (m_jobs.empty()) {
+					break;
+				}
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			auto startTime = std::chrono::high_resolution_clock::now();
+			unsigned int program = createShaderProgram(job.vertexSource.c_str(), job.fragmentSource.c_str());
+			//Another context is only guaranteed to see the linked program once this one's commands have completed
+			glFinish();
+			auto endTime = std::chrono::high_resolution_clock::now();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_compiled.push_back({ job.slot, program, std::chrono::duration<float, std::milli>(endTime - startTime).count() });
+			}
+			m_programCompiled.notify_all();
+		}
+		glfwMakeContextCurrent(nullptr);
+	}
+
+	/// <summary>
+	/// Finds or creates the slot for a program
+	/// </summary>
+	/// <param name="vertexSource">Final vertex shader source, with defines and includes already in it</param>
+	/// <param name="fragmentSource">Final fragment shader source</param>
+	/// <param name="label">Name shown in the GPU resource registry</param>
+	/// <param name="async">Compile on the background thread, if it is running</param>
+	/// <returns>Slot index, for getShader and waitForShader</returns>
+	int ShaderCache::request(const std::string& vertexSource, const std::string& fragmentSource, const std::string& label, bool async)
+	{
+		m_numRequests++;
+		std::string source = vertexSource + '\0' + fragmentSource;
+		std::vector<int>& candidates = m_slotsByHash[hashSource(source)];
+		for (int slot : candidates) {
+			if (m_slots[slot].source == source) {
+				m_numDeduplicated++;
+				return slot;
+			}
+		}
+		int slot = (int)m_slots.size();
+		candidates.push_back(slot);
+		m_slots.push_back({ std::move(source), label, nullptr });
+
+		if (async && m_compileWindow != nullptr) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_jobs.push_back({ slot, vertexSource, fragmentSource });
+			}
+			m_numPending++;
+			m_jobAdded.notify_one();
+			return slot;
+		}
+		auto startTime = std::chrono::high_resolution_clock::now();
+		unsigned int program = createShaderProgram(vertexSource.c_str(), fragmentSource.c_str());
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_compileMilliseconds += std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		m_slots[slot].shader = std::make_unique<Shader>(program, label);
+		return slot;
+	}
+
+	void ShaderCache::adopt(const CompiledProgram& compiled)
+	{
+		Slot& slot = m_slots[compiled.slot];
+		slot.shader = std::make_unique<Shader>(compiled.program, slot.label);
+		m_compileMilliseconds += compiled.milliseconds;
+		m_numPending--;
+	}
+
+	void ShaderCache::update()
+	{
+		std::vector<CompiledProgram> compiled;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			compiled.swap(m_compiled);
+		}
+		for (const CompiledProgram& program : compiled) {
+			adopt(program);
+		}
+	}
+
+	const Shader* ShaderCache::getShader(int slot)const
+	{
+		if (slot < 0 || slot >= (int)m_slots.size()) {
+			return nullptr;
+		}
+		return m_slots[slot].shader.get();
+	}
+
+	const Shader* ShaderCache::waitForShader(int slot)
+	{
+		if (slot < 0 || slot >= (int)m_slots.size()) {
+			return nullptr;
+		}
+		//Only pending slots are missing a shader, and the thread finishes its queue before stopping
+		while (m_slots[slot].shader == nullptr) {
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_programCompiled.wait(lock, [this] { return !m_compiled.empty(); });
+			}
+			update();
+		}
+		return m_slots[slot].shader.get();
+	}
+
+	/// <summary>
+	/// Loads both stages and resolves their includes once. Nothing is compiled until a variant is asked for
+	/// </summary>
+	/// <param name="cache">Compiles and owns the programs</param>
+	/// <param name="vertexShader">File path to vertex shader</param>
+	/// <param name="fragmentShader">File path to fragment shader</param>
+	/// <param name="features">Define per mask bit, in the form "NAME" or "NAME VALUE". At most MAX_FEATURES</param>
+	/// <param name="defines">Defines every variant has</param>
+	ShaderVariants::ShaderVariants(ShaderCache* cache, const std::string& vertexShader, const std::string& fragmentShader,
+		const std::vector<std::string>& features, const std::vector<std::string>& defines)
+		:m_cache(cache), m_features(features), m_defines(defines)
+	{
+		if (m_features.size() > MAX_FEATURES) {
+			printf("ShaderVariants supports %d features, %d were given\n", MAX_FEATURES, (int)m_features.size());
+			m_features.resize(MAX_FEATURES);
+		}
+		m_label = vertexShader + " + " + fragmentShader;
+		m_vertexSource = loadShaderSourceWithIncludes(vertexShader);
+		m_fragmentSource = loadShaderSourceWithIncludes(fragmentShader);
+		for (size_t i = 0; i < m_features.size(); i++)
+		{
+			//A name that appears only as part of a longer one still counts. That only costs a duplicate program
+			std::string name = m_features[i].substr(0, m_features[i].find(' '));
+			if (m_vertexSource.find(name) != std::string::npos || m_fragmentSource.find(name) != std::string::npos) {
+				m_usedFeatures |= 1u << i;
+			}
+		}
+		m_slots.assign((size_t)1 << m_features.size(), -1);
+	}
+
+	unsigned int ShaderVariants::getMask(const std::string& feature)const
+	{
+		for (size_t i = 0; i < m_features.size(); i++)
+		{
+			if (m_features[i] == feature) {
+				return 1u << i;
+			}
+		}
+		return 0;
+	}
+
+	int ShaderVariants::requestSlot(unsigned int mask, bool async)
+	{
+		mask &= m_usedFeatures;
+		if (m_slots[mask] >= 0) {
+			return m_slots[mask];
+		}
+		std::vector<std::string> defines = m_defines;
+		std::string label = m_label;
+		for (size_t i = 0; i < m_features.size(); i++)
+		{
+			if (mask & (1u << i)) {
+				defines.push_back(m_features[i]);
+				label += " " + m_features[i];
+			}
+		}
+		m_slots[mask] = m_cache->request(insertDefines(m_vertexSource, defines), insertDefines(m_fragmentSource, defines), label, async);
+		return m_slots[mask];
+	}
+
+	const Shader* ShaderVariants::get(unsigned int mask)
+	{
+		return m_cache->waitForShader(requestSlot(mask, false));
+	}
+
+	const Shader* ShaderVariants::tryGet(unsigned int mask)
+	{
+		return m_cache->getShader(requestSlot(mask, true));
+	}
+
+	void ShaderVariants::precompile(unsigned int mask)
+	{
+		requestSlot(mask, true);
+	}
+
+	void ShaderVariants::precompileAll()
+	{
+		for (unsigned int mask = 0; mask < (unsigned int)m_slots.size(); mask++)
+		{
+			//Masks with unused bits share a slot with one already queued
+			if ((mask & ~m_usedFeatures) == 0) {
+				precompile(mask);
+			}
+		}
+	}
+}
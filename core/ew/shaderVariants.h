@@ -0,0 +1,118 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "shader.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <stdint.h>
+
+struct GLFWwindow;
+
+namespace ew {
+	//Linked programs, deduplicated by a hash of their final source so identical permutations are compiled once,
+	//whichever ShaderVariants asks for them. Can compile on a background thread with its own GL context,
+	//shared with the main one so the programs it links can be used by either
+	class ShaderCache {
+	public:
+		ShaderCache() {};
+		~ShaderCache();
+		ShaderCache(const ShaderCache&) = delete;
+		ShaderCache& operator=(const ShaderCache&) = delete;
+		//Creates a hidden window sharing mainWindow's context and starts the compile thread.
+		//GLFW windows can only be created on the main thread, so this must be called from it
+		bool startBackgroundCompiler(GLFWwindow* mainWindow);
+		void stopBackgroundCompiler();
+		//Returns the slot holding the program for these sources, compiling it if no slot has the same source.
+		//Asynchronous requests are compiled on the background thread, when it is running
+		int request(const std::string& vertexSource, const std::string& fragmentSource, const std::string& label, bool async);
+		//Adopts programs finished by the background thread. Call once per frame on the main thread
+		void update();
+		//Null while the slot is still compiling
+		const Shader* getShader(int slot)const;
+		//Blocks until the slot's program is linked
+		const Shader* waitForShader(int slot);
+
+		inline int getNumPrograms()const { return (int)m_slots.size(); }
+		inline int getNumRequests()const { return m_numRequests; }
+		//Requests that found a program with the same source already compiled or compiling
+		inline int getNumDeduplicated()const { return m_numDeduplicated; }
+		inline int getNumPending()const { return m_numPending; }
+		//Total time spent compiling and linking, on either thread
+		inline float getCompileMilliseconds()const { return m_compileMilliseconds; }
+		inline bool isBackgroundCompilerRunning()const { return m_compileWindow != nullptr; }
+	private:
+		struct Slot {
+			std::string source; //Vertex and fragment source, compared on hash matches
+			std::string label;
+			std::unique_ptr<Shader> shader; //Stays put while slots are added
+		};
+		struct CompileJob {
+			int slot = 0;
+			std::string vertexSource;
+			std::string fragmentSource;
+		};
+		struct CompiledProgram {
+			int slot = 0;
+			unsigned int program = 0;
+			float milliseconds = 0.0f;
+		};
+		std::vector<Slot> m_slots;
+		std::unordered_map<uint64_t, std::vector<int>> m_slotsByHash;
+		int m_numRequests = 0;
+		int m_numDeduplicated = 0;
+		int m_numPending = 0;
+		float m_compileMilliseconds = 0.0f;
+
+		GLFWwindow* m_compileWindow = nullptr;
+		std::thread m_compileThread;
+		std::mutex m_mutex;
+		std::condition_variable m_jobAdded;
+		std::condition_variable m_programCompiled;
+		std::deque<CompileJob> m_jobs;
+		std::vector<CompiledProgram> m_compiled;
+		bool m_stopping = false;
+		void compileLoop();
+		void adopt(const CompiledProgram& compiled);
+	};
+
+	//Permutations of one vertex and fragment shader pair. Each feature is a define, and bit i of a mask
+	//enables features[i]. Variants are compiled the first time they are asked for, or ahead of time with precompile.
+	//Selecting an already requested variant is a table lookup
+	class ShaderVariants {
+	public:
+		static const int MAX_FEATURES = 8;
+
+		ShaderVariants(ShaderCache* cache, const std::string& vertexShader, const std::string& fragmentShader,
+			const std::vector<std::string>& features, const std::vector<std::string>& defines = {});
+		//Mask with only this feature's bit set, 0 if there is no such feature
+		unsigned int getMask(const std::string& feature)const;
+		//Compiles the variant if needed. Waits for it if it is compiling in the background
+		const Shader* get(unsigned int mask);
+		//Queues the variant for background compilation if needed. Null until it is ready
+		const Shader* tryGet(unsigned int mask);
+		void precompile(unsigned int mask);
+		//Every combination of features
+		void precompileAll();
+		inline int getNumFeatures()const { return (int)m_features.size(); }
+	private:
+		ShaderCache* m_cache;
+		std::string m_label;
+		std::string m_vertexSource;
+		std::string m_fragmentSource;
+		std::vector<std::string> m_features;
+		std::vector<std::string> m_defines;
+		//Features whose name appears in neither stage have no effect, so they are masked out
+		//and share a program with the variants without them
+		unsigned int m_usedFeatures = 0;
+		std::vector<int> m_slots; //Cache slot per mask, -1 until requested
+		int requestSlot(unsigned int mask, bool async);
+	};
+}
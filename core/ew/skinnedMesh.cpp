@@ -0,0 +1,380 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "skinnedMesh.h"
+#include "model.h"
+#include "gpuResources.h"
+#include "external/glad.h"
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+namespace ew {
+	void setSkinWeights(SkinnedVertex* vertex, const int* joints, const float* weights, int count)
+	{
+		//Largest weights first
+		int order[MAX_JOINTS_PER_VERTEX];
+		int numKept = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (weights[i] <= 0.0f) {
+				continue;
+			}
+			int slot;
+			if (numKept < MAX_JOINTS_PER_VERTEX) {
+				slot = numKept++;
+			}
+			else if (weights[i] > weights[order[MAX_JOINTS_PER_VERTEX - 1]]) {
+				slot = MAX_JOINTS_PER_VERTEX - 1;
+			}
+			else {
+				continue;
+			}
+			order[slot] = i;
+			while (slot > 0 && weights[order[slot - 1]] < weights[order[slot]]) {
+				std::swap(order[slot - 1], order[slot]);
+				slot--;
+			}
+		}
+		for (int i = 0; i < MAX_JOINTS_PER_VERTEX; i++)
+		{
+			vertex->joints[i] = 0;
+			vertex->weights[i] = 0;
+		}
+		//Unweighted vertices follow the first joint
+		if (numKept == 0) {
+			vertex->weights[0] = 255;
+			return;
+		}
+		float total = 0.0f;
+		for (int i = 0; i < numKept; i++)
+		{
+			total += weights[order[i]];
+		}
+		int sum = 0;
+		for (int i = 0; i < numKept; i++)
+		{
+			vertex->joints[i] = (unsigned char)std::min(std::max(joints[order[i]], 0), MAX_SKIN_JOINTS - 1);
+			vertex->weights[i] = (unsigned char)lroundf(weights[order[i]] / total * 255.0f);
+			sum += vertex->weights[i];
+		}
+		//Rounding error goes to the largest weight, so the weights always sum to exactly 1
+		vertex->weights[0] = (unsigned char)(vertex->weights[0] + 255 - sum);
+	}
+
+	SkinnedMesh::SkinnedMesh(const SkinnedMeshData& meshData)
+	{
+		load(meshData);
+	}
+
+	SkinnedMesh::~SkinnedMesh()
+	{
+		release();
+	}
+
+	SkinnedMesh::SkinnedMesh(SkinnedMesh&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	SkinnedMesh& SkinnedMesh::operator=(SkinnedMesh&& other) noexcept
+	{
+		if (this != &other) {
+			release();
+			m_vao = other.m_vao;
+			m_vbo = other.m_vbo;
+			m_ebo = other.m_ebo;
+			m_numVertices = other.m_numVertices;
+			m_numIndices = other.m_numIndices;
+			other.m_vao = other.m_vbo = other.m_ebo = 0;
+			other.m_numVertices = other.m_numIndices = 0;
+		}
+		return *this;
+	}
+
+	void SkinnedMesh::release()
+	{
+		if (m_vao == 0) {
+			return;
+		}
+		untrackGpuResource(GpuResourceType::VERTEX_ARRAY, m_vao);
+		untrackGpuResource(GpuResourceType::BUFFER, m_vbo);
+		untrackGpuResource(GpuResourceType::BUFFER, m_ebo);
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ebo);
+		m_vao = m_vbo = m_ebo = 0;
+		m_numVertices = m_numIndices = 0;
+	}
+
+	void SkinnedMesh::load(const SkinnedMeshData& meshData)
+	{
+		release();
+		if (meshData.vertices.empty() || meshData.indices.empty()) {
+			return;
+		}
+		m_numVertices = (int)meshData.vertices.size();
+		m_numIndices = (int)meshData.indices.size();
+		size_t vertexBytes = sizeof(SkinnedVertex) * meshData.vertices.size();
+		size_t indexBytes = sizeof(unsigned int) * meshData.indices.size();
+		glCreateBuffers(1, &m_vbo);
+		glNamedBufferStorage(m_vbo, vertexBytes, meshData.vertices.data(), 0);
+		glCreateBuffers(1, &m_ebo);
+		glNamedBufferStorage(m_ebo, indexBytes, meshData.indices.data(), 0);
+
+		glCreateVertexArrays(1, &m_vao);
+		glVertexArrayVertexBuffer(m_vao, 0, m_vbo, 0, sizeof(SkinnedVertex));
+		glVertexArrayElementBuffer(m_vao, m_ebo);
+		glEnableVertexArrayAttrib(m_vao, 0);
+		glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(SkinnedVertex, pos));
+		glVertexArrayAttribBinding(m_vao, 0, 0);
+		glEnableVertexArrayAttrib(m_vao, 1);
+		glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(SkinnedVertex, normal));
+		glVertexArrayAttribBinding(m_vao, 1, 0);
+		glEnableVertexArrayAttrib(m_vao, 2);
+		glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(SkinnedVertex, uv));
+		glVertexArrayAttribBinding(m_vao, 2, 0);
+		//Joint indices stay integers
+		glEnableVertexArrayAttrib(m_vao, 3);
+		glVertexArrayAttribIFormat(m_vao, 3, 4, GL_UNSIGNED_BYTE, offsetof(SkinnedVertex, joints));
+		glVertexArrayAttribBinding(m_vao, 3, 0);
+		//Weights are normalized to 0-1
+		glEnableVertexArrayAttrib(m_vao, 4);
+		glVertexArrayAttribFormat(m_vao, 4, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(SkinnedVertex, weights));
+		glVertexArrayAttribBinding(m_vao, 4, 0);
+
+		trackGpuResource(GpuResourceType::VERTEX_ARRAY, m_vao, 0, "Skinned mesh");
+		trackGpuResource(GpuResourceType::BUFFER, m_vbo, vertexBytes, "Skinned mesh vertices");
+		trackGpuResource(GpuResourceType::BUFFER, m_ebo, indexBytes, "Skinned mesh indices");
+	}
+
+	void SkinnedMesh::draw() const
+	{
+		drawInstanced(1);
+	}
+
+	void SkinnedMesh::drawInstanced(int numInstances) const
+	{
+		if (m_vao == 0) {
+			return;
+		}
+		glBindVertexArray(m_vao);
+		glDrawElementsInstanced(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL, numInstances);
+	}
+
+	SkinningPalette::~SkinningPalette()
+	{
+		release();
+	}
+
+	SkinningPalette::SkinningPalette(SkinningPalette&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	SkinningPalette& SkinningPalette::operator=(SkinningPalette&& other) noexcept
+	{
+		if (this != &other) {
+			release();
+			m_buffer = other.m_buffer;
+			m_numMatrices = other.m_numMatrices;
+			other.m_buffer = 0;
+			other.m_numMatrices = 0;
+		}
+		return *this;
+	}
+
+	void SkinningPalette::release()
+	{
+		if (m_buffer == 0) {
+			return;
+		}
+		untrackGpuResource(GpuResourceType::BUFFER, m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		m_numMatrices = 0;
+	}
+
+	void SkinningPalette::upload(const glm::mat4* matrices, int count)
+	{
+		if (m_buffer == 0) {
+			glCreateBuffers(1, &m_buffer);
+			trackGpuResource(GpuResourceType::BUFFER, m_buffer, 0, "Skinning palette");
+		}
+		size_t bytes = sizeof(glm::mat4) * count;
+		glNamedBufferData(m_buffer, bytes, matrices, GL_STREAM_DRAW);
+		if (count != m_numMatrices) {
+			resizeGpuResource(GpuResourceType::BUFFER, m_buffer, bytes);
+			m_numMatrices = count;
+		}
+	}
+
+	void SkinningPalette::bind(unsigned int binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_buffer);
+	}
+
+	static glm::mat4 convertAIMat4(const aiMatrix4x4& m) {
+		//Assimp is row major
+		return glm::mat4(
+			glm::vec4(m.a1, m.b1, m.c1, m.d1),
+			glm::vec4(m.a2, m.b2, m.c2, m.d2),
+			glm::vec4(m.a3, m.b3, m.c3, m.d3),
+			glm::vec4(m.a4, m.b4, m.c4, m.d4));
+	}
+
+	static glm::vec3 convertAIVector(const aiVector3D& v) {
+		return glm::vec3(v.x, v.y, v.z);
+	}
+
+	static glm::quat convertAIQuaternion(const aiQuaternion& q) {
+		return glm::quat(q.w, q.x, q.y, q.z);
+	}
+
+	/// <summary>
+	/// True if node or any of its descendants is a bone
+	/// </summary>
+	static bool hasBone(const aiNode* node, const std::unordered_map<std::string, glm::mat4>& bones) {
+		if (bones.count(node->mName.C_Str()) > 0) {
+			return true;
+		}
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		{
+			if (hasBone(node->mChildren[i], bones)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// <summary>
+	/// Adds node and its descendants that lead to bones, parents first
+	/// </summary>
+	static void addJoints(const aiNode* node, int parent, const std::unordered_map<std::string, glm::mat4>& bones, Skeleton* skeleton) {
+		if (!hasBone(node, bones)) {
+			return;
+		}
+		aiVector3D scaling, position;
+		aiQuaternion rotation;
+		node->mTransformation.Decompose(scaling, rotation, position);
+		auto bone = bones.find(node->mName.C_Str());
+		glm::mat4 inverseBindMatrix = bone != bones.end() ? bone->second : glm::mat4(1.0f);
+		int joint = skeleton->addJoint(node->mName.C_Str(), parent, convertAIVector(position), convertAIQuaternion(rotation), convertAIVector(scaling), inverseBindMatrix);
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		{
+			addJoints(node->mChildren[i], joint, bones, skeleton);
+		}
+	}
+
+	bool loadSkinnedModelData(const std::string& filePath, SkinnedModelData* model, float sampleRate)
+	{
+		*model = SkinnedModelData();
+		Assimp::Importer importer;
+		const aiScene* aiScene = readAssimpScene(importer, filePath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_LimitBoneWeights);
+		if (aiScene == NULL) {
+			printf("Failed to load model %s: %s\n", filePath.c_str(), importer.GetErrorString());
+			return false;
+		}
+		//Bind pose of every bone, by name
+		std::unordered_map<std::string, glm::mat4> bones;
+		for (unsigned int i = 0; i < aiScene->mNumMeshes; i++)
+		{
+			const aiMesh* aiMesh = aiScene->mMeshes[i];
+			for (unsigned int j = 0; j < aiMesh->mNumBones; j++)
+			{
+				bones[aiMesh->mBones[j]->mName.C_Str()] = convertAIMat4(aiMesh->mBones[j]->mOffsetMatrix);
+			}
+		}
+		Skeleton& skeleton = model->skeleton;
+		addJoints(aiScene->mRootNode, -1, bones, &skeleton);
+		if (skeleton.getNumJoints() == 0) {
+			//Not skinned. One joint keeps it drawable and movable by its world matrix
+			skeleton.addJoint("Root", -1, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f), glm::mat4(1.0f));
+		}
+		if (skeleton.getNumJoints() > MAX_SKIN_JOINTS) {
+			printf("Model %s has %d joints, at most %d are supported\n", filePath.c_str(), skeleton.getNumJoints(), MAX_SKIN_JOINTS);
+			*model = SkinnedModelData();
+			return false;
+		}
+
+		model->meshes.reserve(aiScene->mNumMeshes);
+		for (unsigned int i = 0; i < aiScene->mNumMeshes; i++)
+		{
+			aiMesh* aiMesh = aiScene->mMeshes[i];
+			MeshData meshData = processAiMesh(aiMesh);
+			//Influences per vertex, MAX_JOINTS_PER_VERTEX after aiProcess_LimitBoneWeights
+			std::vector<std::vector<std::pair<int, float>>> influences(meshData.vertices.size());
+			for (unsigned int j = 0; j < aiMesh->mNumBones; j++)
+			{
+				const aiBone* bone = aiMesh->mBones[j];
+				int joint = skeleton.findJoint(bone->mName.C_Str());
+				for (unsigned int k = 0; k < bone->mNumWeights; k++)
+				{
+					influences[bone->mWeights[k].mVertexId].push_back({ joint, bone->mWeights[k].mWeight });
+				}
+			}
+			SkinnedMeshData skinnedMesh;
+			skinnedMesh.vertices.resize(meshData.vertices.size());
+			for (size_t j = 0; j < meshData.vertices.size(); j++)
+			{
+				SkinnedVertex& vertex = skinnedMesh.vertices[j];
+				vertex.pos = meshData.vertices[j].pos;
+				vertex.normal = meshData.vertices[j].normal;
+				vertex.uv = meshData.vertices[j].uv;
+				int joints[MAX_JOINTS_PER_VERTEX * 2];
+				float weights[MAX_JOINTS_PER_VERTEX * 2];
+				int count = std::min((int)influences[j].size(), MAX_JOINTS_PER_VERTEX * 2);
+				for (int k = 0; k < count; k++)
+				{
+					joints[k] = influences[j][k].first;
+					weights[k] = influences[j][k].second;
+				}
+				setSkinWeights(&vertex, joints, weights, count);
+			}
+			skinnedMesh.indices = std::move(meshData.indices);
+			model->meshes.push_back(std::move(skinnedMesh));
+		}
+
+		for (unsigned int i = 0; i < aiScene->mNumAnimations; i++)
+		{
+			const aiAnimation* aiAnimation = aiScene->mAnimations[i];
+			//Assimp leaves ticks per second at 0 when the file doesn't say
+			float ticksPerSecond = aiAnimation->mTicksPerSecond > 0.0 ? (float)aiAnimation->mTicksPerSecond : 25.0f;
+			std::vector<JointTrack> tracks(skeleton.getNumJoints());
+			for (unsigned int j = 0; j < aiAnimation->mNumChannels; j++)
+			{
+				const aiNodeAnim* channel = aiAnimation->mChannels[j];
+				int joint = skeleton.findJoint(channel->mNodeName.C_Str());
+				if (joint < 0) {
+					continue;
+				}
+				JointTrack& track = tracks[joint];
+				for (unsigned int k = 0; k < channel->mNumPositionKeys; k++)
+				{
+					track.positionTimes.push_back((float)channel->mPositionKeys[k].mTime / ticksPerSecond);
+					track.positions.push_back(convertAIVector(channel->mPositionKeys[k].mValue));
+				}
+				for (unsigned int k = 0; k < channel->mNumRotationKeys; k++)
+				{
+					track.rotationTimes.push_back((float)channel->mRotationKeys[k].mTime / ticksPerSecond);
+					track.rotations.push_back(convertAIQuaternion(channel->mRotationKeys[k].mValue));
+				}
+				for (unsigned int k = 0; k < channel->mNumScalingKeys; k++)
+				{
+					track.scaleTimes.push_back((float)channel->mScalingKeys[k].mTime / ticksPerSecond);
+					track.scales.push_back(convertAIVector(channel->mScalingKeys[k].mValue));
+				}
+			}
+			std::string name = aiAnimation->mName.length > 0 ? aiAnimation->mName.C_Str() : "Animation " + std::to_string(i);
+			model->clips.push_back(AnimationClip(name, skeleton, tracks, (float)aiAnimation->mDuration / ticksPerSecond, sampleRate));
+		}
+		return true;
+	}
+}
@@ -0,0 +1,91 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "animation.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+
+namespace ew {
+	//Joint indices are stored in a byte
+	const int MAX_SKIN_JOINTS = 256;
+	const int MAX_JOINTS_PER_VERTEX = 4;
+
+	//Vertex with its joint influences packed into the same stream.
+	//Attribute locations: 0 = pos, 1 = normal, 2 = uv (as ew::Vertex), 3 = joints (uvec4), 4 = weights (normalized vec4)
+	struct SkinnedVertex {
+		glm::vec3 pos;
+		glm::vec3 normal;
+		glm::vec2 uv;
+		unsigned char joints[MAX_JOINTS_PER_VERTEX] = {};
+		unsigned char weights[MAX_JOINTS_PER_VERTEX] = {}; //Sum to 255
+	};
+
+	struct SkinnedMeshData {
+		std::vector<SkinnedVertex> vertices;
+		std::vector<unsigned int> indices;
+	};
+
+	//Keeps the MAX_JOINTS_PER_VERTEX largest weights, normalizes them and quantizes them to bytes that sum to 255
+	void setSkinWeights(SkinnedVertex* vertex, const int* joints, const float* weights, int count);
+
+	//Owns its vertex array and buffers, like ew::Mesh. Skinned in the vertex shader (see SkinningPalette)
+	class SkinnedMesh {
+	public:
+		SkinnedMesh() {};
+		SkinnedMesh(const SkinnedMeshData& meshData);
+		~SkinnedMesh();
+		SkinnedMesh(SkinnedMesh&& other) noexcept;
+		SkinnedMesh& operator=(SkinnedMesh&& other) noexcept;
+		SkinnedMesh(const SkinnedMesh&) = delete;
+		SkinnedMesh& operator=(const SkinnedMesh&) = delete;
+		void load(const SkinnedMeshData& meshData);
+		void draw()const;
+		//One character per instance. Shaders find their matrices with gl_InstanceID
+		void drawInstanced(int numInstances)const;
+		inline int getNumVertices()const { return m_numVertices; }
+		inline int getNumIndices()const { return m_numIndices; }
+	private:
+		unsigned int m_vao = 0;
+		unsigned int m_vbo = 0;
+		unsigned int m_ebo = 0;
+		int m_numVertices = 0;
+		int m_numIndices = 0;
+		void release();
+	};
+
+	//Skinning matrices of every character, in one shader storage buffer.
+	//Character i's joint j is _SkinningMatrices[i * numJoints + j]
+	class SkinningPalette {
+	public:
+		static const unsigned int BINDING = 3; //After ClusteredLighting's 0-2
+
+		SkinningPalette() {};
+		~SkinningPalette();
+		SkinningPalette(SkinningPalette&& other) noexcept;
+		SkinningPalette& operator=(SkinningPalette&& other) noexcept;
+		SkinningPalette(const SkinningPalette&) = delete;
+		SkinningPalette& operator=(const SkinningPalette&) = delete;
+		//Storage is orphaned on every upload, so the GPU can still read last frame's matrices
+		void upload(const glm::mat4* matrices, int count);
+		void bind(unsigned int binding = BINDING)const;
+		inline int getNumMatrices()const { return m_numMatrices; }
+	private:
+		unsigned int m_buffer = 0;
+		int m_numMatrices = 0;
+		void release();
+	};
+
+	struct SkinnedModelData {
+		Skeleton skeleton;
+		std::vector<SkinnedMeshData> meshes;
+		std::vector<AnimationClip> clips;
+	};
+
+	//Imports meshes, bone weights, the skeleton and every animation with Assimp. The skeleton holds each bone
+	//and its ancestors, so transforms above the bones (e.g. an armature's scale) are kept.
+	//Meshes are expected in the scene root's space. Assimp joins identical vertices and limits each to 4 influences
+	bool loadSkinnedModelData(const std::string& filePath, SkinnedModelData* model, float sampleRate = 30.0f);
+}
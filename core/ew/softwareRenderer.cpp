@@ -0,0 +1,538 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "softwareRenderer.h"
+#include "jobSystem.h"
+#include "assetArchive.h"
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define EW_SOFTWARE_SSE
+#endif
+
+namespace ew {
+	static inline size_t numTriangles(const MeshData& meshData) {
+		return meshData.indices.empty() ? meshData.vertices.size() / 3 : meshData.indices.size() / 3;
+	}
+
+	const int NUM_ATTRIBUTES = 8;
+
+	//Projected vertex. x, y in pixels, z in 0-1 window depth, attributes already divided by w
+	struct ScreenVertex {
+		float x, y, z;
+		float invW;
+		float attributes[NUM_ATTRIBUTES];
+	};
+
+	SoftwareTexture loadSoftwareTexture(const char* filePath)
+	{
+		SoftwareTexture texture;
+		AssetImage image;
+		if (!image.load(filePath)) {
+			printf("Failed to load image %s", filePath);
+			return texture;
+		}
+		texture.width = image.getWidth();
+		texture.height = image.getHeight();
+		//Expanded to RGBA the way stb_image does when asked for 4 components: gray is copied to rgb, alpha defaults to opaque
+		int numComponents = image.getNumComponents();
+		const unsigned char* src = image.getPixels();
+		size_t numPixels = (size_t)texture.width * texture.height;
+		texture.pixels.resize(numPixels * 4);
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			const unsigned char* p = src + i * numComponents;
+			uint8_t* dst = &texture.pixels[i * 4];
+			bool gray = numComponents < 3;
+			dst[0] = p[0];
+			dst[1] = gray ? p[0] : p[1];
+			dst[2] = gray ? p[0] : p[2];
+			dst[3] = numComponents == 2 ? p[1] : (numComponents == 4 ? p[3] : 255);
+		}
+		return texture;
+	}
+
+	/// <summary>
+	/// Bilinear filtering with repeat wrapping, matching GL_REPEAT + GL_LINEAR without mipmaps
+	/// </summary>
+	static glm::vec3 sampleTexture(const SoftwareTexture* texture, float u, float v) {
+		if (texture == nullptr || texture->width == 0) {
+			return glm::vec3(1.0f);
+		}
+		float x = u * texture->width - 0.5f;
+		float y = v * texture->height - 0.5f;
+		float fx = floorf(x);
+		float fy = floorf(y);
+		float tx = x - fx;
+		float ty = y - fy;
+		//Wrap in floating point first, uvs can be far outside 0-1
+		int x0 = (int)(fx - floorf(fx / texture->width) * texture->width) % texture->width;
+		int y0 = (int)(fy - floorf(fy / texture->height) * texture->height) % texture->height;
+		int x1 = (x0 + 1) % texture->width;
+		int y1 = (y0 + 1) % texture->height;
+		auto texel = [&](int px, int py) {
+			const uint8_t* p = &texture->pixels[(py * texture->width + px) * 4];
+			return glm::vec3(p[0], p[1], p[2]);
+		};
+		glm::vec3 bottom = texel(x0, y0) * (1.0f - tx) + texel(x1, y0) * tx;
+		glm::vec3 top = texel(x0, y1) * (1.0f - tx) + texel(x1, y1) * tx;
+		return (bottom * (1.0f - ty) + top * ty) * (1.0f / 255.0f);
+	}
+
+	SoftwareRenderer::SoftwareRenderer(int width, int height)
+	{
+		resize(width, height);
+	}
+
+	void SoftwareRenderer::resize(int width, int height)
+	{
+		m_width = std::max(width, 1);
+		m_height = std::max(height, 1);
+		m_tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+		m_tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+		m_color.assign(m_width * m_height * 4, 0);
+		m_depth.assign(m_width * m_height, 1.0f);
+	}
+
+	void SoftwareRenderer::clear(const glm::vec3& color, float depth)
+	{
+		glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+		uint8_t rgba[4] = { (uint8_t)c.x, (uint8_t)c.y, (uint8_t)c.z, 255 };
+		for (size_t i = 0; i < m_color.size(); i += 4)
+		{
+			memcpy(&m_color[i], rgba, 4);
+		}
+		std::fill(m_depth.begin(), m_depth.end(), depth);
+	}
+
+	void SoftwareRenderer::setCamera(const Camera& camera)
+	{
+		m_viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+		m_eyePosition = camera.position;
+	}
+
+	void SoftwareRenderer::setLight(const glm::vec3& direction, const glm::vec3& color, const glm::vec3& ambient)
+	{
+		m_lightDirection = direction;
+		m_lightColor = color;
+		m_ambientColor = ambient;
+	}
+
+	void SoftwareRenderer::draw(const MeshData* meshData, const glm::mat4& model, const SoftwareMaterial& material, const SoftwareTexture* texture)
+	{
+		m_drawCalls.push_back({ meshData, model, material, texture });
+	}
+
+	void SoftwareRenderer::flush(JobSystem* jobs)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		//Vertices and triangles are split evenly between bins regardless of which draw they belong to.
+		//Each bin gets a contiguous range, so walking the bins in order keeps submission order
+		std::vector<size_t> drawStarts(m_drawCalls.size() + 1, 0);
+		std::vector<size_t> vertexStarts(m_drawCalls.size() + 1, 0);
+		for (size_t i = 0; i < m_drawCalls.size(); i++)
+		{
+			drawStarts[i + 1] = drawStarts[i] + numTriangles(*m_drawCalls[i].meshData);
+			vertexStarts[i + 1] = vertexStarts[i] + m_drawCalls[i].meshData->vertices.size();
+		}
+		size_t totalTriangles = drawStarts.back();
+		size_t totalVertices = vertexStarts.back();
+
+		int threads = jobs != nullptr ? jobs->getNumThreads() : 1;
+		//Each vertex is transformed once, however many triangles or bins share it
+		m_clipVertices.resize(totalVertices);
+		parallelFor(jobs, totalVertices, [&](size_t begin, size_t end) {
+			transformVertices(begin, end, vertexStarts);
+		}, 1024);
+
+		//One set of bins per thread, so jobs never share one
+		int numBins = (int)std::min<size_t>((size_t)threads, std::max<size_t>(1, totalTriangles / 256));
+		m_bins.resize(numBins);
+		for (WorkerBins& bins : m_bins) {
+			bins.triangles.clear();
+			bins.tiles.resize(m_tilesX * m_tilesY);
+			for (std::vector<uint32_t>& tile : bins.tiles) tile.clear();
+			bins.numRasterized = 0;
+		}
+		parallelFor(jobs, numBins, [&](size_t begin, size_t end) {
+			for (size_t bin = begin; bin < end; bin++)
+			{
+				binTriangles(totalTriangles * bin / numBins, totalTriangles * (bin + 1) / numBins, drawStarts, vertexStarts, m_bins[bin]);
+			}
+		});
+		auto binTime = std::chrono::high_resolution_clock::now();
+
+		//Tiles own disjoint pixels, so jobs need no synchronization
+		std::atomic<int64_t> pixelsShaded(0);
+		parallelFor(jobs, m_tilesX * m_tilesY, [&](size_t begin, size_t end) {
+			int64_t pixels = 0;
+			for (size_t tile = begin; tile < end; tile++)
+			{
+				pixels += rasterizeTile((int)tile);
+			}
+			pixelsShaded += pixels;
+		});
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		m_stats = SoftwareRenderStats();
+		m_stats.numThreadsUsed = threads;
+		m_stats.numTrianglesSubmitted = (int)totalTriangles;
+		for (const WorkerBins& bins : m_bins) m_stats.numTrianglesRasterized += bins.numRasterized;
+		m_stats.numPixelsShaded = pixelsShaded;
+		m_stats.geometryMilliseconds = std::chrono::duration<float, std::milli>(binTime - startTime).count();
+		m_stats.rasterMilliseconds = std::chrono::duration<float, std::milli>(endTime - binTime).count();
+		float totalSeconds = (m_stats.geometryMilliseconds + m_stats.rasterMilliseconds) / 1000.0f;
+		m_stats.trianglesPerSecond = totalSeconds > 0.0f ? totalTriangles / totalSeconds : 0.0f;
+		m_stats.pixelsPerSecond = m_stats.rasterMilliseconds > 0.0f ? m_stats.numPixelsShaded / (m_stats.rasterMilliseconds / 1000.0f) : 0.0f;
+		m_drawCalls.clear();
+	}
+
+	/// <summary>
+	/// Vertex stage, equivalent to lit.vert. Transforms a range of the vertices of every draw, concatenated in draw order
+	/// </summary>
+	void SoftwareRenderer::transformVertices(size_t firstVertex, size_t endVertex, const std::vector<size_t>& vertexStarts)
+	{
+		if (firstVertex >= endVertex) {
+			return;
+		}
+		//Draw containing the first vertex. Draws without vertices are skipped by the loop below
+		size_t drawCall = std::upper_bound(vertexStarts.begin(), vertexStarts.end(), firstVertex) - vertexStarts.begin() - 1;
+		size_t v = firstVertex;
+		while (v < endVertex) {
+			const DrawCall& d = m_drawCalls[drawCall];
+			glm::mat4 mvp = m_viewProjection * d.model;
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(d.model)));
+			const std::vector<Vertex>& vertices = d.meshData->vertices;
+			size_t drawEnd = std::min(vertexStarts[drawCall + 1], endVertex);
+			for (; v < drawEnd; v++)
+			{
+				const Vertex& in = vertices[v - vertexStarts[drawCall]];
+				ClipVertex& out = m_clipVertices[v];
+				out.position = mvp * glm::vec4(in.pos, 1.0f);
+				glm::vec3 worldPos = glm::vec3(d.model * glm::vec4(in.pos, 1.0f));
+				glm::vec3 worldNormal = normalMatrix * in.normal;
+				out.attributes[0] = worldPos.x;
+				out.attributes[1] = worldPos.y;
+				out.attributes[2] = worldPos.z;
+				out.attributes[3] = worldNormal.x;
+				out.attributes[4] = worldNormal.y;
+				out.attributes[5] = worldNormal.z;
+				out.attributes[6] = in.uv.x;
+				out.attributes[7] = in.uv.y;
+			}
+			drawCall++;
+		}
+	}
+
+	/// <summary>
+	/// Assembles a range of triangles from the transformed vertices and sets them up
+	/// </summary>
+	void SoftwareRenderer::binTriangles(size_t firstTriangle, size_t endTriangle, const std::vector<size_t>& drawStarts, const std::vector<size_t>& vertexStarts, WorkerBins& bins)
+	{
+		if (firstTriangle >= endTriangle) {
+			return;
+		}
+		//Draw containing the first triangle
+		size_t drawCall = std::upper_bound(drawStarts.begin(), drawStarts.end(), firstTriangle) - drawStarts.begin() - 1;
+		for (size_t t = firstTriangle; t < endTriangle; t++)
+		{
+			while (t >= drawStarts[drawCall + 1]) {
+				drawCall++;
+			}
+			const MeshData& meshData = *m_drawCalls[drawCall].meshData;
+			const ClipVertex* clipVertices = m_clipVertices.data() + vertexStarts[drawCall];
+			size_t local = t - drawStarts[drawCall];
+			ClipVertex triangle[3];
+			for (int i = 0; i < 3; i++)
+			{
+				size_t index = meshData.indices.empty() ? local * 3 + i : meshData.indices[local * 3 + i];
+				triangle[i] = clipVertices[index];
+			}
+			setupTriangle(triangle, (int)drawCall, bins);
+		}
+	}
+
+	/// <summary>
+	/// Clips a triangle against the near plane, projects it, computes its interpolation planes
+	/// and adds it to the bins of every tile its screen bounds touch
+	/// </summary>
+	void SoftwareRenderer::setupTriangle(const ClipVertex* clip, int drawCall, WorkerBins& bins)
+	{
+		//Trivial reject when all vertices are outside the same frustum plane
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (clip[0].position[axis] > clip[0].position.w && clip[1].position[axis] > clip[1].position.w && clip[2].position[axis] > clip[2].position.w) return;
+			if (clip[0].position[axis] < -clip[0].position.w && clip[1].position[axis] < -clip[1].position.w && clip[2].position[axis] < -clip[2].position.w) return;
+		}
+		//Near plane clipping (z >= -w) leaves at most 4 vertices
+		ClipVertex polygon[4];
+		int numVertices = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const ClipVertex& a = clip[i];
+			const ClipVertex& b = clip[(i + 1) % 3];
+			float da = a.position.z + a.position.w;
+			float db = b.position.z + b.position.w;
+			if (da >= 0.0f) {
+				polygon[numVertices++] = a;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				float t = da / (da - db);
+				ClipVertex& v = polygon[numVertices++];
+				v.position = a.position + (b.position - a.position) * t;
+				for (int j = 0; j < NUM_ATTRIBUTES; j++)
+				{
+					v.attributes[j] = a.attributes[j] + (b.attributes[j] - a.attributes[j]) * t;
+				}
+			}
+		}
+		if (numVertices < 3) {
+			return;
+		}
+		ScreenVertex screen[4];
+		for (int i = 0; i < numVertices; i++)
+		{
+			float invW = 1.0f / std::max(polygon[i].position.w, 1e-6f);
+			screen[i].x = (polygon[i].position.x * invW * 0.5f + 0.5f) * m_width;
+			screen[i].y = (polygon[i].position.y * invW * 0.5f + 0.5f) * m_height;
+			screen[i].z = polygon[i].position.z * invW * 0.5f + 0.5f;
+			screen[i].invW = invW;
+			for (int j = 0; j < NUM_ATTRIBUTES; j++)
+			{
+				screen[i].attributes[j] = polygon[i].attributes[j] * invW;
+			}
+		}
+		for (int i = 2; i < numVertices; i++)
+		{
+			const ScreenVertex* v[3] = { &screen[0], &screen[i - 1], &screen[i] };
+			float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[2]->x - v[0]->x) * (v[1]->y - v[0]->y);
+			if (area == 0.0f || (area < 0.0f && backfaceCulling)) {
+				continue;
+			}
+			//Rasterizer expects counter-clockwise triangles
+			if (area < 0.0f) {
+				std::swap(v[1], v[2]);
+			}
+			//Clamped as floats first, vertices near the near plane can project very far off screen
+			float boundsMinX = std::min(std::min(v[0]->x, v[1]->x), v[2]->x);
+			float boundsMinY = std::min(std::min(v[0]->y, v[1]->y), v[2]->y);
+			float boundsMaxX = std::max(std::max(v[0]->x, v[1]->x), v[2]->x);
+			float boundsMaxY = std::max(std::max(v[0]->y, v[1]->y), v[2]->y);
+			if (boundsMaxX < 0.0f || boundsMaxY < 0.0f || boundsMinX >= m_width || boundsMinY >= m_height) {
+				continue;
+			}
+			TriangleSetup setup;
+			setup.minX = (int)std::max(boundsMinX, 0.0f);
+			setup.minY = (int)std::max(boundsMinY, 0.0f);
+			setup.maxX = (int)std::min(boundsMaxX, m_width - 1.0f);
+			setup.maxY = (int)std::min(boundsMaxY, m_height - 1.0f);
+			setup.drawCall = drawCall;
+			//Edge i runs from v[i] to v[i + 1]. Positive inside
+			float a[3], b[3], c[3];
+			for (int j = 0; j < 3; j++)
+			{
+				const ScreenVertex* p = v[j];
+				const ScreenVertex* q = v[(j + 1) % 3];
+				a[j] = p->y - q->y;
+				b[j] = q->x - p->x;
+				c[j] = p->x * q->y - p->y * q->x;
+				setup.edgeA[j] = a[j];
+				setup.edgeB[j] = b[j];
+				setup.edgeC[j] = c[j];
+			}
+			//Edge i is opposite vertex (i + 2) % 3, so barycentrics are edge values over the total area
+			float invArea = 1.0f / (c[0] + c[1] + c[2]);
+			auto plane = [&](float f0, float f1, float f2, float* out) {
+				out[0] = (a[1] * f0 + a[2] * f1 + a[0] * f2) * invArea;
+				out[1] = (b[1] * f0 + b[2] * f1 + b[0] * f2) * invArea;
+				out[2] = (c[1] * f0 + c[2] * f1 + c[0] * f2) * invArea;
+			};
+			plane(v[0]->z, v[1]->z, v[2]->z, setup.depth);
+			plane(v[0]->invW, v[1]->invW, v[2]->invW, setup.invW);
+			for (int j = 0; j < NUM_ATTRIBUTES; j++)
+			{
+				plane(v[0]->attributes[j], v[1]->attributes[j], v[2]->attributes[j], setup.attributes[j]);
+			}
+			uint32_t index = (uint32_t)bins.triangles.size();
+			bins.triangles.push_back(setup);
+			bins.numRasterized++;
+			for (int ty = setup.minY / TILE_SIZE; ty <= setup.maxY / TILE_SIZE; ty++)
+			{
+				for (int tx = setup.minX / TILE_SIZE; tx <= setup.maxX / TILE_SIZE; tx++)
+				{
+					bins.tiles[tx + ty * m_tilesX].push_back(index);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Resolves visibility for every triangle binned to a tile, then shades each visible pixel once.
+	/// Depth and the triangle covering each pixel live in tile local buffers until the tile is done.
+	/// Returns the number of pixels shaded
+	/// </summary>
+	int64_t SoftwareRenderer::rasterizeTile(int tile)
+	{
+		int tileX = (tile % m_tilesX) * TILE_SIZE;
+		int tileY = (tile / m_tilesX) * TILE_SIZE;
+		int tileWidth = std::min(TILE_SIZE, m_width - tileX);
+		int tileHeight = std::min(TILE_SIZE, m_height - tileY);
+		alignas(16) float depth[TILE_SIZE * TILE_SIZE];
+		const TriangleSetup* visible[TILE_SIZE * TILE_SIZE];
+		for (int y = 0; y < TILE_SIZE; y++)
+		{
+			for (int x = 0; x < TILE_SIZE; x++)
+			{
+				//Pixels past the edge of the image get a depth nothing can pass
+				bool inImage = x < tileWidth && y < tileHeight;
+				depth[y * TILE_SIZE + x] = inImage ? m_depth[(tileY + y) * m_width + tileX + x] : -FLT_MAX;
+				visible[y * TILE_SIZE + x] = nullptr;
+			}
+		}
+
+		for (const WorkerBins& bins : m_bins) {
+			for (uint32_t index : bins.tiles[tile]) {
+				const TriangleSetup& t = bins.triangles[index];
+				//Triangle bounds within the tile. Rows are walked in groups of 4 pixels
+				int minX = std::max(tileX, t.minX) & ~3;
+				int minY = std::max(tileY, t.minY);
+				int maxX = std::min(tileX + TILE_SIZE - 1, t.maxX);
+				int maxY = std::min(tileY + TILE_SIZE - 1, t.maxY);
+				for (int y = minY; y <= maxY; y++)
+				{
+					float py = y + 0.5f;
+					float px = minX + 0.5f;
+					float e0 = t.edgeA[0] * px + t.edgeB[0] * py + t.edgeC[0];
+					float e1 = t.edgeA[1] * px + t.edgeB[1] * py + t.edgeC[1];
+					float e2 = t.edgeA[2] * px + t.edgeB[2] * py + t.edgeC[2];
+					float z = t.depth[0] * px + t.depth[1] * py + t.depth[2];
+					float* depthRow = depth + (y - tileY) * TILE_SIZE;
+					const TriangleSetup** visibleRow = visible + (y - tileY) * TILE_SIZE;
+#ifdef EW_SOFTWARE_SSE
+					const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+					const __m128 zero = _mm_setzero_ps();
+					__m128 edge0 = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(_mm_set1_ps(t.edgeA[0]), lanes));
+					__m128 edge1 = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(_mm_set1_ps(t.edgeA[1]), lanes));
+					__m128 edge2 = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(_mm_set1_ps(t.edgeA[2]), lanes));
+					__m128 depth4 = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(_mm_set1_ps(t.depth[0]), lanes));
+					const __m128 step0 = _mm_set1_ps(t.edgeA[0] * 4.0f);
+					const __m128 step1 = _mm_set1_ps(t.edgeA[1] * 4.0f);
+					const __m128 step2 = _mm_set1_ps(t.edgeA[2] * 4.0f);
+					const __m128 stepZ = _mm_set1_ps(t.depth[0] * 4.0f);
+					for (int x = minX - tileX; x <= maxX - tileX; x += 4)
+					{
+						__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+						__m128 current = _mm_load_ps(depthRow + x);
+						__m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(depth4, current));
+						int mask = _mm_movemask_ps(pass);
+						if (mask != 0) {
+							_mm_store_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, depth4), _mm_andnot_ps(pass, current)));
+							for (int lane = 0; lane < 4; lane++)
+							{
+								if (mask & (1 << lane)) visibleRow[x + lane] = &t;
+							}
+						}
+						edge0 = _mm_add_ps(edge0, step0);
+						edge1 = _mm_add_ps(edge1, step1);
+						edge2 = _mm_add_ps(edge2, step2);
+						depth4 = _mm_add_ps(depth4, stepZ);
+					}
+#else
+					for (int x = minX - tileX; x < ((maxX - tileX + 4) & ~3); x++)
+					{
+						if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f && z < depthRow[x]) {
+							depthRow[x] = z;
+							visibleRow[x] = &t;
+						}
+						e0 += t.edgeA[0];
+						e1 += t.edgeA[1];
+						e2 += t.edgeA[2];
+						z += t.depth[0];
+					}
+#endif
+				}
+			}
+		}
+
+		//Deferred shading, overdraw only costs the depth test above
+		int64_t numShaded = 0;
+		for (int y = 0; y < tileHeight; y++)
+		{
+			for (int x = 0; x < tileWidth; x++)
+			{
+				int pixel = (tileY + y) * m_width + tileX + x;
+				m_depth[pixel] = depth[y * TILE_SIZE + x];
+				const TriangleSetup* t = visible[y * TILE_SIZE + x];
+				if (t == nullptr) {
+					continue;
+				}
+				glm::vec3 color = glm::clamp(shade(*t, tileX + x + 0.5f, tileY + y + 0.5f), 0.0f, 1.0f) * 255.0f + 0.5f;
+				uint8_t* out = &m_color[pixel * 4];
+				out[0] = (uint8_t)color.x;
+				out[1] = (uint8_t)color.y;
+				out[2] = (uint8_t)color.z;
+				out[3] = 255;
+				numShaded++;
+			}
+		}
+		return numShaded;
+	}
+
+	/// <summary>
+	/// Fragment stage, equivalent to lit.frag without the clustered lights
+	/// </summary>
+	glm::vec3 SoftwareRenderer::shade(const TriangleSetup& t, float x, float y)const
+	{
+		//Perspective correct interpolation: attributes / w and 1 / w are linear in screen space
+		float w = 1.0f / (t.invW[0] * x + t.invW[1] * y + t.invW[2]);
+		float attributes[NUM_ATTRIBUTES];
+		for (int i = 0; i < NUM_ATTRIBUTES; i++)
+		{
+			attributes[i] = (t.attributes[i][0] * x + t.attributes[i][1] * y + t.attributes[i][2]) * w;
+		}
+		const DrawCall& drawCall = m_drawCalls[t.drawCall];
+		const SoftwareMaterial& material = drawCall.material;
+		glm::vec3 worldPos = glm::vec3(attributes[0], attributes[1], attributes[2]);
+		glm::vec3 normal = glm::normalize(glm::vec3(attributes[3], attributes[4], attributes[5]));
+		glm::vec3 toLight = -m_lightDirection;
+		glm::vec3 toEye = glm::normalize(m_eyePosition - worldPos);
+		float diffuseFactor = std::max(glm::dot(normal, toLight), 0.0f);
+		glm::vec3 h = glm::normalize(toLight + toEye);
+		float specularFactor = powf(std::max(glm::dot(normal, h), 0.0f), material.Shininess);
+		glm::vec3 lightColor = (material.Kd * diffuseFactor + material.Ks * specularFactor) * m_lightColor;
+		lightColor += m_ambientColor * material.Ka;
+		return sampleTexture(drawCall.texture, attributes[6], attributes[7]) * lightColor;
+	}
+
+	bool SoftwareRenderer::writePPM(const std::string& filePath)const
+	{
+		FILE* file = fopen(filePath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to open %s for writing\n", filePath.c_str());
+			return false;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", m_width, m_height);
+		std::vector<uint8_t> row(m_width * 3);
+		for (int y = m_height - 1; y >= 0; y--)
+		{
+			const uint8_t* src = &m_color[y * m_width * 4];
+			for (int x = 0; x < m_width; x++)
+			{
+				row[x * 3 + 0] = src[x * 4 + 0];
+				row[x * 3 + 1] = src[x * 4 + 1];
+				row[x * 3 + 2] = src[x * 4 + 2];
+			}
+			fwrite(row.data(), 1, row.size(), file);
+		}
+		fclose(file);
+		return true;
+	}
+}
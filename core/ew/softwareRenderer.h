@@ -0,0 +1,124 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "camera.h"
+
+namespace ew {
+	class JobSystem;
+
+	//Same parameters as the Material struct in lit.frag
+	struct SoftwareMaterial {
+		float Ka = 1.0f;
+		float Kd = 0.5f;
+		float Ks = 0.5f;
+		float Shininess = 128.0f;
+	};
+
+	//RGBA8 image in CPU memory, first row at the bottom like OpenGL textures
+	struct SoftwareTexture {
+		int width = 0;
+		int height = 0;
+		std::vector<uint8_t> pixels;
+	};
+	//Loads an image with the same vertical flip as ew::loadTexture, from the mounted asset archive when it has it.
+	//Returns an empty texture on failure
+	SoftwareTexture loadSoftwareTexture(const char* filePath);
+
+	struct SoftwareRenderStats {
+		int numThreadsUsed = 0;
+		int numTrianglesSubmitted = 0;
+		int numTrianglesRasterized = 0; //After clipping and culling
+		int64_t numPixelsShaded = 0;
+		float geometryMilliseconds = 0.0f; //Vertex transform, clipping, setup and binning
+		float rasterMilliseconds = 0.0f; //Rasterization and shading
+		float trianglesPerSecond = 0.0f; //Submitted triangles over total time
+		float pixelsPerSecond = 0.0f; //Shaded pixels over raster time
+	};
+
+	//CPU rendering backend producing the same image as lit.vert/lit.frag (Blinn-Phong with one directional light),
+	//for reference images and regression tests on machines without a GPU.
+	//Draws are queued and rendered by flush(). Every vertex is transformed once, then triangles are clipped and binned
+	//into screen tiles in parallel, then each tile is rasterized by one job: coverage and depth are resolved first with SSE edge functions,
+	//4 pixels at a time, and each visible pixel is shaded once afterwards.
+	//Buffers use OpenGL conventions: row 0 is the bottom of the image, depth is 0-1 with LESS testing.
+	class SoftwareRenderer {
+	public:
+		static const int TILE_SIZE = 32;
+		bool backfaceCulling = true;
+
+		SoftwareRenderer(int width = 1080, int height = 720);
+		void resize(int width, int height);
+		void clear(const glm::vec3& color, float depth = 1.0f);
+		void setCamera(const Camera& camera);
+		//Matches _LightDirection, _LightColor and _AmbientColor in lit.frag
+		void setLight(const glm::vec3& direction, const glm::vec3& color = glm::vec3(1.0f), const glm::vec3& ambient = glm::vec3(0.3f, 0.4f, 0.46f));
+		//meshData and texture must stay alive until flush() returns. A null texture samples white
+		void draw(const MeshData* meshData, const glm::mat4& model, const SoftwareMaterial& material, const SoftwareTexture* texture = nullptr);
+		//Renders every queued draw into the color and depth buffers. The stages are spread over jobs,
+		//or run on this thread when jobs is null
+		void flush(JobSystem* jobs = nullptr);
+
+		inline int getWidth()const { return m_width; }
+		inline int getHeight()const { return m_height; }
+		//RGBA8
+		inline const uint8_t* getColor()const { return m_color.data(); }
+		inline const float* getDepth()const { return m_depth.data(); }
+		inline const SoftwareRenderStats& getStats()const { return m_stats; }
+		//Writes the color buffer as a binary PPM, top row first
+		bool writePPM(const std::string& filePath)const;
+	private:
+		struct DrawCall {
+			const MeshData* meshData;
+			glm::mat4 model;
+			SoftwareMaterial material;
+			const SoftwareTexture* texture;
+		};
+		//Post transform vertex. Attributes are world position, world normal, uv
+		struct ClipVertex {
+			glm::vec4 position;
+			float attributes[8];
+		};
+		//Screen space plane equations, f(x, y) = a * x + b * y + c at pixel coordinates
+		struct TriangleSetup {
+			float edgeA[3], edgeB[3], edgeC[3];
+			float depth[3];
+			float invW[3];
+			float attributes[8][3]; //Divided by w for perspective correct interpolation
+			int minX, minY, maxX, maxY;
+			int drawCall;
+		};
+		struct WorkerBins {
+			std::vector<TriangleSetup> triangles;
+			std::vector<std::vector<uint32_t>> tiles;
+			int numRasterized = 0;
+		};
+		int m_width = 0;
+		int m_height = 0;
+		int m_tilesX = 0;
+		int m_tilesY = 0;
+		std::vector<uint8_t> m_color;
+		std::vector<float> m_depth;
+		glm::mat4 m_viewProjection = glm::mat4(1.0f);
+		glm::vec3 m_eyePosition = glm::vec3(0.0f);
+		glm::vec3 m_lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+		glm::vec3 m_lightColor = glm::vec3(1.0f);
+		glm::vec3 m_ambientColor = glm::vec3(0.3f, 0.4f, 0.46f);
+		std::vector<DrawCall> m_drawCalls;
+		std::vector<ClipVertex> m_clipVertices; //Every draw's vertices, transformed
+		std::vector<WorkerBins> m_bins;
+		SoftwareRenderStats m_stats;
+
+		void transformVertices(size_t firstVertex, size_t endVertex, const std::vector<size_t>& vertexStarts);
+		void binTriangles(size_t firstTriangle, size_t endTriangle, const std::vector<size_t>& drawStarts, const std::vector<size_t>& vertexStarts, WorkerBins& bins);
+		void setupTriangle(const ClipVertex* vertices, int drawCall, WorkerBins& bins);
+		int64_t rasterizeTile(int tile);
+		glm::vec3 shade(const TriangleSetup& triangle, float x, float y)const;
+	};
+}
@@ -0,0 +1,495 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "terrain.h"
+#include "procGen.h"
+#include "shader.h"
+#include "texture.h"
+#include "jobSystem.h"
+#include "gpuResources.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+namespace ew {
+	Terrain::~Terrain()
+	{
+		release();
+	}
+
+	void Terrain::release()
+	{
+		if (m_pageTexture != 0) {
+			deleteTexture(m_pageTexture);
+			m_pageTexture = 0;
+		}
+		if (m_nodeBuffer != 0) {
+			untrackGpuResource(GpuResourceType::BUFFER, m_nodeBuffer);
+			glDeleteBuffers(1, &m_nodeBuffer);
+			m_nodeBuffer = 0;
+			m_nodeBufferSize = 0;
+		}
+		m_patch = Mesh();
+		m_pages.clear();
+		m_pageLayers.clear();
+		m_heights = nullptr;
+		m_file.close();
+	}
+
+	/// <summary>
+	/// Maps a raw heightmap file
+	/// </summary>
+	/// <param name="filePath">Little endian 16 bit heights, row by row</param>
+	/// <param name="width">Texels per row</param>
+	/// <param name="height">Number of rows</param>
+	/// <returns>False if the file is missing or too small</returns>
+	bool Terrain::load(const std::string& filePath, int width, int height, const TerrainSettings& settings)
+	{
+		release();
+		if (!m_file.open(filePath)) {
+			printf("Failed to open heightmap %s\n", filePath.c_str());
+			return false;
+		}
+		if (width <= 0 || height <= 0 || m_file.size() < (size_t)width * height * sizeof(uint16_t)) {
+			printf("Heightmap %s is smaller than %dx%d 16 bit texels\n", filePath.c_str(), width, height);
+			m_file.close();
+			return false;
+		}
+		const char* texels = m_file.data();
+		HeightFunction heights = [texels, width](int x, int z) {
+			uint16_t h;
+			memcpy(&h, texels + ((size_t)z * width + x) * sizeof(uint16_t), sizeof(uint16_t));
+			return h;
+		};
+		if (!create(width, height, settings)) {
+			m_file.close();
+			return false;
+		}
+		m_heights = heights;
+		return true;
+	}
+
+	/// <summary>
+	/// Uses a function as the heightmap, e.g. getProceduralHeight
+	/// </summary>
+	/// <param name="heights">Only called with texels inside width x height</param>
+	bool Terrain::load(const HeightFunction& heights, int width, int height, const TerrainSettings& settings)
+	{
+		release();
+		if (!create(width, height, settings)) {
+			return false;
+		}
+		m_heights = heights;
+		return true;
+	}
+
+	bool Terrain::create(int width, int height, const TerrainSettings& settings)
+	{
+		if (settings.gridSize < 2 || (settings.gridSize & (settings.gridSize - 1)) != 0) {
+			printf("Terrain grid size must be a power of 2, %d was given\n", settings.gridSize);
+			return false;
+		}
+		if (width < 2 || height < 2 || settings.maxPages < 1) {
+			printf("Terrain needs at least 2x2 heightmap texels and 1 page\n");
+			return false;
+		}
+		m_settings = settings;
+		m_width = width;
+		m_height = height;
+		//The root covers every quad
+		m_numLevels = 1;
+		while (((int64_t)m_settings.gridSize << (m_numLevels - 1)) < std::max(width, height) - 1) {
+			m_numLevels++;
+		}
+
+		//Every node draws this patch. Triangles are sorted by the quadrant they are in, so one node can draw a
+		//quarter of itself where a child would be outside of the child's range
+		MeshData patch = createPlane(1.0f, 1.0f, m_settings.gridSize);
+		std::vector<unsigned int> quadrants[4];
+		for (size_t i = 0; i < patch.indices.size(); i += 6)
+		{
+			//The two triangles of a quad share its first and opposite corners
+			glm::vec3 center = (patch.vertices[patch.indices[i]].pos + patch.vertices[patch.indices[i + 2]].pos) * 0.5f;
+			int quadrant = (center.x > 0.0f ? 1 : 0) + (center.z > 0.0f ? 2 : 0);
+			quadrants[quadrant].insert(quadrants[quadrant].end(), patch.indices.begin() + i, patch.indices.begin() + i + 6);
+		}
+		patch.indices.clear();
+		for (const std::vector<unsigned int>& quadrant : quadrants) {
+			patch.indices.insert(patch.indices.end(), quadrant.begin(), quadrant.end());
+		}
+		m_patch.load(patch);
+
+		int pageSize = getPageSize();
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_pageTexture);
+		glTextureStorage3D(m_pageTexture, 1, GL_R16, pageSize, pageSize, m_settings.maxPages);
+		glTextureParameteri(m_pageTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_pageTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_pageTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_pageTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		trackGpuResource(GpuResourceType::TEXTURE, m_pageTexture, (size_t)pageSize * pageSize * sizeof(uint16_t) * m_settings.maxPages,
+			"Terrain height pages x" + std::to_string(m_settings.maxPages));
+		glCreateBuffers(1, &m_nodeBuffer);
+		trackGpuResource(GpuResourceType::BUFFER, m_nodeBuffer, 0, "Terrain nodes");
+
+		m_pages.assign(m_settings.maxPages, Page());
+		m_pageLayers.clear();
+		m_frame = 0;
+		return true;
+	}
+
+	uint64_t Terrain::getNodeKey(int level, int x, int z) const
+	{
+		return ((uint64_t)level << 48) | ((uint64_t)x << 24) | (uint64_t)z;
+	}
+
+	bool Terrain::nodeExists(int level, int x, int z) const
+	{
+		int64_t nodeTexels = (int64_t)m_settings.gridSize << level;
+		return x * nodeTexels < m_width - 1 && z * nodeTexels < m_height - 1;
+	}
+
+	Bounds Terrain::getNodeBounds(int level, int x, int z, const Page& page) const
+	{
+		float size = (float)((int64_t)m_settings.gridSize << level) * m_settings.texelSpacing;
+		Bounds bounds;
+		bounds.min = glm::vec3(m_settings.position.x + x * size, page.minHeight, m_settings.position.z + z * size);
+		bounds.max = glm::vec3(bounds.min.x + size, page.maxHeight, bounds.min.z + size);
+		return bounds;
+	}
+
+	static bool sphereIntersectsBounds(const glm::vec3& center, float radius, const Bounds& bounds) {
+		glm::vec3 closest = glm::clamp(center, bounds.min, bounds.max);
+		glm::vec3 toClosest = closest - center;
+		return glm::dot(toClosest, toClosest) <= radius * radius;
+	}
+
+	bool Terrain::isInFrustum(const Bounds& bounds) const
+	{
+		for (const glm::vec4& plane : m_frustum) {
+			//Corner furthest along the plane normal
+			glm::vec3 corner = glm::vec3(plane.x > 0.0f ? bounds.max.x : bounds.min.x,
+				plane.y > 0.0f ? bounds.max.y : bounds.min.y,
+				plane.z > 0.0f ? bounds.max.z : bounds.min.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Terrain::addNode(int level, int x, int z, int quadrant, int layer)
+	{
+		float size = (float)((int64_t)m_settings.gridSize << level) * m_settings.texelSpacing;
+		float morphEnd = m_ranges[level];
+		float previousRange = level > 0 ? m_ranges[level - 1] : 0.0f;
+		float morphStart = previousRange + (morphEnd - previousRange) * m_settings.morphStartRatio;
+		NodeInstance instance;
+		instance.area = glm::vec4(m_settings.position.x + x * size, m_settings.position.z + z * size, size, (float)level);
+		instance.params = glm::vec4((float)layer, morphStart, 1.0f / std::max(morphEnd - morphStart, 0.0001f), 0.0f);
+		m_instances[quadrant + 1].push_back(instance);
+	}
+
+	/// <summary>
+	/// Adds a node, or the parts of its children that are in range, to the draw lists. The node's page must be resident
+	/// </summary>
+	void Terrain::selectNode(int level, int x, int z)
+	{
+		int layer = m_pageLayers[getNodeKey(level, x, z)];
+		Page& page = m_pages[layer];
+		page.lastUsedFrame = m_frame;
+		Bounds bounds = getNodeBounds(level, x, z, page);
+		if (!isInFrustum(bounds)) {
+			return;
+		}
+		if (level == 0 || !sphereIntersectsBounds(m_eye, m_ranges[level - 1], bounds)) {
+			addNode(level, x, z, -1, layer);
+			return;
+		}
+
+		//Split only once every child can be drawn, so a node never has a hole while its children stream in
+		int childLayers[4];
+		bool childrenResident = true;
+		for (int i = 0; i < 4; i++)
+		{
+			int childX = x * 2 + (i & 1);
+			int childZ = z * 2 + (i >> 1);
+			childLayers[i] = -1;
+			if (!nodeExists(level - 1, childX, childZ)) {
+				continue;
+			}
+			uint64_t key = getNodeKey(level - 1, childX, childZ);
+			auto found = m_pageLayers.find(key);
+			if (found == m_pageLayers.end()) {
+				glm::vec3 toNode = glm::clamp(m_eye, bounds.min, bounds.max) - m_eye;
+				m_requests.push_back({ key, level - 1, childX, childZ, glm::length(toNode) });
+				childrenResident = false;
+				continue;
+			}
+			childLayers[i] = found->second;
+			m_pages[found->second].lastUsedFrame = m_frame;
+		}
+		if (!childrenResident) {
+			addNode(level, x, z, -1, layer);
+			return;
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			if (childLayers[i] < 0) {
+				continue;
+			}
+			int childX = x * 2 + (i & 1);
+			int childZ = z * 2 + (i >> 1);
+			Bounds childBounds = getNodeBounds(level - 1, childX, childZ, m_pages[childLayers[i]]);
+			if (sphereIntersectsBounds(m_eye, m_ranges[level - 1], childBounds)) {
+				selectNode(level - 1, childX, childZ);
+			}
+			//Too far for the child's level, so this level covers its area
+			else if (isInFrustum(childBounds)) {
+				addNode(level, x, z, i, layer);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Samples a node's heights, one per patch vertex plus a border, into texels.
+	/// Sampling at the node's own spacing keeps shared edges identical across levels, since a coarser node's
+	/// samples are a subset of its children's
+	/// </summary>
+	/// <param name="page">Receives the node's height range</param>
+	void Terrain::buildPage(int level, int x, int z, uint16_t* texels, Page* page) const
+	{
+		int pageSize = getPageSize();
+		int step = 1 << level;
+		int originX = x * (m_settings.gridSize << level);
+		int originZ = z * (m_settings.gridSize << level);
+		uint16_t minHeight = UINT16_MAX, maxHeight = 0;
+		for (int row = 0; row < pageSize; row++)
+		{
+			int texelZ = glm::clamp(originZ + (row - 1) * step, 0, m_height - 1);
+			for (int col = 0; col < pageSize; col++)
+			{
+				int texelX = glm::clamp(originX + (col - 1) * step, 0, m_width - 1);
+				uint16_t h = m_heights(texelX, texelZ);
+				texels[row * pageSize + col] = h;
+				//The border is only used for normals
+				if (row > 0 && col > 0 && row < pageSize - 1 && col < pageSize - 1) {
+					minHeight = std::min(minHeight, h);
+					maxHeight = std::max(maxHeight, h);
+				}
+			}
+		}
+		//Finer levels can reach a little past the samples of this one, but they are bounded by their own pages once split
+		page->minHeight = m_settings.position.y + minHeight / 65535.0f * m_settings.heightScale;
+		page->maxHeight = m_settings.position.y + maxHeight / 65535.0f * m_settings.heightScale;
+	}
+
+	/// <summary>
+	/// Builds up to maxPageLoadsPerFrame requested pages, coarsest and nearest first, and uploads them
+	/// into the layers used least recently
+	/// </summary>
+	void Terrain::loadPages(JobSystem* jobs)
+	{
+		m_stats.numPageRequests = (int)m_requests.size();
+		std::sort(m_requests.begin(), m_requests.end(), [](const PageRequest& a, const PageRequest& b) {
+			if (a.level != b.level) {
+				return a.level > b.level;
+			}
+			return a.distance < b.distance;
+		});
+		//Pages not used this frame can be replaced
+		std::vector<int> freeLayers;
+		for (int i = 0; i < (int)m_pages.size(); i++)
+		{
+			if (m_pages[i].lastUsedFrame < m_frame) {
+				freeLayers.push_back(i);
+			}
+		}
+		size_t numLoads = std::min({ m_requests.size(), freeLayers.size(), (size_t)std::max(m_settings.maxPageLoadsPerFrame, 0) });
+		std::partial_sort(freeLayers.begin(), freeLayers.begin() + numLoads, freeLayers.end(), [this](int a, int b) {
+			return m_pages[a].lastUsedFrame < m_pages[b].lastUsedFrame;
+		});
+		for (size_t i = 0; i < numLoads; i++)
+		{
+			Page& page = m_pages[freeLayers[i]];
+			if (page.key != UINT64_MAX) {
+				m_pageLayers.erase(page.key);
+			}
+			page.key = m_requests[i].key;
+			page.lastUsedFrame = m_frame;
+			m_pageLayers[page.key] = freeLayers[i];
+		}
+
+		size_t pageTexels = (size_t)getPageSize() * getPageSize();
+		m_pageTexels.resize(numLoads * pageTexels);
+		parallelFor(jobs, numLoads, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				const PageRequest& request = m_requests[i];
+				buildPage(request.level, request.x, request.z, &m_pageTexels[i * pageTexels], &m_pages[freeLayers[i]]);
+			}
+		});
+		//Rows of an odd number of 16 bit texels aren't 4 byte aligned
+		GLint unpackAlignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+		for (size_t i = 0; i < numLoads; i++)
+		{
+			glTextureSubImage3D(m_pageTexture, 0, 0, 0, freeLayers[i], getPageSize(), getPageSize(), 1, GL_RED, GL_UNSIGNED_SHORT, &m_pageTexels[i * pageTexels]);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+		m_stats.numPageLoads = (int)numLoads;
+		m_stats.numResidentPages = (int)m_pageLayers.size();
+	}
+
+	void Terrain::update(const Camera& camera, JobSystem* jobs)
+	{
+		if (m_numLevels == 0) {
+			return;
+		}
+		auto selectStart = std::chrono::high_resolution_clock::now();
+		m_frame++;
+		m_eye = camera.position;
+		float leafSize = m_settings.gridSize * m_settings.texelSpacing;
+		m_ranges.resize(m_numLevels);
+		for (int level = 0; level < m_numLevels; level++)
+		{
+			m_ranges[level] = leafSize * m_settings.lodDistanceRatio * (float)(1 << level);
+		}
+		//Side planes only. Nodes are limited by their LOD range instead of the far plane, and the near
+		//plane differs between depth conventions
+		glm::mat4 viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+		glm::vec4 rowX = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 rowY = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 rowW = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+		m_frustum[0] = rowW + rowX;
+		m_frustum[1] = rowW - rowX;
+		m_frustum[2] = rowW + rowY;
+		m_frustum[3] = rowW - rowY;
+
+		for (std::vector<NodeInstance>& instances : m_instances) {
+			instances.clear();
+		}
+		m_requests.clear();
+		uint64_t rootKey = getNodeKey(m_numLevels - 1, 0, 0);
+		if (m_pageLayers.count(rootKey)) {
+			selectNode(m_numLevels - 1, 0, 0);
+		}
+		else {
+			//Nothing can be drawn until the root arrives
+			m_requests.push_back({ rootKey, m_numLevels - 1, 0, 0, 0.0f });
+		}
+
+		//One buffer for all groups, each drawn with its own instance offset
+		std::vector<NodeInstance> allInstances;
+		int numTriangles = 0;
+		int patchTriangles = m_settings.gridSize * m_settings.gridSize * 2;
+		for (int i = 0; i < 5; i++)
+		{
+			m_firstInstance[i] = (int)allInstances.size();
+			allInstances.insert(allInstances.end(), m_instances[i].begin(), m_instances[i].end());
+			numTriangles += (int)m_instances[i].size() * (i == 0 ? patchTriangles : patchTriangles / 4);
+		}
+		size_t bytes = sizeof(NodeInstance) * allInstances.size();
+		if (bytes > 0) {
+			glNamedBufferData(m_nodeBuffer, bytes, allInstances.data(), GL_STREAM_DRAW);
+			if (bytes != m_nodeBufferSize) {
+				resizeGpuResource(GpuResourceType::BUFFER, m_nodeBuffer, bytes);
+				m_nodeBufferSize = bytes;
+			}
+		}
+		m_stats.numNodes = (int)allInstances.size();
+		m_stats.numTriangles = numTriangles;
+		auto selectEnd = std::chrono::high_resolution_clock::now();
+
+		loadPages(jobs);
+		auto streamEnd = std::chrono::high_resolution_clock::now();
+		m_stats.selectMilliseconds = std::chrono::duration<float, std::milli>(selectEnd - selectStart).count();
+		m_stats.streamMilliseconds = std::chrono::duration<float, std::milli>(streamEnd - selectEnd).count();
+	}
+
+	void Terrain::draw(const Shader& shader, unsigned int heightUnit) const
+	{
+		if (m_stats.numNodes == 0) {
+			return;
+		}
+		shader.use();
+		bindTextureUnit(heightUnit, m_pageTexture);
+		shader.setInt("_HeightPages", heightUnit);
+		shader.setFloat("_GridSize", (float)m_settings.gridSize);
+		shader.setFloat("_PageSize", (float)getPageSize());
+		shader.setFloat("_HeightScale", m_settings.heightScale);
+		shader.setFloat("_BaseHeight", m_settings.position.y);
+		shader.setVec3("_MorphEye", m_eye);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, m_nodeBuffer);
+		int quadrantIndices = m_patch.getNumIndices() / 4;
+		for (int i = 0; i < 5; i++)
+		{
+			int numInstances = (int)m_instances[i].size();
+			if (numInstances == 0) {
+				continue;
+			}
+			shader.setInt("_FirstInstance", m_firstInstance[i]);
+			if (i == 0) {
+				m_patch.drawInstanced(numInstances);
+			}
+			else {
+				m_patch.drawRangeInstanced((i - 1) * quadrantIndices, quadrantIndices, numInstances);
+			}
+		}
+	}
+
+	float Terrain::getHeight(float worldX, float worldZ) const
+	{
+		if (!m_heights) {
+			return m_settings.position.y;
+		}
+		float x = glm::clamp((worldX - m_settings.position.x) / m_settings.texelSpacing, 0.0f, (float)(m_width - 1));
+		float z = glm::clamp((worldZ - m_settings.position.z) / m_settings.texelSpacing, 0.0f, (float)(m_height - 1));
+		int x0 = std::min((int)x, m_width - 2);
+		int z0 = std::min((int)z, m_height - 2);
+		float tx = x - x0, tz = z - z0;
+		float h0 = glm::mix((float)m_heights(x0, z0), (float)m_heights(x0 + 1, z0), tx);
+		float h1 = glm::mix((float)m_heights(x0, z0 + 1), (float)m_heights(x0 + 1, z0 + 1), tx);
+		return m_settings.position.y + glm::mix(h0, h1, tz) / 65535.0f * m_settings.heightScale;
+	}
+
+	static float getLatticeValue(int x, int z) {
+		uint32_t h = (uint32_t)x * 374761393u + (uint32_t)z * 668265263u;
+		h = (h ^ (h >> 13)) * 1274126177u;
+		h ^= h >> 16;
+		return (h & 0xffff) / 65535.0f;
+	}
+
+	static float getValueNoise(float x, float z) {
+		float fx = floorf(x), fz = floorf(z);
+		int ix = (int)fx, iz = (int)fz;
+		float tx = x - fx, tz = z - fz;
+		//Smoothstep, so slopes are continuous across lattice cells
+		tx = tx * tx * (3.0f - 2.0f * tx);
+		tz = tz * tz * (3.0f - 2.0f * tz);
+		float a = glm::mix(getLatticeValue(ix, iz), getLatticeValue(ix + 1, iz), tx);
+		float b = glm::mix(getLatticeValue(ix, iz + 1), getLatticeValue(ix + 1, iz + 1), tx);
+		return glm::mix(a, b, tz);
+	}
+
+	uint16_t getProceduralHeight(int x, int z)
+	{
+		const int NUM_OCTAVES = 9;
+		float frequency = 1.0f / 2048.0f;
+		float amplitude = 0.5f;
+		float height = 0.0f;
+		for (int i = 0; i < NUM_OCTAVES; i++)
+		{
+			height += getValueNoise(x * frequency, z * frequency) * amplitude;
+			frequency *= 2.0f;
+			amplitude *= 0.5f;
+		}
+		//Squared, for flat valleys and sharper peaks
+		height /= 1.0f - amplitude * 2.0f;
+		return (uint16_t)(glm::clamp(height * height, 0.0f, 1.0f) * 65535.0f);
+	}
+}
@@ -0,0 +1,136 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include "mesh.h"
+#include "mappedFile.h"
+#include "camera.h"
+#include <glm/glm.hpp>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace ew {
+	class JobSystem;
+	class Shader;
+
+	//16 bit height at heightmap texel (x, z), 0-65535 mapping to 0-TerrainSettings::heightScale. Called from worker threads
+	typedef std::function<uint16_t(int x, int z)> HeightFunction;
+
+	struct TerrainSettings {
+		int gridSize = 32; //Quads per patch side. Power of 2
+		float texelSpacing = 1.0f; //World units between heightmap texels
+		float heightScale = 100.0f; //World height of the largest heightmap value
+		glm::vec3 position = glm::vec3(0.0f); //World position of heightmap texel (0, 0) at height 0
+		float lodDistanceRatio = 2.0f; //Level 0 is used within this many of its node sizes. Each level doubles the range
+		float morphStartRatio = 0.66f; //Fraction of a level's range where morphing towards the next level starts
+		int maxPages = 1024; //Height pages resident on the GPU
+		int maxPageLoadsPerFrame = 32;
+	};
+
+	struct TerrainStats {
+		int numNodes = 0; //Whole nodes and quadrants drawn
+		int numTriangles = 0;
+		int numPageLoads = 0;
+		int numPageRequests = 0; //Pages wanted but not loaded yet, including the ones loaded this frame
+		int numResidentPages = 0;
+		float selectMilliseconds = 0.0f;
+		float streamMilliseconds = 0.0f; //Building and uploading pages
+	};
+
+	//Continuous distance-dependent level of detail (CDLOD) terrain. The heightmap is covered by a quadtree of
+	//nodes which all draw the same grid patch, made by createPlane, scaled to their size. Each frame nodes are
+	//selected by their distance from the camera: a node is split into its children while they are within the
+	//next finer level's range, and frustum culled by its bounds. Vertices near the end of a level's range
+	//morph towards the next coarser level in the vertex shader, so levels meet without seams or popping.
+	//Heights are streamed: every node has a page of (gridSize + 3)^2 heights sampled at its own spacing
+	//(one texel per vertex plus a border for normals), kept in the layers of a 16 bit texture array.
+	//Missing pages are built on the job system and uploaded a few per frame. A node is only split once all of its
+	//children's pages are resident, and pages unused for the longest time are replaced first
+	class Terrain {
+	public:
+		static const int NODE_BINDING = 4; //Shader storage binding of the drawn nodes, see terrain.vert
+
+		Terrain() {};
+		~Terrain();
+		Terrain(const Terrain&) = delete;
+		Terrain& operator=(const Terrain&) = delete;
+		//Raw little endian 16 bit heightmap file, width * height texels. Mapped, so only the texels pages use are read
+		bool load(const std::string& filePath, int width, int height, const TerrainSettings& settings);
+		bool load(const HeightFunction& heights, int width, int height, const TerrainSettings& settings);
+		//Selects the nodes to draw from camera and streams in missing pages
+		void update(const Camera& camera, JobSystem* jobs = nullptr);
+		//Draws the selected nodes with terrain.vert (or a shader with the same inputs). Sets the terrain's uniforms,
+		//the caller sets _ViewProjection and anything its fragment shader needs
+		void draw(const Shader& shader, unsigned int heightUnit = 1)const;
+
+		inline const TerrainStats& getStats()const { return m_stats; }
+		inline const TerrainSettings& getSettings()const { return m_settings; }
+		//Changing lodDistanceRatio or morphStartRatio is picked up by the next update
+		inline TerrainSettings& getSettings() { return m_settings; }
+		inline int getNumLevels()const { return m_numLevels; }
+		//World size of the area covered, along x and z
+		inline glm::vec2 getWorldSize()const { return glm::vec2(m_width - 1, m_height - 1) * m_settings.texelSpacing; }
+		//Height of the heightmap at a world position, with bilinear filtering
+		float getHeight(float worldX, float worldZ)const;
+	private:
+		//Matches TerrainNode in terrain.vert
+		struct NodeInstance {
+			glm::vec4 area; //xy = world xz of the min corner, z = world size, w = level
+			glm::vec4 params; //x = page layer, y = distance morphing starts, z = 1 / morph distance
+		};
+		struct Page {
+			uint64_t key = UINT64_MAX;
+			int64_t lastUsedFrame = -1;
+			float minHeight = 0.0f; //World space
+			float maxHeight = 0.0f;
+		};
+		struct PageRequest {
+			uint64_t key;
+			int level;
+			int x;
+			int z;
+			float distance;
+		};
+		TerrainSettings m_settings;
+		HeightFunction m_heights;
+		MappedFile m_file;
+		int m_width = 0;
+		int m_height = 0;
+		int m_numLevels = 0;
+		Mesh m_patch; //Triangles ordered by quadrant, so a node can draw one quarter of itself
+		unsigned int m_pageTexture = 0;
+		unsigned int m_nodeBuffer = 0;
+		size_t m_nodeBufferSize = 0;
+		std::vector<Page> m_pages;
+		std::unordered_map<uint64_t, int> m_pageLayers;
+		std::vector<PageRequest> m_requests;
+		std::vector<uint16_t> m_pageTexels;
+		std::vector<float> m_ranges; //Per level
+		//Whole nodes, then quadrant 0-3 of nodes
+		std::vector<NodeInstance> m_instances[5];
+		int m_firstInstance[5] = {};
+		int64_t m_frame = 0;
+		glm::vec3 m_eye = glm::vec3(0.0f);
+		glm::vec4 m_frustum[4];
+		TerrainStats m_stats;
+
+		void release();
+		bool create(int width, int height, const TerrainSettings& settings);
+		inline int getPageSize()const { return m_settings.gridSize + 3; }
+		uint64_t getNodeKey(int level, int x, int z)const;
+		bool nodeExists(int level, int x, int z)const;
+		Bounds getNodeBounds(int level, int x, int z, const Page& page)const;
+		bool isInFrustum(const Bounds& bounds)const;
+		void selectNode(int level, int x, int z);
+		void addNode(int level, int x, int z, int quadrant, int layer);
+		void loadPages(JobSystem* jobs);
+		void buildPage(int level, int x, int z, uint16_t* texels, Page* page)const;
+	};
+
+	//Smooth 16384 x 16384 heightmap made of fractal value noise, for trying out terrains without a data file
+	uint16_t getProceduralHeight(int x, int z);
+}
@@ -3,6 +3,8 @@
 */
 
 #include "texture.h"
+#include "gpuResources.h"
+#include "assetArchive.h"
 #include "external/glad.h"
 #include "external/stb_image.h"
 
@@ -26,19 +28,20 @@ namespace ew {
 		return loadTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true);
 	}
 	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap) {
-		stbi_set_flip_vertically_on_load(true);
-		int width, height, numComponents;
-		unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 0);
-		if (data == NULL) {
+		//Pre-decoded textures in the mounted asset archive upload straight from its mapping
+		AssetImage image;
+		if (!image.load(filePath)) {
 			printf("Failed to load image %s", filePath);
-			stbi_image_free(data);
 			return 0;
 		}
+		int width = image.getWidth();
+		int height = image.getHeight();
+		int numComponents = image.getNumComponents();
 		unsigned int texture;
 		glGenTextures(1, &texture);
 		glBindTexture(GL_TEXTURE_2D, texture);
 		int format = getTextureFormat(numComponents);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image.getPixels());
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
@@ -53,8 +56,60 @@ namespace ew {
 		}
 
 		glBindTexture(GL_TEXTURE_2D, 0);
-		stbi_image_free(data);
+
+		trackGpuResource(GpuResourceType::TEXTURE, texture, getTextureBytes(width, height, 1, numComponents, mipmap), filePath);
 		return texture;
 	}
+	size_t getTextureBytes(int width, int height, int numLayers, int numComponents, bool mipmap) {
+		size_t bytes = (size_t)width * height * numLayers * (numComponents == 3 ? 4 : numComponents);
+		return mipmap ? bytes * 4 / 3 : bytes;
+	}
+	void deleteTexture(unsigned int texture) {
+		if (texture == 0) {
+			return;
+		}
+		untrackGpuResource(GpuResourceType::TEXTURE, texture);
+		glDeleteTextures(1, &texture);
+	}
+
+	Texture::Texture(const char* filePath)
+	{
+		m_texture = loadTexture(filePath);
+	}
+	Texture::Texture(unsigned int texture)
+	{
+		m_texture = texture;
+	}
+	Texture::~Texture()
+	{
+		deleteTexture(m_texture);
+	}
+	Texture::Texture(Texture&& other) noexcept
+	{
+		m_texture = other.m_texture;
+		other.m_texture = 0;
+	}
+	Texture& Texture::operator=(Texture&& other) noexcept
+	{
+		if (this != &other) {
+			deleteTexture(m_texture);
+			m_texture = other.m_texture;
+			other.m_texture = 0;
+		}
+		return *this;
+	}
+
+	static unsigned int s_textureBindCount = 0;
+
+	void bindTextureUnit(unsigned int unit, unsigned int texture) {
+		glBindTextureUnit(unit, texture);
+		s_textureBindCount++;
+	}
+	unsigned int getTextureBindCount() {
+		return s_textureBindCount;
+	}
+	void resetTextureBindCount() {
+		s_textureBindCount = 0;
+	}
 }
 
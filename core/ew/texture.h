@@ -3,8 +3,39 @@
 */
 
 #pragma once
+#include <stddef.h>
 
 namespace ew {
+	//Returned textures belong to the caller. Wrap them in ew::Texture, or free them with deleteTexture
 	unsigned int loadTexture(const char* filePath);
 	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+	//Deletes a texture and removes it from the GPU resource registry
+	void deleteTexture(unsigned int texture);
+	//GPU memory of an 8 bit texture as tracked in the GPU resource registry. Drivers store RGB as RGBA,
+	//and a full mip chain adds roughly a third
+	size_t getTextureBytes(int width, int height, int numLayers, int numComponents, bool mipmap);
+
+	//Owns a GL texture, which is deleted with it. Move-only so handles are never shared
+	class Texture {
+	public:
+		Texture() {};
+		//Loads with ew::loadTexture defaults
+		explicit Texture(const char* filePath);
+		//Takes ownership of an existing texture
+		explicit Texture(unsigned int texture);
+		~Texture();
+		Texture(Texture&& other) noexcept;
+		Texture& operator=(Texture&& other) noexcept;
+		Texture(const Texture&) = delete;
+		Texture& operator=(const Texture&) = delete;
+		inline unsigned int getHandle()const { return m_texture; }
+	private:
+		unsigned int m_texture = 0;
+	};
+
+	//glBindTextureUnit, counted so render loops can report texture binds per frame
+	void bindTextureUnit(unsigned int unit, unsigned int texture);
+	//Binds since the last reset
+	unsigned int getTextureBindCount();
+	void resetTextureBindCount();
 }
@@ -0,0 +1,157 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#include "textureArray.h"
+#include "texture.h"
+#include "gpuResources.h"
+#include "external/glad.h"
+#include "assetArchive.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+namespace ew {
+	static GLenum getInternalFormat(int numComponents) {
+		switch (numComponents) {
+		default:
+			return GL_RGBA8;
+		case 3:
+			return GL_RGB8;
+		case 2:
+			return GL_RG8;
+		case 1:
+			return GL_R8;
+		}
+	}
+
+	static GLenum getPixelFormat(int numComponents) {
+		switch (numComponents) {
+		default:
+			return GL_RGBA;
+		case 3:
+			return GL_RGB;
+		case 2:
+			return GL_RG;
+		case 1:
+			return GL_RED;
+		}
+	}
+
+	TextureArrayManager::~TextureArrayManager()
+	{
+		release();
+	}
+
+	TextureArrayManager::TextureArrayManager(TextureArrayManager&& other) noexcept
+	{
+		m_arrays = std::move(other.m_arrays);
+		other.m_arrays.clear();
+	}
+
+	TextureArrayManager& TextureArrayManager::operator=(TextureArrayManager&& other) noexcept
+	{
+		if (this != &other) {
+			release();
+			m_arrays = std::move(other.m_arrays);
+			other.m_arrays.clear();
+		}
+		return *this;
+	}
+
+	void TextureArrayManager::release()
+	{
+		for (TextureArray& a : m_arrays) {
+			if (a.texture != 0) {
+				untrackGpuResource(GpuResourceType::TEXTURE, a.texture);
+				glDeleteTextures(1, &a.texture);
+			}
+		}
+		m_arrays.clear();
+	}
+
+	TextureLayer TextureArrayManager::add(const char* filePath)
+	{
+		AssetImage image;
+		if (!image.load(filePath)) {
+			printf("Failed to load image %s\n", filePath);
+			return TextureLayer();
+		}
+		return add(image.getWidth(), image.getHeight(), image.getNumComponents(), image.getPixels());
+	}
+
+	TextureLayer TextureArrayManager::add(int width, int height, int numComponents, const unsigned char* pixels)
+	{
+		if (width <= 0 || height <= 0 || numComponents < 1 || numComponents > 4) {
+			printf("TextureArrayManager: unsupported texture %dx%d with %d components\n", width, height, numComponents);
+			return TextureLayer();
+		}
+		//First array with the same size and format that still has room and hasn't been uploaded
+		int array = -1;
+		for (int i = 0; i < (int)m_arrays.size(); i++)
+		{
+			const TextureArray& a = m_arrays[i];
+			if (a.width == width && a.height == height && a.numComponents == numComponents && a.numLayers < MAX_LAYERS && a.texture == 0) {
+				array = i;
+				break;
+			}
+		}
+		if (array < 0) {
+			array = (int)m_arrays.size();
+			m_arrays.push_back(TextureArray());
+			m_arrays[array].width = width;
+			m_arrays[array].height = height;
+			m_arrays[array].numComponents = numComponents;
+		}
+		TextureArray& a = m_arrays[array];
+		size_t layerSize = (size_t)width * height * numComponents;
+		a.pixels.resize(a.pixels.size() + layerSize);
+		memcpy(a.pixels.data() + a.pixels.size() - layerSize, pixels, layerSize);
+
+		TextureLayer layer;
+		layer.array = array;
+		layer.layer = a.numLayers++;
+		return layer;
+	}
+
+	void TextureArrayManager::upload()
+	{
+		upload(GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
+	}
+
+	void TextureArrayManager::upload(int wrapMode, int magFilter, int minFilter)
+	{
+		//Rows of RGB and single channel textures aren't 4 byte aligned
+		GLint unpackAlignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (TextureArray& a : m_arrays) {
+			if (a.texture != 0) {
+				continue;
+			}
+			int numLevels = 1;
+			while ((std::max(a.width, a.height) >> numLevels) > 0) {
+				numLevels++;
+			}
+			glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &a.texture);
+			glTextureStorage3D(a.texture, numLevels, getInternalFormat(a.numComponents), a.width, a.height, a.numLayers);
+			glTextureSubImage3D(a.texture, 0, 0, 0, 0, a.width, a.height, a.numLayers, getPixelFormat(a.numComponents), GL_UNSIGNED_BYTE, a.pixels.data());
+			glTextureParameteri(a.texture, GL_TEXTURE_WRAP_S, wrapMode);
+			glTextureParameteri(a.texture, GL_TEXTURE_WRAP_T, wrapMode);
+			glTextureParameteri(a.texture, GL_TEXTURE_MIN_FILTER, minFilter);
+			glTextureParameteri(a.texture, GL_TEXTURE_MAG_FILTER, magFilter);
+			glGenerateTextureMipmap(a.texture);
+			trackGpuResource(GpuResourceType::TEXTURE, a.texture, getTextureBytes(a.width, a.height, a.numLayers, a.numComponents, true),
+				"Texture array " + std::to_string(a.width) + "x" + std::to_string(a.height) + " x" + std::to_string(a.numLayers));
+			//Pixels live on the GPU now
+			std::vector<unsigned char>().swap(a.pixels);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+	}
+
+	void TextureArrayManager::bind(unsigned int unit, int array) const
+	{
+		bindTextureUnit(unit, m_arrays[array].texture);
+	}
+}
@@ -0,0 +1,60 @@
+/*
+*	Author: Eric Winebrenner
+*/
+
+#pragma once
+#include <vector>
+
+namespace ew {
+	//Where a texture lives inside a TextureArrayManager
+	struct TextureLayer {
+		int array = -1; //Index of the array, see TextureArrayManager::getTexture()
+		int layer = 0;
+		inline bool isValid()const { return array >= 0; }
+	};
+
+	//Packs textures of the same size and format into the layers of GL_TEXTURE_2D_ARRAYs, so objects with
+	//different textures can share one bind and be drawn in a single instanced or multi-draw call.
+	//Textures are added first and uploaded together, since array storage is immutable and sized by its layer count
+	class TextureArrayManager {
+	public:
+		//Layers per array. Well below GL_MAX_ARRAY_TEXTURE_LAYERS (at least 2048 in GL 4.5), so no array gets huge
+		static const int MAX_LAYERS = 256;
+
+		TextureArrayManager() {};
+		//Deletes every array. Move-only so arrays are never shared
+		~TextureArrayManager();
+		TextureArrayManager(TextureArrayManager&& other) noexcept;
+		TextureArrayManager& operator=(TextureArrayManager&& other) noexcept;
+		TextureArrayManager(const TextureArrayManager&) = delete;
+		TextureArrayManager& operator=(const TextureArrayManager&) = delete;
+		//Loads an image file, flipped vertically like ew::loadTexture. Returns an invalid layer on failure
+		TextureLayer add(const char* filePath);
+		//Copies tightly packed 8 bit pixels with 1-4 components
+		TextureLayer add(int width, int height, int numComponents, const unsigned char* pixels);
+		//Creates storage for every array added to since the last upload, with a full mip chain, and uploads their layers.
+		//Arrays that were already uploaded can't take new layers; textures added to them afterwards start a new array
+		void upload(int wrapMode, int magFilter, int minFilter);
+		void upload();
+
+		//GL texture name of an array. 0 until uploaded
+		inline unsigned int getTexture(int array)const { return m_arrays[array].texture; }
+		inline int getNumArrays()const { return (int)m_arrays.size(); }
+		inline int getNumLayers(int array)const { return m_arrays[array].numLayers; }
+		inline int getWidth(int array)const { return m_arrays[array].width; }
+		inline int getHeight(int array)const { return m_arrays[array].height; }
+		//Binds an array with ew::bindTextureUnit
+		void bind(unsigned int unit, int array)const;
+	private:
+		struct TextureArray {
+			int width = 0;
+			int height = 0;
+			int numComponents = 0;
+			int numLayers = 0;
+			unsigned int texture = 0;
+			std::vector<unsigned char> pixels; //Layers waiting for upload
+		};
+		std::vector<TextureArray> m_arrays;
+		void release();
+	};
+}
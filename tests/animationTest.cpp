@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <ew/animation.h>
+#include "testUtils.h"
+
+//Tests the SoA Pose layout, that the scalar and SIMD interpolation agree, how close the approximated slerp
+//stays to a true slerp, and blendPoses / AnimationClip::sample
+
+const double PI = 3.14159265358979323846;
+
+float randomFloat(float min, float max) {
+	return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+//Unit quaternion from an axis and an angle in radians, built here so the test does not depend on glm's conventions
+glm::quat axisAngle(float angle, float x, float y, float z) {
+	float length = sqrtf(x * x + y * y + z * z);
+	float s = sinf(angle * 0.5f) / length;
+	return glm::quat(cosf(angle * 0.5f), x * s, y * s, z * s);
+}
+
+glm::quat randomRotation() {
+	return axisAngle(randomFloat(-3.1f, 3.1f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.1f, 1.0f));
+}
+
+//Angle in degrees of the rotation from q to r. Opposite quaternions are the same rotation
+double rotationDifference(const glm::quat& q, const glm::quat& r) {
+	double dot = (double)q.x * r.x + (double)q.y * r.y + (double)q.z * r.z + (double)q.w * r.w;
+	double sign = dot < 0.0 ? -1.0 : 1.0;
+	double dx = q.x - sign * r.x, dy = q.y - sign * r.y, dz = q.z - sign * r.z, dw = q.w - sign * r.w;
+	//The chord between the unit 4-vectors is 2 sin(phi / 2), and the rotation angle is 2 phi.
+	//Unlike acos of the dot product this stays precise for small angles
+	double chord = sqrt(dx * dx + dy * dy + dz * dz + dw * dw);
+	return 4.0 * asin(fmin(chord * 0.5, 1.0)) * 180.0 / PI;
+}
+
+//Reference slerp in double precision, along the short way like the pose interpolation
+void slerpReference(const glm::quat& a, const glm::quat& b, double t, double out[4]) {
+	double qa[4] = { a.x, a.y, a.z, a.w };
+	double qb[4] = { b.x, b.y, b.z, b.w };
+	double dot = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2] + qa[3] * qb[3];
+	if (dot < 0.0) {
+		for (int i = 0; i < 4; i++) qb[i] = -qb[i];
+		dot = -dot;
+	}
+	double angle = acos(fmin(dot, 1.0));
+	double wa = 1.0 - t, wb = t;
+	if (angle > 1e-9) {
+		wa = sin((1.0 - t) * angle) / sin(angle);
+		wb = sin(t * angle) / sin(angle);
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		out[i] = qa[i] * wa + qb[i] * wb;
+	}
+}
+
+double maxDifference(const ew::Pose& a, const ew::Pose& b) {
+	double result = 0.0;
+	int numFloats = ew::Pose::NUM_STREAMS * a.getStride();
+	for (int i = 0; i < numFloats; i++)
+	{
+		result = fmax(result, fabs((double)a.getData()[i] - b.getData()[i]));
+	}
+	return result;
+}
+
+ew::Pose randomPose(int numJoints) {
+	ew::Pose pose(numJoints);
+	for (int j = 0; j < numJoints; j++)
+	{
+		glm::vec3 position(randomFloat(-5.0f, 5.0f), randomFloat(-5.0f, 5.0f), randomFloat(-5.0f, 5.0f));
+		glm::vec3 scale(randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f));
+		pose.setJoint(j, position, randomRotation(), scale);
+	}
+	return pose;
+}
+
+void testPoseLayout() {
+	ew::Pose pose(5);
+	CHECK(pose.getNumJoints() == 5);
+	CHECK(pose.getStride() == 8);
+	CHECK(pose.getStream(ew::Pose::TX) == pose.getData());
+	CHECK(pose.getStream(ew::Pose::RW) == pose.getData() + ew::Pose::RW * 8);
+	CHECK(pose.getStream(ew::Pose::SZ) == pose.getData() + ew::Pose::SZ * 8);
+
+	//Every joint starts as identity, padding included
+	for (int j = 0; j < pose.getStride(); j++)
+	{
+		for (int s = 0; s < ew::Pose::NUM_STREAMS; s++)
+		{
+			bool one = s == ew::Pose::RW || s >= ew::Pose::SX;
+			CHECK(pose.getStream(s)[j] == (one ? 1.0f : 0.0f));
+		}
+	}
+
+	glm::quat rotation = axisAngle(1.0f, 0.0f, 1.0f, 0.0f);
+	pose.setJoint(3, glm::vec3(1.0f, 2.0f, 3.0f), rotation, glm::vec3(4.0f, 5.0f, 6.0f));
+	const float expected[ew::Pose::NUM_STREAMS] = { 1.0f, 2.0f, 3.0f, rotation.x, rotation.y, rotation.z, rotation.w, 4.0f, 5.0f, 6.0f };
+	for (int s = 0; s < ew::Pose::NUM_STREAMS; s++)
+	{
+		CHECK(pose.getStream(s)[3] == expected[s]);
+		//Neighbours are untouched
+		CHECK(pose.getStream(s)[2] == pose.getStream(s)[4]);
+	}
+	glm::vec3 position = pose.getPosition(3);
+	glm::quat readRotation = pose.getRotation(3);
+	glm::vec3 scale = pose.getScale(3);
+	CHECK(position.x == 1.0f && position.y == 2.0f && position.z == 3.0f);
+	CHECK(readRotation.x == rotation.x && readRotation.y == rotation.y && readRotation.z == rotation.z && readRotation.w == rotation.w);
+	CHECK(scale.x == 4.0f && scale.y == 5.0f && scale.z == 6.0f);
+
+	pose.resize(9);
+	CHECK(pose.getStride() == 12);
+	CHECK(pose.getPosition(3).x == 0.0f && pose.getRotation(3).w == 1.0f && pose.getScale(3).x == 1.0f);
+}
+
+//Joint counts that are and aren't a multiple of 4, with random rotations so about half the pairs have a negative dot product
+void testSimdMatchesScalar() {
+	const int jointCounts[] = { 1, 4, 7, 37 };
+	const float weights[] = { 0.0f, 0.1f, 0.37f, 0.5f, 0.83f, 1.0f };
+	for (int numJoints : jointCounts) {
+		ew::Pose a = randomPose(numJoints);
+		ew::Pose b = randomPose(numJoints);
+		for (float weight : weights) {
+			ew::Pose scalar, simd;
+			ew::blendPoses(a, b, weight, &scalar, false);
+			ew::blendPoses(a, b, weight, &simd, true);
+			double difference = maxDifference(scalar, simd);
+			if (difference > 1e-6) {
+				printf("%d joints, weight %f: scalar and SIMD differ by %g\n", numJoints, weight, difference);
+				numFailures++;
+			}
+			//Padding joints stay identity
+			for (int j = numJoints; j < simd.getStride(); j++)
+			{
+				CHECK(simd.getRotation(j).w == 1.0f && simd.getScale(j).x == 1.0f && simd.getPosition(j).x == 0.0f);
+			}
+		}
+	}
+}
+
+//The corrected nlerp should stay within 0.1 degrees of slerp for any pair of rotations, in both paths
+void testSlerpAccuracy() {
+	const int NUM_ANGLES = 36;
+	const int NUM_WEIGHTS = 21;
+	ew::Pose a(NUM_ANGLES), b(NUM_ANGLES);
+	std::vector<glm::quat> rotationsA(NUM_ANGLES), rotationsB(NUM_ANGLES);
+	for (int j = 0; j < NUM_ANGLES; j++)
+	{
+		//Angles between the two rotations from 0 to 180 degrees, with b sometimes on the far hemisphere
+		float angle = (float)(PI * j / (NUM_ANGLES - 1));
+		rotationsA[j] = randomRotation();
+		glm::quat delta = axisAngle(angle, randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.1f, 1.0f));
+		rotationsB[j] = rotationsA[j] * delta;
+		if (j % 3 == 0) {
+			rotationsB[j] = -rotationsB[j];
+		}
+		a.setJoint(j, glm::vec3(0.0f), rotationsA[j], glm::vec3(1.0f));
+		b.setJoint(j, glm::vec3(0.0f), rotationsB[j], glm::vec3(1.0f));
+	}
+
+	for (int simd = 0; simd < 2; simd++) {
+		double maxError = 0.0;
+		for (int w = 0; w < NUM_WEIGHTS; w++)
+		{
+			float weight = (float)w / (NUM_WEIGHTS - 1);
+			ew::Pose out;
+			ew::blendPoses(a, b, weight, &out, simd == 1);
+			for (int j = 0; j < NUM_ANGLES; j++)
+			{
+				double reference[4];
+				slerpReference(rotationsA[j], rotationsB[j], weight, reference);
+				glm::quat expected((float)reference[3], (float)reference[0], (float)reference[1], (float)reference[2]);
+				maxError = fmax(maxError, rotationDifference(out.getRotation(j), expected));
+			}
+		}
+		if (maxError > 0.1) {
+			printf("%s interpolation is %f degrees from slerp\n", simd ? "SIMD" : "Scalar", maxError);
+			numFailures++;
+		}
+	}
+
+	//Plain nlerp a quarter of the way between rotations 120 degrees apart lags slerp by about 2 degrees
+	glm::quat from = axisAngle(0.0f, 0.0f, 1.0f, 0.0f);
+	glm::quat to = axisAngle((float)(PI * 2.0 / 3.0), 0.0f, 1.0f, 0.0f);
+	ew::Pose p(1), q(1), out;
+	p.setJoint(0, glm::vec3(0.0f), from, glm::vec3(1.0f));
+	q.setJoint(0, glm::vec3(0.0f), to, glm::vec3(1.0f));
+	ew::blendPoses(p, q, 0.25f, &out, false);
+	glm::quat quarter = axisAngle((float)(PI / 6.0), 0.0f, 1.0f, 0.0f);
+	CHECK(rotationDifference(out.getRotation(0), quarter) < 0.1);
+}
+
+void testBlendPoses() {
+	ew::Pose a = randomPose(6);
+	ew::Pose b = randomPose(6);
+	for (int simd = 0; simd < 2; simd++) {
+		ew::Pose out;
+		ew::blendPoses(a, b, 0.0f, &out, simd == 1);
+		CHECK(out.getNumJoints() == 6);
+		for (int j = 0; j < 6; j++)
+		{
+			CHECK(out.getPosition(j).x == a.getPosition(j).x && out.getScale(j).z == a.getScale(j).z);
+			CHECK(rotationDifference(out.getRotation(j), a.getRotation(j)) < 0.01);
+		}
+		ew::blendPoses(a, b, 1.0f, &out, simd == 1);
+		for (int j = 0; j < 6; j++)
+		{
+			CHECK(fabsf(out.getPosition(j).y - b.getPosition(j).y) < 1e-5f && fabsf(out.getScale(j).x - b.getScale(j).x) < 1e-5f);
+			//Possibly negated when b was on the far hemisphere, which is the same rotation
+			CHECK(rotationDifference(out.getRotation(j), b.getRotation(j)) < 0.01);
+		}
+
+		//Halfway positions are the average, halfway rotations are as far from a as from b
+		ew::blendPoses(a, b, 0.5f, &out, simd == 1);
+		for (int j = 0; j < 6; j++)
+		{
+			CHECK(fabsf(out.getPosition(j).z - (a.getPosition(j).z + b.getPosition(j).z) * 0.5f) < 1e-5f);
+			double fromA = rotationDifference(out.getRotation(j), a.getRotation(j));
+			double fromB = rotationDifference(out.getRotation(j), b.getRotation(j));
+			CHECK(fabs(fromA - fromB) < 0.1);
+		}
+
+		//Blending in place gives the same result
+		ew::Pose inPlace = a;
+		ew::blendPoses(inPlace, b, 0.3f, &inPlace, simd == 1);
+		ew::blendPoses(a, b, 0.3f, &out, simd == 1);
+		CHECK(maxDifference(inPlace, out) == 0.0);
+	}
+
+	//Mismatched joint counts leave out untouched
+	ew::Pose other(7);
+	ew::Pose out(2);
+	out.setJoint(1, glm::vec3(9.0f), axisAngle(0.5f, 1.0f, 0.0f, 0.0f), glm::vec3(2.0f));
+	ew::Pose before = out;
+	ew::blendPoses(a, other, 0.5f, &out);
+	CHECK(out.getNumJoints() == 2);
+	CHECK(maxDifference(out, before) == 0.0);
+}
+
+//One joint sliding 2 units along x and turning 90 degrees about y over one second
+void testClipSampling() {
+	ew::Skeleton skeleton;
+	skeleton.addJoint("root", -1, glm::vec3(0.0f), axisAngle(0.0f, 0.0f, 1.0f, 0.0f), glm::vec3(1.0f), glm::mat4(1.0f));
+	std::vector<ew::JointTrack> tracks(1);
+	tracks[0].positionTimes = { 0.0f, 1.0f };
+	tracks[0].positions = { glm::vec3(0.0f), glm::vec3(2.0f, 0.0f, 0.0f) };
+	tracks[0].rotationTimes = { 0.0f, 1.0f };
+	tracks[0].rotations = { axisAngle(0.0f, 0.0f, 1.0f, 0.0f), axisAngle((float)(PI * 0.5), 0.0f, 1.0f, 0.0f) };
+	ew::AnimationClip clip("slide", skeleton, tracks, 1.0f, 30.0f);
+	CHECK(clip.getNumJoints() == 1);
+	CHECK(clip.getNumFrames() == 31);
+
+	for (int simd = 0; simd < 2; simd++) {
+		ew::Pose pose;
+		clip.sample(0.25f, &pose, true, simd == 1);
+		CHECK(pose.getNumJoints() == 1);
+		CHECK(fabsf(pose.getPosition(0).x - 0.5f) < 1e-5f);
+		CHECK(rotationDifference(pose.getRotation(0), axisAngle((float)(PI / 8.0), 0.0f, 1.0f, 0.0f)) < 0.15);
+		//Looping wraps time, otherwise it is clamped to the end
+		clip.sample(1.25f, &pose, true, simd == 1);
+		CHECK(fabsf(pose.getPosition(0).x - 0.5f) < 1e-5f);
+		clip.sample(-0.75f, &pose, true, simd == 1);
+		CHECK(fabsf(pose.getPosition(0).x - 0.5f) < 1e-5f);
+		clip.sample(2.0f, &pose, false, simd == 1);
+		CHECK(fabsf(pose.getPosition(0).x - 2.0f) < 1e-5f);
+		CHECK(rotationDifference(pose.getRotation(0), axisAngle((float)(PI * 0.5), 0.0f, 1.0f, 0.0f)) < 0.01);
+	}
+}
+
+int main() {
+	srand(1);
+	testPoseLayout();
+	testSimdMatchesScalar();
+	testSlerpAccuracy();
+	testBlendPoses();
+	testClipSampling();
+	return finishTests("animation");
+}
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <random>
+
+#include <ew/lz4.h>
+#include <ew/assetArchive.h>
+#include "testUtils.h"
+
+//Tests LZ4 round trips and malformed blocks, and writing, opening and reading an asset archive
+
+//Compresses and decompresses data, checking the result matches and stays within lz4CompressBound.
+//Returns the compressed size, or 0 on failure
+size_t roundTrip(const std::string& data) {
+	std::vector<char> compressed(ew::lz4CompressBound(data.size()));
+	size_t compressedSize = ew::lz4Compress(data.data(), data.size(), compressed.data(), compressed.size());
+	//Extra space past dstSize, which decompression must not touch
+	std::vector<char> decompressed(data.size() + 16, '#');
+	bool ok = compressedSize > 0 && ew::lz4Decompress(compressed.data(), compressedSize, decompressed.data(), data.size());
+	ok = ok && memcmp(decompressed.data(), data.data(), data.size()) == 0 && decompressed[data.size()] == '#';
+	if (!ok) {
+		printf("Round trip of %d bytes failed\n", (int)data.size());
+		numFailures++;
+		return 0;
+	}
+	return compressedSize;
+}
+
+std::string randomBytes(size_t size, std::mt19937& rng) {
+	std::string result(size, '\0');
+	for (char& c : result) {
+		c = (char)(rng() & 0xFF);
+	}
+	return result;
+}
+
+void testLz4RoundTrips() {
+	std::mt19937 rng(1);
+	CHECK(roundTrip("") > 0);
+	//Blocks end with at least 5 literals and the last match starts 12 bytes before the end, so these are all literals
+	for (size_t size = 1; size < 13; size++)
+	{
+		roundTrip(std::string(size, 'a'));
+		roundTrip(randomBytes(size, rng));
+	}
+
+	//Incompressible data only grows by the literal length bytes
+	std::string noise = randomBytes(100000, rng);
+	size_t noiseSize = roundTrip(noise);
+	CHECK(noiseSize >= noise.size() && noiseSize <= ew::lz4CompressBound(noise.size()));
+
+	//Runs are matches that overlap their own output: offset 1 for a single repeated byte, 3 for a repeated pattern
+	CHECK(roundTrip(std::string(100000, 'x')) < 1000);
+	std::string pattern;
+	for (int i = 0; i < 30000; i++)
+	{
+		pattern += "abc";
+	}
+	CHECK(roundTrip(pattern) < 1000);
+
+	//Over 64 KB: a block repeated after more than the 65535 byte maximum offset can't match its first copy,
+	//but text with short range repeats still compresses throughout
+	std::string farRepeat = randomBytes(70000, rng);
+	farRepeat += farRepeat;
+	roundTrip(farRepeat);
+	std::string text;
+	const char* words[] = { "vertex ", "normal ", "texture ", "shadow ", "light ", "cluster ", "\n" };
+	while (text.size() < 300000) {
+		text += words[rng() % 7];
+	}
+	CHECK(roundTrip(text) < text.size() / 2);
+
+	//A fixed block as the reference LZ4_compress_default would write it: one literal, a match of 10 at offset 1,
+	//then the final 5 literals
+	const char block[] = { 0x16, 'a', 0x01, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a' };
+	char output[16];
+	CHECK(ew::lz4Decompress(block, sizeof(block), output, 16));
+	CHECK(std::string(output, 16) == std::string(16, 'a'));
+}
+
+void testLz4RejectsMalformedBlocks() {
+	std::mt19937 rng(2);
+	std::string data;
+	for (int i = 0; i < 2000; i++)
+	{
+		data += "block " + std::to_string(i % 50) + " ";
+	}
+	data += randomBytes(500, rng);
+	std::vector<char> compressed(ew::lz4CompressBound(data.size()));
+	size_t compressedSize = ew::lz4Compress(data.data(), data.size(), compressed.data(), compressed.size());
+	CHECK(compressedSize > 0);
+	std::vector<char> output(data.size());
+
+	//Every truncation fails
+	int numTruncationsAccepted = 0;
+	for (size_t size = 0; size < compressedSize; size++)
+	{
+		std::vector<char> truncated(compressed.begin(), compressed.begin() + size);
+		numTruncationsAccepted += ew::lz4Decompress(truncated.data(), size, output.data(), output.size()) ? 1 : 0;
+	}
+	CHECK(numTruncationsAccepted == 0);
+
+	//The block must expand to exactly dstSize
+	CHECK(!ew::lz4Decompress(compressed.data(), compressedSize, output.data(), output.size() - 1));
+	std::vector<char> larger(data.size() + 1);
+	CHECK(!ew::lz4Decompress(compressed.data(), compressedSize, larger.data(), larger.size()));
+
+	//A match reaching back before the start of the output
+	const char badOffset[] = { 0x10, 'a', 0x05, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a' };
+	char small[10];
+	CHECK(!ew::lz4Decompress(badOffset, sizeof(badOffset), small, 10));
+	//Offset 0 is invalid
+	const char zeroOffset[] = { 0x10, 'a', 0x00, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a' };
+	CHECK(!ew::lz4Decompress(zeroOffset, sizeof(zeroOffset), small, 10));
+	//A literal length running past the end of the input
+	const char longLiterals[] = { (char)0xF0, (char)0xFF, (char)0xFF, 'a', 'b' };
+	CHECK(!ew::lz4Decompress(longLiterals, sizeof(longLiterals), small, 10));
+
+	//Corrupt bytes may decode to garbage, but must never go out of bounds (run under a sanitizer to see that)
+	//or claim more output than was asked for
+	for (int i = 0; i < 2000; i++)
+	{
+		std::vector<char> corrupt(compressed.begin(), compressed.begin() + compressedSize);
+		corrupt[rng() % compressedSize] = (char)(rng() & 0xFF);
+		corrupt[rng() % compressedSize] = (char)(rng() & 0xFF);
+		std::vector<char> guarded(output.size() + 16, '#');
+		ew::lz4Decompress(corrupt.data(), corrupt.size(), guarded.data(), output.size());
+		if (guarded[output.size()] != '#') {
+			printf("Corrupt block %d wrote past the end of the output\n", i);
+			numFailures++;
+			break;
+		}
+	}
+}
+
+bool writeFile(const char* filePath, const std::string& data) {
+	FILE* file = fopen(filePath, "wb");
+	if (file == NULL) {
+		printf("Failed to write %s\n", filePath);
+		return false;
+	}
+	fwrite(data.data(), 1, data.size(), file);
+	fclose(file);
+	return true;
+}
+
+std::string readFile(const char* filePath) {
+	std::string data;
+	FILE* file = fopen(filePath, "rb");
+	if (file != NULL) {
+		char buffer[4096];
+		size_t size;
+		while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+			data.append(buffer, size);
+		}
+		fclose(file);
+	}
+	return data;
+}
+
+void putUint(std::string& data, uint32_t value, int numBytes) {
+	for (int i = 0; i < numBytes; i++)
+	{
+		data += (char)((value >> (8 * i)) & 0xFF);
+	}
+}
+
+//24 bit BMP of 3x2 pixels. BMP rows are stored bottom first in BGR order, padded to 4 bytes
+std::string createBmp(const unsigned char rgbBottomFirst[2][3][3]) {
+	std::string bmp = "BM";
+	putUint(bmp, 54 + 2 * 12, 4);
+	putUint(bmp, 0, 4);
+	putUint(bmp, 54, 4);
+	putUint(bmp, 40, 4);
+	putUint(bmp, 3, 4);
+	putUint(bmp, 2, 4);
+	putUint(bmp, 1, 2);
+	putUint(bmp, 24, 2);
+	putUint(bmp, 0, 4);
+	putUint(bmp, 2 * 12, 4);
+	putUint(bmp, 2835, 4);
+	putUint(bmp, 2835, 4);
+	putUint(bmp, 0, 4);
+	putUint(bmp, 0, 4);
+	for (int y = 0; y < 2; y++)
+	{
+		for (int x = 0; x < 3; x++)
+		{
+			bmp += (char)rgbBottomFirst[y][x][2];
+			bmp += (char)rgbBottomFirst[y][x][1];
+			bmp += (char)rgbBottomFirst[y][x][0];
+		}
+		putUint(bmp, 0, 3);
+	}
+	return bmp;
+}
+
+void testArchive() {
+	const char* archivePath = "assetArchiveTest.pak";
+	std::string shader = "#version 450\nvoid main(){}\n";
+	std::string text;
+	for (int i = 0; i < 4000; i++)
+	{
+		text += "v 1.0 2.0 3.0\n";
+	}
+	const unsigned char pixels[2][3][3] = {
+		{ { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 } },
+		{ { 10, 20, 30 }, { 40, 50, 60 }, { 70, 80, 90 } }
+	};
+	bool written = writeFile("assetArchiveTest.vert", shader) && writeFile("assetArchiveTest.obj", text)
+		&& writeFile("assetArchiveTest.bmp", createBmp(pixels)) && writeFile("assetArchiveTest.txt", "");
+	CHECK(written);
+
+	std::vector<ew::AssetPackInput> inputs = {
+		{ "assets/Shaders/Lit.vert", "assetArchiveTest.vert" },
+		{ "assets/Suzanne.obj", "assetArchiveTest.obj" },
+		{ "assets/brick.bmp", "assetArchiveTest.bmp" },
+		{ "assets/empty.txt", "assetArchiveTest.txt" }
+	};
+	ew::AssetPackSettings settings;
+	settings.compress = true;
+	ew::AssetPackStats stats;
+	CHECK(ew::writeAssetArchive(archivePath, inputs, settings, &stats));
+	CHECK(stats.numEntries == 4);
+	CHECK(stats.numCompressed == 1);
+	CHECK(stats.numTextures == 1);
+
+	ew::AssetArchive archive;
+	CHECK(archive.open(archivePath));
+	CHECK(archive.getNumEntries() == 4);
+
+	//Lookups ignore case, slash direction and "." / ".." segments
+	int vert = archive.find("assets/Shaders/Lit.vert");
+	CHECK(vert >= 0);
+	CHECK(archive.find("ASSETS/shaders/lit.VERT") == vert);
+	CHECK(archive.find("assets\\shaders\\lit.vert") == vert);
+	CHECK(archive.find("./assets/models/../shaders/lit.vert") == vert);
+	CHECK(archive.find("assets/shaders/lit.frag") < 0);
+	CHECK(archive.find("lit.vert") < 0);
+	CHECK(archive.getName(vert) == "assets/Shaders/Lit.vert");
+
+	for (int i = 0; i < archive.getNumEntries(); i++)
+	{
+		CHECK(archive.getEntry(i).offset % ew::AssetArchive::ALIGNMENT == 0);
+	}
+
+	//Uncompressed entries point into the mapping
+	ew::AssetData asset;
+	CHECK(archive.read(vert, &asset));
+	CHECK(std::string(asset.data, asset.size) == shader);
+	CHECK(asset.storage.empty());
+	CHECK((asset.entry->flags & ew::AssetArchive::COMPRESSED) == 0);
+
+	int obj = archive.find("assets/suzanne.obj");
+	CHECK(obj >= 0 && archive.read(obj, &asset));
+	CHECK((archive.getEntry(obj).flags & ew::AssetArchive::COMPRESSED) != 0);
+	CHECK(archive.getEntry(obj).storedSize < text.size() / 10);
+	CHECK(std::string(asset.data, asset.size) == text);
+
+	int empty = archive.find("assets/empty.txt");
+	CHECK(empty >= 0 && archive.read(empty, &asset));
+	CHECK(asset.size == 0);
+
+	//Images are stored decoded, bottom row first, which BMP already is
+	int bmp = archive.find("assets/Brick.BMP");
+	CHECK(bmp >= 0 && archive.read(bmp, &asset));
+	const ew::AssetArchiveEntry& image = archive.getEntry(bmp);
+	CHECK((image.flags & ew::AssetArchive::TEXTURE) != 0);
+	CHECK(image.width == 3 && image.height == 2 && image.numComponents == 3);
+	CHECK(asset.size == sizeof(pixels) && memcmp(asset.data, pixels, sizeof(pixels)) == 0);
+	archive.close();
+
+	//Loaders find the texture in the mounted archive and upload it without decoding or copying
+	CHECK(ew::mountAssetArchive(archivePath));
+	{
+		ew::AssetImage assetImage;
+		CHECK(assetImage.load("assets/brick.bmp"));
+		CHECK(assetImage.isZeroCopy());
+		CHECK(assetImage.getWidth() == 3 && assetImage.getHeight() == 2 && assetImage.getNumComponents() == 3);
+		CHECK(assetImage.getPixels() != nullptr && memcmp(assetImage.getPixels(), pixels, sizeof(pixels)) == 0);
+	}
+	ew::unmountAssetArchive();
+
+	//Two inputs naming the same asset, once case and slashes are ignored
+	std::vector<ew::AssetPackInput> duplicates = {
+		{ "assets/Suzanne.obj", "assetArchiveTest.obj" },
+		{ "assets\\suzanne.OBJ", "assetArchiveTest.obj" }
+	};
+	CHECK(!ew::writeAssetArchive("assetArchiveTestDuplicates.pak", duplicates));
+	remove("assetArchiveTestDuplicates.pak");
+
+	//Damaged archives don't open
+	std::string original = readFile(archivePath);
+	CHECK(original.size() > 512);
+	std::string damaged = original;
+	damaged[0] = 'X';
+	CHECK(writeFile(archivePath, damaged) && !archive.open(archivePath));
+	CHECK(writeFile(archivePath, original.substr(0, original.size() - 1)) && !archive.open(archivePath));
+
+	//One entry gets 2 slots. Filling both (the table follows the 56 byte header and the entry) would make find probe forever
+	std::vector<ew::AssetPackInput> single = { { "assets/Shaders/Lit.vert", "assetArchiveTest.vert" } };
+	CHECK(ew::writeAssetArchive(archivePath, single));
+	CHECK(archive.open(archivePath));
+	archive.close();
+	std::string full = readFile(archivePath);
+	const size_t slotsOffset = 56 + sizeof(ew::AssetArchiveEntry);
+	for (int slot = 0; slot < 2; slot++)
+	{
+		full[slotsOffset + slot * 4] = 1;
+	}
+	CHECK(writeFile(archivePath, full) && !archive.open(archivePath));
+
+	remove(archivePath);
+	remove("assetArchiveTest.vert");
+	remove("assetArchiveTest.obj");
+	remove("assetArchiveTest.bmp");
+	remove("assetArchiveTest.txt");
+}
+
+int main() {
+	testLz4RoundTrips();
+	testLz4RejectsMalformedBlocks();
+	testArchive();
+	return finishTests("asset archive");
+}
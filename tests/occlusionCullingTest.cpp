@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#include <ew/occlusionCulling.h>
+#include <ew/procGen.h>
+#include <ew/jobSystem.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "testUtils.h"
+
+//Tests OcclusionCuller on the CPU: rasterized coverage and depth, the hierarchical-Z pyramid, isVisible,
+//and rasterizing with jobs
+
+/// <summary>
+/// Quad covering [-0.5, 0.5] in x and y, counter-clockwise when viewed down -z.
+/// zLeft and zRight are the depths of its left and right edges
+/// </summary>
+ew::MeshData createQuad(float zLeft, float zRight) {
+	ew::MeshData meshData;
+	const glm::vec3 corners[4] = { glm::vec3(-0.5f, -0.5f, zLeft), glm::vec3(0.5f, -0.5f, zRight), glm::vec3(0.5f, 0.5f, zRight), glm::vec3(-0.5f, 0.5f, zLeft) };
+	for (const glm::vec3& corner : corners) {
+		ew::Vertex vertex;
+		vertex.pos = corner;
+		vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+		vertex.uv = glm::vec2(0.0f);
+		meshData.vertices.push_back(vertex);
+	}
+	meshData.indices = { 0, 1, 2, 0, 2, 3 };
+	return meshData;
+}
+
+float depthAt(const ew::OcclusionCuller& culler, int x, int y) {
+	return culler.getDepth(0)[y * culler.getWidth() + x];
+}
+
+//With an identity view projection clip space is NDC, so the quad covers pixels 16-47 of a 64x64 buffer
+//and its depth is the NDC x of each pixel center mapped to 0-1
+void testCoverageAndDepth() {
+	ew::OcclusionCuller culler(64, 64);
+	CHECK(culler.getWidth() == 64 && culler.getHeight() == 64);
+	ew::MeshData sloped = createQuad(-0.5f, 0.5f);
+	culler.beginFrame(glm::mat4(1.0f));
+	culler.addOccluder(&sloped, glm::mat4(1.0f));
+	culler.rasterize();
+	CHECK(culler.getNumOccluderTriangles() == 2);
+
+	int numCovered = 0;
+	for (int y = 0; y < 64; y++)
+	{
+		for (int x = 0; x < 64; x++)
+		{
+			bool inside = x >= 16 && x < 48 && y >= 16 && y < 48;
+			float expected = inside ? (x + 0.5f) / 64.0f : 1.0f;
+			if (fabsf(depthAt(culler, x, y) - expected) > 1e-4f) {
+				printf("pixel %d, %d: depth %f, expected %f\n", x, y, depthAt(culler, x, y), expected);
+				numFailures++;
+			}
+			numCovered += depthAt(culler, x, y) < 1.0f ? 1 : 0;
+		}
+	}
+	CHECK(numCovered == 32 * 32);
+
+	//The nearest of overlapping occluders wins, whichever order they are added in
+	ew::MeshData flat = createQuad(-0.9f, -0.9f);
+	glm::mat4 right = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, 0.0f, 0.0f));
+	culler.beginFrame(glm::mat4(1.0f));
+	culler.addOccluder(&sloped, glm::mat4(1.0f));
+	culler.addOccluder(&flat, right);
+	culler.rasterize();
+	CHECK(fabsf(depthAt(culler, 20, 32) - 20.5f / 64.0f) < 1e-4f);
+	CHECK(fabsf(depthAt(culler, 40, 32) - 0.05f) < 1e-4f);
+	CHECK(fabsf(depthAt(culler, 60, 32) - 0.05f) < 1e-4f);
+	CHECK(depthAt(culler, 40, 10) == 1.0f);
+}
+
+void testPyramid() {
+	ew::OcclusionCuller culler(64, 64);
+	ew::MeshData sloped = createQuad(-0.5f, 0.5f);
+	culler.beginFrame(glm::mat4(1.0f));
+	culler.addOccluder(&sloped, glm::mat4(1.0f));
+	culler.rasterize();
+
+	CHECK(culler.getNumLevels() == 7);
+	for (int level = 1; level < culler.getNumLevels(); level++)
+	{
+		int srcWidth = culler.getLevelWidth(level - 1);
+		int srcHeight = culler.getLevelHeight(level - 1);
+		CHECK(culler.getLevelWidth(level) == (srcWidth + 1) / 2 && culler.getLevelHeight(level) == (srcHeight + 1) / 2);
+		const float* src = culler.getDepth(level - 1);
+		const float* dst = culler.getDepth(level);
+		for (int y = 0; y < culler.getLevelHeight(level); y++)
+		{
+			for (int x = 0; x < culler.getLevelWidth(level); x++)
+			{
+				float farthest = 0.0f;
+				for (int sy = y * 2; sy <= std::min(y * 2 + 1, srcHeight - 1); sy++)
+				{
+					for (int sx = x * 2; sx <= std::min(x * 2 + 1, srcWidth - 1); sx++)
+					{
+						farthest = std::max(farthest, src[sy * srcWidth + sx]);
+					}
+				}
+				if (dst[y * culler.getLevelWidth(level) + x] != farthest) {
+					printf("level %d texel %d, %d: depth %f, expected the farthest below it, %f\n", level, x, y, dst[y * culler.getLevelWidth(level) + x], farthest);
+					numFailures++;
+				}
+			}
+		}
+	}
+	//Level 4 texels are 16x16 pixels. Texel 1, 1 is fully covered, its farthest pixel is column 31
+	CHECK(fabsf(culler.getDepth(4)[1 * 4 + 1] - 31.5f / 64.0f) < 1e-4f);
+	//Texel 0, 0 is background
+	CHECK(culler.getDepth(4)[0] == 1.0f);
+	CHECK(culler.getDepth(culler.getNumLevels() - 1)[0] == 1.0f);
+}
+
+void testVisibility() {
+	ew::OcclusionCuller culler(64, 64);
+	//Flat occluder at NDC z 0, window depth 0.5
+	ew::MeshData flat = createQuad(0.0f, 0.0f);
+	culler.beginFrame(glm::mat4(1.0f));
+	culler.addOccluder(&flat, glm::mat4(1.0f));
+	culler.rasterize();
+
+	ew::Bounds behind;
+	behind.min = glm::vec3(-0.2f, -0.2f, 0.4f);
+	behind.max = glm::vec3(0.2f, 0.2f, 0.6f);
+	CHECK(!culler.isVisible(behind));
+	//Same bounds, moved in front of the occluder
+	CHECK(culler.isVisible(behind, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -1.0f))));
+
+	//Sticks out past the right edge of the occluder
+	ew::Bounds partly;
+	partly.min = glm::vec3(0.3f, -0.2f, 0.4f);
+	partly.max = glm::vec3(0.8f, 0.2f, 0.6f);
+	CHECK(culler.isVisible(partly));
+
+	//Off screen
+	ew::Bounds outside;
+	outside.min = glm::vec3(1.5f, -0.2f, 0.4f);
+	outside.max = glm::vec3(2.0f, 0.2f, 0.6f);
+	CHECK(!culler.isVisible(outside));
+
+	//Perspective camera at the origin looking down -z, with a wall filling the view 5 units away
+	ew::OcclusionCuller perspective(64, 64);
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+	glm::mat4 wall = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f)), glm::vec3(40.0f, 40.0f, 1.0f));
+	perspective.beginFrame(projection);
+	perspective.addOccluder(&flat, wall);
+	perspective.rasterize();
+
+	ew::Bounds box;
+	box.min = glm::vec3(-0.5f);
+	box.max = glm::vec3(0.5f);
+	CHECK(!perspective.isVisible(box, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -10.0f))));
+	CHECK(perspective.isVisible(box, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.0f))));
+	//Crosses the near plane, so it can't be projected and is kept even though it is behind the wall's pixels
+	CHECK(perspective.isVisible(box, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -0.2f))));
+	//Entirely behind the camera
+	CHECK(!perspective.isVisible(box, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 3.0f))));
+	//Between the near plane and the camera
+	ew::Bounds tiny;
+	tiny.min = glm::vec3(-0.01f);
+	tiny.max = glm::vec3(0.01f);
+	CHECK(!perspective.isVisible(tiny, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -0.05f))));
+}
+
+//Spreading binning and tiles over jobs gives the same depth buffer as running on one thread
+void testJobs() {
+	ew::MeshData sphere = ew::createSphere(1.0f, 32);
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+	ew::OcclusionCuller serial(256, 128);
+	ew::OcclusionCuller parallel(256, 128);
+	ew::JobSystem jobs(4);
+	for (ew::OcclusionCuller* culler : { &serial, &parallel }) {
+		culler->beginFrame(projection);
+		for (int i = -4; i <= 4; i++)
+		{
+			culler->addOccluder(&sphere, glm::translate(glm::mat4(1.0f), glm::vec3(i * 1.5f, 0.0f, -6.0f - (i & 1) * 2.0f)));
+		}
+	}
+	serial.rasterize();
+	parallel.rasterize(&jobs);
+	CHECK(parallel.getNumThreadsUsed() == 4);
+	CHECK(parallel.getNumOccluderTriangles() == serial.getNumOccluderTriangles());
+	int numDifferent = 0;
+	for (int i = 0; i < serial.getWidth() * serial.getHeight(); i++)
+	{
+		numDifferent += serial.getDepth(0)[i] != parallel.getDepth(0)[i] ? 1 : 0;
+	}
+	CHECK(numDifferent == 0);
+}
+
+int main() {
+	testCoverageAndDepth();
+	testPyramid();
+	testVisibility();
+	testJobs();
+	return finishTests("occlusion culling");
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <ew/skinnedMesh.h>
+#include "testUtils.h"
+
+//Tests loadSkinnedModelData on a small rigged COLLADA file: the joints it keeps and how vertex weights are
+//normalized
+
+//A strip of three rows of vertices up the y axis, skinned to a chain of two bones under an armature node.
+//The bottom row belongs to Bone1, the top row to Bone2. The middle row is weighted 0.25 to each, which isn't normalized
+const char* RIGGED_STRIP = R"(<?xml version="1.0" encoding="utf-8"?>
+<COLLADA xmlns="http://www.collada.org/2005/11/COLLADASchema" version="1.4.1">
+  <asset><unit name="meter" meter="1"/><up_axis>Y_UP</up_axis></asset>
+  <library_geometries>
+    <geometry id="Strip-mesh" name="Strip">
+      <mesh>
+        <source id="Strip-positions">
+          <float_array id="Strip-positions-array" count="18">0 0 0 1 0 0 0 1 0 1 1 0 0 2 0 1 2 0</float_array>
+          <technique_common>
+            <accessor source="#Strip-positions-array" count="6" stride="3">
+              <param name="X" type="float"/><param name="Y" type="float"/><param name="Z" type="float"/>
+            </accessor>
+          </technique_common>
+        </source>
+        <vertices id="Strip-vertices"><input semantic="POSITION" source="#Strip-positions"/></vertices>
+        <triangles count="4">
+          <input semantic="VERTEX" source="#Strip-vertices" offset="0"/>
+          <p>0 1 2 2 1 3 2 3 4 4 3 5</p>
+        </triangles>
+      </mesh>
+    </geometry>
+  </library_geometries>
+  <library_controllers>
+    <controller id="Strip-skin">
+      <skin source="#Strip-mesh">
+        <bind_shape_matrix>1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1</bind_shape_matrix>
+        <source id="Strip-joints">
+          <Name_array id="Strip-joints-array" count="2">Bone1 Bone2</Name_array>
+          <technique_common>
+            <accessor source="#Strip-joints-array" count="2" stride="1"><param name="JOINT" type="name"/></accessor>
+          </technique_common>
+        </source>
+        <source id="Strip-bind-poses">
+          <float_array id="Strip-bind-poses-array" count="32">1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1 1 0 0 0 0 1 0 -1 0 0 1 0 0 0 0 1</float_array>
+          <technique_common>
+            <accessor source="#Strip-bind-poses-array" count="2" stride="16"><param name="TRANSFORM" type="float4x4"/></accessor>
+          </technique_common>
+        </source>
+        <source id="Strip-weights">
+          <float_array id="Strip-weights-array" count="2">1 0.25</float_array>
+          <technique_common>
+            <accessor source="#Strip-weights-array" count="2" stride="1"><param name="WEIGHT" type="float"/></accessor>
+          </technique_common>
+        </source>
+        <joints>
+          <input semantic="JOINT" source="#Strip-joints"/>
+          <input semantic="INV_BIND_MATRIX" source="#Strip-bind-poses"/>
+        </joints>
+        <vertex_weights count="6">
+          <input semantic="JOINT" source="#Strip-joints" offset="0"/>
+          <input semantic="WEIGHT" source="#Strip-weights" offset="1"/>
+          <vcount>1 1 2 2 1 1</vcount>
+          <v>0 0 0 0 0 1 1 1 0 1 1 1 1 0 1 0</v>
+        </vertex_weights>
+      </skin>
+    </controller>
+  </library_controllers>
+  <library_visual_scenes>
+    <visual_scene id="Scene" name="Scene">
+      <node id="Armature" name="Armature" type="NODE">
+        <node id="Bone1" name="Bone1" sid="Bone1" type="JOINT">
+          <matrix sid="transform">1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1</matrix>
+          <node id="Bone2" name="Bone2" sid="Bone2" type="JOINT">
+            <matrix sid="transform">1 0 0 0 0 1 0 1 0 0 1 0 0 0 0 1</matrix>
+          </node>
+        </node>
+      </node>
+      <node id="Strip" name="Strip" type="NODE">
+        <instance_controller url="#Strip-skin"><skeleton>#Bone1</skeleton></instance_controller>
+      </node>
+    </visual_scene>
+  </library_visual_scenes>
+  <scene><instance_visual_scene url="#Scene"/></scene>
+</COLLADA>
+)";
+
+int main() {
+	const char* filePath = "skinnedMeshTest.dae";
+	FILE* file = fopen(filePath, "wb");
+	if (file == NULL) {
+		printf("Failed to write %s\n", filePath);
+		return 1;
+	}
+	fputs(RIGGED_STRIP, file);
+	fclose(file);
+
+	ew::SkinnedModelData model;
+	bool loaded = ew::loadSkinnedModelData(filePath, &model);
+	remove(filePath);
+	CHECK(loaded);
+	if (!loaded) {
+		return 1;
+	}
+
+	//The skeleton holds both bones and the nodes above them (the armature and whatever root Assimp adds), nothing else
+	const ew::Skeleton& skeleton = model.skeleton;
+	int bone1 = skeleton.findJoint("Bone1");
+	int bone2 = skeleton.findJoint("Bone2");
+	CHECK(bone1 >= 0 && bone2 >= 0);
+	if (bone1 < 0 || bone2 < 0) {
+		return 1;
+	}
+	CHECK(skeleton.parents[bone2] == bone1);
+	CHECK(skeleton.findJoint("Armature") >= 0);
+	CHECK(skeleton.findJoint("Strip") < 0);
+	int numAncestors = 0;
+	for (int joint = skeleton.parents[bone1]; joint >= 0; joint = skeleton.parents[joint]) {
+		CHECK(skeleton.inverseBindMatrices[joint] == glm::mat4(1.0f));
+		numAncestors++;
+	}
+	CHECK(skeleton.getNumJoints() == numAncestors + 2);
+	CHECK(fabsf(skeleton.inverseBindMatrices[bone2][3][1] + 1.0f) < 1e-5f);
+	CHECK(model.clips.empty());
+
+	//Weights are normalized and quantized to bytes that sum to 255, whatever the file's weights summed to
+	CHECK(model.meshes.size() == 1);
+	for (const ew::SkinnedMeshData& mesh : model.meshes) {
+		CHECK(mesh.vertices.size() == 6);
+		CHECK(mesh.indices.size() == 12);
+		for (const ew::SkinnedVertex& vertex : mesh.vertices) {
+			int sum = 0;
+			int numInfluences = 0;
+			for (int i = 0; i < ew::MAX_JOINTS_PER_VERTEX; i++)
+			{
+				sum += vertex.weights[i];
+				if (vertex.weights[i] > 0) {
+					numInfluences++;
+					CHECK(vertex.joints[i] == bone1 || vertex.joints[i] == bone2);
+				}
+			}
+			CHECK(sum == 255);
+			int expectedJoint = vertex.pos.y < 0.5f ? bone1 : bone2;
+			if (vertex.pos.y < 0.5f || vertex.pos.y > 1.5f) {
+				CHECK(numInfluences == 1);
+				for (int i = 0; i < ew::MAX_JOINTS_PER_VERTEX; i++)
+				{
+					CHECK(vertex.weights[i] == 0 || vertex.joints[i] == expectedJoint);
+				}
+			}
+			else {
+				//Equal halves, off by at most the rounding of an odd total
+				CHECK(numInfluences == 2);
+				for (int i = 0; i < ew::MAX_JOINTS_PER_VERTEX; i++)
+				{
+					CHECK(vertex.weights[i] == 0 || vertex.weights[i] == 127 || vertex.weights[i] == 128);
+				}
+			}
+		}
+	}
+
+	return finishTests("skinned model");
+}
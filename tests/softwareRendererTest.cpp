@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+#include <ew/softwareRenderer.h>
+#include <ew/procGen.h>
+#include <ew/jobSystem.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "testUtils.h"
+
+//Renders a small fixed scene with SoftwareRenderer and compares it to a checked in reference image.
+//Usage: SoftwareRendererTest <reference.ppm> [--update]. --update rewrites the reference from this build instead,
+//for changes that are meant to alter the image. On a mismatch the rendered image is left next to the test for comparison
+
+const int WIDTH = 128;
+const int HEIGHT = 96;
+//A channel off by more than this is a mismatched pixel. Triangle edges may flip under different compilers
+//or math libraries, so a few of those are allowed
+const int CHANNEL_TOLERANCE = 8;
+const float MAX_MISMATCHED_FRACTION = 0.01f;
+const float MAX_MEAN_ERROR = 0.5f;
+
+struct Image {
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> rgb; //Top row first, like the file
+};
+
+bool readPPM(const std::string& filePath, Image* image) {
+	FILE* file = fopen(filePath.c_str(), "rb");
+	if (file == NULL) {
+		return false;
+	}
+	int maxValue = 0;
+	bool ok = fscanf(file, "P6 %d %d %d", &image->width, &image->height, &maxValue) == 3 && maxValue == 255 && fgetc(file) != EOF;
+	ok = ok && image->width > 0 && image->height > 0;
+	if (ok) {
+		image->rgb.resize((size_t)image->width * image->height * 3);
+		ok = fread(image->rgb.data(), 1, image->rgb.size(), file) == image->rgb.size();
+	}
+	fclose(file);
+	return ok;
+}
+
+//Checkerboard of 4x4 squares, so texture coordinates and filtering show up in the image
+ew::SoftwareTexture createChecker() {
+	ew::SoftwareTexture texture;
+	texture.width = 32;
+	texture.height = 32;
+	texture.pixels.resize(32 * 32 * 4);
+	for (int y = 0; y < 32; y++)
+	{
+		for (int x = 0; x < 32; x++)
+		{
+			bool light = ((x / 4) + (y / 4)) % 2 == 0;
+			uint8_t* pixel = &texture.pixels[(y * 32 + x) * 4];
+			pixel[0] = light ? 230 : 40;
+			pixel[1] = light ? 200 : 60;
+			pixel[2] = light ? 120 : 90;
+			pixel[3] = 255;
+		}
+	}
+	return texture;
+}
+
+//A textured floor with a sphere and a rotated cube on it, lit from the upper left
+void renderScene(ew::SoftwareRenderer& renderer, ew::JobSystem* jobs) {
+	ew::MeshData plane = ew::createPlane(6.0f, 6.0f, 4);
+	ew::MeshData sphere = ew::createSphere(0.8f, 24);
+	ew::MeshData cube = ew::createCube(1.0f);
+	ew::SoftwareTexture checker = createChecker();
+
+	ew::Camera camera;
+	camera.position = glm::vec3(0.0f, 2.5f, 5.0f);
+	camera.target = glm::vec3(0.0f, 0.3f, 0.0f);
+	camera.aspectRatio = (float)WIDTH / HEIGHT;
+	renderer.setCamera(camera);
+	renderer.setLight(glm::normalize(glm::vec3(-1.0f, -2.0f, -1.0f)));
+	renderer.clear(glm::vec3(0.2f, 0.3f, 0.4f));
+
+	ew::SoftwareMaterial matte;
+	matte.Ks = 0.1f;
+	ew::SoftwareMaterial shiny;
+	shiny.Kd = 0.4f;
+	shiny.Ks = 0.8f;
+	shiny.Shininess = 32.0f;
+	renderer.draw(&plane, glm::mat4(1.0f), matte, &checker);
+	renderer.draw(&sphere, glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, 0.8f, 0.0f)), shiny);
+	glm::mat4 cubeMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(1.2f, 0.5f, 0.5f));
+	cubeMatrix = glm::rotate(cubeMatrix, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	renderer.draw(&cube, cubeMatrix, matte);
+	renderer.flush(jobs);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printf("Usage: %s <reference.ppm> [--update]\n", argv[0]);
+		return 1;
+	}
+	const std::string referencePath = argv[1];
+	const bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+	const char* outputPath = "softwareRendererTest.ppm";
+
+	ew::SoftwareRenderer renderer(WIDTH, HEIGHT);
+	renderScene(renderer, nullptr);
+	CHECK(renderer.getStats().numTrianglesRasterized > 0);
+
+	//Jobs only change who renders each tile, never the result
+	ew::SoftwareRenderer parallel(WIDTH, HEIGHT);
+	ew::JobSystem jobs(4);
+	renderScene(parallel, &jobs);
+	CHECK(memcmp(renderer.getColor(), parallel.getColor(), (size_t)WIDTH * HEIGHT * 4) == 0);
+
+	if (update) {
+		CHECK(renderer.writePPM(referencePath));
+		printf("Wrote %s\n", referencePath.c_str());
+		return finishTests("software renderer");
+	}
+
+	Image reference, rendered;
+	if (!readPPM(referencePath, &reference)) {
+		printf("Failed to read reference image %s\n", referencePath.c_str());
+		return 1;
+	}
+	CHECK(renderer.writePPM(outputPath) && readPPM(outputPath, &rendered));
+	CHECK(reference.width == WIDTH && reference.height == HEIGHT);
+	if (reference.rgb.size() != rendered.rgb.size()) {
+		return finishTests("software renderer");
+	}
+
+	int numMismatched = 0;
+	double totalError = 0.0;
+	for (size_t pixel = 0; pixel < reference.rgb.size() / 3; pixel++)
+	{
+		int maxError = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			int error = abs((int)reference.rgb[pixel * 3 + c] - (int)rendered.rgb[pixel * 3 + c]);
+			maxError = error > maxError ? error : maxError;
+			totalError += error;
+		}
+		numMismatched += maxError > CHANNEL_TOLERANCE ? 1 : 0;
+	}
+	int numPixels = WIDTH * HEIGHT;
+	float meanError = (float)(totalError / (numPixels * 3.0));
+	printf("%d of %d pixels mismatched, mean channel error %.3f\n", numMismatched, numPixels, meanError);
+	CHECK(numMismatched <= (int)(numPixels * MAX_MISMATCHED_FRACTION));
+	CHECK(meanError <= MAX_MEAN_ERROR);
+	if (numFailures == 0) {
+		remove(outputPath);
+	}
+	else {
+		printf("Rendered image left in %s\n", outputPath);
+	}
+	return finishTests("software renderer");
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdio.h>
+
+//Shared by the CPU tests. A failed CHECK prints where it was and is counted, and the test keeps going,
+//so one run reports every failure. main returns finishTests(...)
+
+static int numFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			numFailures++; \
+		} \
+	} while (0)
+
+/// <summary>
+/// Prints the outcome and returns the exit code for main
+/// </summary>
+static inline int finishTests(const char* name) {
+	if (numFailures > 0) {
+		printf("%d checks failed\n", numFailures);
+		return 1;
+	}
+	printf("All %s checks passed\n", name);
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <ew/assetArchive.h>
+
+//Packs asset files into one archive that ew::mountAssetArchive serves loaders from.
+//Usage: AssetPack <output> [--root <dir>] [--lz4] [--keep-images] <files...>
+//Entries are named by their path relative to --root, e.g. <root>/assets/lit.vert becomes "assets/lit.vert".
+//AssetPack --list <archive> prints an archive's contents
+
+/// <summary>
+/// Name an input is stored under: its path relative to root when it is inside it, otherwise as given
+/// </summary>
+std::string getEntryName(const std::string& filePath, const std::string& root) {
+	std::string path = ew::normalizeAssetPath(filePath);
+	if (root.empty()) {
+		return path;
+	}
+	std::string prefix = ew::normalizeAssetPath(root) + "/";
+	return path.compare(0, prefix.size(), prefix) == 0 ? path.substr(prefix.size()) : path;
+}
+
+int listArchive(const std::string& filePath) {
+	ew::AssetArchive archive;
+	if (!archive.open(filePath)) {
+		return 1;
+	}
+	printf("%s: %d entries, %.1f KB\n", filePath.c_str(), archive.getNumEntries(), archive.getFileSize() / 1024.0f);
+	printf("  %-40s %10s %10s  %s\n", "Name", "Size", "Stored", "Format");
+	for (int i = 0; i < archive.getNumEntries(); i++)
+	{
+		const ew::AssetArchiveEntry& e = archive.getEntry(i);
+		char format[64] = "";
+		if (e.flags & ew::AssetArchive::TEXTURE) {
+			snprintf(format, sizeof(format), "texture %ux%u x%u", e.width, e.height, e.numComponents);
+		}
+		if (e.flags & ew::AssetArchive::COMPRESSED) {
+			strncat(format, format[0] ? ", lz4" : "lz4", sizeof(format) - strlen(format) - 1);
+		}
+		printf("  %-40s %10llu %10llu  %s\n", archive.getName(i).c_str(), (unsigned long long)e.size, (unsigned long long)e.storedSize, format);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && strcmp(argv[1], "--list") == 0) {
+		return listArchive(argv[2]);
+	}
+	std::string output;
+	std::string root;
+	ew::AssetPackSettings settings;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+			root = argv[++i];
+		}
+		else if (strcmp(argv[i], "--lz4") == 0) {
+			settings.compress = true;
+		}
+		else if (strcmp(argv[i], "--keep-images") == 0) {
+			settings.decodeImages = false;
+		}
+		else if (output.empty()) {
+			output = argv[i];
+		}
+		else {
+			files.push_back(argv[i]);
+		}
+	}
+	if (output.empty() || files.empty()) {
+		printf("Usage: AssetPack <output> [--root <dir>] [--lz4] [--keep-images] <files...>\n");
+		printf("       AssetPack --list <archive>\n");
+		return 1;
+	}
+
+	std::vector<ew::AssetPackInput> inputs;
+	inputs.reserve(files.size());
+	for (const std::string& file : files) {
+		inputs.push_back({ getEntryName(file, root), file });
+	}
+	ew::AssetPackStats stats;
+	if (!ew::writeAssetArchive(output, inputs, settings, &stats)) {
+		return 1;
+	}
+	printf("Packed %d assets (%d decoded textures, %d compressed) into %s: %.1f KB from %.1f KB in %.1f ms\n",
+		stats.numEntries, stats.numTextures, stats.numCompressed, output.c_str(),
+		stats.archiveBytes / 1024.0f, stats.inputBytes / 1024.0f, stats.milliseconds);
+	return 0;
+}
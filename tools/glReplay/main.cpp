@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <ew/external/glad.h>
+#include <ew/glCapture.h>
+#include <GLFW/glfw3.h>
+
+//Replays GL captures written by ew::startGlCapture and reports where the time went.
+//Usage: GLReplay <capture> [<capture to compare>] [--top N]
+
+/// <summary>
+/// Replays a capture in a hidden window the size of the captured default framebuffer
+/// </summary>
+/// <returns>False if the capture could not be read or the context could not be created</returns>
+bool replay(const std::string& filePath, ew::GlReplayResult* result) {
+	int width, height, numFrames;
+	if (!ew::readGlCaptureHeader(filePath, &width, &height, &numFrames)) {
+		return false;
+	}
+	//Each capture gets a fresh context, so object names and state from one don't leak into the other
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(width, height, "GL Replay", NULL, NULL);
+	if (window == NULL) {
+		printf("GLFW failed to create window\n");
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGL(glfwGetProcAddress)) {
+		printf("GLAD Failed to load GL headers\n");
+		glfwDestroyWindow(window);
+		return false;
+	}
+	printf("Replaying %s (%d frames, %dx%d) on %s\n", filePath.c_str(), numFrames, width, height, (const char*)glGetString(GL_RENDERER));
+	bool replayed = ew::replayGlCapture(filePath, result);
+	glfwMakeContextCurrent(nullptr);
+	glfwDestroyWindow(window);
+	return replayed;
+}
+
+int main(int argc, char** argv) {
+	std::string captures[2];
+	int numCaptures = 0;
+	int numTop = 20;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+			numTop = atoi(argv[++i]);
+		}
+		else if (numCaptures < 2) {
+			captures[numCaptures++] = argv[i];
+		}
+	}
+	if (numCaptures == 0) {
+		printf("Usage: GLReplay <capture> [<capture to compare>] [--top N]\n");
+		return 1;
+	}
+	if (!glfwInit()) {
+		printf("GLFW failed to init!\n");
+		return 1;
+	}
+
+	ew::GlReplayResult results[2];
+	for (int i = 0; i < numCaptures; i++)
+	{
+		if (!replay(captures[i], &results[i])) {
+			glfwTerminate();
+			return 1;
+		}
+		printf("\n");
+		ew::printGlReplayReport(results[i], numTop);
+		printf("\n");
+	}
+	if (numCaptures == 2) {
+		printf("Comparing %s (A) with %s (B)\n", captures[0].c_str(), captures[1].c_str());
+		ew::printGlReplayDiff(results[0], results[1], numTop);
+	}
+	glfwTerminate();
+	return 0;
+}